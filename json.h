@@ -375,6 +375,8 @@ public:
 #if !defined(JSON_IS_AMALGAMATION)
 #include "forwards.h"
 #endif // if !defined(JSON_IS_AMALGAMATION)
+#include <stddef.h>
+#include <new>
 #include <string>
 #include <vector>
 
@@ -424,6 +426,51 @@ enum CommentPlacement {
 //   typedef CppTL::AnyEnumerator<const Value &> EnumValues;
 //# endif
 
+// pjsettings: memory of strings, member names and containers of values.
+// It comes from the arena of current pjsettings::ArenaScope of the thread,
+// or from operator new when there is no arena in scope.
+JSON_API void *allocateValueMemory(size_t size);
+JSON_API void releaseValueMemory(void *memory);
+
+template <typename T> class ValueMemoryAllocator {
+public:
+  typedef T value_type;
+  typedef T *pointer;
+  typedef const T *const_pointer;
+  typedef T &reference;
+  typedef const T &const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+
+  template <typename U> struct rebind {
+    typedef ValueMemoryAllocator<U> other;
+  };
+
+  ValueMemoryAllocator() {}
+  template <typename U>
+  ValueMemoryAllocator(const ValueMemoryAllocator<U> &) {}
+
+  pointer address(reference value) const { return &value; }
+  const_pointer address(const_reference value) const { return &value; }
+  pointer allocate(size_type count, const void * = 0) {
+    return static_cast<pointer>(allocateValueMemory(count * sizeof(T)));
+  }
+  void deallocate(pointer memory, size_type) { releaseValueMemory(memory); }
+  size_type max_size() const { return size_type(-1) / sizeof(T); }
+  void construct(pointer memory, const T &value) { new (memory) T(value); }
+  void destroy(pointer memory) { memory->~T(); }
+};
+
+template <typename T, typename U>
+bool operator==(const ValueMemoryAllocator<T> &, const ValueMemoryAllocator<U> &) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const ValueMemoryAllocator<T> &, const ValueMemoryAllocator<U> &) {
+  return false;
+}
+
 /** \brief Lightweight wrapper to tag static string.
  *
  * Value constructor and objectValue member assignement takes advantage of the
@@ -552,7 +599,9 @@ private:
 
 public:
 #ifndef JSON_USE_CPPTL_SMALLMAP
-  typedef std::map<CZString, Value> ObjectValues;
+  typedef std::map<CZString, Value, std::less<CZString>,
+                   ValueMemoryAllocator<std::pair<const CZString, Value> > >
+      ObjectValues;
 #else
   typedef CppTL::SmallMap<CZString, Value> ObjectValues;
 #endif // ifndef JSON_USE_CPPTL_SMALLMAP
@@ -198,6 +198,8 @@ static inline void fixNumericLocale(char* begin, char* end) {
 #include <cassert>
 #include <cstring>
 #include <istream>
+#include "pjsettings-arena.h"
+#include "pjsettings-number.h"
 
 #if defined(_MSC_VER) && _MSC_VER >= 1400 // VC++ 8.0
 // Disable warning about strdup being deprecated.
@@ -745,33 +747,11 @@ bool Reader::decodeDouble(Token &token) {
 
 bool Reader::decodeDouble(Token &token, Value &decoded) {
   double value = 0;
-  const int bufferSize = 32;
-  int count;
-  int length = int(token.end_ - token.start_);
-
-  // Sanity check to avoid buffer overflow exploits.
-  if (length < 0) {
-    return addError("Unable to parse token length", token);
-  }
-
-  // Avoid using a string constant for the format control string given to
-  // sscanf, as this can cause hard to debug crashes on OS X. See here for more
-  // info:
-  //
-  //     http://developer.apple.com/library/mac/#DOCUMENTATION/DeveloperTools/gcc-4.0.1/gcc/Incompatibilities.html
-  char format[] = "%lf";
-
-  if (length <= bufferSize) {
-    Char buffer[bufferSize + 1];
-    memcpy(buffer, token.start_, length);
-    buffer[length] = 0;
-    count = sscanf(buffer, format, &value);
-  } else {
-    std::string buffer(token.start_, token.end_);
-    count = sscanf(buffer.c_str(), format, &value);
-  }
 
-  if (count != 1)
+  // pjsettings: locale independent parsing without copying the token,
+  // sscanf takes the locale lock and serializes concurrent readers.
+  // Number at the start of the token is decoded, as sscanf did.
+  if (pjsettings::parseDouble(token.start_, token.end_, value) == token.start_)
     return addError("'" + std::string(token.start_, token.end_) +
                         "' is not a number.",
                     token);
@@ -1587,7 +1567,7 @@ static inline char *duplicateStringValue(const char *value,
   if (length >= (unsigned)Value::maxInt)
     length = Value::maxInt - 1;
 
-  char *newString = static_cast<char *>(malloc(length + 1));
+  char *newString = static_cast<char *>(allocateValueMemory(length + 1));
   JSON_ASSERT_MESSAGE(newString != 0,
                       "in Json::Value::duplicateStringValue(): "
                       "Failed to allocate string value buffer");
@@ -1599,7 +1579,37 @@ static inline char *duplicateStringValue(const char *value,
 /** Free the string duplicated by duplicateStringValue().
  */
 static inline void releaseStringValue(char *value) {
-  free(value);
+  releaseValueMemory(value);
+}
+
+// pjsettings: strings and containers of values are allocated from
+// the arena of document being loaded, see json.h
+void *allocateValueMemory(size_t size) {
+  return pjsettings::allocateArenaMemory(size);
+}
+
+void releaseValueMemory(void *memory) {
+  pjsettings::releaseArenaMemory(memory);
+}
+
+static Value::ObjectValues *newObjectValues() {
+  return new (allocateValueMemory(sizeof(Value::ObjectValues))) Value::ObjectValues();
+}
+
+static Value::ObjectValues *newObjectValues(const Value::ObjectValues &other) {
+  void *memory = allocateValueMemory(sizeof(Value::ObjectValues));
+  try {
+    return new (memory) Value::ObjectValues(other);
+  } catch (...) {
+    releaseValueMemory(memory);
+    throw;
+  }
+}
+
+static void deleteObjectValues(Value::ObjectValues *values) {
+  typedef Value::ObjectValues ObjectValues;
+  values->~ObjectValues();
+  releaseValueMemory(values);
 }
 
 } // namespace Json
@@ -1745,7 +1755,7 @@ Value::Value(ValueType type)
 #ifndef JSON_VALUE_USE_INTERNAL_MAP
   case arrayValue:
   case objectValue:
-    value_.map_ = new ObjectValues();
+    value_.map_ = newObjectValues();
     break;
 #else
   case arrayValue:
@@ -1918,7 +1928,7 @@ Value::Value(const Value &other)
 #ifndef JSON_VALUE_USE_INTERNAL_MAP
   case arrayValue:
   case objectValue:
-    value_.map_ = new ObjectValues(*other.value_.map_);
+    value_.map_ = newObjectValues(*other.value_.map_);
     break;
 #else
   case arrayValue:
@@ -1956,7 +1966,7 @@ Value::~Value() {
 #ifndef JSON_VALUE_USE_INTERNAL_MAP
   case arrayValue:
   case objectValue:
-    delete value_.map_;
+    deleteObjectValues(value_.map_);
     break;
 #else
   case arrayValue:
@@ -0,0 +1,185 @@
+/*
+ * Monotonic memory arena for document trees
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <new>
+#include "pjsettings-arena.h"
+#include "pjsettings-config.h"
+
+namespace pjsettings
+{
+
+    // Allocations are aligned as the most aligned member of jsoncpp values
+    union ArenaAlignment
+    {
+        double number;
+        int64_t integer;
+        void *pointer;
+    };
+
+    static const size_t alignment = sizeof(ArenaAlignment);
+    static const size_t firstChunkSize = 16 * 1024;
+    static const size_t maxChunkSize = 1024 * 1024;
+
+    static size_t align(size_t size)
+    {
+        return (size + alignment - 1) & ~(alignment - 1);
+    }
+
+    // Chunk header is followed by the memory handed out
+    static const size_t chunkHeaderSize = align(sizeof(void *) + sizeof(size_t));
+
+    Arena::Arena()
+        : _chunks(NULL)
+        , _current(NULL)
+        , _end(NULL)
+        , _size(0)
+        , _chunkCount(0)
+        , _nextChunkSize(firstChunkSize)
+    {
+    }
+
+    Arena::Arena(const Arena &)
+        : _chunks(NULL)
+        , _current(NULL)
+        , _end(NULL)
+        , _size(0)
+        , _chunkCount(0)
+        , _nextChunkSize(firstChunkSize)
+    {
+    }
+
+    Arena &Arena::operator=(const Arena &)
+    {
+        // memory stays with the values allocated from it
+        return *this;
+    }
+
+    Arena::~Arena()
+    {
+        release();
+    }
+
+    void *Arena::allocate(size_t size)
+    {
+        size = align(size == 0 ? 1 : size);
+        if (static_cast<size_t>(_end - _current) < size)
+        {
+            // blocks larger than a quarter of chunk get chunk of their own,
+            // so the rest of current chunk is not wasted
+            size_t chunkSize = size > _nextChunkSize / 4 ? size : _nextChunkSize;
+            Chunk *chunk = static_cast<Chunk *>(malloc(chunkHeaderSize + chunkSize));
+            if (chunk == NULL)
+            {
+                throw std::bad_alloc();
+            }
+            chunk->next = _chunks;
+            chunk->size = chunkSize;
+            _chunks = chunk;
+            _size += chunkSize;
+            ++_chunkCount;
+
+            char *memory = reinterpret_cast<char *>(chunk) + chunkHeaderSize;
+            if (chunkSize == size && _current != NULL)
+            {
+                return memory;
+            }
+            _current = memory;
+            _end = memory + chunkSize;
+            if (_nextChunkSize < maxChunkSize)
+            {
+                _nextChunkSize *= 2;
+            }
+        }
+        void *result = _current;
+        _current += size;
+        return result;
+    }
+
+    void Arena::release()
+    {
+        while (_chunks != NULL)
+        {
+            Chunk *next = _chunks->next;
+            free(_chunks);
+            _chunks = next;
+        }
+        _current = NULL;
+        _end = NULL;
+        _size = 0;
+        _chunkCount = 0;
+        _nextChunkSize = firstChunkSize;
+    }
+
+    size_t Arena::size() const
+    {
+        return _size;
+    }
+
+    size_t Arena::chunkCount() const
+    {
+        return _chunkCount;
+    }
+
+    static PJSETTINGS_THREAD_LOCAL Arena *currentArena = NULL;
+
+    ArenaScope::ArenaScope(Arena *arena)
+        : _previous(currentArena)
+    {
+        currentArena = arena;
+    }
+
+    ArenaScope::~ArenaScope()
+    {
+        currentArena = _previous;
+    }
+
+    // Every block is preceded by arena it came from, NULL for heap blocks
+    union BlockHeader
+    {
+        Arena *arena;
+        ArenaAlignment alignment;
+    };
+
+    void *allocateArenaMemory(size_t size)
+    {
+        Arena *arena = currentArena;
+        BlockHeader *header = static_cast<BlockHeader *>(arena != NULL
+            ? arena->allocate(sizeof(BlockHeader) + size)
+            : ::operator new(sizeof(BlockHeader) + size));
+        header->arena = arena;
+        return header + 1;
+    }
+
+    void releaseArenaMemory(void *memory)
+    {
+        if (memory == NULL)
+        {
+            return;
+        }
+        BlockHeader *header = static_cast<BlockHeader *>(memory) - 1;
+        if (header->arena == NULL)
+        {
+            ::operator delete(header);
+        }
+    }
+
+}
@@ -0,0 +1,93 @@
+/*
+ * Monotonic memory arena for document trees
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PJSETTINGS_ARENA_H__
+#define __PJSETTINGS_ARENA_H__
+
+#include <stddef.h>
+
+namespace pjsettings
+{
+    /**
+     * Memory handed out by pointer bump from chunks of growing size.
+     *
+     * Allocations are never freed one by one, all chunks are freed
+     * at once by release() or destructor. Copy of arena is empty arena,
+     * so it can be member of copyable class.
+     */
+    class Arena
+    {
+    public:
+        Arena();
+        Arena(const Arena &);
+        Arena &operator=(const Arena &);
+        ~Arena();
+
+        // aligned as double, throws std::bad_alloc
+        void *allocate(size_t size);
+        void release();
+
+        // Bytes of chunks held and number of chunks
+        size_t size() const;
+        size_t chunkCount() const;
+
+    private:
+        struct Chunk
+        {
+            Chunk *next;
+            size_t size;
+        };
+
+        Chunk *_chunks;
+        char *_current;
+        char *_end;
+        size_t _size;
+        size_t _chunkCount;
+        size_t _nextChunkSize;
+    };
+
+    /**
+     * Makes arena current for allocateArenaMemory() calls of the thread
+     * while in scope, scopes can be nested. NULL arena makes allocations
+     * go to operator new.
+     */
+    class ArenaScope
+    {
+    public:
+        explicit ArenaScope(Arena *arena);
+        ~ArenaScope();
+
+    private:
+        ArenaScope(const ArenaScope &);
+        ArenaScope &operator=(const ArenaScope &);
+
+        Arena *_previous;
+    };
+
+    // Memory of current arena of the thread, or of operator new if there
+    // is no current arena. Block remembers where it came from, so it can be
+    // released in any scope: heap blocks are deleted, arena blocks are kept
+    // until their arena is released.
+    void *allocateArenaMemory(size_t size);
+    void releaseArenaMemory(void *memory);
+}
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * Random access to array items of PJSIP persistent document nodes
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PJSETTINGS_ARRAY_ELEMENTS_H__
+#define __PJSETTINGS_ARRAY_ELEMENTS_H__
+
+#include <string>
+#include <vector>
+
+#ifndef PJSETTINGS_NOT_USE_PJSUA
+#include <pjsua2/persistent.hpp>
+#endif
+
+namespace pjsettings
+{
+    /**
+     * Nodes of every array item at once.
+     *
+     * pj::ContainerNode reads array items one after another through
+     * cursor of array node. Documents implementing this interface read
+     * the array the same way readArray() does and return a node for each
+     * of its items. Node of an item is array node positioned at that item:
+     * next read of the node (readContainer(), readString() and so on,
+     * with any name) reads the item, e.g. item is passed to readObject()
+     * of persistent object as is.
+     *
+     * Nodes don't depend on each other or on array node, so items are read
+     * in any order, and by several threads when document reads concurrently.
+     * Arrays that readArray() can't read throw the same pj::Error,
+     * and so do nodes of other documents.
+     */
+    class ArrayElementsExtension
+    {
+    public:
+        virtual ~ArrayElementsExtension() {}
+
+        // nodes are cleared and filled with nodes of items, capacity of nodes is reused by next reads
+        virtual void readArrayElements(const pj::ContainerNode &node, const std::string &name, std::vector<pj::ContainerNode> &elements) const throw(pj::Error) = 0;
+    };
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * Compiler feature detection for pjsettings
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PJSETTINGS_CONFIG_H__
+#define __PJSETTINGS_CONFIG_H__
+
+// rvalue references (std::string&& overloads)
+#ifndef PJSETTINGS_HAS_RVALUE_REFERENCES
+#   if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1600)
+#       define PJSETTINGS_HAS_RVALUE_REFERENCES 1
+#   else
+#       define PJSETTINGS_HAS_RVALUE_REFERENCES 0
+#   endif
+#endif
+
+// thread local storage of plain variables
+#ifndef PJSETTINGS_THREAD_LOCAL
+#   if defined(_MSC_VER)
+#       define PJSETTINGS_THREAD_LOCAL __declspec(thread)
+#   else
+#       define PJSETTINGS_THREAD_LOCAL __thread
+#   endif
+#endif
+
+// Page pool of PugixmlDocument, the bundled pugixml is patched to take pages from it.
+// External pugixml allocates pages with its memory functions.
+#ifndef PJSETTINGS_HAS_PUGIXML_PAGE_POOL
+#   define PJSETTINGS_HAS_PUGIXML_PAGE_POOL 1
+#endif
+
+// POSIX threads for parallel parsing, otherwise parts are parsed one after another
+#ifndef PJSETTINGS_HAS_PTHREADS
+#   if defined(__unix__) || defined(__APPLE__)
+#       define PJSETTINGS_HAS_PTHREADS 1
+#   else
+#       define PJSETTINGS_HAS_PTHREADS 0
+#   endif
+#endif
+
+#endif
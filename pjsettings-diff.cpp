@@ -0,0 +1,161 @@
+/*
+ * Structural diff of PJSIP persistent documents
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <stdio.h>
+#include "pjsettings-diff.h"
+
+namespace pjsettings
+{
+    static const size_t initialCapacity = 64;
+
+    static size_t hash_address(const void *node)
+    {
+        // nodes are aligned, low bits carry no information
+        uint64_t key = static_cast<uint64_t>(reinterpret_cast<size_t>(node));
+        key *= 0x9E3779B97F4A7C15ULL;
+        return static_cast<size_t>(key >> 32);
+    }
+
+    SubtreeHashCache::SubtreeHashCache()
+        : _entries()
+        , _mask(0)
+        , _size(0)
+    {
+    }
+
+    bool SubtreeHashCache::find(const void *node, uint64_t &hash) const
+    {
+        if (_entries.empty())
+        {
+            return false;
+        }
+        for (size_t i = hash_address(node) & _mask; _entries[i].node != NULL; i = (i + 1) & _mask)
+        {
+            if (_entries[i].node == node)
+            {
+                hash = _entries[i].hash;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void SubtreeHashCache::insert(const void *node, uint64_t hash)
+    {
+        // load factor is kept below 1/2
+        if ((_size + 1) * 2 > _entries.size())
+        {
+            grow();
+        }
+        size_t i = hash_address(node) & _mask;
+        for (; _entries[i].node != NULL; i = (i + 1) & _mask)
+        {
+            if (_entries[i].node == node)
+            {
+                _entries[i].hash = hash;
+                return;
+            }
+        }
+        _entries[i].node = node;
+        _entries[i].hash = hash;
+        ++_size;
+    }
+
+    void SubtreeHashCache::grow()
+    {
+        std::vector<Entry> entries;
+        Entry empty = { NULL, 0 };
+        entries.resize(_entries.empty() ? initialCapacity : _entries.size() * 2, empty);
+        entries.swap(_entries);
+        _mask = _entries.size() - 1;
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            if (entries[i].node != NULL)
+            {
+                size_t j = hash_address(entries[i].node) & _mask;
+                while (_entries[j].node != NULL)
+                {
+                    j = (j + 1) & _mask;
+                }
+                _entries[j] = entries[i];
+            }
+        }
+    }
+
+    void SubtreeHashCache::clear()
+    {
+        if (_size > 0)
+        {
+            std::vector<Entry>().swap(_entries);
+            _mask = 0;
+            _size = 0;
+        }
+    }
+
+    size_t SubtreeHashCache::size() const
+    {
+        return _size;
+    }
+
+    DiffPath::DiffPath(std::vector<std::string> &changed)
+        : _path()
+        , _lengths()
+        , _changed(changed)
+    {
+    }
+
+    void DiffPath::push(const char *name)
+    {
+        _lengths.push_back(_path.size());
+        if (_lengths.size() > 1)
+        {
+            _path += '/';
+        }
+        _path += name;
+    }
+
+    void DiffPath::push(size_t index)
+    {
+        char text[24];
+        snprintf(text, sizeof(text), "%lu", static_cast<unsigned long>(index));
+        push(text);
+    }
+
+    void DiffPath::pop()
+    {
+        _path.resize(_lengths.back());
+        _lengths.pop_back();
+    }
+
+    size_t DiffPath::mark() const
+    {
+        return _changed.size();
+    }
+
+    void DiffPath::report(size_t mark)
+    {
+        _changed.insert(_changed.begin() + mark, _path);
+    }
+
+    void DiffPath::report()
+    {
+        _changed.push_back(_path);
+    }
+}
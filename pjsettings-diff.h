@@ -0,0 +1,91 @@
+/*
+ * Structural diff of PJSIP persistent documents
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PJSETTINGS_DIFF_H__
+#define __PJSETTINGS_DIFF_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace pjsettings
+{
+    /**
+     * Hashes of container subtrees of one document tree.
+     *
+     * Open addressing table keyed by node address. Hashes are valid
+     * while the tree is not changed, so documents clear the cache
+     * when they are loaded or written.
+     */
+    class SubtreeHashCache
+    {
+    public:
+        SubtreeHashCache();
+
+        bool find(const void *node, uint64_t &hash) const;
+        void insert(const void *node, uint64_t hash);
+        void clear();
+        size_t size() const;
+
+    private:
+        struct Entry
+        {
+            const void *node;
+            uint64_t hash;
+        };
+
+        void grow();
+
+        std::vector<Entry> _entries;
+        size_t _mask;
+        size_t _size;
+    };
+
+    /**
+     * Path of container being compared, and list of changed paths.
+     *
+     * Path is made of member names and array indices joined by '/',
+     * for example "accounts/12/AccountConfig". Root container is "".
+     * Container is reported once, before containers found inside it.
+     */
+    class DiffPath
+    {
+    public:
+        explicit DiffPath(std::vector<std::string> &changed);
+
+        void push(const char *name);
+        void push(size_t index);
+        void pop();
+
+        // Position of current container in changed list, taken before its children are compared
+        size_t mark() const;
+        void report(size_t mark);
+        void report();
+
+    private:
+        std::string _path;
+        std::vector<size_t> _lengths;
+        std::vector<std::string> &_changed;
+    };
+}
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ * Fast non-cryptographic hash for pjsettings
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <string.h>
+#include "pjsettings-hash.h"
+
+namespace pjsettings
+{
+
+    static const uint64_t prime1 = 11400714785074694791ULL;
+    static const uint64_t prime2 = 14029467366897019727ULL;
+    static const uint64_t prime3 = 1609587929392839161ULL;
+    static const uint64_t prime4 = 9650029242287828579ULL;
+    static const uint64_t prime5 = 2870177450012600261ULL;
+
+    static inline uint64_t rotl(uint64_t value, int bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    static inline uint64_t read64(const unsigned char *p)
+    {
+        // little endian regardless of platform
+        return static_cast<uint64_t>(p[0])
+            | (static_cast<uint64_t>(p[1]) << 8)
+            | (static_cast<uint64_t>(p[2]) << 16)
+            | (static_cast<uint64_t>(p[3]) << 24)
+            | (static_cast<uint64_t>(p[4]) << 32)
+            | (static_cast<uint64_t>(p[5]) << 40)
+            | (static_cast<uint64_t>(p[6]) << 48)
+            | (static_cast<uint64_t>(p[7]) << 56);
+    }
+
+    static inline uint64_t read32(const unsigned char *p)
+    {
+        return static_cast<uint64_t>(p[0])
+            | (static_cast<uint64_t>(p[1]) << 8)
+            | (static_cast<uint64_t>(p[2]) << 16)
+            | (static_cast<uint64_t>(p[3]) << 24);
+    }
+
+    static inline uint64_t round(uint64_t accumulator, uint64_t input)
+    {
+        accumulator += input * prime2;
+        accumulator = rotl(accumulator, 31);
+        return accumulator * prime1;
+    }
+
+    static inline uint64_t merge_round(uint64_t accumulator, uint64_t value)
+    {
+        accumulator ^= round(0, value);
+        return accumulator * prime1 + prime4;
+    }
+
+    Hash64::Hash64(uint64_t seed)
+    {
+        reset(seed);
+    }
+
+    void Hash64::reset(uint64_t seed)
+    {
+        _seed = seed;
+        _totalSize = 0;
+        _accumulators[0] = seed + prime1 + prime2;
+        _accumulators[1] = seed + prime2;
+        _accumulators[2] = seed;
+        _accumulators[3] = seed - prime1;
+        _bufferSize = 0;
+    }
+
+    void Hash64::update(const void *data, size_t size)
+    {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        const unsigned char *end = p + size;
+        _totalSize += size;
+
+        if (_bufferSize + size < sizeof(_buffer))
+        {
+            memcpy(_buffer + _bufferSize, p, size);
+            _bufferSize += size;
+            return;
+        }
+
+        if (_bufferSize > 0)
+        {
+            size_t fill = sizeof(_buffer) - _bufferSize;
+            memcpy(_buffer + _bufferSize, p, fill);
+            p += fill;
+            for (int i = 0; i < 4; ++i)
+            {
+                _accumulators[i] = round(_accumulators[i], read64(_buffer + i * 8));
+            }
+            _bufferSize = 0;
+        }
+
+        uint64_t v1 = _accumulators[0], v2 = _accumulators[1], v3 = _accumulators[2], v4 = _accumulators[3];
+        while (p + 32 <= end)
+        {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+            p += 32;
+        }
+        _accumulators[0] = v1;
+        _accumulators[1] = v2;
+        _accumulators[2] = v3;
+        _accumulators[3] = v4;
+
+        _bufferSize = static_cast<size_t>(end - p);
+        memcpy(_buffer, p, _bufferSize);
+    }
+
+    uint64_t Hash64::digest() const
+    {
+        uint64_t hash;
+        if (_totalSize >= 32)
+        {
+            const uint64_t *v = _accumulators;
+            hash = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+            for (int i = 0; i < 4; ++i)
+            {
+                hash = merge_round(hash, v[i]);
+            }
+        }
+        else
+        {
+            hash = _seed + prime5;
+        }
+        hash += _totalSize;
+
+        const unsigned char *p = _buffer;
+        const unsigned char *end = _buffer + _bufferSize;
+        while (p + 8 <= end)
+        {
+            hash ^= round(0, read64(p));
+            hash = rotl(hash, 27) * prime1 + prime4;
+            p += 8;
+        }
+        if (p + 4 <= end)
+        {
+            hash ^= read32(p) * prime1;
+            hash = rotl(hash, 23) * prime2 + prime3;
+            p += 4;
+        }
+        while (p < end)
+        {
+            hash ^= (*p) * prime5;
+            hash = rotl(hash, 11) * prime1;
+            ++p;
+        }
+
+        hash ^= hash >> 33;
+        hash *= prime2;
+        hash ^= hash >> 29;
+        hash *= prime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    uint64_t Hash64::calculate(const void *data, size_t size, uint64_t seed)
+    {
+        Hash64 hash(seed);
+        hash.update(data, size);
+        return hash.digest();
+    }
+
+}
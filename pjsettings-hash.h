@@ -0,0 +1,55 @@
+/*
+ * Fast non-cryptographic hash for pjsettings
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PJSETTINGS_HASH_H__
+#define __PJSETTINGS_HASH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace pjsettings
+{
+    /**
+     * Streaming implementation of XXH64 hash by Yann Collet.
+     *
+     * Data can be passed by pieces of any size,
+     * result is the same as for data passed at once.
+     */
+    class Hash64
+    {
+    public:
+        Hash64(uint64_t seed = 0);
+        void reset(uint64_t seed = 0);
+        void update(const void *data, size_t size);
+        uint64_t digest() const;
+
+        static uint64_t calculate(const void *data, size_t size, uint64_t seed = 0);
+
+    private:
+        uint64_t _seed;
+        uint64_t _totalSize;
+        uint64_t _accumulators[4];
+        unsigned char _buffer[32];
+        size_t _bufferSize;
+    };
+}
+
+#endif
@@ -0,0 +1,478 @@
+/*
+ * Parallel parsing of large json arrays for jsoncpp values
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <string.h>
+#include <algorithm>
+#include <exception>
+#include "pjsettings-config.h"
+#include "pjsettings-json-parallel.h"
+
+#if PJSETTINGS_HAS_PTHREADS
+#include <pthread.h>
+#endif
+
+using namespace Json;
+using namespace std;
+
+namespace pjsettings
+{
+
+    /* Structural scan */
+
+    // Whitespace that Json::Reader skips between tokens
+    static bool is_space(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    static const char *skip_space(const char *position, const char *end)
+    {
+        while (position < end && is_space(*position))
+        {
+            ++position;
+        }
+        return position;
+    }
+
+    // Position after comment that starts at position, NULL if there is none or it is not closed
+    static const char *skip_comment(const char *position, const char *end)
+    {
+        if (end - position < 2 || position[0] != '/')
+        {
+            return NULL;
+        }
+        if (position[1] == '/')
+        {
+            for (position += 2; position < end; ++position)
+            {
+                if (*position == '\r' || *position == '\n')
+                {
+                    return position + 1;
+                }
+            }
+            return end;
+        }
+        if (position[1] == '*')
+        {
+            for (position += 2; end - position >= 2; ++position)
+            {
+                if (position[0] == '*' && position[1] == '/')
+                {
+                    return position + 2;
+                }
+            }
+        }
+        return NULL;
+    }
+
+    // Comments outside of the array stay in input parsed by Json::Reader, so they are skipped
+    static const char *skip_space_and_comments(const char *position, const char *end)
+    {
+        while (true)
+        {
+            position = skip_space(position, end);
+            const char *comment = skip_comment(position, end);
+            if (comment == NULL)
+            {
+                return position;
+            }
+            position = comment;
+        }
+    }
+
+    // Closing quote of string whose characters start at position, end if there is none.
+    // Quote preceded by odd number of backslashes is escaped, as Json::Reader reads it.
+    static const char *find_string_end(const char *position, const char *end)
+    {
+        const char *start = position;
+        while (position < end)
+        {
+            const char *quote = static_cast<const char *>(memchr(position, '"', end - position));
+            if (quote == NULL)
+            {
+                return end;
+            }
+            const char *backslashes = quote;
+            while (backslashes > start && backslashes[-1] == '\\')
+            {
+                --backslashes;
+            }
+            if ((quote - backslashes) % 2 == 0)
+            {
+                return quote;
+            }
+            position = quote + 1;
+        }
+        return end;
+    }
+
+    // ',' or '}' after value of root object member, NULL if a string or comment is not closed
+    static const char *find_member_end(const char *position, const char *end)
+    {
+        size_t depth = 0;
+        for (; position < end; ++position)
+        {
+            switch (*position)
+            {
+            case '"':
+                position = find_string_end(position + 1, end);
+                if (position == end)
+                {
+                    return NULL;
+                }
+                break;
+            case '{':
+            case '[':
+                ++depth;
+                break;
+            case '}':
+            case ']':
+                if (depth == 0)
+                {
+                    return position;
+                }
+                --depth;
+                break;
+            case ',':
+                if (depth == 0)
+                {
+                    return position;
+                }
+                break;
+            case '/':
+                {
+                    const char *comment = skip_comment(position, end);
+                    if (comment == NULL)
+                    {
+                        return NULL;
+                    }
+                    position = comment - 1;
+                }
+                break;
+            }
+        }
+        return end;
+    }
+
+    static bool add_item(const char *begin, const char *item, const char *separator, JsonArrayItems &items)
+    {
+        const char *itemEnd = separator;
+        while (itemEnd > item && is_space(itemEnd[-1]))
+        {
+            --itemEnd;
+        }
+        if (itemEnd == item)
+        {
+            return false;
+        }
+        items.begins.push_back(item - begin);
+        items.ends.push_back(itemEnd - begin);
+        return true;
+    }
+
+    // Position after ']' of array which '[' is at open, NULL if items can't be split
+    static const char *scan_items(const char *begin, const char *open, const char *end, JsonArrayItems &items)
+    {
+        items.open = open - begin;
+        const char *position = skip_space(open + 1, end);
+        if (position < end && *position == ']')
+        {
+            items.close = position - begin;
+            return position + 1;
+        }
+
+        const char *item = position;
+        size_t depth = 0;
+        for (; position < end; ++position)
+        {
+            switch (*position)
+            {
+            case '"':
+                position = find_string_end(position + 1, end);
+                if (position == end)
+                {
+                    return NULL;
+                }
+                break;
+            case '{':
+            case '[':
+                ++depth;
+                break;
+            case '}':
+                if (depth == 0)
+                {
+                    return NULL;
+                }
+                --depth;
+                break;
+            case ']':
+                if (depth > 0)
+                {
+                    --depth;
+                    break;
+                }
+                if (!add_item(begin, item, position, items))
+                {
+                    return NULL;
+                }
+                items.close = position - begin;
+                return position + 1;
+            case ',':
+                if (depth > 0)
+                {
+                    break;
+                }
+                if (!add_item(begin, item, position, items))
+                {
+                    return NULL;
+                }
+                item = skip_space(position + 1, end);
+                position = item - 1;
+                break;
+            case '/':
+                // comments are attached to neighbour values, only Json::Reader knows which
+                return NULL;
+            }
+        }
+        return NULL;
+    }
+
+    bool scanJsonArrayItems(const char *begin, const char *end, const string &arrayName, JsonArrayItems &items)
+    {
+        items = JsonArrayItems();
+        const char *position = skip_space_and_comments(begin, end);
+        if (arrayName.empty())
+        {
+            return position < end && *position == '[' && scan_items(begin, position, end, items) != NULL;
+        }
+
+        if (position == end || *position != '{')
+        {
+            return false;
+        }
+        position = skip_space_and_comments(position + 1, end);
+        bool found = false;
+        while (position < end && *position == '"')
+        {
+            const char *name = position + 1;
+            const char *nameEnd = find_string_end(name, end);
+            // escaped name may be the same as array name after all
+            if (nameEnd == end || memchr(name, '\\', nameEnd - name) != NULL)
+            {
+                return false;
+            }
+            position = skip_space_and_comments(nameEnd + 1, end);
+            if (position == end || *position != ':')
+            {
+                return false;
+            }
+            position = skip_space_and_comments(position + 1, end);
+
+            if (arrayName.size() == static_cast<size_t>(nameEnd - name) && memcmp(name, arrayName.data(), arrayName.size()) == 0)
+            {
+                // the last of duplicate members is kept by Json::Reader
+                if (found || position == end || *position != '[')
+                {
+                    return false;
+                }
+                found = true;
+                position = scan_items(begin, position, end, items);
+                if (position == NULL)
+                {
+                    return false;
+                }
+            }
+
+            position = find_member_end(position, end);
+            if (position == NULL || position == end)
+            {
+                return false;
+            }
+            if (*position == '}')
+            {
+                return found;
+            }
+            if (*position != ',')
+            {
+                return false;
+            }
+            position = skip_space_and_comments(position + 1, end);
+        }
+        return false;
+    }
+
+    /* Parallel parsing */
+
+    // Offsets of values at or after from are moved by shift
+    static void shift_offsets(Value &value, size_t from, size_t shift)
+    {
+        if (value.getOffsetStart() >= from)
+        {
+            value.setOffsetStart(value.getOffsetStart() + shift);
+        }
+        if (value.getOffsetLimit() >= from)
+        {
+            value.setOffsetLimit(value.getOffsetLimit() + shift);
+        }
+        if (value.isArray() || value.isObject())
+        {
+            for (Value::iterator it = value.begin(); it != value.end(); ++it)
+            {
+                shift_offsets(*it, from, shift);
+            }
+        }
+    }
+
+    struct ItemsChunk
+    {
+        const char *input;
+        const JsonArrayItems *items;
+        Value *const *values;
+        size_t first;
+        size_t last;
+        Arena *arena;
+        bool parsed;
+    };
+
+    static void parse_items(ItemsChunk &chunk)
+    {
+        chunk.parsed = false;
+        try
+        {
+            Reader reader;
+            for (size_t i = chunk.first; i < chunk.last; ++i)
+            {
+                const char *itemBegin = chunk.input + chunk.items->begins[i];
+                const char *itemEnd = chunk.input + chunk.items->ends[i];
+                Value &value = *chunk.values[i];
+                // value that ends before the item does is not what Json::Reader reads
+                // from the whole input, e.g. "1 2" is an error of missing ','
+                if (!reader.parse(itemBegin, itemEnd, value) || value.getOffsetLimit() != static_cast<size_t>(itemEnd - itemBegin))
+                {
+                    return;
+                }
+                shift_offsets(value, 0, chunk.items->begins[i]);
+            }
+            chunk.parsed = true;
+        }
+        catch (std::exception &)
+        {
+        }
+    }
+
+    static void *parse_items_thread(void *argument)
+    {
+        ItemsChunk &chunk = *static_cast<ItemsChunk *>(argument);
+        ArenaScope scope(chunk.arena);
+        parse_items(chunk);
+        return NULL;
+    }
+
+    bool parseJsonArrayInParallel(const char *begin, const char *end, const string &arrayName,
+        unsigned threads, Value &root, vector<Arena> *threadArenas)
+    {
+        JsonArrayItems items;
+        if (threads < 2 || !scanJsonArrayItems(begin, end, arrayName, items) || items.begins.size() < 2)
+        {
+            return false;
+        }
+
+        // input with the array left empty, its "[" and "]" are kept
+        size_t removed = items.close - items.open - 1;
+        string skeleton;
+        skeleton.reserve((end - begin) - removed);
+        skeleton.append(begin, items.open + 1);
+        skeleton.append(begin + items.close, end);
+        Reader reader;
+        if (!reader.parse(skeleton.data(), skeleton.data() + skeleton.size(), root))
+        {
+            return false;
+        }
+        shift_offsets(root, items.open + 1, removed);
+        Value &array = arrayName.empty() ? root : root[arrayName];
+        if (!array.isArray() || !array.empty())
+        {
+            return false;
+        }
+
+        // items are added in order on this thread as Json::Reader adds them,
+        // threads parse into values that are there already
+        size_t count = items.begins.size();
+        vector<Value *> values(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            values[i] = &array[static_cast<ArrayIndex>(i)];
+        }
+
+        // chunks hold about the same bytes of the array
+        size_t chunkCount = min<size_t>(threads, count);
+        if (threadArenas != NULL)
+        {
+            chunkCount = min(chunkCount, threadArenas->size() + 1);
+        }
+        vector<ItemsChunk> chunks(chunkCount);
+        size_t arrayBytes = items.close - items.open;
+        size_t first = 0;
+        for (size_t c = 0; c < chunkCount; ++c)
+        {
+            size_t last = count;
+            if (c + 1 < chunkCount)
+            {
+                size_t limit = items.open + arrayBytes * (c + 1) / chunkCount;
+                last = lower_bound(items.begins.begin(), items.begins.end(), limit) - items.begins.begin();
+                last = min(max(last, first + 1), count - (chunkCount - c - 1));
+            }
+            ItemsChunk chunk = { begin, &items, &values[0], first, last, NULL, false };
+            if (c > 0 && threadArenas != NULL)
+            {
+                chunk.arena = &(*threadArenas)[c - 1];
+            }
+            chunks[c] = chunk;
+            first = last;
+        }
+
+#if PJSETTINGS_HAS_PTHREADS
+        vector<pthread_t> handles(chunkCount);
+        vector<char> started(chunkCount, 0);
+        for (size_t c = 1; c < chunkCount; ++c)
+        {
+            started[c] = pthread_create(&handles[c], NULL, &parse_items_thread, &chunks[c]) == 0;
+        }
+#endif
+        // the first chunk goes to arena of this thread
+        parse_items(chunks[0]);
+        bool parsed = chunks[0].parsed;
+        for (size_t c = 1; c < chunkCount; ++c)
+        {
+#if PJSETTINGS_HAS_PTHREADS
+            if (started[c])
+            {
+                pthread_join(handles[c], NULL);
+                parsed = parsed && chunks[c].parsed;
+                continue;
+            }
+#endif
+            parse_items_thread(&chunks[c]);
+            parsed = parsed && chunks[c].parsed;
+        }
+        return parsed;
+    }
+
+}
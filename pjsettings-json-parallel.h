@@ -0,0 +1,81 @@
+/*
+ * Parallel parsing of large json arrays for jsoncpp values
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PJSETTINGS_JSON_PARALLEL_H__
+#define __PJSETTINGS_JSON_PARALLEL_H__
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "pjsettings-arena.h"
+
+#ifndef PJSETTINGS_NOT_USE_PJSUA
+#include "json.h"
+#endif
+
+namespace pjsettings
+{
+    // Items of json array, offsets are from the start of input
+    struct JsonArrayItems
+    {
+        JsonArrayItems() : open(0), close(0) {}
+
+        size_t open;                    // '[' of the array
+        size_t close;                   // ']' of the array
+        std::vector<size_t> begins;     // first character of item
+        std::vector<size_t> ends;       // after last character of item, spaces excluded
+    };
+
+    /**
+     * Finds items of the root array (arrayName is empty) or of array
+     * member of the root object by structural scan: strings are skipped,
+     * brackets counted, nothing is parsed or allocated per item.
+     * Comments outside of the array are skipped.
+     *
+     * Returns false if the array is not there, the root object has the
+     * member twice or has member names with escapes, the array holds
+     * comments or empty items, or the input ends inside of it.
+     * Scan does not validate input, items are checked when they are parsed.
+     */
+    bool scanJsonArrayItems(const char *begin, const char *end, const std::string &arrayName, JsonArrayItems &items);
+
+    /**
+     * Parses input into root with Json::Reader, with items of array found
+     * by scanJsonArrayItems() split by size between threads.
+     *
+     * Input without the items is parsed on calling thread, so the array is
+     * empty, then items are parsed one by one on their threads straight into
+     * the array. Item is accepted only if it is parsed up to its end, so
+     * the items are the values Json::Reader reads from the whole input.
+     * Offsets of values are moved to the whole input too.
+     *
+     * Values of calling thread are allocated in its current arena, values
+     * of other threads in threadArenas (one arena per thread but the first,
+     * heap if NULL). Returns false if the array is not found, has less than
+     * two items, or any part of input fails to parse: root is left partially
+     * parsed then and input is to be parsed by Json::Reader, which reports
+     * errors with their lines and columns.
+     */
+    bool parseJsonArrayInParallel(const char *begin, const char *end, const std::string &arrayName,
+        unsigned threads, Json::Value &root, std::vector<Arena> *threadArenas);
+}
+
+#endif
@@ -0,0 +1,997 @@
+/*
+ * PJSIP persistent document implementation based on streaming json parser
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <string.h>
+#include <sstream>
+#include "pjsettings-json-stream.h"
+#include "pjsettings-number.h"
+
+using namespace pj;
+using namespace Json;
+using namespace std;
+
+namespace pjsettings
+{
+
+    /* Json stream node operations */
+    static bool          jsonStreamNode_hasUnread(const ContainerNode*);
+    static string        jsonStreamNode_unreadName(const ContainerNode*n) throw(Error);
+    static float         jsonStreamNode_readNumber(const ContainerNode*, const string&) throw(Error);
+    static bool          jsonStreamNode_readBool(const ContainerNode*, const string&) throw(Error);
+    static string        jsonStreamNode_readString(const ContainerNode*, const string&) throw(Error);
+    static StringVector  jsonStreamNode_readStringVector(const ContainerNode*, const string&) throw(Error);
+    static ContainerNode jsonStreamNode_readContainer(const ContainerNode*, const string &) throw(Error);
+    static ContainerNode jsonStreamNode_readArray(const ContainerNode*, const string &) throw(Error);
+    static void          jsonStreamNode_writeNumber(ContainerNode*, const string &name, float num) throw(Error);
+    static void          jsonStreamNode_writeBool(ContainerNode*, const string &name, bool value) throw(Error);
+    static void          jsonStreamNode_writeString(ContainerNode*, const string &name, const string &value) throw(Error);
+    static void          jsonStreamNode_writeStringVector(ContainerNode*, const string &name, const StringVector &value) throw(Error);
+    static ContainerNode jsonStreamNode_writeNewContainer(ContainerNode*, const string &name) throw(Error);
+    static ContainerNode jsonStreamNode_writeNewArray(ContainerNode*, const string &name) throw(Error);
+
+    static container_node_op json_stream_op = {
+        &jsonStreamNode_hasUnread,
+        &jsonStreamNode_unreadName,
+        &jsonStreamNode_readNumber,
+        &jsonStreamNode_readBool,
+        &jsonStreamNode_readString,
+        &jsonStreamNode_readStringVector,
+        &jsonStreamNode_readContainer,
+        &jsonStreamNode_readArray,
+        &jsonStreamNode_writeNumber,
+        &jsonStreamNode_writeBool,
+        &jsonStreamNode_writeString,
+        &jsonStreamNode_writeStringVector,
+        &jsonStreamNode_writeNewContainer,
+        &jsonStreamNode_writeNewArray
+    };
+
+    static const size_t fileChunkSize = 64 * 1024;
+    static const unsigned maxNestingDepth = 1000;
+
+    /* Json stream parser */
+
+    JsonStreamParser::JsonStreamParser()
+        : _file(NULL)
+        , _filename()
+        , _buffer()
+        , _text()
+        , _position(NULL)
+        , _end(NULL)
+        , _line(1)
+        , _column(1)
+    {
+    }
+
+    JsonStreamParser::~JsonStreamParser()
+    {
+        close();
+    }
+
+    void JsonStreamParser::openFile(const std::string &filename) throw(pj::Error)
+    {
+        close();
+        _file = fopen(filename.c_str(), "rb");
+        if (_file == NULL)
+        {
+            throw Error(1, "there is no file exists", filename, __FILE__, __LINE__);
+        }
+        _filename = filename;
+        _buffer.resize(fileChunkSize);
+    }
+
+    void JsonStreamParser::openBuffer(const char *input, size_t size)
+    {
+        close();
+        _text.assign(input, size);
+        _position = _text.data();
+        _end = _position + _text.size();
+    }
+
+    void JsonStreamParser::close()
+    {
+        if (_file != NULL)
+        {
+            fclose(_file);
+        }
+        _file = NULL;
+        _filename.clear();
+        std::vector<char>().swap(_buffer);
+        std::string().swap(_text);
+        _position = NULL;
+        _end = NULL;
+        _line = 1;
+        _column = 1;
+    }
+
+    bool JsonStreamParser::fill()
+    {
+        if (_file == NULL)
+        {
+            return false;
+        }
+        size_t size = fread(&_buffer[0], 1, _buffer.size(), _file);
+        if (size == 0)
+        {
+            return false;
+        }
+        _position = &_buffer[0];
+        _end = _position + size;
+        return true;
+    }
+
+    int JsonStreamParser::peekChar()
+    {
+        if (_position == _end && !fill())
+        {
+            return -1;
+        }
+        return static_cast<unsigned char>(*_position);
+    }
+
+    int JsonStreamParser::getChar()
+    {
+        int c = peekChar();
+        if (c < 0)
+        {
+            return c;
+        }
+        ++_position;
+        if (c == '\n')
+        {
+            ++_line;
+            _column = 1;
+        }
+        else
+        {
+            ++_column;
+        }
+        return c;
+    }
+
+    void JsonStreamParser::fail(const std::string &message) const throw(pj::Error)
+    {
+        std::ostringstream reason;
+        reason << "* Line " << _line << ", Column " << _column << "\n  " << message << "\n";
+        throw Error(1, "json stream parse error", reason.str(), _filename, 0);
+    }
+
+    void JsonStreamParser::skipSpace() throw(pj::Error)
+    {
+        for (;;)
+        {
+            int c = peekChar();
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            {
+                getChar();
+            }
+            else if (c == '/')
+            {
+                // comments are allowed like in Json::Reader
+                getChar();
+                int kind = getChar();
+                if (kind == '/')
+                {
+                    while ((c = getChar()) >= 0 && c != '\n')
+                    {
+                    }
+                }
+                else if (kind == '*')
+                {
+                    int previous = 0;
+                    while ((c = getChar()) >= 0 && !(previous == '*' && c == '/'))
+                    {
+                        previous = c;
+                    }
+                    if (c < 0)
+                    {
+                        fail("Syntax error: comment is not closed.");
+                    }
+                }
+                else
+                {
+                    fail("Syntax error: value, object or array expected.");
+                }
+            }
+            else
+            {
+                return;
+            }
+        }
+    }
+
+    int JsonStreamParser::peek() throw(pj::Error)
+    {
+        skipSpace();
+        return peekChar();
+    }
+
+    void JsonStreamParser::expect(char expected) throw(pj::Error)
+    {
+        if (peek() != static_cast<unsigned char>(expected))
+        {
+            fail(std::string("Missing '") + expected + "'");
+        }
+        getChar();
+    }
+
+    std::string JsonStreamParser::readString() throw(pj::Error)
+    {
+        std::string value;
+        readString(&value);
+        return value;
+    }
+
+    static void append_utf8(std::string &value, unsigned codePoint)
+    {
+        if (codePoint < 0x80)
+        {
+            value += static_cast<char>(codePoint);
+        }
+        else if (codePoint < 0x800)
+        {
+            value += static_cast<char>(0xC0 | (codePoint >> 6));
+            value += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        else if (codePoint < 0x10000)
+        {
+            value += static_cast<char>(0xE0 | (codePoint >> 12));
+            value += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            value += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        else
+        {
+            value += static_cast<char>(0xF0 | (codePoint >> 18));
+            value += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            value += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            value += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+    }
+
+    void JsonStreamParser::readString(std::string *value) throw(pj::Error)
+    {
+        if (peek() != '"')
+        {
+            fail("Missing '\"'");
+        }
+        getChar();
+        for (;;)
+        {
+            int c = getChar();
+            if (c < 0)
+            {
+                fail("Missing '\"', end of input in string.");
+            }
+            if (c == '"')
+            {
+                return;
+            }
+            if (c != '\\')
+            {
+                if (value != NULL)
+                {
+                    *value += static_cast<char>(c);
+                }
+                continue;
+            }
+
+            int escape = getChar();
+            char decoded = 0;
+            switch (escape)
+            {
+            case '"': decoded = '"'; break;
+            case '/': decoded = '/'; break;
+            case '\\': decoded = '\\'; break;
+            case 'b': decoded = '\b'; break;
+            case 'f': decoded = '\f'; break;
+            case 'n': decoded = '\n'; break;
+            case 'r': decoded = '\r'; break;
+            case 't': decoded = '\t'; break;
+            case 'u':
+            {
+                unsigned codePoint = 0;
+                for (int surrogate = 0; surrogate < 2; ++surrogate)
+                {
+                    unsigned unit = 0;
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        int digit = getChar();
+                        unit <<= 4;
+                        if (digit >= '0' && digit <= '9') unit += digit - '0';
+                        else if (digit >= 'a' && digit <= 'f') unit += digit - 'a' + 10;
+                        else if (digit >= 'A' && digit <= 'F') unit += digit - 'A' + 10;
+                        else fail("Bad unicode escape sequence in string: hexadecimal digit expected.");
+                    }
+                    if (surrogate == 0)
+                    {
+                        codePoint = unit;
+                        if (unit < 0xD800 || unit > 0xDBFF)
+                        {
+                            break;
+                        }
+                        if (getChar() != '\\' || getChar() != 'u')
+                        {
+                            fail("expecting another \\u token to begin the second half of a unicode surrogate pair");
+                        }
+                    }
+                    else
+                    {
+                        codePoint = 0x10000 + ((codePoint & 0x3FF) << 10) + (unit & 0x3FF);
+                    }
+                }
+                if (value != NULL)
+                {
+                    append_utf8(*value, codePoint);
+                }
+                continue;
+            }
+            default:
+                fail("Bad escape sequence in string");
+            }
+            if (value != NULL)
+            {
+                *value += decoded;
+            }
+        }
+    }
+
+    void JsonStreamParser::readLiteral(const char *literal) throw(pj::Error)
+    {
+        for (const char *expected = literal; *expected != '\0'; ++expected)
+        {
+            if (getChar() != *expected)
+            {
+                fail("Syntax error: value, object or array expected.");
+            }
+        }
+    }
+
+    void JsonStreamParser::readNumber(Json::Value *value) throw(pj::Error)
+    {
+        std::string token;
+        for (int c = peekChar(); c > 0 && strchr("0123456789+-.eE", c) != NULL; c = peekChar())
+        {
+            token += static_cast<char>(getChar());
+        }
+
+        // same decoding as Json::Reader::decodeNumber
+        bool isDouble = false;
+        for (size_t i = 0; i < token.size(); ++i)
+        {
+            char c = token[i];
+            isDouble = isDouble || c == '.' || c == 'e' || c == 'E' || c == '+' || (c == '-' && i != 0);
+        }
+
+        bool isNegative = !token.empty() && token[0] == '-';
+        Value::LargestUInt maxIntegerValue = isNegative ? Value::LargestUInt(-Value::minLargestInt) : Value::maxLargestUInt;
+        Value::LargestUInt threshold = maxIntegerValue / 10;
+        Value::LargestUInt integer = 0;
+        for (size_t i = isNegative ? 1 : 0; i < token.size() && !isDouble; ++i)
+        {
+            char c = token[i];
+            if (c < '0' || c > '9')
+            {
+                fail("'" + token + "' is not a number.");
+            }
+            Value::UInt digit(c - '0');
+            if (integer >= threshold && (integer > threshold || i + 1 != token.size() || digit > maxIntegerValue % 10))
+            {
+                isDouble = true;
+                break;
+            }
+            integer = integer * 10 + digit;
+        }
+
+        if (isDouble)
+        {
+            double real = 0;
+            const char *end = token.data() + token.size();
+            if (token.empty() || parseDouble(token.data(), end, real) != end)
+            {
+                fail("'" + token + "' is not a number.");
+            }
+            if (value != NULL)
+            {
+                *value = real;
+            }
+            return;
+        }
+        if (token.empty() || (isNegative && token.size() == 1))
+        {
+            fail("'" + token + "' is not a number.");
+        }
+        if (value == NULL)
+        {
+            return;
+        }
+        if (isNegative)
+        {
+            *value = -Value::LargestInt(integer);
+        }
+        else if (integer <= Value::LargestUInt(Value::maxInt))
+        {
+            *value = Value::LargestInt(integer);
+        }
+        else
+        {
+            *value = integer;
+        }
+    }
+
+    void JsonStreamParser::readValue(Json::Value *value) throw(pj::Error)
+    {
+        readValue(value, 0);
+    }
+
+    void JsonStreamParser::readValue(Json::Value *value, unsigned depth) throw(pj::Error)
+    {
+        if (depth > maxNestingDepth)
+        {
+            fail("Exceeded stack limit");
+        }
+
+        int c = peek();
+        switch (c)
+        {
+        case '{':
+            getChar();
+            if (value != NULL)
+            {
+                *value = Value(objectValue);
+            }
+            if (peek() == '}')
+            {
+                getChar();
+                return;
+            }
+            for (;;)
+            {
+                if (peek() != '"')
+                {
+                    fail("Missing '}' or object member name");
+                }
+                if (value != NULL)
+                {
+                    std::string name = readString();
+                    expect(':');
+                    readValue(&(*value)[name], depth + 1);
+                }
+                else
+                {
+                    readString(NULL);
+                    expect(':');
+                    readValue(NULL, depth + 1);
+                }
+                c = peek();
+                getChar();
+                if (c == '}')
+                {
+                    return;
+                }
+                if (c != ',')
+                {
+                    fail("Missing ',' or '}' in object declaration");
+                }
+            }
+        case '[':
+            getChar();
+            if (value != NULL)
+            {
+                *value = Value(arrayValue);
+            }
+            if (peek() == ']')
+            {
+                getChar();
+                return;
+            }
+            for (;;)
+            {
+                readValue(value != NULL ? &value->append(Value()) : NULL, depth + 1);
+                c = peek();
+                getChar();
+                if (c == ']')
+                {
+                    return;
+                }
+                if (c != ',')
+                {
+                    fail("Missing ',' or ']' in array declaration");
+                }
+            }
+        case '"':
+            if (value != NULL)
+            {
+                *value = readString();
+            }
+            else
+            {
+                readString(NULL);
+            }
+            return;
+        case 't':
+            readLiteral("true");
+            if (value != NULL)
+            {
+                *value = true;
+            }
+            return;
+        case 'f':
+            readLiteral("false");
+            if (value != NULL)
+            {
+                *value = false;
+            }
+            return;
+        case 'n':
+            readLiteral("null");
+            if (value != NULL)
+            {
+                *value = Value();
+            }
+            return;
+        default:
+            if (c == '-' || (c >= '0' && c <= '9'))
+            {
+                readNumber(value);
+                return;
+            }
+            fail("Syntax error: value, object or array expected.");
+        }
+    }
+
+    /* Json stream document */
+
+    JsonStreamFrame::JsonStreamFrame()
+        : generation(0)
+        , streamed(false)
+        , isArray(false)
+        , finished(false)
+        , first(true)
+        , itemReady(false)
+        , pending()
+        , storage()
+        , value(NULL)
+        , index(0)
+    {
+    }
+
+    JsonStreamDocument::JsonStreamDocument()
+        : _parser()
+        , _frames()
+        , _generation(0)
+        , _rootNode()
+    {
+        // empty document reads default values
+        _frames.push_back(JsonStreamFrame());
+        JsonStreamFrame &root = _frames.back();
+        root.generation = ++_generation;
+        root.storage = Value(objectValue);
+        root.value = &root.storage;
+        _rootNode.op = &json_stream_op;
+        _rootNode.data.doc = this;
+        _rootNode.data.data1 = reinterpret_cast<void*>(0);
+        _rootNode.data.data2 = reinterpret_cast<void*>(root.generation);
+    }
+
+    void JsonStreamDocument::initRoot() throw(pj::Error)
+    {
+        _frames.clear();
+        if (_parser.peek() != '{')
+        {
+            _parser.fail("Syntax error: object expected.");
+        }
+        _parser.expect('{');
+        _frames.push_back(JsonStreamFrame());
+        JsonStreamFrame &root = _frames.back();
+        root.generation = ++_generation;
+        root.streamed = true;
+        _rootNode.op = &json_stream_op;
+        _rootNode.data.doc = this;
+        _rootNode.data.data1 = reinterpret_cast<void*>(0);
+        _rootNode.data.data2 = reinterpret_cast<void*>(root.generation);
+    }
+
+    void JsonStreamDocument::loadFile(const std::string &filename) throw(pj::Error)
+    {
+        _parser.openFile(filename);
+        initRoot();
+    }
+
+    void JsonStreamDocument::loadString(const std::string &input) throw(pj::Error)
+    {
+        loadBuffer(input.data(), input.size());
+    }
+
+    void JsonStreamDocument::loadBuffer(const char *input, size_t size) throw(pj::Error)
+    {
+        _parser.openBuffer(input, size);
+        initRoot();
+    }
+
+    void JsonStreamDocument::saveFile(const std::string &filename) throw(pj::Error)
+    {
+        throw Error(1, "json stream save to file error", "json stream document is read-only", filename, 0);
+    }
+
+    std::string JsonStreamDocument::saveString() throw(pj::Error)
+    {
+        throw Error(1, "json stream save to string error", "json stream document is read-only", "", 0);
+    }
+
+    pj::ContainerNode &JsonStreamDocument::getRootContainer() const
+    {
+        return _rootNode;
+    }
+
+    JsonStreamFrame &JsonStreamDocument::activateFrame(const ContainerNode *node) throw(pj::Error)
+    {
+        size_t depth = reinterpret_cast<size_t>(node->data.data1);
+        size_t generation = reinterpret_cast<size_t>(node->data.data2);
+        if (depth >= _frames.size() || _frames[depth].generation != generation)
+        {
+            throw Error(1, "json stream read error", "container is already read to the end", "", 0);
+        }
+        while (_frames.size() > depth + 1)
+        {
+            finishFrame(_frames.back());
+            _frames.pop_back();
+        }
+        return _frames[depth];
+    }
+
+    void JsonStreamDocument::finishFrame(JsonStreamFrame &frame) throw(pj::Error)
+    {
+        if (!frame.streamed)
+        {
+            return;
+        }
+        if (frame.isArray)
+        {
+            while (hasUnreadItem(frame))
+            {
+                frame.itemReady = false;
+                _parser.readValue(NULL);
+            }
+        }
+        else
+        {
+            std::string name;
+            while (nextMember(frame, name))
+            {
+                _parser.readValue(NULL);
+            }
+        }
+    }
+
+    bool JsonStreamDocument::hasUnreadItem(JsonStreamFrame &frame) throw(pj::Error)
+    {
+        if (!frame.isArray)
+        {
+            return false;
+        }
+        if (!frame.streamed)
+        {
+            return frame.value->isValidIndex(frame.index);
+        }
+        if (frame.finished)
+        {
+            return false;
+        }
+        if (frame.itemReady)
+        {
+            return true;
+        }
+        int c = _parser.peek();
+        if (c == ']')
+        {
+            _parser.expect(']');
+            frame.finished = true;
+            return false;
+        }
+        if (!frame.first)
+        {
+            if (c != ',')
+            {
+                _parser.fail("Missing ',' or ']' in array declaration");
+            }
+            _parser.expect(',');
+        }
+        frame.first = false;
+        frame.itemReady = true;
+        return true;
+    }
+
+    bool JsonStreamDocument::nextMember(JsonStreamFrame &frame, std::string &name) throw(pj::Error)
+    {
+        if (frame.finished)
+        {
+            return false;
+        }
+        int c = _parser.peek();
+        if (c == '}')
+        {
+            _parser.expect('}');
+            frame.finished = true;
+            return false;
+        }
+        if (!frame.first)
+        {
+            if (c != ',')
+            {
+                _parser.fail("Missing ',' or '}' in object declaration");
+            }
+            _parser.expect(',');
+        }
+        frame.first = false;
+        if (_parser.peek() != '"')
+        {
+            _parser.fail("Missing '}' or object member name");
+        }
+        name = _parser.readString();
+        _parser.expect(':');
+        return true;
+    }
+
+    bool JsonStreamDocument::findMember(JsonStreamFrame &frame, const std::string &name) throw(pj::Error)
+    {
+        // members on the way are kept, they can be read later
+        std::string memberName;
+        while (nextMember(frame, memberName))
+        {
+            if (memberName == name)
+            {
+                return true;
+            }
+            _parser.readValue(&frame.pending[memberName]);
+        }
+        return false;
+    }
+
+    const Json::Value *JsonStreamDocument::bufferedValue(JsonStreamFrame &frame, const std::string &name) throw(pj::Error)
+    {
+        if (frame.isArray)
+        {
+            if (!frame.value->isValidIndex(frame.index))
+            {
+                throw Error(1, "read container error", "no more container items in array", "", frame.index + 1);
+            }
+            return &(*frame.value)[frame.index++];
+        }
+        const Json::Value &parent = *frame.value;
+        return &parent[name];
+    }
+
+    void JsonStreamDocument::readItem(JsonStreamFrame &frame, const std::string &name, Json::Value &value) throw(pj::Error)
+    {
+        if (!frame.streamed)
+        {
+            value = *bufferedValue(frame, name);
+        }
+        else if (frame.isArray)
+        {
+            if (!hasUnreadItem(frame))
+            {
+                throw Error(1, "read container error", "no more container items in array", "", 0);
+            }
+            frame.itemReady = false;
+            _parser.readValue(&value);
+        }
+        else
+        {
+            std::map<std::string, Json::Value>::iterator pending = frame.pending.find(name);
+            if (pending != frame.pending.end())
+            {
+                value.swap(pending->second);
+                frame.pending.erase(pending);
+            }
+            else if (findMember(frame, name))
+            {
+                _parser.readValue(&value);
+            }
+            else
+            {
+                value = Value();
+            }
+        }
+    }
+
+    ContainerNode JsonStreamDocument::pushFrame(JsonStreamFrame &frame)
+    {
+        frame.generation = ++_generation;
+        ContainerNode childNode = {};
+        childNode.op = &json_stream_op;
+        childNode.data.doc = this;
+        childNode.data.data1 = reinterpret_cast<void*>(_frames.size() - 1);
+        childNode.data.data2 = reinterpret_cast<void*>(frame.generation);
+        return childNode;
+    }
+
+    ContainerNode JsonStreamDocument::readItemContainer(JsonStreamFrame &frame, const std::string &name, bool isArray) throw(pj::Error)
+    {
+        const Json::Value *bufferedParent = NULL;
+        Json::Value buffered;
+        bool streamed = false;
+        if (!frame.streamed)
+        {
+            bufferedParent = bufferedValue(frame, name);
+        }
+        else
+        {
+            bool found = false;
+            if (frame.isArray)
+            {
+                if (!hasUnreadItem(frame))
+                {
+                    throw Error(1, "read container error", "no more container items in array", "", 0);
+                }
+                frame.itemReady = false;
+                found = true;
+            }
+            else
+            {
+                std::map<std::string, Json::Value>::iterator pending = frame.pending.find(name);
+                if (pending != frame.pending.end())
+                {
+                    buffered.swap(pending->second);
+                    frame.pending.erase(pending);
+                }
+                else
+                {
+                    found = findMember(frame, name);
+                }
+            }
+
+            if (found)
+            {
+                // only containers of requested kind are streamed, other values are read
+                // whole to behave like jsoncpp document on them
+                int c = _parser.peek();
+                streamed = isArray ? c == '[' : c == '{';
+                if (streamed)
+                {
+                    _parser.expect(static_cast<char>(c));
+                }
+                else
+                {
+                    _parser.readValue(&buffered);
+                }
+            }
+        }
+
+        const Json::Value &childValue = bufferedParent != NULL ? *bufferedParent : buffered;
+        if (isArray && !streamed && !childValue.isArray())
+        {
+            throw Error(1, "read array error", "array expected", name, 0);
+        }
+
+        _frames.push_back(JsonStreamFrame());
+        JsonStreamFrame &child = _frames.back();
+        child.streamed = streamed;
+        child.isArray = isArray;
+        if (bufferedParent != NULL)
+        {
+            child.value = bufferedParent;
+        }
+        else
+        {
+            child.storage.swap(buffered);
+            child.value = &child.storage;
+        }
+        return pushFrame(child);
+    }
+
+    static JsonStreamDocument &get_document(const ContainerNode *node)
+    {
+        return *static_cast<JsonStreamDocument *>(node->data.doc);
+    }
+
+    static bool          jsonStreamNode_hasUnread(const ContainerNode *node)
+    {
+        JsonStreamDocument &doc = get_document(node);
+        return doc.hasUnreadItem(doc.activateFrame(node));
+    }
+
+    static string        jsonStreamNode_unreadName(const ContainerNode *) throw(Error)
+    {
+        // There is no name property for json values
+        return "";
+    }
+
+    static float         jsonStreamNode_readNumber(const ContainerNode *node, const string &name) throw(Error)
+    {
+        JsonStreamDocument &doc = get_document(node);
+        Json::Value value;
+        doc.readItem(doc.activateFrame(node), name, value);
+        return value.asDouble();
+    }
+
+    static bool          jsonStreamNode_readBool(const ContainerNode *node, const string &name) throw(Error)
+    {
+        JsonStreamDocument &doc = get_document(node);
+        Json::Value value;
+        doc.readItem(doc.activateFrame(node), name, value);
+        return value.asBool();
+    }
+
+    static string        jsonStreamNode_readString(const ContainerNode *node, const string &name) throw(Error)
+    {
+        JsonStreamDocument &doc = get_document(node);
+        Json::Value value;
+        doc.readItem(doc.activateFrame(node), name, value);
+        return value.asString();
+    }
+
+    static StringVector  jsonStreamNode_readStringVector(const ContainerNode *node, const string &name) throw(Error)
+    {
+        JsonStreamDocument &doc = get_document(node);
+        Json::Value element;
+        doc.readItem(doc.activateFrame(node), name, element);
+        StringVector result;
+        for (Json::ArrayIndex i = 0; i < element.size(); ++i)
+        {
+            const Json::Value &item = element[i];
+            result.push_back(item.asCString());
+        }
+        return result;
+    }
+
+    static ContainerNode jsonStreamNode_readContainer(const ContainerNode *node, const string &name) throw(Error)
+    {
+        JsonStreamDocument &doc = get_document(node);
+        return doc.readItemContainer(doc.activateFrame(node), name, false);
+    }
+
+    static ContainerNode jsonStreamNode_readArray(const ContainerNode *node, const string &name) throw(Error)
+    {
+        JsonStreamDocument &doc = get_document(node);
+        return doc.readItemContainer(doc.activateFrame(node), name, true);
+    }
+
+    static void          jsonStreamNode_writeNumber(ContainerNode*, const string &, float) throw(Error)
+    {
+        throw Error(1, "json stream write error", "json stream document is read-only", "", 0);
+    }
+
+    static void          jsonStreamNode_writeBool(ContainerNode*, const string &, bool) throw(Error)
+    {
+        throw Error(1, "json stream write error", "json stream document is read-only", "", 0);
+    }
+
+    static void          jsonStreamNode_writeString(ContainerNode*, const string &, const string &) throw(Error)
+    {
+        throw Error(1, "json stream write error", "json stream document is read-only", "", 0);
+    }
+
+    static void          jsonStreamNode_writeStringVector(ContainerNode*, const string &, const StringVector &) throw(Error)
+    {
+        throw Error(1, "json stream write error", "json stream document is read-only", "", 0);
+    }
+
+    static ContainerNode jsonStreamNode_writeNewContainer(ContainerNode*, const string &) throw(Error)
+    {
+        throw Error(1, "json stream write error", "json stream document is read-only", "", 0);
+    }
+
+    static ContainerNode jsonStreamNode_writeNewArray(ContainerNode*, const string &) throw(Error)
+    {
+        throw Error(1, "json stream write error", "json stream document is read-only", "", 0);
+    }
+
+}
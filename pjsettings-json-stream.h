@@ -0,0 +1,154 @@
+/*
+ * PJSIP persistent document implementation based on streaming json parser
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PJSETTINGS_JSON_STREAM_H__
+#define __PJSETTINGS_JSON_STREAM_H__
+
+#include <stdio.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifndef PJSETTINGS_NOT_USE_PJSUA
+#include <pjsua2/persistent.hpp>
+#include "json.h"
+
+#endif
+
+namespace pjsettings
+{
+    /**
+     * Forward-only json parser over file or memory buffer.
+     *
+     * File is read by fixed-size chunks. Values are parsed one by one,
+     * either into Json::Value or skipped without building anything.
+     */
+    class JsonStreamParser
+    {
+    public:
+        JsonStreamParser();
+        ~JsonStreamParser();
+
+        void openFile(const std::string &filename) throw(pj::Error);
+        void openBuffer(const char *input, size_t size);
+        void close();
+
+        // Next character after whitespace and comments, -1 at the end of input
+        int peek() throw(pj::Error);
+        void expect(char expected) throw(pj::Error);
+        std::string readString() throw(pj::Error);
+
+        // Parses next value, the value is skipped if it is NULL
+        void readValue(Json::Value *value) throw(pj::Error);
+
+        void fail(const std::string &message) const throw(pj::Error);
+
+    private:
+        JsonStreamParser(const JsonStreamParser &);
+        JsonStreamParser &operator=(const JsonStreamParser &);
+
+        int peekChar();
+        int getChar();
+        bool fill();
+        void skipSpace() throw(pj::Error);
+        void readString(std::string *value) throw(pj::Error);
+        void readLiteral(const char *literal) throw(pj::Error);
+        void readNumber(Json::Value *value) throw(pj::Error);
+        void readValue(Json::Value *value, unsigned depth) throw(pj::Error);
+
+        FILE *_file;
+        std::string _filename;
+        std::vector<char> _buffer;
+        std::string _text;
+        const char *_position;
+        const char *_end;
+        unsigned _line;
+        unsigned _column;
+    };
+
+    /**
+     * Object or array that is being read by JsonStreamDocument.
+     *
+     * Streamed container is read from parser as it goes. Members of
+     * streamed object that are skipped while looking for other names
+     * are kept parsed in pending, so they can still be read later.
+     * Buffered container is read from value that is already parsed.
+     */
+    struct JsonStreamFrame
+    {
+        JsonStreamFrame();
+
+        size_t generation;
+        bool streamed;
+        bool isArray;
+
+        // streamed container state
+        bool finished;
+        bool first;
+        bool itemReady;
+        std::map<std::string, Json::Value> pending;
+
+        // buffered container state
+        Json::Value storage;
+        const Json::Value *value;
+        Json::ArrayIndex index;
+    };
+
+    class JsonStreamDocument : public pj::PersistentDocument
+    {
+    public:
+        JsonStreamDocument();
+        virtual void loadFile(const std::string &filename) throw(pj::Error);
+        virtual void loadString(const std::string &input) throw(pj::Error);
+        void loadBuffer(const char *input, size_t size) throw(pj::Error);
+
+        // Document is read-only, save methods throw pj::Error
+        virtual void saveFile(const std::string &filename) throw(pj::Error);
+        virtual std::string saveString() throw(pj::Error);
+        virtual pj::ContainerNode &getRootContainer() const;
+
+        // Frame of node, frames of containers read from the node are finished
+        JsonStreamFrame &activateFrame(const pj::ContainerNode *node) throw(pj::Error);
+
+        bool hasUnreadItem(JsonStreamFrame &frame) throw(pj::Error);
+
+        // Next array item or member with specified name, null value if there is no such member
+        void readItem(JsonStreamFrame &frame, const std::string &name, Json::Value &value) throw(pj::Error);
+        pj::ContainerNode readItemContainer(JsonStreamFrame &frame, const std::string &name, bool isArray) throw(pj::Error);
+
+    private:
+        void initRoot() throw(pj::Error);
+        bool nextMember(JsonStreamFrame &frame, std::string &name) throw(pj::Error);
+        bool findMember(JsonStreamFrame &frame, const std::string &name) throw(pj::Error);
+        const Json::Value *bufferedValue(JsonStreamFrame &frame, const std::string &name) throw(pj::Error);
+        void finishFrame(JsonStreamFrame &frame) throw(pj::Error);
+        pj::ContainerNode pushFrame(JsonStreamFrame &frame);
+
+        JsonStreamParser _parser;
+        std::deque<JsonStreamFrame> _frames;
+        size_t _generation;
+        mutable pj::ContainerNode _rootNode;
+    };
+
+}
+
+#endif
@@ -0,0 +1,483 @@
+/*
+ * Buffered json serializer for jsoncpp values
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <string.h>
+#include "pjsettings-json-writer.h"
+#include "pjsettings-number.h"
+
+using namespace pj;
+using namespace Json;
+using namespace std;
+
+namespace pjsettings
+{
+
+    // The same right margin and indentation Json::StyledStreamWriter("    ") uses
+    static const unsigned rightMargin = 74;
+    static const char indentation[] = "    ";
+    static const size_t indentationSize = sizeof(indentation) - 1;
+
+    JsonFileSink::JsonFileSink()
+        : _file(NULL)
+        , _filename()
+    {
+    }
+
+    JsonFileSink::~JsonFileSink()
+    {
+        if (_file != NULL)
+        {
+            fclose(_file);
+        }
+    }
+
+    void JsonFileSink::open(const std::string &filename) throw(pj::Error)
+    {
+        if (_file != NULL)
+        {
+            fclose(_file);
+        }
+        _filename = filename;
+        _file = fopen(filename.c_str(), "wb");
+        if (_file == NULL)
+        {
+            throw Error(1, "json write error", "can't open file for writing", filename, 0);
+        }
+        // writer passes whole buffers, stdio buffer would only copy them once more
+        setvbuf(_file, NULL, _IONBF, 0);
+    }
+
+    void JsonFileSink::close() throw(pj::Error)
+    {
+        if (_file == NULL)
+        {
+            return;
+        }
+        bool closed = fclose(_file) == 0;
+        _file = NULL;
+        if (!closed)
+        {
+            throw Error(1, "json write error", "can't write file", _filename, 0);
+        }
+    }
+
+    void JsonFileSink::write(const char *data, size_t size) throw(pj::Error)
+    {
+        if (_file == NULL || fwrite(data, 1, size, _file) != size)
+        {
+            throw Error(1, "json write error", "can't write file", _filename, 0);
+        }
+    }
+
+    JsonWriter::JsonWriter(JsonSink &sink, bool styled)
+        : _sink(sink)
+        , _styled(styled)
+        , _size(0)
+        , _indent(0)
+        , _measuring(false)
+        , _measured(0)
+    {
+    }
+
+    void JsonWriter::write(const Json::Value &root) throw(pj::Error)
+    {
+        _size = 0;
+        _indent = 0;
+        if (_styled)
+        {
+            writeCommentBefore(root);
+            writeStyled(root);
+            writeCommentAfter(root);
+        }
+        else
+        {
+            writeFast(root);
+        }
+        put('\n');
+        flush();
+    }
+
+    void JsonWriter::put(const char *data, size_t size)
+    {
+        if (_measuring)
+        {
+            _measured += size;
+            return;
+        }
+        while (size > 0)
+        {
+            if (_size == BufferSize)
+            {
+                flush();
+            }
+            size_t chunk = BufferSize - _size < size ? BufferSize - _size : size;
+            memcpy(_buffer + _size, data, chunk);
+            _size += chunk;
+            data += chunk;
+            size -= chunk;
+        }
+    }
+
+    void JsonWriter::put(const char *data)
+    {
+        put(data, strlen(data));
+    }
+
+    void JsonWriter::put(char c)
+    {
+        if (_measuring)
+        {
+            ++_measured;
+            return;
+        }
+        if (_size == BufferSize)
+        {
+            flush();
+        }
+        _buffer[_size++] = c;
+    }
+
+    void JsonWriter::flush()
+    {
+        if (_size > 0)
+        {
+            _sink.write(_buffer, _size);
+            _size = 0;
+        }
+    }
+
+    static size_t format_uint(LargestUInt value, char *buffer, size_t size)
+    {
+        char *end = buffer + size;
+        char *current = end;
+        do
+        {
+            *--current = static_cast<char>('0' + value % 10);
+            value /= 10;
+        }
+        while (value != 0);
+        size_t length = static_cast<size_t>(end - current);
+        memmove(buffer, current, length);
+        return length;
+    }
+
+    static size_t format_int(LargestInt value, char *buffer, size_t size)
+    {
+        if (value >= 0)
+        {
+            return format_uint(static_cast<LargestUInt>(value), buffer, size);
+        }
+        buffer[0] = '-';
+        return 1 + format_uint(LargestUInt(0) - static_cast<LargestUInt>(value), buffer + 1, size - 1);
+    }
+
+    void JsonWriter::writeScalar(const Json::Value &value)
+    {
+        char buffer[NumberBufferSize];
+        switch (value.type())
+        {
+        case nullValue:
+            put("null", 4);
+            break;
+        case intValue:
+            put(buffer, format_int(value.asLargestInt(), buffer, sizeof(buffer)));
+            break;
+        case uintValue:
+            put(buffer, format_uint(value.asLargestUInt(), buffer, sizeof(buffer)));
+            break;
+        case realValue:
+            put(buffer, formatDouble(value.asDouble(), buffer));
+            break;
+        case stringValue:
+            writeString(value.asCString());
+            break;
+        case booleanValue:
+            if (value.asBool())
+            {
+                put("true", 4);
+            }
+            else
+            {
+                put("false", 5);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    static bool is_control_character(char c)
+    {
+        return c > 0 && c <= 0x1F;
+    }
+
+    // The same escaping Json::valueToQuotedString does
+    void JsonWriter::writeString(const char *value)
+    {
+        put('"');
+        const char *plain = value;
+        for (const char *c = value; *c != 0; ++c)
+        {
+            const char *escaped = NULL;
+            char unicode[7];
+            switch (*c)
+            {
+            case '"': escaped = "\\\""; break;
+            case '\\': escaped = "\\\\"; break;
+            case '\b': escaped = "\\b"; break;
+            case '\f': escaped = "\\f"; break;
+            case '\n': escaped = "\\n"; break;
+            case '\r': escaped = "\\r"; break;
+            case '\t': escaped = "\\t"; break;
+            default:
+                if (is_control_character(*c))
+                {
+                    snprintf(unicode, sizeof(unicode), "\\u%04X", static_cast<int>(*c));
+                    escaped = unicode;
+                }
+                break;
+            }
+            if (escaped != NULL)
+            {
+                put(plain, static_cast<size_t>(c - plain));
+                put(escaped);
+                plain = c + 1;
+            }
+        }
+        put(plain, strlen(plain));
+        put('"');
+    }
+
+    void JsonWriter::writeFast(const Json::Value &value)
+    {
+        switch (value.type())
+        {
+        case arrayValue:
+        {
+            put('[');
+            ArrayIndex size = value.size();
+            for (ArrayIndex index = 0; index < size; ++index)
+            {
+                if (index > 0)
+                {
+                    put(',');
+                }
+                writeFast(value[index]);
+            }
+            put(']');
+            break;
+        }
+        case objectValue:
+        {
+            put('{');
+            for (Value::const_iterator it = value.begin(); it != value.end(); ++it)
+            {
+                if (it != value.begin())
+                {
+                    put(',');
+                }
+                writeString(it.memberName());
+                put(':');
+                writeFast(*it);
+            }
+            put('}');
+            break;
+        }
+        default:
+            writeScalar(value);
+            break;
+        }
+    }
+
+    void JsonWriter::writeStyled(const Json::Value &value)
+    {
+        switch (value.type())
+        {
+        case arrayValue:
+            writeStyledArray(value);
+            break;
+        case objectValue:
+        {
+            if (value.empty())
+            {
+                put("{}", 2);
+                break;
+            }
+            writeIndent();
+            put('{');
+            ++_indent;
+            Value::const_iterator it = value.begin();
+            for (;;)
+            {
+                const Value &childValue = *it;
+                writeCommentBefore(childValue);
+                writeIndent();
+                writeString(it.memberName());
+                put(" : ", 3);
+                writeStyled(childValue);
+                if (++it == value.end())
+                {
+                    writeCommentAfter(childValue);
+                    break;
+                }
+                put(',');
+                writeCommentAfter(childValue);
+            }
+            --_indent;
+            writeIndent();
+            put('}');
+            break;
+        }
+        default:
+            writeScalar(value);
+            break;
+        }
+    }
+
+    void JsonWriter::writeStyledArray(const Json::Value &value)
+    {
+        ArrayIndex size = value.size();
+        if (size == 0)
+        {
+            put("[]", 2);
+            return;
+        }
+
+        if (!isMultilineArray(value))
+        {
+            put("[ ", 2);
+            for (ArrayIndex index = 0; index < size; ++index)
+            {
+                if (index > 0)
+                {
+                    put(", ", 2);
+                }
+                writeStyled(value[index]);
+            }
+            put(" ]", 2);
+            return;
+        }
+
+        writeIndent();
+        put('[');
+        ++_indent;
+        for (ArrayIndex index = 0; ; )
+        {
+            const Value &childValue = value[index];
+            writeCommentBefore(childValue);
+            writeIndent();
+            writeStyled(childValue);
+            if (++index == size)
+            {
+                writeCommentAfter(childValue);
+                break;
+            }
+            put(',');
+            writeCommentAfter(childValue);
+        }
+        --_indent;
+        writeIndent();
+        put(']');
+    }
+
+    bool JsonWriter::isMultilineArray(const Json::Value &value)
+    {
+        ArrayIndex size = value.size();
+        bool isMultiline = size * 3 >= rightMargin;
+        for (ArrayIndex index = 0; index < size && !isMultiline; ++index)
+        {
+            const Value &childValue = value[index];
+            isMultiline = (childValue.isArray() || childValue.isObject()) && childValue.size() > 0;
+        }
+        if (isMultiline)
+        {
+            return true;
+        }
+
+        // only scalars and empty containers are here, line length is measured
+        // by formatting them with no output, instead of keeping formatted items
+        _measuring = true;
+        _measured = 4 + (size - 1) * 2;     // '[ ' + ', '*n + ' ]'
+        for (ArrayIndex index = 0; index < size; ++index)
+        {
+            writeStyled(value[index]);
+        }
+        _measuring = false;
+        return _measured >= rightMargin;
+    }
+
+    void JsonWriter::writeIndent()
+    {
+        put('\n');
+        for (unsigned i = 0; i < _indent; ++i)
+        {
+            put(indentation, indentationSize);
+        }
+    }
+
+    // Comment with mac and dos line ends converted to unix ones
+    void JsonWriter::writeComment(const std::string &comment)
+    {
+        const char *current = comment.c_str();
+        const char *end = current + comment.size();
+        while (current != end)
+        {
+            char c = *current++;
+            if (c == '\r')
+            {
+                if (current != end && *current == '\n')
+                {
+                    ++current;
+                }
+                put('\n');
+            }
+            else
+            {
+                put(c);
+            }
+        }
+    }
+
+    void JsonWriter::writeCommentBefore(const Json::Value &value)
+    {
+        if (!value.hasComment(commentBefore))
+        {
+            return;
+        }
+        writeComment(value.getComment(commentBefore));
+        put('\n');
+    }
+
+    void JsonWriter::writeCommentAfter(const Json::Value &value)
+    {
+        if (value.hasComment(commentAfterOnSameLine))
+        {
+            put(' ');
+            writeComment(value.getComment(commentAfterOnSameLine));
+        }
+        if (value.hasComment(commentAfter))
+        {
+            put('\n');
+            writeComment(value.getComment(commentAfter));
+            put('\n');
+        }
+    }
+
+}
@@ -0,0 +1,137 @@
+/*
+ * Buffered json serializer for jsoncpp values
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PJSETTINGS_JSON_WRITER_H__
+#define __PJSETTINGS_JSON_WRITER_H__
+
+#include <stdio.h>
+#include <string>
+
+#ifndef PJSETTINGS_NOT_USE_PJSUA
+#include <pjsua2/persistent.hpp>
+#include "json.h"
+
+#endif
+
+namespace pjsettings
+{
+    // Destination of serialized json, receives output by buffer-sized chunks
+    class JsonSink
+    {
+    public:
+        virtual ~JsonSink() {}
+        virtual void write(const char *data, size_t size) throw(pj::Error) = 0;
+    };
+
+    // Writes straight to file descriptor, the file is not buffered by stdio
+    class JsonFileSink : public JsonSink
+    {
+    public:
+        JsonFileSink();
+        ~JsonFileSink();
+
+        void open(const std::string &filename) throw(pj::Error);
+        void close() throw(pj::Error);
+        virtual void write(const char *data, size_t size) throw(pj::Error);
+
+    private:
+        JsonFileSink(const JsonFileSink &);
+        JsonFileSink &operator=(const JsonFileSink &);
+
+        FILE *_file;
+        std::string _filename;
+    };
+
+    // Appends to string, capacity can be reserved by size of JsonSizeSink output
+    class JsonStringSink : public JsonSink
+    {
+    public:
+        explicit JsonStringSink(std::string &output) : _output(output) {}
+        virtual void write(const char *data, size_t size) throw(pj::Error) { _output.append(data, size); }
+
+    private:
+        std::string &_output;
+    };
+
+    // Counts size of output only
+    class JsonSizeSink : public JsonSink
+    {
+    public:
+        JsonSizeSink() : _size(0) {}
+        virtual void write(const char * /* data */, size_t size) throw(pj::Error) { _size += size; }
+        size_t size() const { return _size; }
+
+    private:
+        size_t _size;
+    };
+
+    /**
+     * Serializer of Json::Value that emits tokens into fixed-size buffer
+     * and passes the buffer to sink every time it fills up.
+     *
+     * Layout is the same as of Json::StyledStreamWriter("    ") for styled
+     * and Json::FastWriter for not styled writing, including comments,
+     * but no intermediate strings are built for values or arrays.
+     * Real numbers are written as shortest text that reads back
+     * as the same double (see formatDouble).
+     */
+    class JsonWriter
+    {
+    public:
+        JsonWriter(JsonSink &sink, bool styled);
+
+        // Whole document with trailing line feed, the buffer is flushed at the end
+        void write(const Json::Value &root) throw(pj::Error);
+
+    private:
+        JsonWriter(const JsonWriter &);
+        JsonWriter &operator=(const JsonWriter &);
+
+        void put(const char *data, size_t size);
+        void put(const char *data);
+        void put(char c);
+        void flush();
+
+        void writeScalar(const Json::Value &value);
+        void writeString(const char *value);
+        void writeFast(const Json::Value &value);
+        void writeStyled(const Json::Value &value);
+        void writeStyledArray(const Json::Value &value);
+        bool isMultilineArray(const Json::Value &value);
+        void writeIndent();
+        void writeComment(const std::string &comment);
+        void writeCommentBefore(const Json::Value &value);
+        void writeCommentAfter(const Json::Value &value);
+
+        static const size_t BufferSize = 16384;
+
+        JsonSink &_sink;
+        bool _styled;
+        size_t _size;
+        unsigned _indent;
+        bool _measuring;                // output is not written, its size is counted only
+        size_t _measured;
+        char _buffer[BufferSize];
+    };
+
+}
+
+#endif
@@ -19,10 +19,16 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <new>
+#include <string.h>
 #include <stdexcept>
 #include "pjsettings-jsoncpp.h"
+#include "pjsettings-diff.h"
+#include "pjsettings-hash.h"
+#include "pjsettings-json-parallel.h"
+#include "pjsettings-json-writer.h"
+#include "pjsettings-mapped-file.h"
+#include "pjsettings-number.h"
 
 using namespace pj;
 using namespace Json;
@@ -64,16 +70,151 @@ namespace pjsettings
         &jsoncppNode_writeNewArray
     };
 
+    /* Snapshot of jsoncpp document */
+
+    static void build_snapshot_value(SnapshotBuilder &builder, uint32_t index, const Json::Value &value)
+    {
+        SnapshotNode &node = builder.node(index);
+        switch (value.type())
+        {
+        case nullValue:
+            node.type = SNAPSHOT_NULL;
+            break;
+        case booleanValue:
+            node.type = SNAPSHOT_BOOL;
+            break;
+        case intValue:
+            node.type = SNAPSHOT_INT;
+            node.integer = value.asLargestInt();
+            break;
+        case uintValue:
+            node.type = SNAPSHOT_UINT;
+            node.integer = static_cast<int64_t>(value.asLargestUInt());
+            break;
+        case realValue:
+            node.type = SNAPSHOT_REAL;
+            break;
+        case stringValue:
+            node.type = SNAPSHOT_STRING;
+            break;
+        case arrayValue:
+            node.type = SNAPSHOT_ARRAY;
+            break;
+        case objectValue:
+            node.type = SNAPSHOT_OBJECT;
+            break;
+        }
+
+        // the same conversions Json::Value::as* accept
+        if (value.isString())
+        {
+            node.convertible = SNAPSHOT_AS_STRING;
+            node.string = builder.addString(value.asCString());
+            return;
+        }
+        if (!value.isArray() && !value.isObject())
+        {
+            node.convertible = SNAPSHOT_AS_STRING | SNAPSHOT_AS_NUMBER | SNAPSHOT_AS_BOOL;
+            node.string = builder.addString(value.asString());
+            node.number = value.asDouble();
+            node.boolean = value.asBool() ? 1 : 0;
+            return;
+        }
+
+        uint32_t count = static_cast<uint32_t>(value.size());
+        uint32_t first = builder.addNodes(count);
+        // node reference is invalidated by addNodes
+        builder.node(index).firstChild = first;
+        builder.node(index).childCount = count;
+        if (value.isArray())
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                build_snapshot_value(builder, first + i, value[i]);
+            }
+            return;
+        }
+
+        // members are iterated in the order getMemberNames() returns them
+        uint32_t i = first;
+        for (Value::const_iterator it = value.begin(); it != value.end(); ++it, ++i)
+        {
+            builder.node(i).name = builder.addString(it.memberName());
+            build_snapshot_value(builder, i, *it);
+        }
+        uint32_t sortedChildren = builder.addSortedIndex(first, count);
+        builder.node(index).sortedChildren = sortedChildren;
+    }
+
+    static void restore_snapshot_value(const Snapshot &snapshot, const SnapshotNode *node, Json::Value &value)
+    {
+        switch (node->type)
+        {
+        case SNAPSHOT_BOOL:
+            value = Value(node->boolean != 0);
+            break;
+        case SNAPSHOT_INT:
+            value = Value(static_cast<LargestInt>(node->integer));
+            break;
+        case SNAPSHOT_UINT:
+            value = Value(static_cast<LargestUInt>(node->integer));
+            break;
+        case SNAPSHOT_REAL:
+            value = Value(node->number);
+            break;
+        case SNAPSHOT_STRING:
+        {
+            const char *begin = snapshot.string(node->string);
+            value = Value(begin, begin + snapshot.stringSize(node->string));
+            break;
+        }
+        case SNAPSHOT_ARRAY:
+            value = Value(arrayValue);
+            for (uint32_t i = 0; i < node->childCount; ++i)
+            {
+                restore_snapshot_value(snapshot, snapshot.child(node, i), value.append(Value()));
+            }
+            break;
+        case SNAPSHOT_OBJECT:
+            value = Value(objectValue);
+            for (uint32_t i = 0; i < node->childCount; ++i)
+            {
+                const SnapshotNode *member = snapshot.child(node, i);
+                restore_snapshot_value(snapshot, member, value[snapshot.string(member->name)]);
+            }
+            break;
+        default:
+            value = Value();
+            break;
+        }
+    }
+
     JsonCppDocument::JsonCppDocument(bool notStyledOutputOnWriting)
-        : _document(objectValue)
+        : _arena()
+        , _threadArenas()
+        , _arenaEnabled(true)
+        , _document(objectValue)
         , _rootNode()
         , _notStyledOutputOnWriting(notStyledOutputOnWriting)
+        , _snapshotCacheEnabled(false)
+        , _snapshot()
+        , _profiler()
+        , _concurrentReadEnabled(false)
+        , _parallelThreads(1)
+        , _parallelArrayName()
+        , _parallelMinSize(1048576)
+        , _parsedInParallel(false)
+        , _subtreeHashes()
+        , _contentHash(0)
+        , _contentHashValid(false)
     {
         initRoot();
     }
 
     void JsonCppDocument::initRoot()
     {
+        _snapshot.close();
+        _subtreeHashes.clear();
         Value &rootElement = _document;
         _rootNode.op = &jsoncpp_op;
         _rootNode.data.doc = this;
@@ -81,50 +222,167 @@ namespace pjsettings
         _rootNode.data.data2 = NULL;
     }
 
+    // Values of previous tree are destroyed before their arena is released.
+    // Root is destroyed in place: Json::Value assignment keeps comments
+    // of the target, and root comments are allocated from the arena too.
+    void JsonCppDocument::releaseTree()
+    {
+        _document.~Value();
+        new (&_document) Value(objectValue);
+        _arena.release();
+        for (size_t i = 0; i < _threadArenas.size(); ++i)
+        {
+            _threadArenas[i].release();
+        }
+        _parsedInParallel = false;
+        _subtreeHashes.clear();
+        _contentHashValid = false;
+    }
+
+    // Tree is released first, reader holds errors if parsing fails and document is left empty
+    bool JsonCppDocument::parseTree(Json::Reader &reader, const char *begin, const char *end)
+    {
+        releaseTree();
+        if (_parallelThreads > 1 && static_cast<size_t>(end - begin) >= _parallelMinSize)
+        {
+            // arenas are empty after release, so they can be copied on resize
+            _threadArenas.resize(_parallelThreads - 1);
+            bool parsed;
+            {
+                ArenaScope scope(_arenaEnabled ? &_arena : NULL);
+                parsed = parseJsonArrayInParallel(begin, end, _parallelArrayName, _parallelThreads, _document,
+                    _arenaEnabled ? &_threadArenas : NULL);
+            }
+            if (parsed)
+            {
+                _parsedInParallel = true;
+                return true;
+            }
+            // partial tree is dropped, errors come from parsing on this thread
+            releaseTree();
+        }
+        bool parsed;
+        {
+            ArenaScope scope(_arenaEnabled ? &_arena : NULL);
+            parsed = reader.parse(begin, end, _document);
+        }
+        if (!parsed)
+        {
+            // partial tree is dropped, root never points to the previous tree or snapshot
+            releaseTree();
+            initRoot();
+        }
+        return parsed;
+    }
+
     void JsonCppDocument::loadFile(const std::string &filename) throw(pj::Error)
     {
-        std::ifstream input(filename.c_str(), std::ifstream::binary);
-        if (!input)
+        if (_snapshotCacheEnabled && _snapshot.openFile(snapshotFilename(filename), SNAPSHOT_JSONCPP, filename))
         {
-            throw Error(1, "there is no file exists", filename, __FILE__, __LINE__);
+            releaseTree();
+            _rootNode = snapshotRootContainer(_snapshot);
+            _contentHash = _snapshot.header().sourceHash;
+            _contentHashValid = true;
+            return;
         }
+
+        // file is stat'ed before it is read, so the snapshot
+        // never claims newer modification time than parsed content has
+        SnapshotSource source;
+        source.stat(filename);
+
+        // parse straight from the file mapping: Json::Reader::parse(std::istream&)
+        // would copy the whole file into std::string first
+        MappedFile input;
+        input.open(filename);
+        const char *begin = input.data() != NULL ? input.data() : "";
+        uint64_t contentHash = Hash64::calculate(input.data(), input.size());
         Json::Reader reader;
-        bool parsedSuccessfully = reader.parse(input, _document);
-        if (!parsedSuccessfully)
+        if (!parseTree(reader, begin, begin + input.size()))
         {
             throw Error(1, "jsoncpp load from file error", reader.getFormattedErrorMessages(), filename, 0);
         }
         initRoot();
+        _contentHash = contentHash;
+        _contentHashValid = true;
+
+        if (_snapshotCacheEnabled)
+        {
+            // snapshot is a cache only, document is loaded even if it can't be written
+            try
+            {
+                source.hash = contentHash;
+                SnapshotBuilder builder(SNAPSHOT_JSONCPP);
+                build_snapshot_value(builder, builder.addNodes(1), _document);
+                std::vector<char> image;
+                builder.build(image, source);
+                writeSnapshotFile(snapshotFilename(filename), image);
+            }
+            catch (Error &)
+            {
+            }
+        }
     }
 
     void JsonCppDocument::loadString(const std::string &input) throw(pj::Error)
     {
+        loadBuffer(input.data(), input.size());
+    }
+
+#if PJSETTINGS_HAS_RVALUE_REFERENCES
+    void JsonCppDocument::loadString(std::string &&input) throw(pj::Error)
+    {
+        // jsoncpp copies every value into the tree anyway,
+        // so there is nothing to take over from the input
+        loadBuffer(input.data(), input.size());
+    }
+#endif
+
+    void JsonCppDocument::loadBuffer(const char *input, size_t size) throw(pj::Error)
+    {
+        // Json::Reader::parse(const std::string&) would copy the input first
+        uint64_t contentHash = Hash64::calculate(input, size);
         Json::Reader reader;
-        bool parsedSuccessfully = reader.parse(input, _document);
-        if (!parsedSuccessfully)
+        if (!parseTree(reader, input, input + size))
         {
             throw Error(1, "jsoncpp load from string error", reader.getFormattedErrorMessages(), "offset", 0);
         }
         initRoot();
+        _contentHash = contentHash;
+        _contentHashValid = true;
     }
 
-    void JsonCppDocument::saveFile(const std::string &filename) throw(pj::Error)
+    bool JsonCppDocument::reloadIfChanged(const std::string &filename) throw(pj::Error)
     {
-        try
         {
-            std::ofstream output(filename.c_str(), std::ifstream::binary);
-            if (_notStyledOutputOnWriting)
+            MappedFile input;
+            input.open(filename);
+            if (_contentHashValid && Hash64::calculate(input.data(), input.size()) == _contentHash)
             {
-                Json::FastWriter fastWriter;
-                std::string result = fastWriter.write(_document);
-                output << result;
-            }
-            else
-            {
-                Json::StyledStreamWriter styledWriter("    ");
-                styledWriter.write(output, _document);
+                return false;
             }
         }
+        // the file is hashed again by loadFile(), so the hash
+        // always describes bytes that were parsed, even if the file is
+        // replaced in between
+        loadFile(filename);
+        return true;
+    }
+
+    void JsonCppDocument::saveFile(const std::string &filename) throw(pj::Error)
+    {
+        try
+        {
+            Json::Value restored;
+            const Json::Value &document = documentToSave(restored);
+            // output goes to the file by fixed-size buffer as it is serialized,
+            // the whole document is never held in memory
+            JsonFileSink output;
+            output.open(filename);
+            JsonWriter writer(output, !_notStyledOutputOnWriting);
+            writer.write(document);
+            output.close();
+        }
         catch (std::exception &ex)
         {
             throw Error(1, "jsoncpp save to file error", ex.what(), filename.c_str(), 0);
@@ -135,18 +393,17 @@ namespace pjsettings
     {
         try
         {
-            if (_notStyledOutputOnWriting)
-            {
-                Json::FastWriter fastWriter;
-                return fastWriter.write(_document);
-            }
-            else
-            {
-                Json::StyledStreamWriter styledWriter("    ");
-                std::stringstream output;
-                styledWriter.write(output, _document);
-                return output.str();
-            }
+            Json::Value restored;
+            const Json::Value &document = documentToSave(restored);
+            // the first pass counts output size only,
+            // so the result is allocated once and never copied
+            JsonSizeSink size;
+            JsonWriter(size, !_notStyledOutputOnWriting).write(document);
+            std::string result;
+            result.reserve(size.size());
+            JsonStringSink output(result);
+            JsonWriter(output, !_notStyledOutputOnWriting).write(document);
+            return result;
         }
         catch (std::exception &ex)
         {
@@ -156,7 +413,129 @@ namespace pjsettings
 
     pj::ContainerNode &JsonCppDocument::getRootContainer() const
     {
-        return _rootNode;
+        if (_concurrentReadEnabled)
+        {
+            return _rootNode;
+        }
+        return _profiler.wrapRoot(_rootNode);
+    }
+
+    void JsonCppDocument::setSnapshotCacheEnabled(bool enabled)
+    {
+        _snapshotCacheEnabled = enabled;
+    }
+
+    bool JsonCppDocument::isSnapshotCacheEnabled() const
+    {
+        return _snapshotCacheEnabled;
+    }
+
+    bool JsonCppDocument::isLoadedFromSnapshot() const
+    {
+        return _snapshot.isMapped();
+    }
+
+    void JsonCppDocument::freeze() throw(pj::Error)
+    {
+        if (_snapshot.isOpen())
+        {
+            return;
+        }
+        SnapshotBuilder builder(SNAPSHOT_JSONCPP);
+        build_snapshot_value(builder, builder.addNodes(1), _document);
+        std::vector<char> image;
+        builder.build(image, SnapshotSource());
+
+        // the tree is the same, so is the content it was loaded from
+        bool contentHashValid = _contentHashValid;
+        releaseTree();
+        _snapshot.assign(image);
+        _rootNode = snapshotRootContainer(_snapshot);
+        _contentHashValid = contentHashValid;
+    }
+
+    void JsonCppDocument::thaw()
+    {
+        if (!_snapshot.isOpen())
+        {
+            return;
+        }
+        {
+            ArenaScope scope(_arenaEnabled ? &_arena : NULL);
+            restore_snapshot_value(_snapshot, _snapshot.root(), _document);
+        }
+        initRoot();
+    }
+
+    bool JsonCppDocument::isFrozen() const
+    {
+        return _snapshot.isOpen();
+    }
+
+    void JsonCppDocument::setArenaEnabled(bool enabled)
+    {
+        _arenaEnabled = enabled;
+    }
+
+    bool JsonCppDocument::isArenaEnabled() const
+    {
+        return _arenaEnabled;
+    }
+
+    size_t JsonCppDocument::getArenaSize() const
+    {
+        size_t size = _arena.size();
+        for (size_t i = 0; i < _threadArenas.size(); ++i)
+        {
+            size += _threadArenas[i].size();
+        }
+        return size;
+    }
+
+    OperationProfiler &JsonCppDocument::profiler()
+    {
+        return _profiler;
+    }
+
+    void JsonCppDocument::setConcurrentReadEnabled(bool enabled)
+    {
+        if (enabled)
+        {
+            _profiler.setEnabled(false);
+        }
+        _concurrentReadEnabled = enabled;
+    }
+
+    bool JsonCppDocument::isConcurrentReadEnabled() const
+    {
+        return _concurrentReadEnabled;
+    }
+
+    void JsonCppDocument::setParallelParsing(unsigned threads, const std::string &arrayName, size_t minSize)
+    {
+        _parallelThreads = threads;
+        _parallelArrayName = arrayName;
+        _parallelMinSize = minSize;
+    }
+
+    unsigned JsonCppDocument::getParallelParsingThreads() const
+    {
+        return _parallelThreads;
+    }
+
+    bool JsonCppDocument::isParsedInParallel() const
+    {
+        return _parsedInParallel;
+    }
+
+    const Json::Value &JsonCppDocument::documentToSave(Json::Value &restored) const
+    {
+        if (!_snapshot.isOpen())
+        {
+            return _document;
+        }
+        restore_snapshot_value(_snapshot, _snapshot.root(), restored);
+        return restored;
     }
 
     void selectNextArrayElement(const ContainerNode *node, ptrdiff_t currentIndex)
@@ -174,12 +553,36 @@ namespace pjsettings
         return *data;
     }
 
+    static Json::Value &get_writable_value(const ContainerNode *node)
+    {
+        Json::Value &data = get_value(node);
+        if (&data == &Json::Value::null)
+        {
+            throw pj::Error(1, "write error", "container is missing in document", "", 0);
+        }
+        static_cast<JsonCppDocument *>(node->data.doc)->invalidateHashes();
+        return data;
+    }
+
+    static const Json::Value &get_member(const ContainerNode *node, const Json::Value &data, const string &name)
+    {
+        // const lookup never inserts missing member into document,
+        // shared Json::Value::null is returned instead
+        const Json::Value &member = data[name];
+        if (&member == &Json::Value::null)
+        {
+            static_cast<JsonCppDocument *>(node->data.doc)->profiler().countMiss();
+        }
+        return member;
+    }
+
     static ArrayIndex get_array_index(const ContainerNode *node)
     {
         return static_cast<ArrayIndex>(reinterpret_cast<size_t>(node->data.data2));
     }
 
-    static Json::Value &get_array_value(Json::Value &data, ArrayIndex arrayIndex)
+    // const access, so reads of shared document never change it
+    static const Json::Value &get_array_value(const Json::Value &data, ArrayIndex arrayIndex)
     {
         if (!data.isValidIndex(arrayIndex - 1))
         {
@@ -190,7 +593,7 @@ namespace pjsettings
 
     static bool          jsoncppNode_hasUnread(const ContainerNode *node)
     {
-        Json::Value &data = get_value(node);
+        const Json::Value &data = get_value(node);
         ArrayIndex arrayIndex = get_array_index(node);
         if (arrayIndex > 0)
         {
@@ -208,77 +611,69 @@ namespace pjsettings
         return "";
     }
 
-    static float         jsoncppNode_readNumber(const ContainerNode *node, const string &name) throw(Error)
+    // Next array item or named member
+    static const Json::Value &read_value(const ContainerNode *node, const string &name)
     {
-        Json::Value &data = get_value(node);
+        const Json::Value &data = get_value(node);
         ArrayIndex arrayIndex = get_array_index(node);
         if (arrayIndex > 0)
         {
-            Json::Value &arrayElement = get_array_value(data, arrayIndex);
+            const Json::Value &arrayElement = get_array_value(data, arrayIndex);
             selectNextArrayElement(node, arrayIndex);
-            return arrayElement.asDouble();
+            return arrayElement;
         }
         else
         {
-            Json::Value &element = data[name];
-            return element.asDouble();
+            return get_member(node, data, name);
         }
     }
 
+    static float         jsoncppNode_readNumber(const ContainerNode *node, const string &name) throw(Error)
+    {
+        return read_value(node, name).asDouble();
+    }
+
     static bool          jsoncppNode_readBool(const ContainerNode *node, const string &name) throw(Error)
     {
-        Json::Value &data = get_value(node);
+        const Json::Value &data = get_value(node);
         ArrayIndex arrayIndex = get_array_index(node);
         if (arrayIndex > 0)
         {
-            Json::Value &arrayElement = get_array_value(data, arrayIndex);
+            const Json::Value &arrayElement = get_array_value(data, arrayIndex);
             selectNextArrayElement(node, arrayIndex);
             return arrayElement.asBool();
         }
         else
         {
-            Json::Value &element = data[name];
+            const Json::Value &element = get_member(node, data, name);
             return element.asBool();
         }
     }
 
     static string        jsoncppNode_readString(const ContainerNode *node, const string &name) throw(Error)
     {
-        Json::Value &data = get_value(node);
+        const Json::Value &data = get_value(node);
         ArrayIndex arrayIndex = get_array_index(node);
         if (arrayIndex > 0)
         {
-            Json::Value &arrayElement = get_array_value(data, arrayIndex);
+            const Json::Value &arrayElement = get_array_value(data, arrayIndex);
             selectNextArrayElement(node, arrayIndex);
             return arrayElement.asString();
         }
         else
         {
-            Json::Value &element = data[name];
+            const Json::Value &element = get_member(node, data, name);
             return element.asString();
         }
     }
 
     static StringVector  jsoncppNode_readStringVector(const ContainerNode *node, const string &name) throw(Error)
     {
-        Json::Value &data = get_value(node);
-        ArrayIndex arrayIndex = get_array_index(node);
-        Json::Value *stringVectorNode = NULL;
-        if (arrayIndex > 0)
-        {
-            stringVectorNode = &get_array_value(data, arrayIndex);
-            selectNextArrayElement(node, arrayIndex);
-        }
-        else
-        {
-            stringVectorNode = &data[name];
-        }
-
-        Json::Value &element = *stringVectorNode;
+        const Json::Value &element = read_value(node, name);
         StringVector result;
         for (int i = 0; i < element.size(); ++i)
         {
-            Json::Value &item = element[i];
+            const Json::Value &item = element[i];
             result.push_back(item.asCString());
         }
         return result;
@@ -286,46 +681,45 @@ namespace pjsettings
 
     static ContainerNode jsoncppNode_readContainer(const ContainerNode *node, const string &name) throw(Error)
     {
-        Json::Value &data = get_value(node);
+        const Json::Value &data = get_value(node);
         ArrayIndex arrayIndex = get_array_index(node);
         if (arrayIndex > 0)
         {
-            Json::Value &arrayElement = get_array_value(data, arrayIndex);
+            const Json::Value &arrayElement = get_array_value(data, arrayIndex);
 
             ContainerNode childNode = {};
             childNode.op = &jsoncpp_op;
             childNode.data.doc = node->data.doc;
-            childNode.data.data1 = &arrayElement;
+            childNode.data.data1 = const_cast<Json::Value *>(&arrayElement);
 
             selectNextArrayElement(node, arrayIndex);
             return childNode;
         }
         else
         {
-            Json::Value &element = data[name];
+            const Json::Value &element = get_member(node, data, name);
             ContainerNode childNode = {};
             childNode.op = &jsoncpp_op;
             childNode.data.doc = node->data.doc;
-            childNode.data.data1 = &element;
+            childNode.data.data1 = const_cast<Json::Value *>(&element);
             return childNode;
         }
     }
 
     static ContainerNode jsoncppNode_readArray(const ContainerNode *node, const string &name) throw(Error)
     {
-        Json::Value &data = get_value(node);
+        const Json::Value &data = get_value(node);
         ArrayIndex arrayIndex = get_array_index(node);
-        Json::Value *workData = NULL;
+        const Json::Value *workData = NULL;
         if (arrayIndex > 0)
         {
-            Json::Value &arrayElement = get_array_value(data, arrayIndex);
+            const Json::Value &arrayElement = get_array_value(data, arrayIndex);
             workData = &arrayElement;
             selectNextArrayElement(node, arrayIndex);
         }
         else
         {
-            Json::Value &element = data[name.c_str()];
-            workData = &element;
+            workData = &get_member(node, data, name);
         }
 
         if (!workData || !workData->isArray())
@@ -335,29 +729,37 @@ namespace pjsettings
         ContainerNode childNode = {};
         childNode.op = &jsoncpp_op;
         childNode.data.doc = node->data.doc;
-        childNode.data.data1 = workData;
+        childNode.data.data1 = const_cast<Json::Value *>(workData);
         childNode.data.data2 = reinterpret_cast<void*>(1);
         return childNode;
     }
 
-    static void          jsoncppNode_writeNumber(ContainerNode *node, const string &name, float num) throw(Error)
+    // Appended array item or named member
+    static void write_value(ContainerNode *node, const string &name, const Value &value)
     {
-        Value &data = get_value(node);
+        Value &data = get_writable_value(node);
         ArrayIndex arrayIndex = get_array_index(node);
         if (arrayIndex > 0)
         {
-            data.append(Value(num));
+            data.append(value);
             selectNextArrayElement(node, arrayIndex);
         }
         else
         {
-            data[name] = num;
+            data[name] = value;
         }
     }
 
+    static void          jsoncppNode_writeNumber(ContainerNode *node, const string &name, float num) throw(Error)
+    {
+        // double of shortest decimal text of the float, so it is saved
+        // as 0.1 instead of 0.100000001490116 and still read back exactly
+        write_value(node, name, Value(floatToShortestDouble(num)));
+    }
+
     static void          jsoncppNode_writeBool(ContainerNode *node, const string &name, bool value) throw(Error)
     {
-        Value &data = get_value(node);
+        Value &data = get_writable_value(node);
         ArrayIndex arrayIndex = get_array_index(node);
         if (arrayIndex > 0)
         {
@@ -372,7 +774,7 @@ namespace pjsettings
 
     static void          jsoncppNode_writeString(ContainerNode *node, const string &name, const string &value) throw(Error)
     {
-        Value &data = get_value(node);
+        Value &data = get_writable_value(node);
         ArrayIndex arrayIndex = get_array_index(node);
         if (arrayIndex > 0)
         {
@@ -388,7 +790,7 @@ namespace pjsettings
 
     static void          jsoncppNode_writeStringVector(ContainerNode *node, const string &name, const StringVector &value) throw(Error)
     {
-        Value &data = get_value(node);
+        Value &data = get_writable_value(node);
         ArrayIndex arrayIndex = get_array_index(node);
         Value stringVector(arrayValue);
         for (size_t i = 0; i < value.size(); ++i)
@@ -408,7 +810,7 @@ namespace pjsettings
 
     static ContainerNode jsoncppNode_writeNewContainer(ContainerNode *node, const string &name) throw(Error)
     {
-        Value &data = get_value(node);
+        Value &data = get_writable_value(node);
         ArrayIndex arrayIndex = get_array_index(node);
         Value container(objectValue);
         Value *forChildNode = NULL;
@@ -432,7 +834,7 @@ namespace pjsettings
 
     static ContainerNode jsoncppNode_writeNewArray(ContainerNode *node, const string &name) throw(Error)
     {
-        Value &data = get_value(node);
+        Value &data = get_writable_value(node);
         ArrayIndex arrayIndex = get_array_index(node);
         Value container(arrayValue);
         Value *forChildNode = NULL;
@@ -455,5 +857,477 @@ namespace pjsettings
         return childNode;
     }
 
-}
+    /* Typed numbers */
+
+    // 2^63, doubles in [-2^63, 2^63) are truncated to int64_t
+    static const double int64Limit = 9223372036854775808.0;
+
+    static int64_t value_to_int64(const Json::Value &value, const string &name) throw(Error)
+    {
+        switch (value.type())
+        {
+        case nullValue:
+            return 0;
+        case booleanValue:
+            return value.asBool() ? 1 : 0;
+        case intValue:
+            return value.asLargestInt();
+        case uintValue:
+            if (value.asLargestUInt() > static_cast<LargestUInt>(Value::maxInt64))
+            {
+                throw Error(1, "read number error", "value is out of int64 range", name, 0);
+            }
+            return static_cast<int64_t>(value.asLargestUInt());
+        case realValue:
+            if (!(value.asDouble() >= -int64Limit && value.asDouble() < int64Limit))
+            {
+                throw Error(1, "read number error", "value is out of int64 range", name, 0);
+            }
+            return static_cast<int64_t>(value.asDouble());
+        default:
+            throw Error(1, "read number error", "value is not convertible to number", name, 0);
+        }
+    }
+
+    static double value_to_double(const Json::Value &value, const string &name) throw(Error)
+    {
+        switch (value.type())
+        {
+        case nullValue:
+        case booleanValue:
+        case intValue:
+        case uintValue:
+        case realValue:
+            return value.asDouble();
+        default:
+            throw Error(1, "read number error", "value is not convertible to number", name, 0);
+        }
+    }
+
+    static int64_t snapshot_to_int64(const SnapshotNode *value, const string &name) throw(Error)
+    {
+        switch (value->type)
+        {
+        case SNAPSHOT_NULL:
+            return 0;
+        case SNAPSHOT_BOOL:
+            return value->boolean != 0 ? 1 : 0;
+        case SNAPSHOT_INT:
+            return value->integer;
+        case SNAPSHOT_UINT:
+            if (value->integer < 0)
+            {
+                throw Error(1, "read number error", "value is out of int64 range", name, 0);
+            }
+            return value->integer;
+        case SNAPSHOT_REAL:
+            if (!(value->number >= -int64Limit && value->number < int64Limit))
+            {
+                throw Error(1, "read number error", "value is out of int64 range", name, 0);
+            }
+            return static_cast<int64_t>(value->number);
+        default:
+            throw Error(1, "read number error", "value is not convertible to number", name, 0);
+        }
+    }
+
+    static double snapshot_to_double(const SnapshotNode *value, const string &name) throw(Error)
+    {
+        switch (value->type)
+        {
+        case SNAPSHOT_INT:
+            return static_cast<double>(value->integer);
+        case SNAPSHOT_UINT:
+            return static_cast<double>(static_cast<uint64_t>(value->integer));
+        case SNAPSHOT_NULL:
+        case SNAPSHOT_BOOL:
+        case SNAPSHOT_REAL:
+            return value->number;
+        default:
+            throw Error(1, "read number error", "value is not convertible to number", name, 0);
+        }
+    }
+
+    // Array position of node read by its document node copy, named reads
+    // leave node untouched, so concurrent readers can share root node
+    static void update_node_state(const ContainerNode &node, const ContainerNode &native)
+    {
+        if (node.data.data2 != native.data.data2)
+        {
+            const_cast<ContainerNode &>(node).data.data2 = native.data.data2;
+        }
+    }
+
+    /*
+     * Copy of node with operations of document, profiling nodes of document
+     * keep document node data and are resolved too.
+     */
+    ContainerNode JsonCppDocument::nativeNode(const ContainerNode &node) const throw(Error)
+    {
+        ContainerNode native = node;
+        if (node.data.doc == &_profiler)
+        {
+            native.op = _rootNode.op;
+            native.data.doc = _rootNode.data.doc;
+        }
+        if (native.op != _rootNode.op || native.data.doc != _rootNode.data.doc)
+        {
+            throw Error(1, "numeric node error", "node is not a node of this document", "", 0);
+        }
+        return native;
+    }
+
+    int64_t JsonCppDocument::readInt64(const ContainerNode &node, const string &name) const throw(Error)
+    {
+        ContainerNode native = nativeNode(node);
+        int64_t value = _snapshot.isOpen()
+            ? snapshot_to_int64(snapshotReadValue(native, name), name)
+            : value_to_int64(read_value(&native, name), name);
+        update_node_state(node, native);
+        return value;
+    }
+
+    double JsonCppDocument::readDouble(const ContainerNode &node, const string &name) const throw(Error)
+    {
+        ContainerNode native = nativeNode(node);
+        double value = _snapshot.isOpen()
+            ? snapshot_to_double(snapshotReadValue(native, name), name)
+            : value_to_double(read_value(&native, name), name);
+        update_node_state(node, native);
+        return value;
+    }
+
+    void JsonCppDocument::writeInt64(ContainerNode &node, const string &name, int64_t value) throw(Error)
+    {
+        ContainerNode native = nativeNode(node);
+        if (_snapshot.isOpen())
+        {
+            throw Error(1, "snapshot write error", "document is frozen or loaded from snapshot", "", 0);
+        }
+        write_value(&native, name, Value(static_cast<Json::Int64>(value)));
+        update_node_state(node, native);
+    }
+
+    void JsonCppDocument::writeDouble(ContainerNode &node, const string &name, double value) throw(Error)
+    {
+        ContainerNode native = nativeNode(node);
+        if (_snapshot.isOpen())
+        {
+            throw Error(1, "snapshot write error", "document is frozen or loaded from snapshot", "", 0);
+        }
+        write_value(&native, name, Value(value));
+        update_node_state(node, native);
+    }
+
+    /* String views */
+
+    static StringView value_to_view(const Json::Value &value, const string &name) throw(Error)
+    {
+        if (value.isNull())
+        {
+            return StringView();
+        }
+        if (!value.isString())
+        {
+            throw Error(1, "read string error", "value is not a string", name, 0);
+        }
+        const char *data = value.asCString();
+        return StringView(data, strlen(data));
+    }
+
+    static StringView snapshot_to_view(const Snapshot &snapshot, const SnapshotNode *value, const string &name) throw(Error)
+    {
+        if (value->type == SNAPSHOT_NULL)
+        {
+            return StringView();
+        }
+        if (value->type != SNAPSHOT_STRING)
+        {
+            throw Error(1, "read string error", "value is not a string", name, 0);
+        }
+        return StringView(snapshot.string(value->string), snapshot.stringSize(value->string));
+    }
+
+    StringView JsonCppDocument::readStringView(const ContainerNode &node, const string &name) const throw(Error)
+    {
+        ContainerNode native = nativeNode(node);
+        StringView view = _snapshot.isOpen()
+            ? snapshot_to_view(_snapshot, snapshotReadValue(native, name), name)
+            : value_to_view(read_value(&native, name), name);
+        update_node_state(node, native);
+        return view;
+    }
+
+    void JsonCppDocument::readStringVectorViews(const ContainerNode &node, const string &name, std::vector<StringView> &views) const throw(Error)
+    {
+        views.clear();
+        ContainerNode native = nativeNode(node);
+        if (_snapshot.isOpen())
+        {
+            const SnapshotNode *value = snapshotReadElement(native, name);
+            if (value->type != SNAPSHOT_NULL && value->type != SNAPSHOT_ARRAY)
+            {
+                throw Error(1, "read string vector error", "array expected", name, 0);
+            }
+            for (uint32_t i = 0; i < value->childCount; ++i)
+            {
+                views.push_back(snapshot_to_view(_snapshot, _snapshot.child(value, i), name));
+            }
+        }
+        else
+        {
+            const Json::Value &value = read_value(&native, name);
+            if (!value.isNull() && !value.isArray())
+            {
+                throw Error(1, "read string vector error", "array expected", name, 0);
+            }
+            for (ArrayIndex i = 0; i < value.size(); ++i)
+            {
+                views.push_back(value_to_view(value[i], name));
+            }
+        }
+        update_node_state(node, native);
+    }
+
+    /* Array elements */
+
+    void JsonCppDocument::readArrayElements(const ContainerNode &node, const string &name, std::vector<ContainerNode> &elements) const throw(Error)
+    {
+        ContainerNode native = nativeNode(node);
+        ContainerNode array = native.readArray(name);
+        update_node_state(node, native);
+        if (_snapshot.isOpen())
+        {
+            snapshotArrayElements(array, elements);
+            return;
+        }
+        ArrayIndex count = get_value(&array).size();
+        elements.assign(count, array);
+        for (ArrayIndex i = 0; i < count; ++i)
+        {
+            selectNextArrayElement(&elements[i], i);
+        }
+    }
 
+    /* Structural diff */
+
+    static bool is_container(const Json::Value &value)
+    {
+        return value.isObject() || value.isArray();
+    }
+
+    static void hash_scalar(Hash64 &hash, const Json::Value &value)
+    {
+        unsigned char type = static_cast<unsigned char>(value.type());
+        hash.update(&type, sizeof(type));
+        switch (value.type())
+        {
+        case booleanValue:
+        {
+            unsigned char boolean = value.asBool() ? 1 : 0;
+            hash.update(&boolean, sizeof(boolean));
+            break;
+        }
+        case intValue:
+        {
+            int64_t integer = value.asLargestInt();
+            hash.update(&integer, sizeof(integer));
+            break;
+        }
+        case uintValue:
+        {
+            uint64_t integer = value.asLargestUInt();
+            hash.update(&integer, sizeof(integer));
+            break;
+        }
+        case realValue:
+        {
+            double number = value.asDouble();
+            hash.update(&number, sizeof(number));
+            break;
+        }
+        case stringValue:
+        {
+            // terminating zero separates the string from the next item
+            const char *text = value.asCString();
+            hash.update(text, strlen(text) + 1);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // Members are hashed in key order, so equal objects have equal hashes
+    static uint64_t subtree_hash(const Json::Value &value, SubtreeHashCache &cache)
+    {
+        uint64_t cached;
+        if (cache.find(&value, cached))
+        {
+            return cached;
+        }
+
+        Hash64 hash;
+        unsigned char type = static_cast<unsigned char>(value.type());
+        hash.update(&type, sizeof(type));
+        for (Value::const_iterator it = value.begin(); it != value.end(); ++it)
+        {
+            if (value.isObject())
+            {
+                const char *name = it.memberName();
+                hash.update(name, strlen(name) + 1);
+            }
+            if (is_container(*it))
+            {
+                uint64_t child = subtree_hash(*it, cache);
+                hash.update(&child, sizeof(child));
+            }
+            else
+            {
+                hash_scalar(hash, *it);
+            }
+        }
+        uint64_t result = hash.digest();
+        cache.insert(&value, result);
+        return result;
+    }
+
+    struct ValueDiff
+    {
+        SubtreeHashCache &leftHashes;
+        SubtreeHashCache &rightHashes;
+        DiffPath &path;
+    };
+
+    static void diff_containers(ValueDiff &diff, const Json::Value &left, const Json::Value &right);
+
+    // Returns true if container holding the values is changed itself
+    static bool diff_children(ValueDiff &diff, const Json::Value *left, const Json::Value *right)
+    {
+        const Json::Value *present = left != NULL ? left : right;
+        if (left == NULL || right == NULL)
+        {
+            if (!is_container(*present))
+            {
+                return true;
+            }
+            diff.path.report();
+            return false;
+        }
+
+        if (is_container(*left) && left->type() == right->type())
+        {
+            if (subtree_hash(*left, diff.leftHashes) != subtree_hash(*right, diff.rightHashes))
+            {
+                diff_containers(diff, *left, *right);
+            }
+            return false;
+        }
+        if (is_container(*left) || is_container(*right))
+        {
+            // container replaced by container of other type or by scalar
+            diff.path.report();
+            return false;
+        }
+        return left->type() != right->type() || *left != *right;
+    }
+
+    static void diff_containers(ValueDiff &diff, const Json::Value &left, const Json::Value &right)
+    {
+        size_t mark = diff.path.mark();
+        bool changed = false;
+        if (left.isArray())
+        {
+            ArrayIndex count = left.size() > right.size() ? left.size() : right.size();
+            for (ArrayIndex i = 0; i < count; ++i)
+            {
+                diff.path.push(i);
+                changed |= diff_children(diff, i < left.size() ? &left[i] : NULL, i < right.size() ? &right[i] : NULL);
+                diff.path.pop();
+            }
+        }
+        else
+        {
+            // members of both objects are iterated in key order at once
+            Value::const_iterator leftIt = left.begin();
+            Value::const_iterator rightIt = right.begin();
+            while (leftIt != left.end() || rightIt != right.end())
+            {
+                int order = leftIt == left.end() ? 1
+                    : rightIt == right.end() ? -1
+                    : strcmp(leftIt.memberName(), rightIt.memberName());
+                diff.path.push(order <= 0 ? leftIt.memberName() : rightIt.memberName());
+                changed |= diff_children(diff, order <= 0 ? &*leftIt : NULL, order >= 0 ? &*rightIt : NULL);
+                diff.path.pop();
+                if (order <= 0)
+                {
+                    ++leftIt;
+                }
+                if (order >= 0)
+                {
+                    ++rightIt;
+                }
+            }
+        }
+        if (changed)
+        {
+            diff.path.report(mark);
+        }
+    }
+
+    std::vector<std::string> JsonCppDocument::diff(const JsonCppDocument &other) const
+    {
+        std::vector<std::string> changed;
+        // trees restored from snapshot are temporary, their hashes are not kept,
+        // and hashes of trees read by threads at once are not kept either
+        Json::Value leftRestored, rightRestored;
+        SubtreeHashCache leftTemporary, rightTemporary;
+        const Json::Value &left = documentToSave(leftRestored);
+        const Json::Value &right = other.documentToSave(rightRestored);
+        SubtreeHashCache &leftHashes = keepsSubtreeHashes() ? _subtreeHashes : leftTemporary;
+        SubtreeHashCache &rightHashes = other.keepsSubtreeHashes() ? other._subtreeHashes : rightTemporary;
+
+        DiffPath path(changed);
+        ValueDiff diff = { leftHashes, rightHashes, path };
+        if (left.type() != right.type())
+        {
+            path.report();
+        }
+        else if (subtree_hash(left, leftHashes) != subtree_hash(right, rightHashes))
+        {
+            diff_containers(diff, left, right);
+        }
+        return changed;
+    }
+
+    void JsonCppDocument::invalidateHashes()
+    {
+        _subtreeHashes.clear();
+        _contentHashValid = false;
+    }
+
+    bool JsonCppDocument::hasContentHash() const
+    {
+        return _contentHashValid;
+    }
+
+    uint64_t JsonCppDocument::getContentHash() const
+    {
+        return _contentHashValid ? _contentHash : 0;
+    }
+
+    // Cache is written on reads, so it is not used by concurrent readers
+    bool JsonCppDocument::keepsSubtreeHashes() const
+    {
+        return !_snapshot.isOpen() && !_concurrentReadEnabled;
+    }
+
+    uint64_t JsonCppDocument::getTreeHash() const
+    {
+        Json::Value restored;
+        SubtreeHashCache temporary;
+        const Json::Value &document = documentToSave(restored);
+        return subtree_hash(document, keepsSubtreeHashes() ? _subtreeHashes : temporary);
+    }
+
+}
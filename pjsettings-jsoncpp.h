@@ -28,22 +28,134 @@
 
 #endif
 
+#include "pjsettings-arena.h"
+#include "pjsettings-array-elements.h"
+#include "pjsettings-config.h"
+#include "pjsettings-diff.h"
+#include "pjsettings-numeric.h"
+#include "pjsettings-profiler.h"
+#include "pjsettings-snapshot.h"
+#include "pjsettings-string-view.h"
+
 namespace pjsettings
 {
-    class JsonCppDocument : public pj::PersistentDocument
+    class JsonCppDocument : public pj::PersistentDocument, public NumericExtension, public StringViewExtension, public ArrayElementsExtension
     {
     public:
         JsonCppDocument(bool notStyledOutputOnWriting = false);
         virtual void loadFile(const std::string &filename) throw(pj::Error);
         virtual void loadString(const std::string &input) throw(pj::Error);
+#if PJSETTINGS_HAS_RVALUE_REFERENCES
+        void loadString(std::string &&input) throw(pj::Error);
+#endif
+        void loadBuffer(const char *input, size_t size) throw(pj::Error);
         virtual void saveFile(const std::string &filename) throw(pj::Error);
         virtual std::string saveString() throw(pj::Error);
         virtual pj::ContainerNode &getRootContainer() const;
+
+        // loadFile reads binary snapshot cached next to the file instead of
+        // parsing it, when the file is not changed since the snapshot was built.
+        // Document loaded from snapshot is read-only.
+        void setSnapshotCacheEnabled(bool enabled);
+        bool isSnapshotCacheEnabled() const;
+        bool isLoadedFromSnapshot() const;
+
+        // Tree is converted to snapshot layout held in memory: members sorted
+        // by name for binary search, values inline, strings in one pool.
+        // Document loaded from snapshot is frozen too. Frozen document is
+        // read-only until thaw() builds the tree again. Nodes taken before
+        // freeze() or thaw() must not be used after it.
+        void freeze() throw(pj::Error);
+        void thaw();
+        bool isFrozen() const;
+
+        // Strings and containers of loaded tree are allocated from arena
+        // owned by document, that is released at once on next load or
+        // destruction. Values written later are allocated one by one.
+        void setArenaEnabled(bool enabled);
+        bool isArenaEnabled() const;
+        // Bytes held by arena of the tree loaded last
+        size_t getArenaSize() const;
+
+        // Operations on nodes of document are timed and counted
+        // while profiler is enabled, see OperationProfiler
+        OperationProfiler &profiler();
+
+        // Read operations on nodes never write shared document state, so
+        // threads can read the loaded document at once. Each reader takes its
+        // own nodes (arrays keep their cursors in nodes), nodes are not shared
+        // between threads. Loads, writes, freeze() and thaw() still need the
+        // document for themselves. Enabling concurrent reads disables profiler,
+        // it must not be enabled again while threads read the document.
+        // diff() and getTreeHash() don't cache subtree hashes while it is enabled.
+        void setConcurrentReadEnabled(bool enabled);
+        bool isConcurrentReadEnabled() const;
+
+        // Inputs of minSize bytes or more are parsed by threads, when they hold
+        // array arrayName of the root object (the root array if the name is empty):
+        // its items are split between threads by size. The tree is the same as
+        // Json::Reader builds. Input the items can't be split in, e.g. with comments
+        // in the array, or that fails to parse is parsed again on calling thread,
+        // so errors are reported the same way. Parallel parsing is disabled
+        // for less than two threads.
+        void setParallelParsing(unsigned threads, const std::string &arrayName, size_t minSize = 1048576);
+        unsigned getParallelParsingThreads() const;
+        // Whether the tree loaded last was parsed by threads
+        bool isParsedInParallel() const;
+
+        // Numbers stored as Json::Int64 and double, see NumericExtension
+        virtual int64_t readInt64(const pj::ContainerNode &node, const std::string &name) const throw(pj::Error);
+        virtual double readDouble(const pj::ContainerNode &node, const std::string &name) const throw(pj::Error);
+        virtual void writeInt64(pj::ContainerNode &node, const std::string &name, int64_t value) throw(pj::Error);
+        virtual void writeDouble(pj::ContainerNode &node, const std::string &name, double value) throw(pj::Error);
+
+        // Views of Json::Value strings, see StringViewExtension
+        virtual StringView readStringView(const pj::ContainerNode &node, const std::string &name) const throw(pj::Error);
+        virtual void readStringVectorViews(const pj::ContainerNode &node, const std::string &name, std::vector<StringView> &views) const throw(pj::Error);
+
+        // Nodes of all array items, see ArrayElementsExtension
+        virtual void readArrayElements(const pj::ContainerNode &node, const std::string &name, std::vector<pj::ContainerNode> &elements) const throw(pj::Error);
+
+        // Paths of containers that differ from the same containers of other
+        // document, see DiffPath. Unchanged subtrees are skipped by their hashes,
+        // which are kept by both documents until they are loaded or written.
+        std::vector<std::string> diff(const JsonCppDocument &other) const;
+
+        // XXH64 of bytes the document was loaded from (or snapshot was built from),
+        // dropped when the document is written. reloadIfChanged() loads the file
+        // only if its content hash differs, otherwise the file is not parsed.
+        bool hasContentHash() const;
+        uint64_t getContentHash() const;
+        bool reloadIfChanged(const std::string &filename) throw(pj::Error);
+        // Hash of the tree that does not depend on formatting and member order
+        uint64_t getTreeHash() const;
+
+        // Called by write operations of nodes
+        void invalidateHashes();
     private:
         void initRoot();
+        bool keepsSubtreeHashes() const;
+        const Json::Value &documentToSave(Json::Value &restored) const;
+        pj::ContainerNode nativeNode(const pj::ContainerNode &node) const throw(pj::Error);
+        void releaseTree();
+        bool parseTree(Json::Reader &reader, const char *begin, const char *end);
+        Arena _arena;                   // declared before _document, so it outlives the tree
+        std::vector<Arena> _threadArenas;   // array items parsed by other threads
+        bool _arenaEnabled;
         Json::Value _document;
         mutable pj::ContainerNode _rootNode;
         bool _notStyledOutputOnWriting;
+        bool _snapshotCacheEnabled;
+        Snapshot _snapshot;
+        mutable OperationProfiler _profiler;
+        bool _concurrentReadEnabled;
+        unsigned _parallelThreads;
+        std::string _parallelArrayName;
+        size_t _parallelMinSize;
+        bool _parsedInParallel;
+        mutable SubtreeHashCache _subtreeHashes;
+        uint64_t _contentHash;
+        bool _contentHashValid;
     };
 
 }
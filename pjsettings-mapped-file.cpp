@@ -0,0 +1,279 @@
+/*
+ * Memory-mapped file helper for pjsettings document backends
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include "pjsettings-mapped-file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace pj;
+using namespace std;
+
+namespace pjsettings
+{
+
+    MappedFile::MappedFile()
+        : _data(NULL)
+        , _size(0)
+#ifdef _WIN32
+        , _mapping(NULL)
+#else
+        , _device(0)
+        , _inode(0)
+        , _fileSize(0)
+        , _modifiedSeconds(0)
+        , _modifiedNanoseconds(0)
+#endif
+    {
+    }
+
+    MappedFile::~MappedFile()
+    {
+        close();
+    }
+
+#ifdef _WIN32
+
+    void MappedFile::open(const std::string &filename) throw(pj::Error)
+    {
+        close();
+
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            throw Error(1, "there is no file exists", filename, __FILE__, __LINE__);
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize))
+        {
+            CloseHandle(file);
+            throw Error(1, "map file error", "can't get file size", filename, 0);
+        }
+        if (fileSize.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        CloseHandle(file);
+        if (mapping == NULL)
+        {
+            throw Error(1, "map file error", "can't create file mapping", filename, 0);
+        }
+
+        void *data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+        if (data == NULL)
+        {
+            CloseHandle(mapping);
+            throw Error(1, "map file error", "can't map view of file", filename, 0);
+        }
+
+        _mapping = mapping;
+        _data = static_cast<char *>(data);
+        _size = static_cast<size_t>(fileSize.QuadPart);
+    }
+
+    void MappedFile::close()
+    {
+        if (_data != NULL)
+        {
+            UnmapViewOfFile(_data);
+            CloseHandle(_mapping);
+        }
+        _data = NULL;
+        _size = 0;
+        _mapping = NULL;
+    }
+
+    size_t MappedFile::privateResidentSize() const
+    {
+        return _size;
+    }
+
+    bool MappedFile::isModifiedInPlace(const std::string &) const
+    {
+        return false;
+    }
+
+#else
+
+    static long modified_nanoseconds(const struct stat &fileStat)
+    {
+#ifdef __linux__
+        return fileStat.st_mtim.tv_nsec;
+#else
+        (void)fileStat;
+        return 0;
+#endif
+    }
+
+    void MappedFile::open(const std::string &filename) throw(pj::Error)
+    {
+        close();
+
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw Error(1, "there is no file exists", filename, __FILE__, __LINE__);
+        }
+
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) != 0)
+        {
+            ::close(fd);
+            throw Error(1, "map file error", "can't get file size", filename, 0);
+        }
+        if (fileStat.st_size == 0)
+        {
+            ::close(fd);
+            return;
+        }
+
+        size_t size = static_cast<size_t>(fileStat.st_size);
+        void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED)
+        {
+            throw Error(1, "map file error", "mmap failed", filename, 0);
+        }
+
+        _data = static_cast<char *>(data);
+        _size = size;
+        _device = fileStat.st_dev;
+        _inode = fileStat.st_ino;
+        _fileSize = fileStat.st_size;
+        _modifiedSeconds = fileStat.st_mtime;
+        _modifiedNanoseconds = modified_nanoseconds(fileStat);
+    }
+
+    void MappedFile::close()
+    {
+        if (_data != NULL)
+        {
+            munmap(_data, _size);
+        }
+        _data = NULL;
+        _size = 0;
+        _device = 0;
+        _inode = 0;
+        _fileSize = 0;
+        _modifiedSeconds = 0;
+        _modifiedNanoseconds = 0;
+    }
+
+    bool MappedFile::isModifiedInPlace(const std::string &filename) const
+    {
+        struct stat fileStat;
+        if (_data == NULL || ::stat(filename.c_str(), &fileStat) != 0)
+        {
+            return false;
+        }
+        if (static_cast<unsigned long long>(fileStat.st_dev) != _device
+            || static_cast<unsigned long long>(fileStat.st_ino) != _inode)
+        {
+            // replaced by rename, mapped file is not there anymore
+            return false;
+        }
+        return fileStat.st_size != _fileSize
+            || fileStat.st_mtime != _modifiedSeconds
+            || modified_nanoseconds(fileStat) != _modifiedNanoseconds;
+    }
+
+    size_t MappedFile::privateResidentSize() const
+    {
+        if (_data == NULL)
+        {
+            return 0;
+        }
+#ifdef __linux__
+        // Copied-on-write pages of a private file mapping are accounted
+        // as "Anonymous" in the mapping's /proc/self/smaps entry
+        std::ifstream smaps("/proc/self/smaps");
+        if (!smaps)
+        {
+            return _size;
+        }
+
+        unsigned long begin = reinterpret_cast<unsigned long>(_data);
+        unsigned long pageMask = static_cast<unsigned long>(sysconf(_SC_PAGESIZE)) - 1;
+        unsigned long end = (begin + _size + pageMask) & ~pageMask;
+        bool inMapping = false;
+        bool found = false;
+        size_t anonymousKb = 0;
+        std::string line;
+        while (std::getline(smaps, line))
+        {
+            unsigned long regionBegin = 0, regionEnd = 0;
+            char dash = 0;
+            std::istringstream header(line);
+            if (header >> std::hex >> regionBegin >> dash >> regionEnd && dash == '-')
+            {
+                inMapping = regionBegin >= begin && regionEnd <= end;
+                found = found || inMapping;
+                continue;
+            }
+            if (inMapping && line.compare(0, 10, "Anonymous:") == 0)
+            {
+                std::istringstream value(line.substr(10));
+                size_t kb = 0;
+                value >> kb;
+                anonymousKb += kb;
+            }
+        }
+        if (!found)
+        {
+            return _size;
+        }
+        size_t result = anonymousKb * 1024;
+        return result < _size ? result : _size;
+#else
+        return _size;
+#endif
+    }
+
+#endif
+
+    void MappedFile::swap(MappedFile &other)
+    {
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+#ifdef _WIN32
+        std::swap(_mapping, other._mapping);
+#else
+        std::swap(_device, other._device);
+        std::swap(_inode, other._inode);
+        std::swap(_fileSize, other._fileSize);
+        std::swap(_modifiedSeconds, other._modifiedSeconds);
+        std::swap(_modifiedNanoseconds, other._modifiedNanoseconds);
+#endif
+    }
+
+}
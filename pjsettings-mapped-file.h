@@ -0,0 +1,87 @@
+/*
+ * Memory-mapped file helper for pjsettings document backends
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PJSETTINGS_MAPPED_FILE_H__
+#define __PJSETTINGS_MAPPED_FILE_H__
+
+#include <stddef.h>
+#include <string>
+
+#ifndef PJSETTINGS_NOT_USE_PJSUA
+#include <pjsua2/persistent.hpp>
+#endif
+
+namespace pjsettings
+{
+    /**
+     * Private copy-on-write mapping of the whole file.
+     *
+     * Pages are shared with the page cache until they are written to,
+     * so the mapping can be used as a mutable buffer for in-place parsers.
+     * Empty files are not mapped: data() is NULL and size() is 0.
+     *
+     * Pages that were not copied yet show what the file holds now, so the file
+     * must be replaced by rename while it is mapped, never written in place:
+     * truncated file raises SIGBUS on access to pages past its new end.
+     */
+    class MappedFile
+    {
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        void open(const std::string &filename) throw(pj::Error);
+        void close();
+        void swap(MappedFile &other);
+
+        char *data() const { return _data; }
+        size_t size() const { return _size; }
+
+        // Bytes of the mapping that became private (copied on write) memory.
+        // Returns size() when the platform can not tell it.
+        size_t privateResidentSize() const;
+
+        // True if the mapped file is still at filename and was written or truncated
+        // since it was mapped (its size or modification time differ).
+        // File replaced by rename keeps the mapping valid and is not reported.
+        // Not checked on Windows, where mapped files can't be truncated: always false.
+        bool isModifiedInPlace(const std::string &filename) const;
+
+    private:
+        MappedFile(const MappedFile &);
+        MappedFile &operator=(const MappedFile &);
+
+        char *_data;
+        size_t _size;
+#ifdef _WIN32
+        void *_mapping;
+#else
+        // identity and state of the file when it was mapped
+        unsigned long long _device;
+        unsigned long long _inode;
+        long long _fileSize;
+        long long _modifiedSeconds;
+        long _modifiedNanoseconds;
+#endif
+    };
+}
+
+#endif
@@ -0,0 +1,744 @@
+/*
+ * Locale independent number formatting for pjsettings
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <float.h>
+#include <locale.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+#include "pjsettings-number.h"
+
+namespace pjsettings
+{
+
+    static const uint32_t pow10_32[10] = {
+        1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u
+    };
+
+    // Exactly representable powers of ten
+    static const double pow10_double[23] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    /*
+     * Unsigned integer of fixed capacity, large enough for scaled
+     * numerator and denominator of any double: about 1100 bits.
+     */
+    class Bignum
+    {
+    public:
+        Bignum() : _size(0) {}
+
+        void assign(uint64_t value)
+        {
+            _size = 0;
+            while (value != 0)
+            {
+                _words[_size++] = static_cast<uint32_t>(value);
+                value >>= 32;
+            }
+        }
+
+        void shiftLeft(unsigned bits)
+        {
+            if (_size == 0)
+            {
+                return;
+            }
+            unsigned wordShift = bits / 32;
+            unsigned bitShift = bits % 32;
+            if (bitShift != 0)
+            {
+                uint32_t carry = 0;
+                for (unsigned i = 0; i < _size; ++i)
+                {
+                    uint32_t word = _words[i];
+                    _words[i] = (word << bitShift) | carry;
+                    carry = word >> (32 - bitShift);
+                }
+                if (carry != 0)
+                {
+                    _words[_size++] = carry;
+                }
+            }
+            if (wordShift != 0)
+            {
+                memmove(_words + wordShift, _words, _size * sizeof(uint32_t));
+                memset(_words, 0, wordShift * sizeof(uint32_t));
+                _size += wordShift;
+            }
+        }
+
+        void multiply(uint32_t factor)
+        {
+            uint64_t carry = 0;
+            for (unsigned i = 0; i < _size; ++i)
+            {
+                uint64_t product = static_cast<uint64_t>(_words[i]) * factor + carry;
+                _words[i] = static_cast<uint32_t>(product);
+                carry = product >> 32;
+            }
+            if (carry != 0)
+            {
+                _words[_size++] = static_cast<uint32_t>(carry);
+            }
+        }
+
+        void multiplyPow10(int exponent)
+        {
+            for (; exponent >= 9; exponent -= 9)
+            {
+                multiply(pow10_32[9]);
+            }
+            if (exponent > 0)
+            {
+                multiply(pow10_32[exponent]);
+            }
+        }
+
+        void assignSum(const Bignum &a, const Bignum &b)
+        {
+            const Bignum &longer = a._size >= b._size ? a : b;
+            const Bignum &shorter = a._size >= b._size ? b : a;
+            uint64_t carry = 0;
+            for (unsigned i = 0; i < longer._size; ++i)
+            {
+                uint64_t sum = static_cast<uint64_t>(longer._words[i]) + carry;
+                if (i < shorter._size)
+                {
+                    sum += shorter._words[i];
+                }
+                _words[i] = static_cast<uint32_t>(sum);
+                carry = sum >> 32;
+            }
+            _size = longer._size;
+            if (carry != 0)
+            {
+                _words[_size++] = static_cast<uint32_t>(carry);
+            }
+        }
+
+        // other must not be greater than this
+        void subtract(const Bignum &other)
+        {
+            int64_t borrow = 0;
+            for (unsigned i = 0; i < _size; ++i)
+            {
+                int64_t difference = static_cast<int64_t>(_words[i]) - borrow;
+                if (i < other._size)
+                {
+                    difference -= other._words[i];
+                }
+                borrow = difference < 0 ? 1 : 0;
+                _words[i] = static_cast<uint32_t>(difference + (borrow << 32));
+            }
+            while (_size > 0 && _words[_size - 1] == 0)
+            {
+                --_size;
+            }
+        }
+
+        static int compare(const Bignum &a, const Bignum &b)
+        {
+            if (a._size != b._size)
+            {
+                return a._size < b._size ? -1 : 1;
+            }
+            for (unsigned i = a._size; i > 0; --i)
+            {
+                if (a._words[i - 1] != b._words[i - 1])
+                {
+                    return a._words[i - 1] < b._words[i - 1] ? -1 : 1;
+                }
+            }
+            return 0;
+        }
+
+    private:
+        static const unsigned Capacity = 40;
+
+        uint32_t _words[Capacity];
+        unsigned _size;
+    };
+
+    // value is 0.digits * 10^pointPosition
+    struct ShortestDecimal
+    {
+        bool negative;
+        char digits[20];
+        int count;
+        int pointPosition;
+    };
+
+    /*
+     * Shortest digits of f * 2^e that are inside rounding interval of it.
+     *
+     * Burger & Dybvig free-format algorithm: value is r / s, its interval
+     * is (r - mMinus) / s .. (r + mPlus) / s, and digits are generated
+     * until the rest of the value fits in the interval.
+     *
+     * With readAsDouble float is read back by converting text to double and
+     * then to float, so the interval is measured after double rounding:
+     * text that becomes boundary double still gives even float (ties to even),
+     * the interval of even float is widened by half ulp of double on both sides,
+     * interval of odd one is narrowed by it. Boundaries are excluded.
+     */
+    static void shortest_digits(uint64_t f, int e, int precision, int minExponent, bool readAsDouble, ShortestDecimal &result)
+    {
+        bool unequalMargins = f == (static_cast<uint64_t>(1) << (precision - 1)) && e > minExponent;
+        bool boundariesInside = (f & 1) == 0 && !readAsDouble;
+
+        Bignum r;
+        Bignum s;
+        Bignum mPlus;
+        Bignum mMinus;
+        r.assign(f);
+        s.assign(1);
+        mPlus.assign(1);
+        mMinus.assign(1);
+        if (e >= 0)
+        {
+            r.shiftLeft(e + (unequalMargins ? 2 : 1));
+            s.shiftLeft(unequalMargins ? 2 : 1);
+            mPlus.shiftLeft(e + (unequalMargins ? 1 : 0));
+            mMinus.shiftLeft(e);
+        }
+        else
+        {
+            r.shiftLeft(unequalMargins ? 2 : 1);
+            s.shiftLeft(-e + (unequalMargins ? 2 : 1));
+            mPlus.shiftLeft(unequalMargins ? 1 : 0);
+        }
+
+        if (readAsDouble)
+        {
+            // scaled by 2^29, half ulp of double above and below is mPlus and mMinus (53 - 24 = 29 more bits)
+            Bignum halfDoubleUlpAbove = mPlus;
+            Bignum halfDoubleUlpBelow = mMinus;
+            r.shiftLeft(29);
+            s.shiftLeft(29);
+            mPlus.shiftLeft(29);
+            mMinus.shiftLeft(29);
+            if ((f & 1) == 0)
+            {
+                Bignum margin = mPlus;
+                mPlus.assignSum(margin, halfDoubleUlpAbove);
+                margin = mMinus;
+                mMinus.assignSum(margin, halfDoubleUlpBelow);
+            }
+            else
+            {
+                mPlus.subtract(halfDoubleUlpAbove);
+                mMinus.subtract(halfDoubleUlpBelow);
+            }
+        }
+
+        // estimate of decimal point position, corrected below
+        double value = ldexp(static_cast<double>(f), e);
+        int k = static_cast<int>(ceil(log10(value) - 1e-10));
+        if (k >= 0)
+        {
+            s.multiplyPow10(k);
+        }
+        else
+        {
+            r.multiplyPow10(-k);
+            mPlus.multiplyPow10(-k);
+            mMinus.multiplyPow10(-k);
+        }
+
+        Bignum high;
+        for (;;)
+        {
+            high.assignSum(r, mPlus);
+            int c = Bignum::compare(high, s);
+            if (boundariesInside ? c < 0 : c <= 0)
+            {
+                break;
+            }
+            s.multiply(10);
+            ++k;
+        }
+        for (;;)
+        {
+            high.assignSum(r, mPlus);
+            high.multiply(10);
+            int c = Bignum::compare(high, s);
+            if (boundariesInside ? c >= 0 : c > 0)
+            {
+                break;
+            }
+            r.multiply(10);
+            mPlus.multiply(10);
+            mMinus.multiply(10);
+            --k;
+        }
+
+        result.count = 0;
+        result.pointPosition = k;
+        for (;;)
+        {
+            r.multiply(10);
+            mPlus.multiply(10);
+            mMinus.multiply(10);
+            int digit = 0;
+            while (Bignum::compare(r, s) >= 0)
+            {
+                r.subtract(s);
+                ++digit;
+            }
+
+            int low = Bignum::compare(r, mMinus);
+            high.assignSum(r, mPlus);
+            int highCompare = Bignum::compare(high, s);
+            bool lowReached = boundariesInside ? low <= 0 : low < 0;
+            bool highReached = boundariesInside ? highCompare >= 0 : highCompare > 0;
+            if (!lowReached && !highReached && result.count < static_cast<int>(sizeof(result.digits)) - 1)
+            {
+                result.digits[result.count++] = static_cast<char>('0' + digit);
+                continue;
+            }
+
+            if (lowReached && highReached)
+            {
+                // both digits are inside the interval, take the nearest one
+                Bignum twice = r;
+                twice.shiftLeft(1);
+                int c = Bignum::compare(twice, s);
+                if (c > 0 || (c == 0 && (digit & 1) != 0))
+                {
+                    ++digit;
+                }
+            }
+            else if (highReached)
+            {
+                ++digit;
+            }
+            result.digits[result.count++] = static_cast<char>('0' + digit);
+            break;
+        }
+    }
+
+    static size_t format_integer(bool negative, uint64_t value, char *buffer)
+    {
+        char digits[20];
+        int count = 0;
+        do
+        {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        }
+        while (value != 0);
+
+        char *out = buffer;
+        if (negative)
+        {
+            *out++ = '-';
+        }
+        while (count > 0)
+        {
+            *out++ = digits[--count];
+        }
+        *out = 0;
+        return static_cast<size_t>(out - buffer);
+    }
+
+    static size_t format_decimal(const ShortestDecimal &decimal, char *buffer)
+    {
+        char *out = buffer;
+        if (decimal.negative)
+        {
+            *out++ = '-';
+        }
+
+        int count = decimal.count;
+        int point = decimal.pointPosition;
+        int exponent = point - 1;
+        if (exponent >= -6 && exponent < 21)
+        {
+            if (point <= 0)
+            {
+                *out++ = '0';
+                *out++ = '.';
+                for (int i = point; i < 0; ++i)
+                {
+                    *out++ = '0';
+                }
+                memcpy(out, decimal.digits, count);
+                out += count;
+            }
+            else if (point >= count)
+            {
+                memcpy(out, decimal.digits, count);
+                out += count;
+                for (int i = count; i < point; ++i)
+                {
+                    *out++ = '0';
+                }
+            }
+            else
+            {
+                memcpy(out, decimal.digits, point);
+                out += point;
+                *out++ = '.';
+                memcpy(out, decimal.digits + point, count - point);
+                out += count - point;
+            }
+        }
+        else
+        {
+            *out++ = decimal.digits[0];
+            if (count > 1)
+            {
+                *out++ = '.';
+                memcpy(out, decimal.digits + 1, count - 1);
+                out += count - 1;
+            }
+            *out++ = 'e';
+            *out++ = exponent < 0 ? '-' : '+';
+            out += format_integer(false, static_cast<uint64_t>(exponent < 0 ? -exponent : exponent), out);
+        }
+        *out = 0;
+        return static_cast<size_t>(out - buffer);
+    }
+
+    static size_t format_special(bool negative, bool isNan, char *buffer)
+    {
+        const char *text = isNan ? "null" : (negative ? "-1e+9999" : "1e+9999");
+        size_t length = strlen(text);
+        memcpy(buffer, text, length + 1);
+        return length;
+    }
+
+    size_t formatDouble(double value, char *buffer)
+    {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        bool negative = (bits >> 63) != 0;
+        int biasedExponent = static_cast<int>((bits >> 52) & 0x7FF);
+        uint64_t fraction = bits & ((static_cast<uint64_t>(1) << 52) - 1);
+        if (biasedExponent == 0x7FF)
+        {
+            return format_special(negative, fraction != 0, buffer);
+        }
+
+        // integers are the most of numbers in configuration
+        double magnitude = negative ? -value : value;
+        if (magnitude < 9007199254740992.0 && magnitude == floor(magnitude))
+        {
+            return format_integer(negative, static_cast<uint64_t>(magnitude), buffer);
+        }
+
+        ShortestDecimal decimal;
+        decimal.negative = negative;
+        if (biasedExponent == 0)
+        {
+            shortest_digits(fraction, -1074, 53, -1074, false, decimal);
+        }
+        else
+        {
+            shortest_digits(fraction | (static_cast<uint64_t>(1) << 52), biasedExponent - 1075, 53, -1074, false, decimal);
+        }
+        return format_decimal(decimal, buffer);
+    }
+
+    // false for integers and not finite values, that need no digits generation
+    static bool float_shortest_decimal(float value, ShortestDecimal &decimal)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        int biasedExponent = static_cast<int>((bits >> 23) & 0xFF);
+        uint32_t fraction = bits & ((1u << 23) - 1);
+        double magnitude = fabs(static_cast<double>(value));
+        if (biasedExponent == 0xFF || (magnitude < 16777216.0 && magnitude == floor(magnitude)))
+        {
+            return false;
+        }
+
+        decimal.negative = (bits >> 31) != 0;
+        if (biasedExponent == 0)
+        {
+            shortest_digits(fraction, -149, 24, -149, true, decimal);
+        }
+        else
+        {
+            shortest_digits(fraction | (1u << 23), biasedExponent - 150, 24, -149, true, decimal);
+        }
+        return true;
+    }
+
+    size_t formatInt64(int64_t value, char *buffer)
+    {
+        uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+        return format_integer(value < 0, magnitude, buffer);
+    }
+
+    size_t formatFloat(float value, char *buffer)
+    {
+        ShortestDecimal decimal;
+        if (!float_shortest_decimal(value, decimal))
+        {
+            // integers and not finite values are formatted the same way as doubles
+            return formatDouble(value, buffer);
+        }
+        return format_decimal(decimal, buffer);
+    }
+
+    double floatToShortestDouble(float value)
+    {
+        ShortestDecimal decimal;
+        if (!float_shortest_decimal(value, decimal))
+        {
+            return value;
+        }
+
+        // at most 9 digits, mantissa and power of ten are exact,
+        // so the result is rounded only once
+        double mantissa = 0;
+        for (int i = 0; i < decimal.count; ++i)
+        {
+            mantissa = mantissa * 10 + (decimal.digits[i] - '0');
+        }
+        int exponent = decimal.pointPosition - decimal.count;
+        if (exponent < -22 || exponent > 22)
+        {
+            return value;
+        }
+        double result = exponent >= 0 ? mantissa * pow10_double[exponent] : mantissa / pow10_double[-exponent];
+        return decimal.negative ? -result : result;
+    }
+
+    /* Parsing */
+
+    // Fast path needs double arithmetic without excess precision
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD != 0
+    static const bool exactDoubleArithmetic = false;
+#else
+    static const bool exactDoubleArithmetic = true;
+#endif
+
+    static const uint64_t maxExactInteger = static_cast<uint64_t>(1) << 53;
+
+    static bool is_digit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    // Case insensitive match of lowercase word at the start of text
+    static bool match_word(const char *begin, const char *end, const char *word)
+    {
+        for (; *word != 0; ++begin, ++word)
+        {
+            if (begin == end || (*begin | 0x20) != *word)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+#ifdef _WIN32
+    static double strtod_c_locale(const char *text, char **end)
+    {
+        static _locale_t cLocale = _create_locale(LC_NUMERIC, "C");
+        return _strtod_l(text, end, cLocale);
+    }
+#else
+    static double strtod_c_locale(const char *text, char **end)
+    {
+        static locale_t cLocale = newlocale(LC_NUMERIC_MASK, "C", static_cast<locale_t>(0));
+        return strtod_l(text, end, cLocale);
+    }
+#endif
+
+    /*
+     * Correctly rounded conversion of numbers the fast path can't convert:
+     * more than 2^53 in mantissa, large exponents or hexadecimal numbers.
+     * strtod_l with "C" locale neither depends on nor locks global locale.
+     */
+    static const char *parse_slow(const char *begin, const char *end, double &value)
+    {
+        char buffer[64];
+        std::string longText;
+        size_t length = static_cast<size_t>(end - begin);
+        const char *text = buffer;
+        if (length < sizeof(buffer))
+        {
+            memcpy(buffer, begin, length);
+            buffer[length] = 0;
+        }
+        else
+        {
+            longText.assign(begin, end);
+            text = longText.c_str();
+        }
+        char *parsed = NULL;
+        value = strtod_c_locale(text, &parsed);
+        return begin + (parsed - text);
+    }
+
+    const char *parseDouble(const char *begin, const char *end, double &value)
+    {
+        const char *current = begin;
+        bool negative = false;
+        if (current != end && (*current == '-' || *current == '+'))
+        {
+            negative = *current == '-';
+            ++current;
+        }
+
+        if (current != end && !is_digit(*current) && *current != '.')
+        {
+            double zero = 0;
+            if (match_word(current, end, "infinity"))
+            {
+                value = negative ? -1 / zero : 1 / zero;
+                return current + 8;
+            }
+            if (match_word(current, end, "inf"))
+            {
+                value = negative ? -1 / zero : 1 / zero;
+                return current + 3;
+            }
+            if (match_word(current, end, "nan"))
+            {
+                value = zero / zero;
+                return current + 3;
+            }
+            value = 0;
+            return begin;
+        }
+        if (end - current > 1 && current[0] == '0' && (current[1] | 0x20) == 'x')
+        {
+            return parse_slow(begin, end, value);
+        }
+
+        // up to 19 significant digits are kept in mantissa, the rest is only checked for being zero
+        uint64_t mantissa = 0;
+        int digits = 0;
+        int exponent = 0;
+        bool truncated = false;
+        bool anyDigits = false;
+        for (; current != end && is_digit(*current); ++current)
+        {
+            anyDigits = true;
+            unsigned digit = static_cast<unsigned>(*current - '0');
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + digit;
+                digits += mantissa != 0 ? 1 : 0;
+            }
+            else
+            {
+                ++exponent;
+                truncated = truncated || digit != 0;
+            }
+        }
+        if (current != end && *current == '.')
+        {
+            ++current;
+            for (; current != end && is_digit(*current); ++current)
+            {
+                anyDigits = true;
+                unsigned digit = static_cast<unsigned>(*current - '0');
+                if (digits < 19)
+                {
+                    mantissa = mantissa * 10 + digit;
+                    digits += mantissa != 0 ? 1 : 0;
+                    --exponent;
+                }
+                else
+                {
+                    truncated = truncated || digit != 0;
+                }
+            }
+        }
+        if (!anyDigits)
+        {
+            value = 0;
+            return begin;
+        }
+
+        // exponent without digits is not a part of number
+        if (current != end && (*current | 0x20) == 'e')
+        {
+            const char *exponentText = current + 1;
+            bool negativeExponent = false;
+            if (exponentText != end && (*exponentText == '-' || *exponentText == '+'))
+            {
+                negativeExponent = *exponentText == '-';
+                ++exponentText;
+            }
+            if (exponentText != end && is_digit(*exponentText))
+            {
+                int explicitExponent = 0;
+                for (current = exponentText; current != end && is_digit(*current); ++current)
+                {
+                    if (explicitExponent < 100000)
+                    {
+                        explicitExponent = explicitExponent * 10 + (*current - '0');
+                    }
+                }
+                exponent += negativeExponent ? -explicitExponent : explicitExponent;
+            }
+        }
+
+        if (mantissa == 0)
+        {
+            value = negative ? -0.0 : 0.0;
+            return current;
+        }
+
+        // Clinger's fast path: exact mantissa and power of ten give correctly rounded quotient or product
+        if (exactDoubleArithmetic && !truncated && mantissa <= maxExactInteger && exponent >= -22)
+        {
+            if (exponent > 22)
+            {
+                // 1.5e25 is 15000 * 1e22, while the mantissa stays exact
+                for (; exponent > 22 && mantissa <= maxExactInteger / 10; --exponent)
+                {
+                    mantissa *= 10;
+                }
+            }
+            if (exponent <= 22)
+            {
+                double result = static_cast<double>(mantissa);
+                result = exponent >= 0 ? result * pow10_double[exponent] : result / pow10_double[-exponent];
+                value = negative ? -result : result;
+                return current;
+            }
+        }
+        return parse_slow(begin, current, value);
+    }
+
+    double parseDouble(const char *text)
+    {
+        double value = 0;
+        parseDouble(text, text + strlen(text), value);
+        return value;
+    }
+
+}
@@ -0,0 +1,75 @@
+/*
+ * Locale independent number formatting and parsing for pjsettings
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PJSETTINGS_NUMBER_H__
+#define __PJSETTINGS_NUMBER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace pjsettings
+{
+    // Buffer size enough for any text formatDouble() and formatFloat() produce
+    static const size_t NumberBufferSize = 32;
+
+    /*
+     * Shortest text that is read back as exactly the same value.
+     *
+     * Digits are generated exactly (Steele & White / Dragon4 free-format
+     * algorithm), decimal point is always '.', whatever the locale is.
+     * Numbers from 1e-6 up to 1e21 are written in fixed notation,
+     * others in exponential one: "0.1", "100", "1.5e-9", "1e+30".
+     * Not finite values are written as jsoncpp writes them:
+     * "null" for NaN, "1e+9999" and "-1e+9999" for infinities.
+     *
+     * Buffer must hold NumberBufferSize chars, text length is returned,
+     * terminating zero is written after the text.
+     */
+    size_t formatDouble(double value, char *buffer);
+
+    // Shortest text that is read back as double and converted to float gives the same float
+    size_t formatFloat(float value, char *buffer);
+
+    // Decimal text of integer, for the same buffer as formatDouble()
+    size_t formatInt64(int64_t value, char *buffer);
+
+    // Double nearest to formatFloat() text of value, that is 0.1 for 0.1f
+    double floatToShortestDouble(float value);
+
+    /*
+     * Locale independent, allocation free strtod() for text that is not
+     * terminated by zero: sign, decimal digits with optional '.' and exponent,
+     * "inf", "infinity" and "nan" in any case, hexadecimal numbers.
+     *
+     * Number at the start of begin .. end is parsed to correctly rounded value,
+     * end of the number is returned, begin is returned and value is zero
+     * when there's no number. Leading whitespace is not skipped.
+     *
+     * Common numbers (up to 2^53 in mantissa, up to 1e22 in exponent) are
+     * converted by exact double arithmetic, others by strtod_l() with "C" locale.
+     */
+    const char *parseDouble(const char *begin, const char *end, double &value);
+
+    // Number at the start of zero-terminated text, zero if there's no number
+    double parseDouble(const char *text);
+}
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * Typed numbers of PJSIP persistent document nodes
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PJSETTINGS_NUMERIC_H__
+#define __PJSETTINGS_NUMERIC_H__
+
+#include <stdint.h>
+#include <string>
+
+#ifndef PJSETTINGS_NOT_USE_PJSUA
+#include <pjsua2/persistent.hpp>
+#endif
+
+namespace pjsettings
+{
+    /**
+     * Numbers of document nodes in native precision of the backend.
+     *
+     * pj::ContainerNode passes every number through float, so integers
+     * above 2^24 and most of doubles are changed on the way. Documents
+     * implementing this interface read and write numbers of their nodes
+     * (root container and every node read or written from it) directly
+     * in the document storage.
+     *
+     * Nodes behave the same way as with pj::ContainerNode operations:
+     * missing values are read as 0, array nodes read next item or append
+     * new one and ignore the name. Values that are not numbers, or don't
+     * fit in int64_t, throw pj::Error, and so do nodes of other documents.
+     * Real numbers are truncated toward zero by readInt64().
+     */
+    class NumericExtension
+    {
+    public:
+        virtual ~NumericExtension() {}
+
+        virtual int64_t readInt64(const pj::ContainerNode &node, const std::string &name) const throw(pj::Error) = 0;
+        virtual double readDouble(const pj::ContainerNode &node, const std::string &name) const throw(pj::Error) = 0;
+        virtual void writeInt64(pj::ContainerNode &node, const std::string &name, int64_t value) throw(pj::Error) = 0;
+        virtual void writeDouble(pj::ContainerNode &node, const std::string &name, double value) throw(pj::Error) = 0;
+    };
+
+}
+
+#endif
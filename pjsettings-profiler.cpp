@@ -0,0 +1,384 @@
+/*
+ * Profiling of PJSIP persistent document node operations
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "pjsettings-profiler.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+using namespace pj;
+using namespace std;
+
+namespace pjsettings
+{
+
+    /* Profiling node operations */
+    static bool          profiledNode_hasUnread(const ContainerNode*);
+    static string        profiledNode_unreadName(const ContainerNode*n) throw(Error);
+    static float         profiledNode_readNumber(const ContainerNode*, const string&) throw(Error);
+    static bool          profiledNode_readBool(const ContainerNode*, const string&) throw(Error);
+    static string        profiledNode_readString(const ContainerNode*, const string&) throw(Error);
+    static StringVector  profiledNode_readStringVector(const ContainerNode*, const string&) throw(Error);
+    static ContainerNode profiledNode_readContainer(const ContainerNode*, const string &) throw(Error);
+    static ContainerNode profiledNode_readArray(const ContainerNode*, const string &) throw(Error);
+    static void          profiledNode_writeNumber(ContainerNode*, const string &name, float num) throw(Error);
+    static void          profiledNode_writeBool(ContainerNode*, const string &name, bool value) throw(Error);
+    static void          profiledNode_writeString(ContainerNode*, const string &name, const string &value) throw(Error);
+    static void          profiledNode_writeStringVector(ContainerNode*, const string &name, const StringVector &value) throw(Error);
+    static ContainerNode profiledNode_writeNewContainer(ContainerNode*, const string &name) throw(Error);
+    static ContainerNode profiledNode_writeNewArray(ContainerNode*, const string &name) throw(Error);
+
+    static container_node_op profiled_op = {
+        &profiledNode_hasUnread,
+        &profiledNode_unreadName,
+        &profiledNode_readNumber,
+        &profiledNode_readBool,
+        &profiledNode_readString,
+        &profiledNode_readStringVector,
+        &profiledNode_readContainer,
+        &profiledNode_readArray,
+        &profiledNode_writeNumber,
+        &profiledNode_writeBool,
+        &profiledNode_writeString,
+        &profiledNode_writeStringVector,
+        &profiledNode_writeNewContainer,
+        &profiledNode_writeNewArray
+    };
+
+    static const char *operationNames[PROFILE_OPERATIONS_COUNT] = {
+        "hasUnread",
+        "unreadName",
+        "readNumber",
+        "readBool",
+        "readString",
+        "readStringVector",
+        "readContainer",
+        "readArray",
+        "writeNumber",
+        "writeBool",
+        "writeString",
+        "writeStringVector",
+        "writeNewContainer",
+        "writeNewArray"
+    };
+
+    const char *profiledOperationName(ProfiledOperation operation)
+    {
+        if (operation < 0 || operation >= PROFILE_OPERATIONS_COUNT)
+        {
+            return "";
+        }
+        return operationNames[operation];
+    }
+
+    static uint64_t now_ns()
+    {
+#ifdef _WIN32
+        LARGE_INTEGER counter;
+        LARGE_INTEGER frequency;
+        QueryPerformanceCounter(&counter);
+        QueryPerformanceFrequency(&frequency);
+        return static_cast<uint64_t>(counter.QuadPart * 1000000000.0 / frequency.QuadPart);
+#else
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000u + static_cast<uint64_t>(ts.tv_nsec);
+#endif
+    }
+
+    OperationStats::OperationStats()
+        : calls(0)
+        , nanoseconds(0)
+        , misses(0)
+        , bytesCopied(0)
+    {
+    }
+
+    static void add_call(OperationStats &stats, uint64_t nanoseconds, bool missed, size_t bytesCopied)
+    {
+        ++stats.calls;
+        stats.nanoseconds += nanoseconds;
+        stats.misses += missed ? 1 : 0;
+        stats.bytesCopied += bytesCopied;
+    }
+
+    OperationProfiler::OperationProfiler()
+        : _enabled(false)
+        , _perNameStatsEnabled(false)
+        , _missed(false)
+        , _op(NULL)
+        , _doc(NULL)
+        , _root()
+        , _stats()
+    {
+    }
+
+    void OperationProfiler::setEnabled(bool enabled)
+    {
+        _enabled = enabled;
+    }
+
+    bool OperationProfiler::isEnabled() const
+    {
+        return _enabled;
+    }
+
+    void OperationProfiler::setPerNameStatsEnabled(bool enabled)
+    {
+        _perNameStatsEnabled = enabled;
+    }
+
+    bool OperationProfiler::isPerNameStatsEnabled() const
+    {
+        return _perNameStatsEnabled;
+    }
+
+    pj::ContainerNode &OperationProfiler::wrapRoot(pj::ContainerNode &root)
+    {
+        if (!_enabled)
+        {
+            return root;
+        }
+        _op = root.op;
+        _doc = root.data.doc;
+        _root = root;
+        _root.op = &profiled_op;
+        _root.data.doc = this;
+        return _root;
+    }
+
+    void OperationProfiler::countMiss()
+    {
+        // not written while disabled, documents are read by threads then
+        if (_enabled)
+        {
+            _missed = true;
+        }
+    }
+
+    ProfilingStats OperationProfiler::stats() const
+    {
+        return _stats;
+    }
+
+    void OperationProfiler::reset()
+    {
+        _stats = ProfilingStats();
+    }
+
+    struct OperationProfilerAccess
+    {
+        static OperationProfiler &profiler(const ContainerNode *node)
+        {
+            return *static_cast<OperationProfiler *>(node->data.doc);
+        }
+
+        static ContainerNode unwrap(const OperationProfiler &profiler, const ContainerNode *node)
+        {
+            ContainerNode inner = *node;
+            inner.op = profiler._op;
+            inner.data.doc = profiler._doc;
+            return inner;
+        }
+
+        // Nodes of other documents (there should be none) are returned as is
+        static ContainerNode wrap(OperationProfiler &profiler, ContainerNode node)
+        {
+            if (node.op == profiler._op && node.data.doc == profiler._doc)
+            {
+                node.op = &profiled_op;
+                node.data.doc = &profiler;
+            }
+            return node;
+        }
+
+        static void begin(OperationProfiler &profiler)
+        {
+            profiler._missed = false;
+        }
+
+        static void record(OperationProfiler &profiler, ProfiledOperation operation, const string *name, uint64_t nanoseconds, size_t bytesCopied)
+        {
+            if (!profiler._enabled)
+            {
+                return;
+            }
+            add_call(profiler._stats.operations[operation], nanoseconds, profiler._missed, bytesCopied);
+            if (profiler._perNameStatsEnabled && name != NULL && !name->empty())
+            {
+                add_call(profiler._stats.names[*name], nanoseconds, profiler._missed, bytesCopied);
+            }
+        }
+    };
+
+    /*
+     * One call of document operation on unwrapped node. Stats are recorded
+     * and node state changed by the operation (array position, lookup
+     * cursor) is copied back to wrapped node even if operation throws.
+     */
+    class ProfiledCall
+    {
+    public:
+        ProfiledCall(const ContainerNode *node, ProfiledOperation operation, const string *name = NULL)
+            : _node(const_cast<ContainerNode *>(node))
+            , _profiler(OperationProfilerAccess::profiler(node))
+            , _operation(operation)
+            , _name(name)
+            , _bytesCopied(0)
+            , inner(OperationProfilerAccess::unwrap(_profiler, node))
+        {
+            OperationProfilerAccess::begin(_profiler);
+            _start = now_ns();
+        }
+
+        ~ProfiledCall()
+        {
+            uint64_t nanoseconds = now_ns() - _start;
+            _node->data.data1 = inner.data.data1;
+            _node->data.data2 = inner.data.data2;
+            OperationProfilerAccess::record(_profiler, _operation, _name, nanoseconds, _bytesCopied);
+        }
+
+        void copied(size_t bytes)
+        {
+            _bytesCopied += bytes;
+        }
+
+        void copied(const StringVector &value)
+        {
+            for (size_t i = 0; i < value.size(); ++i)
+            {
+                _bytesCopied += value[i].size();
+            }
+        }
+
+        ContainerNode wrap(const ContainerNode &child)
+        {
+            return OperationProfilerAccess::wrap(_profiler, child);
+        }
+
+    private:
+        ContainerNode *_node;
+        OperationProfiler &_profiler;
+        ProfiledOperation _operation;
+        const string *_name;
+        size_t _bytesCopied;
+        uint64_t _start;
+
+    public:
+        ContainerNode inner;
+    };
+
+    static bool          profiledNode_hasUnread(const ContainerNode *node)
+    {
+        ProfiledCall call(node, PROFILE_HAS_UNREAD);
+        return call.inner.op->hasUnread(&call.inner);
+    }
+
+    static string        profiledNode_unreadName(const ContainerNode *node) throw(Error)
+    {
+        ProfiledCall call(node, PROFILE_UNREAD_NAME);
+        string result = call.inner.op->unreadName(&call.inner);
+        call.copied(result.size());
+        return result;
+    }
+
+    static float         profiledNode_readNumber(const ContainerNode *node, const string &name) throw(Error)
+    {
+        ProfiledCall call(node, PROFILE_READ_NUMBER, &name);
+        return call.inner.op->readNumber(&call.inner, name);
+    }
+
+    static bool          profiledNode_readBool(const ContainerNode *node, const string &name) throw(Error)
+    {
+        ProfiledCall call(node, PROFILE_READ_BOOL, &name);
+        return call.inner.op->readBool(&call.inner, name);
+    }
+
+    static string        profiledNode_readString(const ContainerNode *node, const string &name) throw(Error)
+    {
+        ProfiledCall call(node, PROFILE_READ_STRING, &name);
+        string result = call.inner.op->readString(&call.inner, name);
+        call.copied(result.size());
+        return result;
+    }
+
+    static StringVector  profiledNode_readStringVector(const ContainerNode *node, const string &name) throw(Error)
+    {
+        ProfiledCall call(node, PROFILE_READ_STRING_VECTOR, &name);
+        StringVector result = call.inner.op->readStringVector(&call.inner, name);
+        call.copied(result);
+        return result;
+    }
+
+    static ContainerNode profiledNode_readContainer(const ContainerNode *node, const string &name) throw(Error)
+    {
+        ProfiledCall call(node, PROFILE_READ_CONTAINER, &name);
+        return call.wrap(call.inner.op->readContainer(&call.inner, name));
+    }
+
+    static ContainerNode profiledNode_readArray(const ContainerNode *node, const string &name) throw(Error)
+    {
+        ProfiledCall call(node, PROFILE_READ_ARRAY, &name);
+        return call.wrap(call.inner.op->readArray(&call.inner, name));
+    }
+
+    static void          profiledNode_writeNumber(ContainerNode *node, const string &name, float num) throw(Error)
+    {
+        ProfiledCall call(node, PROFILE_WRITE_NUMBER, &name);
+        call.inner.op->writeNumber(&call.inner, name, num);
+    }
+
+    static void          profiledNode_writeBool(ContainerNode *node, const string &name, bool value) throw(Error)
+    {
+        ProfiledCall call(node, PROFILE_WRITE_BOOL, &name);
+        call.inner.op->writeBool(&call.inner, name, value);
+    }
+
+    static void          profiledNode_writeString(ContainerNode *node, const string &name, const string &value) throw(Error)
+    {
+        ProfiledCall call(node, PROFILE_WRITE_STRING, &name);
+        call.inner.op->writeString(&call.inner, name, value);
+        call.copied(value.size());
+    }
+
+    static void          profiledNode_writeStringVector(ContainerNode *node, const string &name, const StringVector &value) throw(Error)
+    {
+        ProfiledCall call(node, PROFILE_WRITE_STRING_VECTOR, &name);
+        call.inner.op->writeStringVector(&call.inner, name, value);
+        call.copied(value);
+    }
+
+    static ContainerNode profiledNode_writeNewContainer(ContainerNode *node, const string &name) throw(Error)
+    {
+        ProfiledCall call(node, PROFILE_WRITE_NEW_CONTAINER, &name);
+        return call.wrap(call.inner.op->writeNewContainer(&call.inner, name));
+    }
+
+    static ContainerNode profiledNode_writeNewArray(ContainerNode *node, const string &name) throw(Error)
+    {
+        ProfiledCall call(node, PROFILE_WRITE_NEW_ARRAY, &name);
+        return call.wrap(call.inner.op->writeNewArray(&call.inner, name));
+    }
+
+}
@@ -0,0 +1,122 @@
+/*
+ * Profiling of PJSIP persistent document node operations
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PJSETTINGS_PROFILER_H__
+#define __PJSETTINGS_PROFILER_H__
+
+#include <stdint.h>
+#include <map>
+#include <string>
+
+#ifndef PJSETTINGS_NOT_USE_PJSUA
+#include <pjsua2/persistent.hpp>
+#endif
+
+namespace pjsettings
+{
+    // Operations of pj::container_node_op in table order
+    enum ProfiledOperation
+    {
+        PROFILE_HAS_UNREAD = 0,
+        PROFILE_UNREAD_NAME,
+        PROFILE_READ_NUMBER,
+        PROFILE_READ_BOOL,
+        PROFILE_READ_STRING,
+        PROFILE_READ_STRING_VECTOR,
+        PROFILE_READ_CONTAINER,
+        PROFILE_READ_ARRAY,
+        PROFILE_WRITE_NUMBER,
+        PROFILE_WRITE_BOOL,
+        PROFILE_WRITE_STRING,
+        PROFILE_WRITE_STRING_VECTOR,
+        PROFILE_WRITE_NEW_CONTAINER,
+        PROFILE_WRITE_NEW_ARRAY,
+        PROFILE_OPERATIONS_COUNT
+    };
+
+    // Name of operation as in pj::container_node_op, e.g. "readNumber"
+    const char *profiledOperationName(ProfiledOperation operation);
+
+    struct OperationStats
+    {
+        OperationStats();
+
+        uint64_t calls;
+        uint64_t nanoseconds;       // cumulative, including time of calls that threw
+        uint64_t misses;            // named lookups that found nothing
+        uint64_t bytesCopied;       // string values read or written
+    };
+
+    struct ProfilingStats
+    {
+        OperationStats operations[PROFILE_OPERATIONS_COUNT];
+
+        // Stats of named operations by name, filled when per name stats are enabled.
+        // Array items have no names and are not counted here.
+        std::map<std::string, OperationStats> names;
+    };
+
+    /**
+     * Decorator of document node operations.
+     *
+     * Root node returned by wrapRoot() and every node read or written
+     * from it go through profiling operations table, that calls
+     * operations of the document and records stats of every call.
+     * Wrapped node keeps document node data as is, only document
+     * pointer is replaced with profiler, so nodes are copied freely.
+     */
+    class OperationProfiler
+    {
+    public:
+        OperationProfiler();
+
+        void setEnabled(bool enabled);
+        bool isEnabled() const;
+        void setPerNameStatsEnabled(bool enabled);
+        bool isPerNameStatsEnabled() const;
+
+        // Root of document with profiling operations, root itself when profiler is disabled
+        pj::ContainerNode &wrapRoot(pj::ContainerNode &root);
+
+        // Called by document operations when named lookup finds nothing
+        void countMiss();
+
+        ProfilingStats stats() const;
+        void reset();
+
+    private:
+        friend struct OperationProfilerAccess;
+
+        OperationProfiler(const OperationProfiler &);
+        OperationProfiler &operator=(const OperationProfiler &);
+
+        bool _enabled;
+        bool _perNameStatsEnabled;
+        bool _missed;
+        pj::container_node_op *_op;
+        void *_doc;
+        pj::ContainerNode _root;
+        ProfilingStats _stats;
+    };
+
+}
+
+#endif
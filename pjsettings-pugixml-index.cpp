@@ -0,0 +1,180 @@
+/*
+ * Attribute and child name index for pugixml backend
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <string.h>
+#include "pjsettings-pugixml-index.h"
+
+namespace pjsettings
+{
+
+    static size_t hash_name(const char *name)
+    {
+        // FNV-1a
+        size_t hash = 2166136261u;
+        for (; *name; ++name)
+        {
+            hash ^= static_cast<unsigned char>(*name);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    static pugi::xml_attribute next_item(const pugi::xml_attribute &item)
+    {
+        return item.next_attribute();
+    }
+
+    static pugi::xml_node next_item(const pugi::xml_node &item)
+    {
+        return item.next_sibling();
+    }
+
+    template <typename Item>
+    PugixmlNameTable<Item>::PugixmlNameTable()
+        : _built(false)
+        , _mask(0)
+        , _slots()
+    {
+    }
+
+    template <typename Item>
+    Item PugixmlNameTable<Item>::find(Item first, const char *name)
+    {
+        if (!_built)
+        {
+            build(first);
+        }
+
+        if (_slots.empty())
+        {
+            for (Item item = first; item; item = next_item(item))
+            {
+                if (strcmp(item.name(), name) == 0)
+                {
+                    return item;
+                }
+            }
+            return Item();
+        }
+
+        for (size_t i = hash_name(name) & _mask; _slots[i]; i = (i + 1) & _mask)
+        {
+            if (strcmp(_slots[i].name(), name) == 0)
+            {
+                return _slots[i];
+            }
+        }
+        return Item();
+    }
+
+    template <typename Item>
+    void PugixmlNameTable<Item>::build(Item first)
+    {
+        _built = true;
+
+        size_t count = 0;
+        for (Item item = first; item; item = next_item(item))
+        {
+            ++count;
+        }
+        if (count < PugixmlNameIndex::wideNodeThreshold)
+        {
+            return;
+        }
+
+        size_t capacity = 16;
+        while (capacity < count * 2)
+        {
+            capacity *= 2;
+        }
+        _slots.assign(capacity, Item());
+        _mask = capacity - 1;
+
+        for (Item item = first; item; item = next_item(item))
+        {
+            size_t i = hash_name(item.name()) & _mask;
+            while (_slots[i] && strcmp(_slots[i].name(), item.name()) != 0)
+            {
+                i = (i + 1) & _mask;
+            }
+            if (!_slots[i])
+            {
+                _slots[i] = item;
+            }
+        }
+    }
+
+    template class PugixmlNameTable<pugi::xml_attribute>;
+    template class PugixmlNameTable<pugi::xml_node>;
+
+    PugixmlNameIndex::PugixmlNameIndex()
+        : _nodes()
+        , _lastNode(NULL)
+        , _lastNodeNames(NULL)
+    {
+    }
+
+    pugi::xml_attribute PugixmlNameIndex::findAttribute(const pugi::xml_node &node, const char *name)
+    {
+        if (!node)
+        {
+            return pugi::xml_attribute();
+        }
+        return getNodeNames(node).attributes.find(node.first_attribute(), name);
+    }
+
+    pugi::xml_node PugixmlNameIndex::findChild(const pugi::xml_node &node, const char *name)
+    {
+        if (!node)
+        {
+            return pugi::xml_node();
+        }
+        return getNodeNames(node).children.find(node.first_child(), name);
+    }
+
+    void PugixmlNameIndex::invalidate(const pugi::xml_node &node)
+    {
+        if (node.internal_object() == _lastNode)
+        {
+            _lastNode = NULL;
+            _lastNodeNames = NULL;
+        }
+        _nodes.erase(node.internal_object());
+    }
+
+    void PugixmlNameIndex::clear()
+    {
+        _nodes.clear();
+        _lastNode = NULL;
+        _lastNodeNames = NULL;
+    }
+
+    PugixmlNameIndex::NodeNames &PugixmlNameIndex::getNodeNames(const pugi::xml_node &node)
+    {
+        // fields of one node are usually read one after another
+        if (node.internal_object() != _lastNode)
+        {
+            _lastNode = node.internal_object();
+            _lastNodeNames = &_nodes[_lastNode];
+        }
+        return *_lastNodeNames;
+    }
+
+}
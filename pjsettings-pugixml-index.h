@@ -0,0 +1,86 @@
+/*
+ * Attribute and child name index for pugixml backend
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PJSETTINGS_PUGIXML_INDEX_H__
+#define __PJSETTINGS_PUGIXML_INDEX_H__
+
+#include <map>
+#include <vector>
+#include "pugixml.hpp"
+
+namespace pjsettings
+{
+    /**
+     * Open addressing hash table of attribute or child names of one node.
+     *
+     * Table is built on first lookup. Narrow nodes are not hashed at all,
+     * linear scan is cheaper for them. For duplicate names the first item
+     * is found, same as xml_node::attribute() and xml_node::child() do.
+     */
+    template <typename Item>
+    class PugixmlNameTable
+    {
+    public:
+        PugixmlNameTable();
+        Item find(Item first, const char *name);
+    private:
+        void build(Item first);
+        bool _built;
+        size_t _mask;
+        std::vector<Item> _slots;
+    };
+
+    /**
+     * Lazily built name index for nodes of one document.
+     *
+     * Index entry of a node must be invalidated when attributes
+     * or children are added to or removed from that node.
+     */
+    class PugixmlNameIndex
+    {
+    public:
+        // Nodes with less attributes or children are scanned linearly
+        static const size_t wideNodeThreshold = 8;
+
+        PugixmlNameIndex();
+
+        pugi::xml_attribute findAttribute(const pugi::xml_node &node, const char *name);
+        pugi::xml_node findChild(const pugi::xml_node &node, const char *name);
+        void invalidate(const pugi::xml_node &node);
+        void clear();
+
+    private:
+        struct NodeNames
+        {
+            PugixmlNameTable<pugi::xml_attribute> attributes;
+            PugixmlNameTable<pugi::xml_node> children;
+        };
+        typedef std::map<pugi::xml_node_struct *, NodeNames> NodeNamesMap;
+
+        NodeNames &getNodeNames(const pugi::xml_node &node);
+
+        NodeNamesMap _nodes;
+        pugi::xml_node_struct *_lastNode;
+        NodeNames *_lastNodeNames;
+    };
+}
+
+#endif
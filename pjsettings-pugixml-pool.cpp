@@ -0,0 +1,113 @@
+/*
+ * Memory page pool of pugixml documents
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <stdlib.h>
+#include "pjsettings-pugixml-pool.h"
+
+namespace pjsettings
+{
+
+    PugixmlPagePool::PugixmlPagePool()
+        : _pageSize(defaultPageSize)
+        , _regularSize(0)
+        , _pagesInUse(0)
+        , _pooledPages(0)
+        , _freePages(NULL)
+    {
+    }
+
+    PugixmlPagePool::~PugixmlPagePool()
+    {
+        trim();
+    }
+
+    size_t PugixmlPagePool::page_size() const
+    {
+        return _pageSize;
+    }
+
+    void *PugixmlPagePool::allocate_page(size_t size, bool regular)
+    {
+        if (regular)
+        {
+            if (_regularSize != size)
+            {
+                // regular size changes with page size only, pooled pages don't fit anymore
+                trim();
+                _regularSize = size;
+            }
+            if (_freePages != NULL)
+            {
+                FreePage *page = _freePages;
+                _freePages = page->next;
+                --_pooledPages;
+                ++_pagesInUse;
+                return page;
+            }
+        }
+        void *memory = malloc(size);
+        if (memory != NULL)
+        {
+            ++_pagesInUse;
+        }
+        return memory;
+    }
+
+    void PugixmlPagePool::deallocate_page(void *memory, size_t size)
+    {
+        --_pagesInUse;
+        if (size != _regularSize)
+        {
+            free(memory);
+            return;
+        }
+        FreePage *page = static_cast<FreePage *>(memory);
+        page->next = _freePages;
+        _freePages = page;
+        ++_pooledPages;
+    }
+
+    void PugixmlPagePool::setPageSize(size_t pageSize)
+    {
+        _pageSize = pageSize;
+    }
+
+    size_t PugixmlPagePool::pagesInUse() const
+    {
+        return _pagesInUse;
+    }
+
+    size_t PugixmlPagePool::pooledPages() const
+    {
+        return _pooledPages;
+    }
+
+    void PugixmlPagePool::trim()
+    {
+        while (_freePages != NULL)
+        {
+            FreePage *next = _freePages->next;
+            free(_freePages);
+            _freePages = next;
+        }
+        _pooledPages = 0;
+    }
+
+}
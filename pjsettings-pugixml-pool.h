@@ -0,0 +1,80 @@
+/*
+ * Memory page pool of pugixml documents
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PJSETTINGS_PUGIXML_POOL_H__
+#define __PJSETTINGS_PUGIXML_POOL_H__
+
+#include <stddef.h>
+#include "pugixml.hpp"
+
+namespace pjsettings
+{
+    /**
+     * Memory pages of one pugixml document.
+     *
+     * Regular pages freed by the document are kept in the pool and given
+     * back on next allocations, so reloading the document reuses the same
+     * pages instead of returning them to malloc. Pages of large allocations
+     * are allocated and freed one by one.
+     */
+    class PugixmlPagePool : public pugi::xml_page_pool
+    {
+    public:
+        static const size_t defaultPageSize = 32768;
+        static const size_t minPageSize = 1024;
+        static const size_t maxPageSize = 65536;
+
+        PugixmlPagePool();
+        virtual ~PugixmlPagePool();
+
+        virtual size_t page_size() const;
+        virtual void *allocate_page(size_t size, bool regular);
+        virtual void deallocate_page(void *memory, size_t size);
+
+        // Pages of previous size still in use are freed when document releases them.
+        // Page size is not checked, see PugixmlDocument::setPageSize
+        void setPageSize(size_t pageSize);
+
+        // Pages allocated by document and not released yet, regular and large ones
+        size_t pagesInUse() const;
+        // Released regular pages kept for reuse
+        size_t pooledPages() const;
+        // Frees pooled pages
+        void trim();
+
+    private:
+        PugixmlPagePool(const PugixmlPagePool &);
+        PugixmlPagePool &operator=(const PugixmlPagePool &);
+
+        struct FreePage
+        {
+            FreePage *next;
+        };
+
+        size_t _pageSize;
+        size_t _regularSize;            // memory size of regular pages, 0 until the first one is allocated
+        size_t _pagesInUse;
+        size_t _pooledPages;
+        FreePage *_freePages;
+    };
+}
+
+#endif
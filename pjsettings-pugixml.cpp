@@ -19,8 +19,14 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 #include <stdexcept>
+#include <stdio.h>
+#include <string.h>
 #include <iostream>
-#include <sstream>
+#include <map>
+#include <utility>
+#include "pjsettings-diff.h"
+#include "pjsettings-hash.h"
+#include "pjsettings-number.h"
 #include "pjsettings-pugixml.h"
 
 using namespace pj;
@@ -62,17 +68,132 @@ namespace pjsettings
         &pugixmlNode_writeNewArray
     };
 
-    PugixmlDocument::PugixmlDocument(unsigned int flags)
+    // The same as as_double(0.0) without strtod(): whitespace is skipped, rest of text after number is ignored
+    static double parse_number(const char *text)
+    {
+        while (*text == ' ' || (*text >= '\t' && *text <= '\r'))
+        {
+            ++text;
+        }
+        return parseDouble(text);
+    }
+
+    // Text is parsed up to the first NUL, as pugi::xml_document::load() of C string does
+    static size_t text_length(const char *input, size_t size)
+    {
+        const char *end = static_cast<const char *>(memchr(input, 0, size));
+        return end == NULL ? size : end - input;
+    }
+
+    /* Snapshot of pugixml document */
+
+    static void build_snapshot_element(SnapshotBuilder &builder, uint32_t index, const pugi::xml_node &element)
+    {
+        // element text is read by array items, so it's kept with the element
+        pugi::xml_text text = element.text();
+        SnapshotNode &node = builder.node(index);
+        node.type = SNAPSHOT_OBJECT;
+        node.convertible = SNAPSHOT_AS_NUMBER | SNAPSHOT_AS_BOOL | SNAPSHOT_AS_STRING;
+        node.number = parse_number(text.get());
+        node.boolean = text.as_bool(false) ? 1 : 0;
+        node.name = builder.addString(element.name());
+        node.string = builder.addString(text.as_string(""));
+
+        uint32_t attributeCount = 0;
+        for (pugi::xml_attribute attribute = element.first_attribute(); attribute; attribute = attribute.next_attribute())
+        {
+            ++attributeCount;
+        }
+        uint32_t firstAttribute = builder.addNodes(attributeCount);
+        uint32_t attributeIndex = firstAttribute;
+        for (pugi::xml_attribute attribute = element.first_attribute(); attribute; attribute = attribute.next_attribute())
+        {
+            SnapshotNode &attributeNode = builder.node(attributeIndex++);
+            attributeNode.type = SNAPSHOT_STRING;
+            attributeNode.convertible = SNAPSHOT_AS_NUMBER | SNAPSHOT_AS_BOOL | SNAPSHOT_AS_STRING;
+            attributeNode.number = parse_number(attribute.value());
+            attributeNode.boolean = attribute.as_bool(false) ? 1 : 0;
+            attributeNode.name = builder.addString(attribute.name());
+            attributeNode.string = builder.addString(attribute.as_string(""));
+        }
+        uint32_t sortedAttributes = builder.addSortedIndex(firstAttribute, attributeCount);
+
+        uint32_t childCount = 0;
+        for (pugi::xml_node child = element.first_child(); child; child = child.next_sibling())
+        {
+            if (child.type() == pugi::node_element)
+            {
+                ++childCount;
+            }
+        }
+        uint32_t firstChild = builder.addNodes(childCount);
+        uint32_t childIndex = firstChild;
+        for (pugi::xml_node child = element.first_child(); child; child = child.next_sibling())
+        {
+            if (child.type() == pugi::node_element)
+            {
+                build_snapshot_element(builder, childIndex++, child);
+            }
+        }
+        uint32_t sortedChildren = builder.addSortedIndex(firstChild, childCount);
+
+        // node reference is invalidated by addNodes
+        SnapshotNode &builtNode = builder.node(index);
+        builtNode.firstAttribute = firstAttribute;
+        builtNode.attributeCount = attributeCount;
+        builtNode.sortedAttributes = sortedAttributes;
+        builtNode.firstChild = firstChild;
+        builtNode.childCount = childCount;
+        builtNode.sortedChildren = sortedChildren;
+    }
+
+    static void restore_snapshot_element(const Snapshot &snapshot, const SnapshotNode *node, pugi::xml_node element)
+    {
+        for (uint32_t i = 0; i < node->attributeCount; ++i)
+        {
+            const SnapshotNode *attribute = snapshot.attribute(node, i);
+            element.append_attribute(snapshot.string(attribute->name)).set_value(snapshot.string(attribute->string));
+        }
+        if (snapshot.stringSize(node->string) > 0)
+        {
+            element.append_child(pugi::node_pcdata).set_value(snapshot.string(node->string));
+        }
+        for (uint32_t i = 0; i < node->childCount; ++i)
+        {
+            const SnapshotNode *child = snapshot.child(node, i);
+            restore_snapshot_element(snapshot, child, element.append_child(snapshot.string(child->name)));
+        }
+    }
+
+    PugixmlDocument::PugixmlDocument(unsigned int flags, bool mapFileOnLoad)
         : _document()
         , _rootNode()
         , _flags(flags)
+        , _mapFileOnLoad(mapFileOnLoad)
+        , _mappedFile()
+        , _inputBuffer()
+        , _nameIndexEnabled(false)
+        , _nameIndex()
+        , _snapshotCacheEnabled(false)
+        , _snapshot()
+        , _profiler()
+        , _concurrentReadEnabled(false)
+        , _subtreeHashes()
+        , _contentHash(0)
+        , _contentHashValid(false)
     {
+#if PJSETTINGS_HAS_PUGIXML_PAGE_POOL
+        _document.set_page_pool(&_pagePool);
+#endif
         _document.root().append_child("root");
         initRoot();
     }
 
     void PugixmlDocument::initRoot()
     {
+        _snapshot.close();
+        _nameIndex.clear();
+        _subtreeHashes.clear();
         pugi::xml_node rootElement = _document.root().first_child();
         _rootNode.op = &pugixml_op;
         _rootNode.data.doc = this;
@@ -80,31 +201,189 @@ namespace pjsettings
         _rootNode.data.data2 = NULL;
     }
 
+    // Document is left with empty root element when loading fails
+    void PugixmlDocument::initEmptyRoot()
+    {
+        _document.reset();
+        _document.root().append_child("root");
+        _mappedFile.close();
+        std::string().swap(_inputBuffer);
+        initRoot();
+        _contentHashValid = false;
+    }
+
     void PugixmlDocument::loadFile(const std::string &filename) throw(pj::Error)
     {
-        pugi::xml_parse_result result = _document.load_file(filename.c_str());
+        if (_snapshotCacheEnabled && _snapshot.openFile(snapshotFilename(filename), SNAPSHOT_PUGIXML, filename))
+        {
+            _document.reset();
+            _document.root().append_child("root");
+            _mappedFile.close();
+            std::string().swap(_inputBuffer);
+            _nameIndex.clear();
+            _subtreeHashes.clear();
+            _rootNode = snapshotRootContainer(_snapshot);
+            _contentHash = _snapshot.header().sourceHash;
+            _contentHashValid = true;
+            return;
+        }
+
+        // file is stat'ed before it is read, so the snapshot
+        // never claims newer modification time than parsed content has
+        SnapshotSource source;
+        if (_snapshotCacheEnabled)
+        {
+            source.stat(filename);
+        }
+
+        // content is hashed, so the file is mapped once for hashing and parsing
+        MappedFile mappedFile;
+        mappedFile.open(filename);
+        uint64_t contentHash = Hash64::calculate(mappedFile.data(), mappedFile.size());
+        source.hash = contentHash;
+        pugi::xml_parse_result result;
+        if (_mapFileOnLoad)
+        {
+            // parse in place from private copy-on-write mapping,
+            // the tree keeps pointers into it until next load
+            result = _document.load_buffer_inplace(mappedFile.data(), mappedFile.size());
+            _mappedFile.swap(mappedFile);
+        }
+        else
+        {
+            result = _document.load_buffer(mappedFile.data(), mappedFile.size());
+            _mappedFile.close();
+        }
+        std::string().swap(_inputBuffer);
         if (!result)
         {
+            // partial tree is dropped, root never points to the previous tree or snapshot
+            initEmptyRoot();
             throw Error(1, "pugixml load from file error", result.description(), filename.c_str(), result.offset);
         }
         initRoot();
+        _contentHash = contentHash;
+        _contentHashValid = true;
+
+        if (_snapshotCacheEnabled)
+        {
+            // snapshot is a cache only, document is loaded even if it can't be written
+            try
+            {
+                SnapshotBuilder builder(SNAPSHOT_PUGIXML);
+                build_snapshot_element(builder, builder.addNodes(1), _document.root().first_child());
+                std::vector<char> image;
+                builder.build(image, source);
+                writeSnapshotFile(snapshotFilename(filename), image);
+            }
+            catch (Error &)
+            {
+            }
+        }
     }
 
     void PugixmlDocument::loadString(const std::string &input) throw(pj::Error)
     {
-        pugi::xml_parse_result result = _document.load(input.c_str());
+        loadBuffer(input.data(), input.size());
+    }
+
+#if PJSETTINGS_HAS_RVALUE_REFERENCES
+    void PugixmlDocument::loadString(std::string &&input) throw(pj::Error)
+    {
+        // take the buffer over and parse it in place, the tree keeps
+        // pointers into it until next load
+        _document.reset();
+        _inputBuffer = std::move(input);
+        _inputBuffer.resize(text_length(_inputBuffer.data(), _inputBuffer.size()));
+        uint64_t contentHash = Hash64::calculate(_inputBuffer.data(), _inputBuffer.size());
+        // strings are UTF-8, their encoding is not detected
+        pugi::xml_parse_result result = _document.load_buffer_inplace(&_inputBuffer[0], _inputBuffer.size(),
+            pugi::parse_default, pugi::encoding_utf8);
+        _mappedFile.close();
+        if (!result)
+        {
+            // partial tree is dropped, root never points to the previous tree or snapshot
+            initEmptyRoot();
+            throw Error(1, "pugixml load from string error", result.description(), "offset", result.offset);
+        }
+        initRoot();
+        _contentHash = contentHash;
+        _contentHashValid = true;
+    }
+#endif
+
+    void PugixmlDocument::loadBuffer(const char *input, size_t size) throw(pj::Error)
+    {
+        size = text_length(input, size);
+        uint64_t contentHash = Hash64::calculate(input, size);
+        // strings are UTF-8, their encoding is not detected
+        pugi::xml_parse_result result = _document.load_buffer(input, size, pugi::parse_default, pugi::encoding_utf8);
+        _mappedFile.close();
+        std::string().swap(_inputBuffer);
         if (!result)
         {
+            // partial tree is dropped, root never points to the previous tree or snapshot
+            initEmptyRoot();
             throw Error(1, "pugixml load from string error", result.description(), "offset", result.offset);
         }
         initRoot();
+        _contentHash = contentHash;
+        _contentHashValid = true;
+    }
+
+    bool PugixmlDocument::reloadIfChanged(const std::string &filename) throw(pj::Error)
+    {
+        // the tree points into mapping of the file, which shows bytes written in place,
+        // so it is not trusted even if the file hashes the same as it was loaded
+        if (_mappedFile.isModifiedInPlace(filename))
+        {
+            loadFile(filename);
+            return true;
+        }
+        {
+            MappedFile input;
+            input.open(filename);
+            if (_contentHashValid && Hash64::calculate(input.data(), input.size()) == _contentHash)
+            {
+                return false;
+            }
+        }
+        // loadFile() hashes the bytes it parses once more,
+        // the file may be replaced after the check above
+        loadFile(filename);
+        return true;
     }
 
+    struct xml_string_writer : pugi::xml_writer
+    {
+        explicit xml_string_writer(std::string &output) : output(output) {}
+
+        virtual void write(const void *data, size_t size)
+        {
+            output.append(static_cast<const char *>(data), size);
+        }
+
+        std::string &output;
+    };
+
+    struct xml_size_writer : pugi::xml_writer
+    {
+        xml_size_writer() : size(0) {}
+
+        virtual void write(const void *, size_t dataSize)
+        {
+            size += dataSize;
+        }
+
+        size_t size;
+    };
+
     void PugixmlDocument::saveFile(const std::string &filename) throw(pj::Error)
     {
         try
         {
-            _document.save_file(
+            pugi::xml_document restored;
+            documentToSave(restored).save_file(
                 filename.c_str(),
                 "    ",
                 _flags,
@@ -120,13 +399,17 @@ namespace pjsettings
     {
         try
         {
-            std::ostringstream result;
-            _document.save(
-                result,
-                "    ",
-                _flags,
-                pugi::encoding_utf8);
-            return result.str();
+            pugi::xml_document restored;
+            const pugi::xml_document &document = documentToSave(restored);
+            // the first pass counts output size only,
+            // so the result is allocated once and never copied
+            xml_size_writer size;
+            document.save(size, "    ", _flags, pugi::encoding_utf8);
+            std::string result;
+            result.reserve(size.size);
+            xml_string_writer output(result);
+            document.save(output, "    ", _flags, pugi::encoding_utf8);
+            return result;
         }
         catch (std::exception &ex)
         {
@@ -136,7 +419,310 @@ namespace pjsettings
 
     pj::ContainerNode &PugixmlDocument::getRootContainer() const
     {
-        return _rootNode;
+        if (_concurrentReadEnabled)
+        {
+            return _rootNode;
+        }
+        return _profiler.wrapRoot(_rootNode);
+    }
+
+#if PJSETTINGS_HAS_PUGIXML_PAGE_POOL
+    void PugixmlDocument::setPageSize(size_t pageSize) throw(pj::Error)
+    {
+        if (pageSize < PugixmlPagePool::minPageSize || pageSize > PugixmlPagePool::maxPageSize)
+        {
+            throw Error(1, "pugixml page size error", "page size must be from 1024 to 65536 bytes", "", 0);
+        }
+        _pagePool.setPageSize(pageSize);
+    }
+
+    size_t PugixmlDocument::getPageSize() const
+    {
+        return _pagePool.page_size();
+    }
+
+    size_t PugixmlDocument::getPagesInUse() const
+    {
+        return _pagePool.pagesInUse();
+    }
+
+    size_t PugixmlDocument::getPooledPages() const
+    {
+        return _pagePool.pooledPages();
+    }
+
+    void PugixmlDocument::trimPagePool()
+    {
+        _pagePool.trim();
+    }
+#else
+    // pages are allocated by pugixml memory functions
+    void PugixmlDocument::setPageSize(size_t /* pageSize */) throw(pj::Error)
+    {
+        throw Error(1, "pugixml page size error", "page pool needs bundled pugixml", "", 0);
+    }
+
+    size_t PugixmlDocument::getPageSize() const
+    {
+        return 0;
+    }
+
+    size_t PugixmlDocument::getPagesInUse() const
+    {
+        return 0;
+    }
+
+    size_t PugixmlDocument::getPooledPages() const
+    {
+        return 0;
+    }
+
+    void PugixmlDocument::trimPagePool()
+    {
+    }
+#endif
+
+    void PugixmlDocument::setSnapshotCacheEnabled(bool enabled)
+    {
+        _snapshotCacheEnabled = enabled;
+    }
+
+    bool PugixmlDocument::isSnapshotCacheEnabled() const
+    {
+        return _snapshotCacheEnabled;
+    }
+
+    bool PugixmlDocument::isLoadedFromSnapshot() const
+    {
+        return _snapshot.isMapped();
+    }
+
+    void PugixmlDocument::freeze() throw(pj::Error)
+    {
+        if (_snapshot.isOpen())
+        {
+            return;
+        }
+        SnapshotBuilder builder(SNAPSHOT_PUGIXML);
+        build_snapshot_element(builder, builder.addNodes(1), _document.root().first_child());
+        std::vector<char> image;
+        builder.build(image, SnapshotSource());
+
+        _snapshot.assign(image);
+        _document.reset();
+        _document.root().append_child("root");
+        _mappedFile.close();
+        std::string().swap(_inputBuffer);
+        _nameIndex.clear();
+        _subtreeHashes.clear();
+        _rootNode = snapshotRootContainer(_snapshot);
+    }
+
+    void PugixmlDocument::thaw()
+    {
+        if (!_snapshot.isOpen())
+        {
+            return;
+        }
+        _document.reset();
+        const SnapshotNode *root = _snapshot.root();
+        restore_snapshot_element(_snapshot, root, _document.append_child(_snapshot.string(root->name)));
+        // content hash is kept, the tree is the same
+        initRoot();
+    }
+
+    bool PugixmlDocument::isFrozen() const
+    {
+        return _snapshot.isOpen();
+    }
+
+    OperationProfiler &PugixmlDocument::profiler()
+    {
+        return _profiler;
+    }
+
+    void PugixmlDocument::setConcurrentReadEnabled(bool enabled)
+    {
+        if (enabled)
+        {
+            _profiler.setEnabled(false);
+        }
+        _concurrentReadEnabled = enabled;
+    }
+
+    bool PugixmlDocument::isConcurrentReadEnabled() const
+    {
+        return _concurrentReadEnabled;
+    }
+
+    const pugi::xml_document &PugixmlDocument::documentToSave(pugi::xml_document &restored) const
+    {
+        if (!_snapshot.isOpen())
+        {
+            return _document;
+        }
+        const SnapshotNode *root = _snapshot.root();
+        restore_snapshot_element(_snapshot, root, restored.append_child(_snapshot.string(root->name)));
+        return restored;
+    }
+
+    size_t PugixmlDocument::getMappedMemorySaving() const
+    {
+        return _mappedFile.size() - _mappedFile.privateResidentSize();
+    }
+
+    void PugixmlDocument::setNameIndexEnabled(bool enabled)
+    {
+        _nameIndexEnabled = enabled;
+        _nameIndex.clear();
+    }
+
+    bool PugixmlDocument::isNameIndexEnabled() const
+    {
+        return _nameIndexEnabled;
+    }
+
+    pugi::xml_attribute PugixmlDocument::findAttribute(const pugi::xml_node &node, const char *name) const
+    {
+        if (_nameIndexEnabled && !_concurrentReadEnabled)
+        {
+            return _nameIndex.findAttribute(node, name);
+        }
+        return node.attribute(name);
+    }
+
+    pugi::xml_node PugixmlDocument::findChild(const pugi::xml_node &node, const char *name) const
+    {
+        if (_nameIndexEnabled && !_concurrentReadEnabled)
+        {
+            return _nameIndex.findChild(node, name);
+        }
+        return node.child(name);
+    }
+
+    bool PugixmlDocument::keepsAttributeCursor(const ContainerNode *node) const
+    {
+        return !_concurrentReadEnabled || node != &_rootNode;
+    }
+
+    void PugixmlDocument::invalidateNode(const pugi::xml_node &node)
+    {
+        if (_nameIndexEnabled)
+        {
+            _nameIndex.invalidate(node);
+        }
+        // hashes of all ancestors are stale too
+        _subtreeHashes.clear();
+        _contentHashValid = false;
+    }
+
+    bool PugixmlDocument::hasContentHash() const
+    {
+        return _contentHashValid;
+    }
+
+    uint64_t PugixmlDocument::getContentHash() const
+    {
+        return _contentHashValid ? _contentHash : 0;
+    }
+
+    static PugixmlDocument &get_document(const ContainerNode *node)
+    {
+        return *static_cast<PugixmlDocument *>(node->data.doc);
+    }
+
+    /*
+     * data2 of array node points to next unread array element.
+     * data2 of object node is NULL or holds attribute cursor: last found
+     * attribute tagged with lowest bit, so next attribute lookup starts
+     * near it. Fields are usually read in the same order they were
+     * written, so in-order reads find every attribute at once.
+     */
+    static const size_t attributeCursorTag = 1;
+
+    static pugi::xml_node_struct *get_array_data(const ContainerNode *node)
+    {
+        size_t data2 = reinterpret_cast<size_t>(node->data.data2);
+        if (data2 & attributeCursorTag)
+        {
+            return NULL;
+        }
+        return reinterpret_cast<pugi::xml_node_struct *>(data2);
+    }
+
+    static pugi::xml_attribute find_attribute(const ContainerNode *node, const pugi::xml_node &element, const string &name)
+    {
+        PugixmlDocument &doc = get_document(node);
+        if (doc.isNameIndexEnabled() && !doc.isConcurrentReadEnabled())
+        {
+            pugi::xml_attribute indexed = doc.findAttribute(element, name.c_str());
+            if (!indexed)
+            {
+                doc.profiler().countMiss();
+            }
+            return indexed;
+        }
+
+        size_t data2 = reinterpret_cast<size_t>(node->data.data2);
+        pugi::xml_attribute start = element.first_attribute();
+        pugi::xml_attribute found;
+        if (data2 & attributeCursorTag)
+        {
+            // in-order and reverse-order reads hit cursor neighbours,
+            // otherwise scan from attribute after cursor and wrap around
+            pugi::xml_attribute cursor(reinterpret_cast<pugi::xml_attribute_struct *>(data2 & ~attributeCursorTag));
+            pugi::xml_attribute next = cursor.next_attribute();
+            pugi::xml_attribute previous = cursor.previous_attribute();
+            if (next && strcmp(next.name(), name.c_str()) == 0)
+            {
+                found = next;
+            }
+            else if (previous && strcmp(previous.name(), name.c_str()) == 0)
+            {
+                found = previous;
+            }
+            else if (next)
+            {
+                start = next;
+            }
+        }
+
+        for (pugi::xml_attribute attribute = start; attribute && !found; attribute = attribute.next_attribute())
+        {
+            if (strcmp(attribute.name(), name.c_str()) == 0)
+            {
+                found = attribute;
+            }
+        }
+        for (pugi::xml_attribute attribute = element.first_attribute(); attribute != start && !found; attribute = attribute.next_attribute())
+        {
+            if (strcmp(attribute.name(), name.c_str()) == 0)
+            {
+                found = attribute;
+            }
+        }
+
+        if (!found)
+        {
+            doc.profiler().countMiss();
+        }
+        else if (doc.keepsAttributeCursor(node))
+        {
+            size_t cursor = reinterpret_cast<size_t>(found.internal_object()) | attributeCursorTag;
+            const_cast<ContainerNode*>(node)->data.data2 = reinterpret_cast<void*>(cursor);
+        }
+        return found;
+    }
+
+    static pugi::xml_node find_child(const ContainerNode *node, const pugi::xml_node &element, const string &name)
+    {
+        PugixmlDocument &doc = get_document(node);
+        pugi::xml_node child = doc.findChild(element, name.c_str());
+        if (!child)
+        {
+            doc.profiler().countMiss();
+        }
+        return child;
     }
 
     void selectNextArrayElement(const ContainerNode *node, const pugi::xml_node &arrayIterator)
@@ -148,7 +734,7 @@ namespace pjsettings
     static bool          pugixmlNode_hasUnread(const ContainerNode *node)
     {
         pugi::xml_node_struct *data = static_cast<pugi::xml_node_struct *>(node->data.data1);
-        pugi::xml_node_struct *arrayData = static_cast<pugi::xml_node_struct *>(node->data.data2);
+        pugi::xml_node_struct *arrayData = get_array_data(node);
         if (arrayData != NULL)
         {
             pugi::xml_node arrayIterator(arrayData);
@@ -163,7 +749,7 @@ namespace pjsettings
     static string        pugixmlNode_unreadName(const ContainerNode *node) throw(Error)
     {
         pugi::xml_node_struct *data = static_cast<pugi::xml_node_struct *>(node->data.data1);
-        pugi::xml_node_struct *arrayData = static_cast<pugi::xml_node_struct *>(node->data.data2);
+        pugi::xml_node_struct *arrayData = get_array_data(node);
         if (arrayData != NULL)
         {
             pugi::xml_node arrayIterator(arrayData);
@@ -176,27 +762,33 @@ namespace pjsettings
         }
     }
 
-    static float         pugixmlNode_readNumber(const ContainerNode *node, const string &name) throw(Error)
+    // Text of next array item or of named attribute
+    static const char *read_text(const ContainerNode *node, const string &name)
     {
         pugi::xml_node_struct *data = static_cast<pugi::xml_node_struct *>(node->data.data1);
-        pugi::xml_node_struct *arrayData = static_cast<pugi::xml_node_struct *>(node->data.data2);
+        pugi::xml_node_struct *arrayData = get_array_data(node);
         if (arrayData != NULL)
         {
             pugi::xml_node arrayIterator(arrayData);
             selectNextArrayElement(node, arrayIterator);
-            return arrayIterator.text().as_double(0.0);
+            return arrayIterator.text().get();
         }
         else
         {
             pugi::xml_node element(data);
-            return element.attribute(name.c_str()).as_double(0.0);
+            return find_attribute(node, element, name).value();
         }
     }
 
+    static float         pugixmlNode_readNumber(const ContainerNode *node, const string &name) throw(Error)
+    {
+        return parse_number(read_text(node, name));
+    }
+
     static bool          pugixmlNode_readBool(const ContainerNode *node, const string &name) throw(Error)
     {
         pugi::xml_node_struct *data = static_cast<pugi::xml_node_struct *>(node->data.data1);
-        pugi::xml_node_struct *arrayData = static_cast<pugi::xml_node_struct *>(node->data.data2);
+        pugi::xml_node_struct *arrayData = get_array_data(node);
         if (arrayData != NULL)
         {
             pugi::xml_node arrayIterator(arrayData);
@@ -206,14 +798,14 @@ namespace pjsettings
         else
         {
             pugi::xml_node element(data);
-            return element.attribute(name.c_str()).as_bool(false);
+            return find_attribute(node, element, name).as_bool(false);
         }
     }
 
     static string        pugixmlNode_readString(const ContainerNode *node, const string &name) throw(Error)
     {
         pugi::xml_node_struct *data = static_cast<pugi::xml_node_struct *>(node->data.data1);
-        pugi::xml_node_struct *arrayData = static_cast<pugi::xml_node_struct *>(node->data.data2);
+        pugi::xml_node_struct *arrayData = get_array_data(node);
         if (arrayData != NULL)
         {
             pugi::xml_node arrayIterator(arrayData);
@@ -223,27 +815,31 @@ namespace pjsettings
         else
         {
             pugi::xml_node element(data);
-            return element.attribute(name.c_str()).as_string("");
+            return find_attribute(node, element, name).as_string("");
         }
     }
 
-    static StringVector  pugixmlNode_readStringVector(const ContainerNode *node, const string &name) throw(Error)
+    // Element of next array item or named child element
+    static pugi::xml_node read_element(const ContainerNode *node, const string &name)
     {
         pugi::xml_node_struct *data = static_cast<pugi::xml_node_struct *>(node->data.data1);
-        pugi::xml_node_struct *arrayData = static_cast<pugi::xml_node_struct *>(node->data.data2);
-        pugi::xml_node stringVectorNode;
+        pugi::xml_node_struct *arrayData = get_array_data(node);
         if (arrayData != NULL)
         {
             pugi::xml_node arrayIterator(arrayData);
-            stringVectorNode = arrayIterator;
             selectNextArrayElement(node, arrayIterator);
+            return arrayIterator;
         }
         else
         {
             pugi::xml_node element(data);
-            stringVectorNode = element.child(name.c_str());
+            return find_child(node, element, name);
         }
+    }
 
+    static StringVector  pugixmlNode_readStringVector(const ContainerNode *node, const string &name) throw(Error)
+    {
+        pugi::xml_node stringVectorNode = read_element(node, name);
         StringVector result;
         for (pugi::xml_node item = stringVectorNode.first_child(); item; item = item.next_sibling())
         {
@@ -256,7 +852,7 @@ namespace pjsettings
     static ContainerNode pugixmlNode_readContainer(const ContainerNode *node, const string &name) throw(Error)
     {
         pugi::xml_node_struct *data = static_cast<pugi::xml_node_struct *>(node->data.data1);
-        pugi::xml_node_struct *arrayData = static_cast<pugi::xml_node_struct *>(node->data.data2);
+        pugi::xml_node_struct *arrayData = get_array_data(node);
         if (arrayData != NULL)
         {
             pugi::xml_node arrayIterator(arrayData);
@@ -271,7 +867,7 @@ namespace pjsettings
         else
         {
             pugi::xml_node element(data);
-            pugi::xml_node child = element.child(name.c_str());
+            pugi::xml_node child = find_child(node, element, name);
             ContainerNode childNode = {};
             childNode.op = &pugixml_op;
             childNode.data.doc = node->data.doc;
@@ -283,7 +879,7 @@ namespace pjsettings
     static ContainerNode pugixmlNode_readArray(const ContainerNode *node, const string &name) throw(Error)
     {
         pugi::xml_node_struct *data = static_cast<pugi::xml_node_struct *>(node->data.data1);
-        pugi::xml_node_struct *arrayData = static_cast<pugi::xml_node_struct *>(node->data.data2);
+        pugi::xml_node_struct *arrayData = get_array_data(node);
         pugi::xml_node workNode;
         if (arrayData != NULL)
         {
@@ -293,7 +889,7 @@ namespace pjsettings
         else
         {
             pugi::xml_node element(data);
-            workNode = element.child(name.c_str());
+            workNode = find_child(node, element, name);
         }
         pugi::xml_node firstArrayChild = workNode.first_child();
         ContainerNode childNode = {};
@@ -304,68 +900,85 @@ namespace pjsettings
         return childNode;
     }
 
-    static void          pugixmlNode_writeNumber(ContainerNode *node, const string &name, float num) throw(Error)
+    // Text of appended array item or of new named attribute
+    static void write_text(ContainerNode *node, const string &name, const char *text)
     {
         pugi::xml_node_struct *data = static_cast<pugi::xml_node_struct *>(node->data.data1);
-        pugi::xml_node_struct *arrayData = static_cast<pugi::xml_node_struct *>(node->data.data2);
+        pugi::xml_node_struct *arrayData = get_array_data(node);
         if (arrayData != NULL)
         {
             pugi::xml_node arrayIterator(arrayData);
-            arrayIterator.append_child("item").text().set(num);
+            arrayIterator.append_child("item").text().set(text);
+            get_document(node).invalidateNode(arrayIterator);
         }
         else
         {
             pugi::xml_node element(data);
-            element.append_attribute(name.c_str()).set_value(num);
+            element.append_attribute(name.c_str()).set_value(text);
+            get_document(node).invalidateNode(element);
         }
     }
 
+    static void          pugixmlNode_writeNumber(ContainerNode *node, const string &name, float num) throw(Error)
+    {
+        // pugixml formats numbers with "%g", that keeps 6 digits only
+        char text[NumberBufferSize];
+        formatFloat(num, text);
+        write_text(node, name, text);
+    }
+
     static void          pugixmlNode_writeBool(ContainerNode *node, const string &name, bool value) throw(Error)
     {
         pugi::xml_node_struct *data = static_cast<pugi::xml_node_struct *>(node->data.data1);
-        pugi::xml_node_struct *arrayData = static_cast<pugi::xml_node_struct *>(node->data.data2);
+        pugi::xml_node_struct *arrayData = get_array_data(node);
         if (arrayData != NULL)
         {
             pugi::xml_node arrayIterator(arrayData);
             arrayIterator.append_child("item").text().set(value);
+            get_document(node).invalidateNode(arrayIterator);
         }
         else
         {
             pugi::xml_node element(data);
             element.append_attribute(name.c_str()).set_value(value);
+            get_document(node).invalidateNode(element);
         }
     }
 
     static void          pugixmlNode_writeString(ContainerNode *node, const string &name, const string &value) throw(Error)
     {
         pugi::xml_node_struct *data = static_cast<pugi::xml_node_struct *>(node->data.data1);
-        pugi::xml_node_struct *arrayData = static_cast<pugi::xml_node_struct *>(node->data.data2);
+        pugi::xml_node_struct *arrayData = get_array_data(node);
         if (arrayData != NULL)
         {
             pugi::xml_node arrayIterator(arrayData);
             arrayIterator.append_child("item").text().set(value.c_str());
+            get_document(node).invalidateNode(arrayIterator);
         }
         else
         {
             pugi::xml_node element(data);
             element.append_attribute(name.c_str()).set_value(value.c_str());
+            get_document(node).invalidateNode(element);
         }
     }
 
     static void          pugixmlNode_writeStringVector(ContainerNode *node, const string &name, const StringVector &value) throw(Error)
     {
         pugi::xml_node_struct *data = static_cast<pugi::xml_node_struct *>(node->data.data1);
-        pugi::xml_node_struct *arrayData = static_cast<pugi::xml_node_struct *>(node->data.data2);
+        pugi::xml_node_struct *arrayData = get_array_data(node);
         pugi::xml_node workNode;
         if (arrayData != NULL)
         {
             pugi::xml_node arrayIterator(arrayData);
             workNode = arrayIterator.append_child(name.c_str());
+            get_document(node).invalidateNode(arrayIterator);
         }
         else
         {
             pugi::xml_node element(data);
             workNode = element.append_child(name.c_str());
+            get_document(node).invalidateNode(element);
         }
 
         for (StringVector::const_iterator it = value.begin(); it != value.end(); ++it)
@@ -377,17 +990,19 @@ namespace pjsettings
     static ContainerNode pugixmlNode_writeNewContainer(ContainerNode *node, const string &name) throw(Error)
     {
         pugi::xml_node_struct *data = static_cast<pugi::xml_node_struct *>(node->data.data1);
-        pugi::xml_node_struct *arrayData = static_cast<pugi::xml_node_struct *>(node->data.data2);
+        pugi::xml_node_struct *arrayData = get_array_data(node);
         pugi::xml_node workNode;
         if (arrayData != NULL)
         {
             pugi::xml_node arrayIterator(data);
             workNode = arrayIterator.append_child(name.c_str());
+            get_document(node).invalidateNode(arrayIterator);
         }
         else
         {
             pugi::xml_node element(data);
             workNode = element.append_child(name.c_str());
+            get_document(node).invalidateNode(element);
         }
         ContainerNode childNode = {};
         childNode.op = &pugixml_op;
@@ -399,17 +1014,19 @@ namespace pjsettings
     static ContainerNode pugixmlNode_writeNewArray(ContainerNode *node, const string &name) throw(Error)
     {
         pugi::xml_node_struct *data = static_cast<pugi::xml_node_struct *>(node->data.data1);
-        pugi::xml_node_struct *arrayData = static_cast<pugi::xml_node_struct *>(node->data.data2);
+        pugi::xml_node_struct *arrayData = get_array_data(node);
         pugi::xml_node workNode;
         if (arrayData != NULL)
         {
             pugi::xml_node arrayIterator(arrayData);
             workNode = arrayIterator.append_child(name.c_str());
+            get_document(node).invalidateNode(arrayIterator);
         }
         else
         {
             pugi::xml_node element(data);
             workNode = element.append_child(name.c_str());
+            get_document(node).invalidateNode(element);
         }
         ContainerNode childNode = {};
         childNode.op = &pugixml_op;
@@ -419,5 +1036,412 @@ namespace pjsettings
         return childNode;
     }
 
-}
+    /* Typed numbers */
+
+    // 2^63, doubles in [-2^63, 2^63) are truncated to int64_t
+    static const double int64Limit = 9223372036854775808.0;
+    static const uint64_t int64Magnitude = static_cast<uint64_t>(1) << 63;
+    static const uint64_t uint64Max = ~static_cast<uint64_t>(0);
 
+    // Integer at the start of text, real numbers and not numbers are read as parse_number() reads them
+    static int64_t parse_int64(const char *text, const string &name) throw(Error)
+    {
+        while (*text == ' ' || (*text >= '\t' && *text <= '\r'))
+        {
+            ++text;
+        }
+        const char *current = text;
+        bool negative = *current == '-';
+        if (*current == '-' || *current == '+')
+        {
+            ++current;
+        }
+        const char *digits = current;
+        uint64_t magnitude = 0;
+        bool overflow = false;
+        for (; *current >= '0' && *current <= '9'; ++current)
+        {
+            unsigned digit = static_cast<unsigned>(*current - '0');
+            overflow = overflow || magnitude > (uint64Max - digit) / 10;
+            magnitude = magnitude * 10 + digit;
+        }
+
+        if (current == digits || *current == '.' || (*current | 0x20) == 'e' || (*current | 0x20) == 'x')
+        {
+            double value = parseDouble(text);
+            if (!(value >= -int64Limit && value < int64Limit))
+            {
+                throw Error(1, "read number error", "value is out of int64 range", name, 0);
+            }
+            return static_cast<int64_t>(value);
+        }
+        uint64_t limit = negative ? int64Magnitude : int64Magnitude - 1;
+        if (overflow || magnitude > limit)
+        {
+            throw Error(1, "read number error", "value is out of int64 range", name, 0);
+        }
+        return negative ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+    }
+
+    // Array position or attribute cursor of node read by its document node copy
+    static void update_node_state(const ContainerNode &node, const ContainerNode &native)
+    {
+        if (node.data.data2 != native.data.data2 && get_document(&native).keepsAttributeCursor(&node))
+        {
+            const_cast<ContainerNode &>(node).data.data2 = native.data.data2;
+        }
+    }
+
+    /*
+     * Copy of node with operations of document, profiling nodes of document
+     * keep document node data and are resolved too.
+     */
+    ContainerNode PugixmlDocument::nativeNode(const ContainerNode &node) const throw(Error)
+    {
+        ContainerNode native = node;
+        if (node.data.doc == &_profiler)
+        {
+            native.op = _rootNode.op;
+            native.data.doc = _rootNode.data.doc;
+        }
+        if (native.op != _rootNode.op || native.data.doc != _rootNode.data.doc)
+        {
+            throw Error(1, "numeric node error", "node is not a node of this document", "", 0);
+        }
+        return native;
+    }
+
+    int64_t PugixmlDocument::readInt64(const ContainerNode &node, const string &name) const throw(Error)
+    {
+        ContainerNode native = nativeNode(node);
+        const char *text = _snapshot.isOpen()
+            ? _snapshot.string(snapshotReadValue(native, name)->string)
+            : read_text(&native, name);
+        int64_t value = parse_int64(text, name);
+        update_node_state(node, native);
+        return value;
+    }
+
+    double PugixmlDocument::readDouble(const ContainerNode &node, const string &name) const throw(Error)
+    {
+        ContainerNode native = nativeNode(node);
+        double value = _snapshot.isOpen()
+            ? snapshotReadValue(native, name)->number
+            : parse_number(read_text(&native, name));
+        update_node_state(node, native);
+        return value;
+    }
+
+    void PugixmlDocument::writeInt64(ContainerNode &node, const string &name, int64_t value) throw(Error)
+    {
+        ContainerNode native = nativeNode(node);
+        if (_snapshot.isOpen())
+        {
+            throw Error(1, "snapshot write error", "document is frozen or loaded from snapshot", "", 0);
+        }
+        char text[NumberBufferSize];
+        formatInt64(value, text);
+        write_text(&native, name, text);
+        update_node_state(node, native);
+    }
+
+    void PugixmlDocument::writeDouble(ContainerNode &node, const string &name, double value) throw(Error)
+    {
+        ContainerNode native = nativeNode(node);
+        if (_snapshot.isOpen())
+        {
+            throw Error(1, "snapshot write error", "document is frozen or loaded from snapshot", "", 0);
+        }
+        char text[NumberBufferSize];
+        formatDouble(value, text);
+        write_text(&native, name, text);
+        update_node_state(node, native);
+    }
+
+    /* String views */
+
+    StringView PugixmlDocument::readStringView(const ContainerNode &node, const string &name) const throw(Error)
+    {
+        ContainerNode native = nativeNode(node);
+        StringView view;
+        if (_snapshot.isOpen())
+        {
+            uint32_t text = snapshotReadValue(native, name)->string;
+            view = StringView(_snapshot.string(text), _snapshot.stringSize(text));
+        }
+        else
+        {
+            const char *text = read_text(&native, name);
+            view = StringView(text, strlen(text));
+        }
+        update_node_state(node, native);
+        return view;
+    }
+
+    void PugixmlDocument::readStringVectorViews(const ContainerNode &node, const string &name, std::vector<StringView> &views) const throw(Error)
+    {
+        views.clear();
+        ContainerNode native = nativeNode(node);
+        if (_snapshot.isOpen())
+        {
+            const SnapshotNode *element = snapshotReadElement(native, name);
+            for (uint32_t i = 0; i < element->childCount; ++i)
+            {
+                uint32_t text = _snapshot.child(element, i)->string;
+                views.push_back(StringView(_snapshot.string(text), _snapshot.stringSize(text)));
+            }
+        }
+        else
+        {
+            pugi::xml_node element = read_element(&native, name);
+            for (pugi::xml_node item = element.first_child(); item; item = item.next_sibling())
+            {
+                const char *text = item.text().get();
+                views.push_back(StringView(text, strlen(text)));
+            }
+        }
+        update_node_state(node, native);
+    }
+
+    /* Array elements */
+
+    void PugixmlDocument::readArrayElements(const ContainerNode &node, const string &name, std::vector<ContainerNode> &elements) const throw(Error)
+    {
+        elements.clear();
+        ContainerNode native = nativeNode(node);
+        ContainerNode array = native.readArray(name);
+        update_node_state(node, native);
+        if (_snapshot.isOpen())
+        {
+            snapshotArrayElements(array, elements);
+            return;
+        }
+        for (pugi::xml_node item(get_array_data(&array)); item; item = item.next_sibling())
+        {
+            elements.push_back(array);
+            elements.back().data.data2 = item.internal_object();
+        }
+    }
+
+    /* Structural diff */
+
+    // Element with text only, as items of string vectors are, is compared as value of its parent
+    static bool is_value_element(const pugi::xml_node &element)
+    {
+        if (element.first_attribute())
+        {
+            return false;
+        }
+        for (pugi::xml_node child = element.first_child(); child; child = child.next_sibling())
+        {
+            if (child.type() == pugi::node_element)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Sum of attribute hashes does not depend on attribute order
+    static uint64_t attributes_hash(const pugi::xml_node &element)
+    {
+        uint64_t sum = 0;
+        for (pugi::xml_attribute attribute = element.first_attribute(); attribute; attribute = attribute.next_attribute())
+        {
+            Hash64 hash;
+            hash.update(attribute.name(), strlen(attribute.name()) + 1);
+            hash.update(attribute.value(), strlen(attribute.value()) + 1);
+            sum += hash.digest();
+        }
+        return sum;
+    }
+
+    static bool is_text(const pugi::xml_node &node)
+    {
+        return node.type() == pugi::node_pcdata || node.type() == pugi::node_cdata;
+    }
+
+    static uint64_t text_hash(const pugi::xml_node &element)
+    {
+        Hash64 hash;
+        for (pugi::xml_node child = element.first_child(); child; child = child.next_sibling())
+        {
+            if (is_text(child))
+            {
+                hash.update(child.value(), strlen(child.value()) + 1);
+            }
+        }
+        return hash.digest();
+    }
+
+    // Comments and processing instructions are not hashed
+    static uint64_t subtree_hash(const pugi::xml_node &element, SubtreeHashCache &cache)
+    {
+        uint64_t cached;
+        if (cache.find(element.internal_object(), cached))
+        {
+            return cached;
+        }
+
+        Hash64 hash;
+        hash.update(element.name(), strlen(element.name()) + 1);
+        uint64_t attributes = attributes_hash(element);
+        hash.update(&attributes, sizeof(attributes));
+        for (pugi::xml_node child = element.first_child(); child; child = child.next_sibling())
+        {
+            if (child.type() == pugi::node_element)
+            {
+                unsigned char tag = 'e';
+                uint64_t childHash = subtree_hash(child, cache);
+                hash.update(&tag, sizeof(tag));
+                hash.update(&childHash, sizeof(childHash));
+            }
+            else if (is_text(child))
+            {
+                unsigned char tag = 't';
+                hash.update(&tag, sizeof(tag));
+                hash.update(child.value(), strlen(child.value()) + 1);
+            }
+        }
+        uint64_t result = hash.digest();
+        cache.insert(element.internal_object(), result);
+        return result;
+    }
+
+    struct ElementDiff
+    {
+        SubtreeHashCache &leftHashes;
+        SubtreeHashCache &rightHashes;
+        DiffPath &path;
+    };
+
+    // Child elements of the same name in both documents
+    struct ChildGroup
+    {
+        std::vector<pugi::xml_node> left;
+        std::vector<pugi::xml_node> right;
+    };
+
+    typedef std::map<std::string, ChildGroup> ChildGroups;
+
+    static void group_children(const pugi::xml_node &element, bool left, std::vector<std::string> &names, ChildGroups &groups)
+    {
+        for (pugi::xml_node child = element.first_child(); child; child = child.next_sibling())
+        {
+            if (child.type() != pugi::node_element)
+            {
+                continue;
+            }
+            ChildGroups::iterator group = groups.find(child.name());
+            if (group == groups.end())
+            {
+                names.push_back(child.name());
+                group = groups.insert(std::make_pair(names.back(), ChildGroup())).first;
+            }
+            (left ? group->second.left : group->second.right).push_back(child);
+        }
+    }
+
+    static void diff_elements(ElementDiff &diff, const pugi::xml_node &left, const pugi::xml_node &right);
+
+    // Returns true if element holding the children is changed itself
+    static bool diff_children(ElementDiff &diff, const pugi::xml_node *left, const pugi::xml_node *right)
+    {
+        if (left == NULL || right == NULL)
+        {
+            if (is_value_element(left != NULL ? *left : *right))
+            {
+                return true;
+            }
+            diff.path.report();
+            return false;
+        }
+        if (subtree_hash(*left, diff.leftHashes) == subtree_hash(*right, diff.rightHashes))
+        {
+            return false;
+        }
+        if (is_value_element(*left) && is_value_element(*right))
+        {
+            return true;
+        }
+        diff_elements(diff, *left, *right);
+        return false;
+    }
+
+    static void diff_elements(ElementDiff &diff, const pugi::xml_node &left, const pugi::xml_node &right)
+    {
+        size_t mark = diff.path.mark();
+        bool changed = attributes_hash(left) != attributes_hash(right) || text_hash(left) != text_hash(right);
+
+        // children are matched by name and by position among children of that name
+        std::vector<std::string> names;
+        ChildGroups groups;
+        group_children(left, true, names, groups);
+        group_children(right, false, names, groups);
+        for (size_t i = 0; i < names.size(); ++i)
+        {
+            const ChildGroup &group = groups[names[i]];
+            size_t count = group.left.size() > group.right.size() ? group.left.size() : group.right.size();
+            for (size_t k = 0; k < count; ++k)
+            {
+                // repeated names get position: "AccountConfig[3]"
+                std::string segment = names[i];
+                if (count > 1)
+                {
+                    char position[24];
+                    snprintf(position, sizeof(position), "[%lu]", static_cast<unsigned long>(k));
+                    segment += position;
+                }
+                diff.path.push(segment.c_str());
+                changed |= diff_children(diff,
+                    k < group.left.size() ? &group.left[k] : NULL,
+                    k < group.right.size() ? &group.right[k] : NULL);
+                diff.path.pop();
+            }
+        }
+        if (changed)
+        {
+            diff.path.report(mark);
+        }
+    }
+
+    // Cache is written on reads, so it is not used by concurrent readers
+    bool PugixmlDocument::keepsSubtreeHashes() const
+    {
+        return !_snapshot.isOpen() && !_concurrentReadEnabled;
+    }
+
+    uint64_t PugixmlDocument::getTreeHash() const
+    {
+        pugi::xml_document restored;
+        SubtreeHashCache temporary;
+        pugi::xml_node root = documentToSave(restored).root().first_child();
+        return subtree_hash(root, keepsSubtreeHashes() ? _subtreeHashes : temporary);
+    }
+
+    std::vector<std::string> PugixmlDocument::diff(const PugixmlDocument &other) const
+    {
+        std::vector<std::string> changed;
+        // trees restored from snapshot are temporary, their hashes are not kept,
+        // and hashes of trees read by threads at once are not kept either
+        pugi::xml_document leftRestored, rightRestored;
+        SubtreeHashCache leftTemporary, rightTemporary;
+        pugi::xml_node left = documentToSave(leftRestored).root().first_child();
+        pugi::xml_node right = other.documentToSave(rightRestored).root().first_child();
+        SubtreeHashCache &leftHashes = keepsSubtreeHashes() ? _subtreeHashes : leftTemporary;
+        SubtreeHashCache &rightHashes = other.keepsSubtreeHashes() ? other._subtreeHashes : rightTemporary;
+
+        DiffPath path(changed);
+        ElementDiff diff = { leftHashes, rightHashes, path };
+        if (strcmp(left.name(), right.name()) != 0)
+        {
+            path.report();
+        }
+        else if (subtree_hash(left, leftHashes) != subtree_hash(right, rightHashes))
+        {
+            diff_elements(diff, left, right);
+        }
+        return changed;
+    }
+
+}
@@ -28,22 +28,144 @@
 
 #endif
 
+#include "pjsettings-array-elements.h"
+#include "pjsettings-config.h"
+#include "pjsettings-diff.h"
+#include "pjsettings-mapped-file.h"
+#include "pjsettings-numeric.h"
+#include "pjsettings-pugixml-index.h"
+#if PJSETTINGS_HAS_PUGIXML_PAGE_POOL
+#include "pjsettings-pugixml-pool.h"
+#endif
+#include "pjsettings-profiler.h"
+#include "pjsettings-snapshot.h"
+#include "pjsettings-string-view.h"
+
 namespace pjsettings
 {
-    class PugixmlDocument : public pj::PersistentDocument
+    class PugixmlDocument : public pj::PersistentDocument, public NumericExtension, public StringViewExtension, public ArrayElementsExtension
     {
     public:
-        PugixmlDocument(unsigned int flags = pugi::format_default);
+        PugixmlDocument(unsigned int flags = pugi::format_default, bool mapFileOnLoad = false);
         virtual void loadFile(const std::string &filename) throw(pj::Error);
         virtual void loadString(const std::string &input) throw(pj::Error);
+#if PJSETTINGS_HAS_RVALUE_REFERENCES
+        void loadString(std::string &&input) throw(pj::Error);
+#endif
+        void loadBuffer(const char *input, size_t size) throw(pj::Error);
         virtual void saveFile(const std::string &filename) throw(pj::Error);
         virtual std::string saveString() throw(pj::Error);
         virtual pj::ContainerNode &getRootContainer() const;
+
+        // Resident memory that mapped loadFile() saved compared to
+        // reading the whole file into a heap buffer (0 if not mapped)
+        size_t getMappedMemorySaving() const;
+
+        // Hash attribute and child names of wide nodes on first lookup
+        void setNameIndexEnabled(bool enabled);
+        bool isNameIndexEnabled() const;
+
+        // Name lookups of node operations
+        pugi::xml_attribute findAttribute(const pugi::xml_node &node, const char *name) const;
+        pugi::xml_node findChild(const pugi::xml_node &node, const char *name) const;
+        // Root node shared by concurrent readers does not keep attribute cursor
+        bool keepsAttributeCursor(const pj::ContainerNode *node) const;
+        // Drops name index of written node, cached subtree hashes and content hash
+        void invalidateNode(const pugi::xml_node &node);
+
+        // Memory pages of the tree are taken from pool owned by document and
+        // go back to it when the tree is freed, so reloads reuse the same pages.
+        // Page size (1 KB to 64 KB, 32 KB by default) is applied on next load.
+        // Without the pool (PJSETTINGS_HAS_PUGIXML_PAGE_POOL is 0) pages are
+        // allocated by pugixml, setPageSize throws and the rest read 0.
+        void setPageSize(size_t pageSize) throw(pj::Error);
+        size_t getPageSize() const;
+        size_t getPagesInUse() const;
+        size_t getPooledPages() const;
+        void trimPagePool();
+
+        // loadFile reads binary snapshot cached next to the file instead of
+        // parsing it, when the file is not changed since the snapshot was built.
+        // Document loaded from snapshot is read-only.
+        void setSnapshotCacheEnabled(bool enabled);
+        bool isSnapshotCacheEnabled() const;
+        bool isLoadedFromSnapshot() const;
+
+        // Tree is converted to snapshot layout held in memory: attributes and
+        // children sorted by name for binary search, text inline, strings in
+        // one pool. Document loaded from snapshot is frozen too. Frozen document
+        // is read-only until thaw() builds the tree again. Nodes taken before
+        // freeze() or thaw() must not be used after it.
+        void freeze() throw(pj::Error);
+        void thaw();
+        bool isFrozen() const;
+
+        // Operations on nodes of document are timed and counted
+        // while profiler is enabled, see OperationProfiler
+        OperationProfiler &profiler();
+
+        // Read operations on nodes never write shared document state, so
+        // threads can read the loaded document at once. Each reader takes its
+        // own nodes (arrays keep their cursors in nodes), nodes are not shared
+        // between threads. Loads, writes, freeze() and thaw() still need the
+        // document for themselves. Enabling concurrent reads disables profiler,
+        // it must not be enabled again while threads read the document.
+        // diff() and getTreeHash() don't cache subtree hashes while it is enabled.
+        // Name index is not used by concurrent reads, it is built on lookups.
+        void setConcurrentReadEnabled(bool enabled);
+        bool isConcurrentReadEnabled() const;
+
+        // Numbers parsed from and formatted to xml text exactly, see NumericExtension
+        virtual int64_t readInt64(const pj::ContainerNode &node, const std::string &name) const throw(pj::Error);
+        virtual double readDouble(const pj::ContainerNode &node, const std::string &name) const throw(pj::Error);
+        virtual void writeInt64(pj::ContainerNode &node, const std::string &name, int64_t value) throw(pj::Error);
+        virtual void writeDouble(pj::ContainerNode &node, const std::string &name, double value) throw(pj::Error);
+
+        // Views of xml text, values are not checked to be strings, see StringViewExtension
+        virtual StringView readStringView(const pj::ContainerNode &node, const std::string &name) const throw(pj::Error);
+        virtual void readStringVectorViews(const pj::ContainerNode &node, const std::string &name, std::vector<StringView> &views) const throw(pj::Error);
+
+        // Nodes of all array items, see ArrayElementsExtension
+        virtual void readArrayElements(const pj::ContainerNode &node, const std::string &name, std::vector<pj::ContainerNode> &elements) const throw(pj::Error);
+
+        // Paths of elements that differ from the same elements of other
+        // document, see DiffPath. Unchanged subtrees are skipped by their hashes,
+        // which are kept by both documents until they are loaded or written.
+        std::vector<std::string> diff(const PugixmlDocument &other) const;
+
+        // XXH64 of bytes the document was loaded from (or snapshot was built from),
+        // dropped when the document is written. reloadIfChanged() loads the file
+        // only if its content hash differs, otherwise the file is not parsed.
+        // File loaded through mapping is loaded again whenever it was written in place.
+        bool hasContentHash() const;
+        uint64_t getContentHash() const;
+        bool reloadIfChanged(const std::string &filename) throw(pj::Error);
+        // Hash of the tree that does not depend on formatting and attribute order
+        uint64_t getTreeHash() const;
     private:
         void initRoot();
+        bool keepsSubtreeHashes() const;
+        void initEmptyRoot();
+        const pugi::xml_document &documentToSave(pugi::xml_document &restored) const;
+        pj::ContainerNode nativeNode(const pj::ContainerNode &node) const throw(pj::Error);
+#if PJSETTINGS_HAS_PUGIXML_PAGE_POOL
+        PugixmlPagePool _pagePool;      // declared before _document, so it outlives the tree
+#endif
         pugi::xml_document _document;
         unsigned int _flags;
         mutable pj::ContainerNode _rootNode;
+        bool _mapFileOnLoad;
+        MappedFile _mappedFile;
+        std::string _inputBuffer;
+        bool _nameIndexEnabled;
+        mutable PugixmlNameIndex _nameIndex;
+        bool _snapshotCacheEnabled;
+        Snapshot _snapshot;
+        mutable OperationProfiler _profiler;
+        bool _concurrentReadEnabled;
+        mutable SubtreeHashCache _subtreeHashes;
+        uint64_t _contentHash;
+        bool _contentHashValid;
     };
 
 }
@@ -0,0 +1,894 @@
+/*
+ * Binary snapshot of loaded pjsettings documents
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "pjsettings-hash.h"
+#include "pjsettings-snapshot.h"
+
+using namespace pj;
+using namespace std;
+
+namespace pjsettings
+{
+
+    static const char snapshotMagic[8] = { 'P', 'J', 'S', 'N', 'A', 'P', '\r', '\n' };
+    static const uint32_t snapshotVersion = 1;
+    static const uint32_t snapshotByteOrder = 0x01020304;
+
+    static size_t align8(size_t size)
+    {
+        return (size + 7) & ~static_cast<size_t>(7);
+    }
+
+    static uint32_t checked_uint32(size_t value) throw(Error)
+    {
+        if (value > 0xffffffffu)
+        {
+            throw Error(1, "snapshot build error", "document is too large for snapshot", "", 0);
+        }
+        return static_cast<uint32_t>(value);
+    }
+
+    SnapshotSource::SnapshotSource()
+        : path()
+        , size(0)
+        , modified(0)
+        , checked(0)
+        , hash(0)
+    {
+    }
+
+    bool SnapshotSource::stat(const std::string &filename)
+    {
+        struct ::stat fileStat;
+        if (::stat(filename.c_str(), &fileStat) != 0)
+        {
+            return false;
+        }
+        checked = static_cast<int64_t>(time(NULL));
+        path = filename;
+        size = static_cast<uint64_t>(fileStat.st_size);
+        modified = static_cast<int64_t>(fileStat.st_mtime);
+        return true;
+    }
+
+    /* Snapshot builder */
+
+    SnapshotBuilder::SnapshotBuilder(SnapshotBackend backend)
+        : _backend(backend)
+        , _nodes()
+        , _sorted()
+        , _strings()
+        , _stringSlots()
+        , _stringCount(0)
+    {
+        // empty string is always at offset 0, null node refers to it
+        addString("", 0);
+    }
+
+    uint32_t SnapshotBuilder::addNodes(size_t count) throw(pj::Error)
+    {
+        uint32_t first = checked_uint32(_nodes.size());
+        SnapshotNode empty;
+        memset(&empty, 0, sizeof(empty));
+        _nodes.resize(checked_uint32(_nodes.size() + count), empty);
+        return first;
+    }
+
+    SnapshotNode &SnapshotBuilder::node(uint32_t index)
+    {
+        return _nodes[index];
+    }
+
+    static size_t string_slot(const char *value, size_t size, size_t mask)
+    {
+        return static_cast<size_t>(Hash64::calculate(value, size)) & mask;
+    }
+
+    uint32_t SnapshotBuilder::addString(const char *value, size_t size) throw(pj::Error)
+    {
+        // load factor is kept below 1/2
+        if ((_stringCount + 1) * 2 > _stringSlots.size())
+        {
+            growStringSlots();
+        }
+        size_t mask = _stringSlots.size() - 1;
+        size_t slot = string_slot(value, size, mask);
+        for (; _stringSlots[slot] != 0; slot = (slot + 1) & mask)
+        {
+            uint32_t pooled = _stringSlots[slot] - 1;
+            uint32_t pooledSize;
+            memcpy(&pooledSize, &_strings[pooled], sizeof(pooledSize));
+            if (pooledSize == size && memcmp(&_strings[pooled + sizeof(pooledSize)], value, size) == 0)
+            {
+                return pooled;
+            }
+        }
+
+        // 32-bit size, bytes and terminating zero
+        uint32_t offset = checked_uint32(_strings.size());
+        uint32_t stringSize = checked_uint32(size);
+        _strings.insert(_strings.end(), reinterpret_cast<const char *>(&stringSize), reinterpret_cast<const char *>(&stringSize) + sizeof(stringSize));
+        _strings.insert(_strings.end(), value, value + size);
+        _strings.push_back('\0');
+        _stringSlots[slot] = offset + 1;
+        ++_stringCount;
+        return offset;
+    }
+
+    void SnapshotBuilder::growStringSlots()
+    {
+        std::vector<uint32_t> slots(_stringSlots.empty() ? 1024 : _stringSlots.size() * 2, 0);
+        size_t mask = slots.size() - 1;
+        for (size_t i = 0; i < _stringSlots.size(); ++i)
+        {
+            if (_stringSlots[i] != 0)
+            {
+                uint32_t pooled = _stringSlots[i] - 1;
+                uint32_t pooledSize;
+                memcpy(&pooledSize, &_strings[pooled], sizeof(pooledSize));
+                size_t slot = string_slot(&_strings[pooled + sizeof(pooledSize)], pooledSize, mask);
+                while (slots[slot] != 0)
+                {
+                    slot = (slot + 1) & mask;
+                }
+                slots[slot] = _stringSlots[i];
+            }
+        }
+        _stringSlots.swap(slots);
+    }
+
+    uint32_t SnapshotBuilder::addString(const char *value) throw(pj::Error)
+    {
+        return addString(value, strlen(value));
+    }
+
+    uint32_t SnapshotBuilder::addString(const std::string &value) throw(pj::Error)
+    {
+        return addString(value.data(), value.size());
+    }
+
+    struct SnapshotNameLess
+    {
+        SnapshotNameLess(const std::vector<SnapshotNode> &nodes, const std::vector<char> &strings)
+            : nodes(nodes)
+            , strings(strings)
+        {
+        }
+
+        bool operator()(uint32_t left, uint32_t right) const
+        {
+            const char *leftName = &strings[nodes[left].name + sizeof(uint32_t)];
+            const char *rightName = &strings[nodes[right].name + sizeof(uint32_t)];
+            return strcmp(leftName, rightName) < 0;
+        }
+
+        const std::vector<SnapshotNode> &nodes;
+        const std::vector<char> &strings;
+    };
+
+    uint32_t SnapshotBuilder::addSortedIndex(uint32_t first, uint32_t count) throw(pj::Error)
+    {
+        uint32_t offset = checked_uint32(_sorted.size());
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            _sorted.push_back(first + i);
+        }
+        // stable, so the first of duplicate names is found first
+        SnapshotNameLess less(_nodes, _strings);
+        if (count > 16)
+        {
+            std::stable_sort(_sorted.begin() + offset, _sorted.end(), less);
+            return offset;
+        }
+        // std::stable_sort allocates its buffer even for few names every node has
+        for (uint32_t i = offset + 1; i < _sorted.size(); ++i)
+        {
+            uint32_t item = _sorted[i];
+            uint32_t j = i;
+            for (; j > offset && less(item, _sorted[j - 1]); --j)
+            {
+                _sorted[j] = _sorted[j - 1];
+            }
+            _sorted[j] = item;
+        }
+        return offset;
+    }
+
+    void SnapshotBuilder::build(std::vector<char> &image, const SnapshotSource &source) throw(pj::Error)
+    {
+        if (_nodes.empty())
+        {
+            throw Error(1, "snapshot build error", "there is no root node", "", 0);
+        }
+
+        SnapshotHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, snapshotMagic, sizeof(header.magic));
+        header.version = snapshotVersion;
+        header.byteOrder = snapshotByteOrder;
+        header.headerSize = sizeof(SnapshotHeader);
+        header.nodeSize = sizeof(SnapshotNode);
+        header.backend = _backend;
+        header.sourcePath = addString(source.path);
+        header.sourceSize = source.size;
+        header.sourceModified = source.modified;
+        header.sourceChecked = source.checked;
+        header.sourceHash = source.hash;
+
+        size_t nodesOffset = align8(sizeof(SnapshotHeader));
+        size_t sortedOffset = nodesOffset + _nodes.size() * sizeof(SnapshotNode);
+        size_t stringsOffset = sortedOffset + _sorted.size() * sizeof(uint32_t);
+        size_t imageSize = stringsOffset + _strings.size();
+
+        header.imageSize = imageSize;
+        header.nodesOffset = checked_uint32(nodesOffset);
+        header.nodeCount = checked_uint32(_nodes.size());
+        header.sortedOffset = checked_uint32(sortedOffset);
+        header.sortedCount = checked_uint32(_sorted.size());
+        header.stringsOffset = checked_uint32(stringsOffset);
+        header.stringsSize = checked_uint32(_strings.size());
+
+        image.assign(imageSize, '\0');
+        memcpy(&image[0], &header, sizeof(header));
+        memcpy(&image[nodesOffset], &_nodes[0], _nodes.size() * sizeof(SnapshotNode));
+        if (!_sorted.empty())
+        {
+            memcpy(&image[sortedOffset], &_sorted[0], _sorted.size() * sizeof(uint32_t));
+        }
+        memcpy(&image[stringsOffset], &_strings[0], _strings.size());
+    }
+
+    /* Snapshot view */
+
+    Snapshot::Snapshot()
+        : _file()
+        , _memory()
+        , _data(NULL)
+        , _size(0)
+    {
+    }
+
+    bool Snapshot::openFile(const std::string &snapshotFilename, SnapshotBackend backend, const std::string &sourceFilename)
+    {
+        SnapshotSource source;
+        if (!source.stat(sourceFilename))
+        {
+            return false;
+        }
+
+        // nodes of the open image may still be read, so it is replaced
+        // only by the image that is checked already
+        Snapshot candidate;
+        try
+        {
+            candidate._file.open(snapshotFilename);
+        }
+        catch (Error &)
+        {
+            return false;
+        }
+        candidate._data = candidate._file.data();
+        candidate._size = candidate._file.size();
+
+        if (!candidate.validate(backend)
+            || sourceFilename != candidate.string(candidate.header().sourcePath)
+            || source.size != candidate.header().sourceSize)
+        {
+            return false;
+        }
+
+        // Snapshot is keyed by content: modification time is kept by copies
+        // (cp -p, rsync -t, tar), so file of the same size and time may still differ.
+        // Hashing the file costs a fraction of parsing it.
+        try
+        {
+            MappedFile sourceFile;
+            sourceFile.open(sourceFilename);
+            if (Hash64::calculate(sourceFile.data(), sourceFile.size()) != candidate.header().sourceHash)
+            {
+                return false;
+            }
+        }
+        catch (Error &)
+        {
+            return false;
+        }
+        swap(candidate);
+        return true;
+    }
+
+    void Snapshot::assign(std::vector<char> &image) throw(pj::Error)
+    {
+        close();
+        _memory.swap(image);
+        _data = _memory.empty() ? NULL : &_memory[0];
+        _size = _memory.size();
+        if (!validate(static_cast<SnapshotBackend>(header().backend)))
+        {
+            close();
+            throw Error(1, "snapshot error", "broken snapshot image", "", 0);
+        }
+    }
+
+    void Snapshot::close()
+    {
+        _file.close();
+        std::vector<char>().swap(_memory);
+        _data = NULL;
+        _size = 0;
+    }
+
+    void Snapshot::swap(Snapshot &other)
+    {
+        // buffers of the vectors and mappings are swapped, so _data stays valid
+        _file.swap(other._file);
+        _memory.swap(other._memory);
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+    }
+
+    bool Snapshot::isOpen() const
+    {
+        return _data != NULL;
+    }
+
+    bool Snapshot::isMapped() const
+    {
+        return _data != NULL && _data == _file.data();
+    }
+
+    bool Snapshot::validate(SnapshotBackend backend) const
+    {
+        if (_data == NULL || _size < sizeof(SnapshotHeader))
+        {
+            return false;
+        }
+        const SnapshotHeader &h = header();
+        bool headerValid = memcmp(h.magic, snapshotMagic, sizeof(h.magic)) == 0
+            && h.version == snapshotVersion
+            && h.byteOrder == snapshotByteOrder
+            && h.headerSize == sizeof(SnapshotHeader)
+            && h.nodeSize == sizeof(SnapshotNode)
+            && h.backend == static_cast<uint32_t>(backend)
+            && h.imageSize == _size
+            && h.nodeCount > 0
+            && h.nodesOffset % 8 == 0
+            && static_cast<uint64_t>(h.nodesOffset) + static_cast<uint64_t>(h.nodeCount) * sizeof(SnapshotNode) <= h.sortedOffset
+            && static_cast<uint64_t>(h.sortedOffset) + static_cast<uint64_t>(h.sortedCount) * sizeof(uint32_t) <= h.stringsOffset
+            && static_cast<uint64_t>(h.stringsOffset) + h.stringsSize <= _size;
+        if (!headerValid || !validString(h.sourcePath))
+        {
+            return false;
+        }
+
+        // nodes are trusted by accessors, so every index and offset
+        // of them is checked once, before the image is read
+        const uint32_t *sorted = reinterpret_cast<const uint32_t *>(_data + h.sortedOffset);
+        for (uint32_t i = 0; i < h.sortedCount; ++i)
+        {
+            if (sorted[i] >= h.nodeCount)
+            {
+                return false;
+            }
+        }
+        const SnapshotNode *nodes = root();
+        for (uint32_t i = 0; i < h.nodeCount; ++i)
+        {
+            const SnapshotNode &node = nodes[i];
+            if (!validString(node.name)
+                || !validString(node.string)
+                || static_cast<uint64_t>(node.firstChild) + node.childCount > h.nodeCount
+                || static_cast<uint64_t>(node.firstAttribute) + node.attributeCount > h.nodeCount
+                || (node.type == SNAPSHOT_OBJECT && node.childCount > 0
+                    && static_cast<uint64_t>(node.sortedChildren) + node.childCount > h.sortedCount)
+                || (node.attributeCount > 0
+                    && static_cast<uint64_t>(node.sortedAttributes) + node.attributeCount > h.sortedCount))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // String of the pool: size, characters and terminating zero inside of the pool
+    bool Snapshot::validString(uint32_t offset) const
+    {
+        const SnapshotHeader &h = header();
+        if (static_cast<uint64_t>(offset) + sizeof(uint32_t) > h.stringsSize)
+        {
+            return false;
+        }
+        uint32_t size = stringSize(offset);
+        uint64_t terminator = static_cast<uint64_t>(offset) + sizeof(uint32_t) + size;
+        return terminator < h.stringsSize && _data[h.stringsOffset + terminator] == '\0';
+    }
+
+    const SnapshotHeader &Snapshot::header() const
+    {
+        return *reinterpret_cast<const SnapshotHeader *>(_data);
+    }
+
+    const SnapshotNode *Snapshot::root() const
+    {
+        return reinterpret_cast<const SnapshotNode *>(_data + header().nodesOffset);
+    }
+
+    const SnapshotNode *Snapshot::child(const SnapshotNode *node, uint32_t index) const
+    {
+        return root() + node->firstChild + index;
+    }
+
+    const SnapshotNode *Snapshot::attribute(const SnapshotNode *node, uint32_t index) const
+    {
+        return root() + node->firstAttribute + index;
+    }
+
+    const char *Snapshot::string(uint32_t offset) const
+    {
+        if (_data == NULL)
+        {
+            return "";
+        }
+        return _data + header().stringsOffset + offset + sizeof(uint32_t);
+    }
+
+    uint32_t Snapshot::stringSize(uint32_t offset) const
+    {
+        if (_data == NULL)
+        {
+            return 0;
+        }
+        uint32_t size;
+        memcpy(&size, _data + header().stringsOffset + offset, sizeof(size));
+        return size;
+    }
+
+    const SnapshotNode *Snapshot::findSorted(uint32_t sortedOffset, uint32_t count, const char *name) const
+    {
+        const uint32_t *sorted = reinterpret_cast<const uint32_t *>(_data + header().sortedOffset) + sortedOffset;
+        const SnapshotNode *nodes = root();
+
+        // lower bound, so the first of duplicate names is found
+        uint32_t low = 0;
+        uint32_t high = count;
+        while (low < high)
+        {
+            uint32_t middle = low + (high - low) / 2;
+            if (strcmp(string(nodes[sorted[middle]].name), name) < 0)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        if (low < count && strcmp(string(nodes[sorted[low]].name), name) == 0)
+        {
+            return nodes + sorted[low];
+        }
+        return NULL;
+    }
+
+    const SnapshotNode *Snapshot::findChild(const SnapshotNode *node, const char *name) const
+    {
+        if (node->type != SNAPSHOT_OBJECT || node->childCount == 0)
+        {
+            return NULL;
+        }
+        return findSorted(node->sortedChildren, node->childCount, name);
+    }
+
+    const SnapshotNode *Snapshot::findAttribute(const SnapshotNode *node, const char *name) const
+    {
+        if (node->attributeCount == 0)
+        {
+            return NULL;
+        }
+        return findSorted(node->sortedAttributes, node->attributeCount, name);
+    }
+
+    const SnapshotNode *Snapshot::nullNode()
+    {
+        // missing json value reads like Json::Value::null
+        static const SnapshotNode node = {
+            0.0, 0, SNAPSHOT_NULL, SNAPSHOT_AS_NUMBER | SNAPSHOT_AS_BOOL | SNAPSHOT_AS_STRING,
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+        };
+        return &node;
+    }
+
+    std::string snapshotFilename(const std::string &sourceFilename)
+    {
+        return sourceFilename + ".snapshot";
+    }
+
+    bool writeSnapshotFile(const std::string &snapshotFilename, const std::vector<char> &image)
+    {
+        std::string temporaryFilename = snapshotFilename + ".tmp";
+        FILE *file = fopen(temporaryFilename.c_str(), "wb");
+        if (file == NULL)
+        {
+            return false;
+        }
+        bool written = image.empty() || fwrite(&image[0], 1, image.size(), file) == image.size();
+        written = fclose(file) == 0 && written;
+        if (!written)
+        {
+            remove(temporaryFilename.c_str());
+            return false;
+        }
+#ifdef _WIN32
+        remove(snapshotFilename.c_str());
+#endif
+        if (rename(temporaryFilename.c_str(), snapshotFilename.c_str()) != 0)
+        {
+            remove(temporaryFilename.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    /* Node operations */
+
+    static const Snapshot &get_snapshot(const ContainerNode *node)
+    {
+        return *static_cast<const Snapshot *>(node->data.doc);
+    }
+
+    static const SnapshotNode *get_snapshot_node(const ContainerNode *node)
+    {
+        return static_cast<const SnapshotNode *>(node->data.data1);
+    }
+
+    // Array nodes hold position of next unread item plus one, object nodes hold 0
+    static uint32_t get_array_position(const ContainerNode *node)
+    {
+        return static_cast<uint32_t>(reinterpret_cast<size_t>(node->data.data2));
+    }
+
+    static void select_next_array_item(const ContainerNode *node, uint32_t position)
+    {
+        const_cast<ContainerNode*>(node)->data.data2 = reinterpret_cast<void*>(static_cast<size_t>(position + 1));
+    }
+
+    static ContainerNode make_container(const ContainerNode *parent, const SnapshotNode *data, bool isArray)
+    {
+        ContainerNode childNode = {};
+        childNode.op = parent->op;
+        childNode.data.doc = parent->data.doc;
+        childNode.data.data1 = const_cast<SnapshotNode *>(data);
+        childNode.data.data2 = reinterpret_cast<void*>(isArray ? 1 : 0);
+        return childNode;
+    }
+
+    static string snapshot_string(const Snapshot &snapshot, uint32_t offset)
+    {
+        return string(snapshot.string(offset), snapshot.stringSize(offset));
+    }
+
+    static bool snapshotNode_hasUnread(const ContainerNode *node)
+    {
+        uint32_t position = get_array_position(node);
+        return position > 0 && position - 1 < get_snapshot_node(node)->childCount;
+    }
+
+    static void snapshotNode_writeNumber(ContainerNode*, const string &, float) throw(Error)
+    {
+        throw Error(1, "snapshot write error", "document is frozen or loaded from snapshot", "", 0);
+    }
+
+    static void snapshotNode_writeBool(ContainerNode*, const string &, bool) throw(Error)
+    {
+        throw Error(1, "snapshot write error", "document is frozen or loaded from snapshot", "", 0);
+    }
+
+    static void snapshotNode_writeString(ContainerNode*, const string &, const string &) throw(Error)
+    {
+        throw Error(1, "snapshot write error", "document is frozen or loaded from snapshot", "", 0);
+    }
+
+    static void snapshotNode_writeStringVector(ContainerNode*, const string &, const StringVector &) throw(Error)
+    {
+        throw Error(1, "snapshot write error", "document is frozen or loaded from snapshot", "", 0);
+    }
+
+    static ContainerNode snapshotNode_writeNewContainer(ContainerNode*, const string &) throw(Error)
+    {
+        throw Error(1, "snapshot write error", "document is frozen or loaded from snapshot", "", 0);
+    }
+
+    static ContainerNode snapshotNode_writeNewArray(ContainerNode*, const string &) throw(Error)
+    {
+        throw Error(1, "snapshot write error", "document is frozen or loaded from snapshot", "", 0);
+    }
+
+    /* Jsoncpp snapshot node operations, behave like jsoncppNode_* ones */
+
+    static const SnapshotNode *json_read_value(const ContainerNode *node, const string &name) throw(Error)
+    {
+        const Snapshot &snapshot = get_snapshot(node);
+        const SnapshotNode *data = get_snapshot_node(node);
+        uint32_t position = get_array_position(node);
+        if (position > 0)
+        {
+            if (position - 1 >= data->childCount)
+            {
+                throw Error(1, "read container error", "no more container items in array", "", position);
+            }
+            select_next_array_item(node, position);
+            return snapshot.child(data, position - 1);
+        }
+        const SnapshotNode *member = snapshot.findChild(data, name.c_str());
+        return member != NULL ? member : Snapshot::nullNode();
+    }
+
+    static string snapshotJsonNode_unreadName(const ContainerNode *) throw(Error)
+    {
+        // There is no name property for json values
+        return "";
+    }
+
+    static float snapshotJsonNode_readNumber(const ContainerNode *node, const string &name) throw(Error)
+    {
+        const SnapshotNode *value = json_read_value(node, name);
+        if (!(value->convertible & SNAPSHOT_AS_NUMBER))
+        {
+            throw Error(1, "read number error", "value is not convertible to number", name, 0);
+        }
+        return static_cast<float>(value->number);
+    }
+
+    static bool snapshotJsonNode_readBool(const ContainerNode *node, const string &name) throw(Error)
+    {
+        const SnapshotNode *value = json_read_value(node, name);
+        if (!(value->convertible & SNAPSHOT_AS_BOOL))
+        {
+            throw Error(1, "read bool error", "value is not convertible to bool", name, 0);
+        }
+        return value->boolean != 0;
+    }
+
+    static string snapshotJsonNode_readString(const ContainerNode *node, const string &name) throw(Error)
+    {
+        const SnapshotNode *value = json_read_value(node, name);
+        if (!(value->convertible & SNAPSHOT_AS_STRING))
+        {
+            throw Error(1, "read string error", "value is not convertible to string", name, 0);
+        }
+        return snapshot_string(get_snapshot(node), value->string);
+    }
+
+    static StringVector snapshotJsonNode_readStringVector(const ContainerNode *node, const string &name) throw(Error)
+    {
+        const Snapshot &snapshot = get_snapshot(node);
+        const SnapshotNode *value = json_read_value(node, name);
+        StringVector result;
+        if (value->type == SNAPSHOT_NULL)
+        {
+            return result;
+        }
+        if (value->type != SNAPSHOT_ARRAY)
+        {
+            throw Error(1, "read string vector error", "array expected", name, 0);
+        }
+        for (uint32_t i = 0; i < value->childCount; ++i)
+        {
+            const SnapshotNode *item = snapshot.child(value, i);
+            if (item->type != SNAPSHOT_STRING)
+            {
+                throw Error(1, "read string vector error", "string expected", name, i);
+            }
+            result.push_back(snapshot_string(snapshot, item->string));
+        }
+        return result;
+    }
+
+    static ContainerNode snapshotJsonNode_readContainer(const ContainerNode *node, const string &name) throw(Error)
+    {
+        return make_container(node, json_read_value(node, name), false);
+    }
+
+    static ContainerNode snapshotJsonNode_readArray(const ContainerNode *node, const string &name) throw(Error)
+    {
+        const SnapshotNode *value = json_read_value(node, name);
+        if (value->type != SNAPSHOT_ARRAY)
+        {
+            throw Error(1, "read array error", "array expected", name, 0);
+        }
+        return make_container(node, value, true);
+    }
+
+    static container_node_op snapshot_jsoncpp_op = {
+        &snapshotNode_hasUnread,
+        &snapshotJsonNode_unreadName,
+        &snapshotJsonNode_readNumber,
+        &snapshotJsonNode_readBool,
+        &snapshotJsonNode_readString,
+        &snapshotJsonNode_readStringVector,
+        &snapshotJsonNode_readContainer,
+        &snapshotJsonNode_readArray,
+        &snapshotNode_writeNumber,
+        &snapshotNode_writeBool,
+        &snapshotNode_writeString,
+        &snapshotNode_writeStringVector,
+        &snapshotNode_writeNewContainer,
+        &snapshotNode_writeNewArray
+    };
+
+    /* Pugixml snapshot node operations, behave like pugixmlNode_* ones */
+
+    // Next item of array node, NULL for object node and read array node,
+    // which are read by name like pugixml nodes with no array iterator
+    static const SnapshotNode *xml_read_array_item(const ContainerNode *node)
+    {
+        if (!snapshotNode_hasUnread(node))
+        {
+            return NULL;
+        }
+        const SnapshotNode *data = get_snapshot_node(node);
+        uint32_t position = get_array_position(node);
+        select_next_array_item(node, position);
+        return get_snapshot(node).child(data, position - 1);
+    }
+
+    // Attribute value for object node, text of current item for array node
+    static const SnapshotNode *xml_read_value(const ContainerNode *node, const string &name)
+    {
+        const SnapshotNode *item = xml_read_array_item(node);
+        if (item != NULL)
+        {
+            return item;
+        }
+        const SnapshotNode *attribute = get_snapshot(node).findAttribute(get_snapshot_node(node), name.c_str());
+        return attribute != NULL ? attribute : Snapshot::nullNode();
+    }
+
+    // Child element for object node, current item for array node
+    static const SnapshotNode *xml_read_element(const ContainerNode *node, const string &name)
+    {
+        const SnapshotNode *item = xml_read_array_item(node);
+        if (item != NULL)
+        {
+            return item;
+        }
+        const SnapshotNode *child = get_snapshot(node).findChild(get_snapshot_node(node), name.c_str());
+        return child != NULL ? child : Snapshot::nullNode();
+    }
+
+    static string snapshotXmlNode_unreadName(const ContainerNode *node) throw(Error)
+    {
+        const Snapshot &snapshot = get_snapshot(node);
+        const SnapshotNode *data = get_snapshot_node(node);
+        if (snapshotNode_hasUnread(node))
+        {
+            return snapshot_string(snapshot, snapshot.child(data, get_array_position(node) - 1)->name);
+        }
+        return snapshot_string(snapshot, data->name);
+    }
+
+    static float snapshotXmlNode_readNumber(const ContainerNode *node, const string &name) throw(Error)
+    {
+        return static_cast<float>(xml_read_value(node, name)->number);
+    }
+
+    static bool snapshotXmlNode_readBool(const ContainerNode *node, const string &name) throw(Error)
+    {
+        return xml_read_value(node, name)->boolean != 0;
+    }
+
+    static string snapshotXmlNode_readString(const ContainerNode *node, const string &name) throw(Error)
+    {
+        return snapshot_string(get_snapshot(node), xml_read_value(node, name)->string);
+    }
+
+    static StringVector snapshotXmlNode_readStringVector(const ContainerNode *node, const string &name) throw(Error)
+    {
+        const Snapshot &snapshot = get_snapshot(node);
+        const SnapshotNode *element = xml_read_element(node, name);
+        StringVector result;
+        for (uint32_t i = 0; i < element->childCount; ++i)
+        {
+            result.push_back(snapshot_string(snapshot, snapshot.child(element, i)->string));
+        }
+        return result;
+    }
+
+    static ContainerNode snapshotXmlNode_readContainer(const ContainerNode *node, const string &name) throw(Error)
+    {
+        return make_container(node, xml_read_element(node, name), false);
+    }
+
+    static ContainerNode snapshotXmlNode_readArray(const ContainerNode *node, const string &name) throw(Error)
+    {
+        return make_container(node, xml_read_element(node, name), true);
+    }
+
+    static container_node_op snapshot_pugixml_op = {
+        &snapshotNode_hasUnread,
+        &snapshotXmlNode_unreadName,
+        &snapshotXmlNode_readNumber,
+        &snapshotXmlNode_readBool,
+        &snapshotXmlNode_readString,
+        &snapshotXmlNode_readStringVector,
+        &snapshotXmlNode_readContainer,
+        &snapshotXmlNode_readArray,
+        &snapshotNode_writeNumber,
+        &snapshotNode_writeBool,
+        &snapshotNode_writeString,
+        &snapshotNode_writeStringVector,
+        &snapshotNode_writeNewContainer,
+        &snapshotNode_writeNewArray
+    };
+
+    container_node_op *snapshotJsoncppOperations()
+    {
+        return &snapshot_jsoncpp_op;
+    }
+
+    container_node_op *snapshotPugixmlOperations()
+    {
+        return &snapshot_pugixml_op;
+    }
+
+    ContainerNode snapshotRootContainer(const Snapshot &snapshot)
+    {
+        ContainerNode rootNode = {};
+        rootNode.op = snapshot.header().backend == SNAPSHOT_JSONCPP ? &snapshot_jsoncpp_op : &snapshot_pugixml_op;
+        rootNode.data.doc = const_cast<Snapshot *>(&snapshot);
+        rootNode.data.data1 = const_cast<SnapshotNode *>(snapshot.root());
+        rootNode.data.data2 = NULL;
+        return rootNode;
+    }
+
+    const SnapshotNode *snapshotReadValue(const ContainerNode &node, const string &name) throw(Error)
+    {
+        if (node.op == &snapshot_jsoncpp_op)
+        {
+            return json_read_value(&node, name);
+        }
+        return xml_read_value(&node, name);
+    }
+
+    const SnapshotNode *snapshotReadElement(const ContainerNode &node, const string &name) throw(Error)
+    {
+        if (node.op == &snapshot_jsoncpp_op)
+        {
+            return json_read_value(&node, name);
+        }
+        return xml_read_element(&node, name);
+    }
+
+    void snapshotArrayElements(const ContainerNode &array, std::vector<ContainerNode> &elements)
+    {
+        uint32_t count = get_snapshot_node(&array)->childCount;
+        elements.assign(count, array);
+        for (uint32_t position = 0; position < count; ++position)
+        {
+            select_next_array_item(&elements[position], position);
+        }
+    }
+
+}
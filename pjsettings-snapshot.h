@@ -0,0 +1,233 @@
+/*
+ * Binary snapshot of loaded pjsettings documents
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PJSETTINGS_SNAPSHOT_H__
+#define __PJSETTINGS_SNAPSHOT_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#ifndef PJSETTINGS_NOT_USE_PJSUA
+#include <pjsua2/persistent.hpp>
+#endif
+
+#include "pjsettings-mapped-file.h"
+
+namespace pjsettings
+{
+    /*
+     * Snapshot is flat position-independent image of document tree:
+     *
+     *   SnapshotHeader | nodes | sorted child index | string pool
+     *
+     * Children (and xml attributes) of a node are stored contiguously
+     * in document order. Sorted child index holds indices of the same
+     * children ordered by name, so named lookups use binary search.
+     * All references are indices or offsets, image can be mapped
+     * at any address and read with no parsing.
+     */
+
+    enum SnapshotBackend
+    {
+        SNAPSHOT_JSONCPP = 1,
+        SNAPSHOT_PUGIXML = 2
+    };
+
+    enum SnapshotNodeType
+    {
+        SNAPSHOT_NULL = 0,
+        SNAPSHOT_BOOL,
+        SNAPSHOT_INT,
+        SNAPSHOT_UINT,
+        SNAPSHOT_REAL,
+        SNAPSHOT_STRING,
+        SNAPSHOT_ARRAY,
+        SNAPSHOT_OBJECT
+    };
+
+    // Which of number, boolean and string fields hold value of the node
+    enum SnapshotConvertible
+    {
+        SNAPSHOT_AS_NUMBER = 1,
+        SNAPSHOT_AS_BOOL = 2,
+        SNAPSHOT_AS_STRING = 4
+    };
+
+    struct SnapshotNode
+    {
+        double number;
+        int64_t integer;            // exact value of SNAPSHOT_INT and SNAPSHOT_UINT
+        uint32_t type;
+        uint32_t convertible;
+        uint32_t boolean;
+        uint32_t name;              // string pool offset
+        uint32_t string;            // string pool offset, xml element text
+        uint32_t firstChild;        // node index
+        uint32_t childCount;
+        uint32_t sortedChildren;    // sorted index offset
+        uint32_t firstAttribute;    // node index, xml only
+        uint32_t attributeCount;
+        uint32_t sortedAttributes;  // sorted index offset
+        uint32_t reserved;
+    };
+
+    struct SnapshotHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t headerSize;
+        uint32_t nodeSize;
+        uint32_t backend;
+        uint32_t sourcePath;        // string pool offset
+        uint64_t sourceSize;
+        int64_t sourceModified;
+        int64_t sourceChecked;
+        uint64_t sourceHash;
+        uint64_t imageSize;
+        uint32_t nodesOffset;
+        uint32_t nodeCount;
+        uint32_t sortedOffset;
+        uint32_t sortedCount;
+        uint32_t stringsOffset;
+        uint32_t stringsSize;
+    };
+
+    // Source file identity the snapshot was built from
+    struct SnapshotSource
+    {
+        SnapshotSource();
+
+        // Fills path, size and times, returns false if file is missing
+        bool stat(const std::string &filename);
+
+        std::string path;
+        uint64_t size;
+        int64_t modified;
+        int64_t checked;            // when file was stat'ed, modifications in that second are racy
+        uint64_t hash;
+    };
+
+    /**
+     * Builds snapshot image node by node.
+     *
+     * Nodes are addressed by index, because references to nodes
+     * are invalidated when new nodes are added.
+     */
+    class SnapshotBuilder
+    {
+    public:
+        SnapshotBuilder(SnapshotBackend backend);
+
+        uint32_t addNodes(size_t count) throw(pj::Error);
+        SnapshotNode &node(uint32_t index);
+        uint32_t addString(const char *value, size_t size) throw(pj::Error);
+        uint32_t addString(const char *value) throw(pj::Error);
+        uint32_t addString(const std::string &value) throw(pj::Error);
+
+        // Index of nodes [first, first + count) stable sorted by name
+        uint32_t addSortedIndex(uint32_t first, uint32_t count) throw(pj::Error);
+
+        void build(std::vector<char> &image, const SnapshotSource &source) throw(pj::Error);
+
+    private:
+        void growStringSlots();
+
+        SnapshotBackend _backend;
+        std::vector<SnapshotNode> _nodes;
+        std::vector<uint32_t> _sorted;
+        std::vector<char> _strings;
+        // Open addressing table of pooled strings: string offset plus one, 0 for empty slot
+        std::vector<uint32_t> _stringSlots;
+        size_t _stringCount;
+    };
+
+    /**
+     * Read-only view of snapshot image mapped from file or held in memory.
+     */
+    class Snapshot
+    {
+    public:
+        Snapshot();
+
+        // Maps snapshot file, returns false if it is missing, broken,
+        // built by other backend or stale for the source file.
+        // Image that is open stays open unless the new one replaces it.
+        bool openFile(const std::string &snapshotFilename, SnapshotBackend backend, const std::string &sourceFilename);
+        void assign(std::vector<char> &image) throw(pj::Error);
+        void close();
+        void swap(Snapshot &other);
+        bool isOpen() const;
+        // Image is mapped from file, not assigned from memory
+        bool isMapped() const;
+
+        const SnapshotHeader &header() const;
+        const SnapshotNode *root() const;
+        const SnapshotNode *child(const SnapshotNode *node, uint32_t index) const;
+        const SnapshotNode *attribute(const SnapshotNode *node, uint32_t index) const;
+        const char *string(uint32_t offset) const;
+        uint32_t stringSize(uint32_t offset) const;
+
+        // First child (attribute) with specified name, NULL if there is no such child
+        const SnapshotNode *findChild(const SnapshotNode *node, const char *name) const;
+        const SnapshotNode *findAttribute(const SnapshotNode *node, const char *name) const;
+
+        // Node with no value and no children, read instead of missing values
+        static const SnapshotNode *nullNode();
+
+    private:
+        Snapshot(const Snapshot &);
+        Snapshot &operator=(const Snapshot &);
+
+        bool validate(SnapshotBackend backend) const;
+        bool validString(uint32_t offset) const;
+        const SnapshotNode *findSorted(uint32_t sortedOffset, uint32_t count, const char *name) const;
+
+        MappedFile _file;
+        std::vector<char> _memory;
+        const char *_data;
+        size_t _size;
+    };
+
+    // Sidecar snapshot file name for source file
+    std::string snapshotFilename(const std::string &sourceFilename);
+
+    // Writes image to temporary file and renames it to snapshot file, returns false on failure
+    bool writeSnapshotFile(const std::string &snapshotFilename, const std::vector<char> &image);
+
+    // Node operations over snapshot of jsoncpp and pugixml documents, write operations throw pj::Error
+    pj::container_node_op *snapshotJsoncppOperations();
+    pj::container_node_op *snapshotPugixmlOperations();
+
+    pj::ContainerNode snapshotRootContainer(const Snapshot &snapshot);
+
+    // Value that readNumber of snapshot node reads: array item or named value, null node if it's missing
+    const SnapshotNode *snapshotReadValue(const pj::ContainerNode &node, const std::string &name) throw(pj::Error);
+
+    // Value that readStringVector of snapshot node reads: xml child element instead of attribute
+    const SnapshotNode *snapshotReadElement(const pj::ContainerNode &node, const std::string &name) throw(pj::Error);
+
+    // Nodes positioned at every item of array node, see ArrayElementsExtension
+    void snapshotArrayElements(const pj::ContainerNode &array, std::vector<pj::ContainerNode> &elements);
+}
+
+#endif
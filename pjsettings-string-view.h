@@ -0,0 +1,95 @@
+/*
+ * Non-owning string reads of PJSIP persistent document nodes
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PJSETTINGS_STRING_VIEW_H__
+#define __PJSETTINGS_STRING_VIEW_H__
+
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifndef PJSETTINGS_NOT_USE_PJSUA
+#include <pjsua2/persistent.hpp>
+#endif
+
+namespace pjsettings
+{
+    // Characters owned by document, followed by terminating zero
+    struct StringView
+    {
+        StringView() : data(""), size(0) {}
+        StringView(const char *data, size_t size) : data(data), size(size) {}
+
+        std::string str() const { return std::string(data, size); }
+        bool empty() const { return size == 0; }
+
+        const char *data;
+        size_t size;
+    };
+
+    inline bool operator==(const StringView &left, const StringView &right)
+    {
+        return left.size == right.size && memcmp(left.data, right.data, left.size) == 0;
+    }
+
+    inline bool operator!=(const StringView &left, const StringView &right)
+    {
+        return !(left == right);
+    }
+
+    inline bool operator==(const StringView &left, const char *right)
+    {
+        return strlen(right) == left.size && memcmp(left.data, right, left.size) == 0;
+    }
+
+    inline bool operator!=(const StringView &left, const char *right)
+    {
+        return !(left == right);
+    }
+
+    /**
+     * String values of document nodes without copying them.
+     *
+     * pj::ContainerNode returns strings and string vectors by value,
+     * so every read allocates. Documents implementing this interface
+     * return views of strings they hold. Views stay valid until the
+     * document is modified or loaded again.
+     *
+     * Nodes behave the same way as with pj::ContainerNode operations:
+     * missing values are read as empty, array nodes read next item and
+     * ignore the name. Values that are not strings throw pj::Error,
+     * and so do nodes of other documents.
+     */
+    class StringViewExtension
+    {
+    public:
+        virtual ~StringViewExtension() {}
+
+        virtual StringView readStringView(const pj::ContainerNode &node, const std::string &name) const throw(pj::Error) = 0;
+
+        // views are cleared and filled with items, capacity of views is reused by next reads
+        virtual void readStringVectorViews(const pj::ContainerNode &node, const std::string &name, std::vector<StringView> &views) const throw(pj::Error) = 0;
+    };
+
+}
+
+#endif
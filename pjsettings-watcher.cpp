@@ -0,0 +1,383 @@
+/*
+ * Hot reload of PJSIP persistent documents watched with inotify
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdexcept>
+#include "pjsettings-watcher.h"
+
+using namespace pj;
+using namespace std;
+
+namespace pjsettings
+{
+
+    /* Shared document handle */
+
+    SharedDocument::SharedDocument()
+        : _holder(NULL)
+    {
+    }
+
+    // Takes over the reference that holder was created with
+    SharedDocument::SharedDocument(Holder *holder)
+        : _holder(holder)
+    {
+    }
+
+    SharedDocument::SharedDocument(const SharedDocument &other)
+        : _holder(other._holder)
+    {
+        if (_holder != NULL)
+        {
+            __sync_add_and_fetch(&_holder->references, 1);
+        }
+    }
+
+    SharedDocument &SharedDocument::operator=(const SharedDocument &other)
+    {
+        if (other._holder != NULL)
+        {
+            __sync_add_and_fetch(&other._holder->references, 1);
+        }
+        release();
+        _holder = other._holder;
+        return *this;
+    }
+
+    SharedDocument::~SharedDocument()
+    {
+        release();
+    }
+
+    void SharedDocument::release()
+    {
+        if (_holder != NULL && __sync_sub_and_fetch(&_holder->references, 1) == 0)
+        {
+            delete _holder->document;
+            delete _holder;
+        }
+        _holder = NULL;
+    }
+
+    PersistentDocument *SharedDocument::get() const
+    {
+        return _holder != NULL ? _holder->document : NULL;
+    }
+
+    unsigned long SharedDocument::version() const
+    {
+        return _holder != NULL ? _holder->version : 0;
+    }
+
+    /* Watcher */
+
+    static const uint32_t watchedEvents = IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_MOVED_TO;
+
+    // Mutex is locked while in scope
+    class WatcherLock
+    {
+    public:
+        explicit WatcherLock(pthread_mutex_t &mutex) : _mutex(mutex) { pthread_mutex_lock(&_mutex); }
+        ~WatcherLock() { pthread_mutex_unlock(&_mutex); }
+    private:
+        WatcherLock(const WatcherLock &);
+        WatcherLock &operator=(const WatcherLock &);
+        pthread_mutex_t &_mutex;
+    };
+
+    DocumentWatcher::DocumentWatcher(const std::string &filename, DocumentLoader &loader)
+        : _filename(filename)
+        , _directory()
+        , _name()
+        , _loader(loader)
+        , _inotify(-1)
+        , _thread()
+        , _running(false)
+        , _current(NULL)
+        , _version(0)
+        , _attempts(0)
+        , _failures(0)
+        , _lastError()
+    {
+        _stopPipe[0] = _stopPipe[1] = -1;
+        size_t slash = filename.rfind('/');
+        if (slash == string::npos)
+        {
+            _directory = ".";
+            _name = filename;
+        }
+        else
+        {
+            _directory = slash == 0 ? "/" : filename.substr(0, slash);
+            _name = filename.substr(slash + 1);
+        }
+        pthread_mutex_init(&_lock, NULL);
+        pthread_cond_init(&_reloaded, NULL);
+    }
+
+    DocumentWatcher::~DocumentWatcher()
+    {
+        stop();
+        SharedDocument last(_current);
+        _current = NULL;
+        pthread_cond_destroy(&_reloaded);
+        pthread_mutex_destroy(&_lock);
+    }
+
+    static void close_descriptor(int &descriptor)
+    {
+        if (descriptor >= 0)
+        {
+            close(descriptor);
+            descriptor = -1;
+        }
+    }
+
+    void DocumentWatcher::start() throw(Error)
+    {
+        if (_running)
+        {
+            return;
+        }
+
+        // file is watched before it is loaded, so changes made while
+        // it is loaded are not missed
+        _inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (_inotify < 0 || inotify_add_watch(_inotify, _directory.c_str(), watchedEvents) < 0
+            || pipe2(_stopPipe, O_CLOEXEC) != 0)
+        {
+            string reason = strerror(errno);
+            close_descriptor(_inotify);
+            throw Error(1, "watcher start error", reason, _directory, 0);
+        }
+
+        try
+        {
+            publish(_loader.load(_filename), false);
+        }
+        catch (...)
+        {
+            close_descriptor(_inotify);
+            close_descriptor(_stopPipe[0]);
+            close_descriptor(_stopPipe[1]);
+            throw;
+        }
+
+        int error = pthread_create(&_thread, NULL, &DocumentWatcher::threadMain, this);
+        if (error != 0)
+        {
+            close_descriptor(_inotify);
+            close_descriptor(_stopPipe[0]);
+            close_descriptor(_stopPipe[1]);
+            throw Error(1, "watcher start error", strerror(error), _filename, 0);
+        }
+        _running = true;
+    }
+
+    void DocumentWatcher::stop()
+    {
+        if (!_running)
+        {
+            return;
+        }
+        char stop = 0;
+        while (write(_stopPipe[1], &stop, 1) < 0 && errno == EINTR)
+        {
+        }
+        pthread_join(_thread, NULL);
+        close_descriptor(_inotify);
+        close_descriptor(_stopPipe[0]);
+        close_descriptor(_stopPipe[1]);
+        _running = false;
+    }
+
+    SharedDocument DocumentWatcher::document() const
+    {
+        // lock covers handle copy only, loading never holds it
+        WatcherLock lock(_lock);
+        if (_current != NULL)
+        {
+            __sync_add_and_fetch(&_current->references, 1);
+        }
+        return SharedDocument(_current);
+    }
+
+    unsigned long DocumentWatcher::reloadAttempts() const
+    {
+        WatcherLock lock(_lock);
+        return _attempts;
+    }
+
+    unsigned long DocumentWatcher::reloadFailures() const
+    {
+        WatcherLock lock(_lock);
+        return _failures;
+    }
+
+    std::string DocumentWatcher::lastError() const
+    {
+        WatcherLock lock(_lock);
+        return _lastError;
+    }
+
+    bool DocumentWatcher::waitReloadAttempts(unsigned long count, unsigned timeoutMs) const
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeoutMs / 1000;
+        deadline.tv_nsec += (timeoutMs % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            ++deadline.tv_sec;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        WatcherLock lock(_lock);
+        while (_attempts < count)
+        {
+            if (pthread_cond_timedwait(&_reloaded, &_lock, &deadline) == ETIMEDOUT)
+            {
+                return _attempts >= count;
+            }
+        }
+        return true;
+    }
+
+    void *DocumentWatcher::threadMain(void *watcher)
+    {
+        static_cast<DocumentWatcher *>(watcher)->run();
+        return NULL;
+    }
+
+    void DocumentWatcher::run()
+    {
+        struct pollfd descriptors[2];
+        descriptors[0].fd = _inotify;
+        descriptors[0].events = POLLIN;
+        descriptors[1].fd = _stopPipe[0];
+        descriptors[1].events = POLLIN;
+
+        // events are aligned as inotify_event, names follow them
+        union
+        {
+            struct inotify_event event;
+            char data[4096];
+        } buffer;
+
+        bool changed = false;
+        for (;;)
+        {
+            int ready = poll(descriptors, 2, changed ? static_cast<int>(settleTimeMs) : -1);
+            if (ready < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                break;
+            }
+            if (descriptors[1].revents != 0)
+            {
+                break;
+            }
+            if (ready == 0)
+            {
+                changed = false;
+                reload();
+                continue;
+            }
+
+            ssize_t size;
+            while ((size = read(_inotify, buffer.data, sizeof(buffer.data))) > 0)
+            {
+                for (const char *current = buffer.data; current < buffer.data + size; )
+                {
+                    const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(current);
+                    if ((event->mask & IN_Q_OVERFLOW) != 0 || (event->len > 0 && _name == event->name))
+                    {
+                        changed = true;
+                    }
+                    current += sizeof(struct inotify_event) + event->len;
+                }
+            }
+        }
+    }
+
+    void DocumentWatcher::reload()
+    {
+        string error;
+        try
+        {
+            publish(_loader.load(_filename), true);
+            return;
+        }
+        catch (Error &err)
+        {
+            error = err.info();
+        }
+        catch (std::exception &ex)
+        {
+            error = ex.what();
+        }
+
+        WatcherLock lock(_lock);
+        ++_attempts;
+        ++_failures;
+        _lastError = error;
+        pthread_cond_broadcast(&_reloaded);
+    }
+
+    void DocumentWatcher::publish(PersistentDocument *document, bool reloaded)
+    {
+        SharedDocument::Holder *holder;
+        try
+        {
+            holder = new SharedDocument::Holder();
+        }
+        catch (...)
+        {
+            delete document;
+            throw;
+        }
+        holder->document = document;
+        holder->references = 1;
+
+        SharedDocument previous;
+        {
+            WatcherLock lock(_lock);
+            holder->version = ++_version;
+            previous = SharedDocument(_current);
+            _current = holder;
+            if (reloaded)
+            {
+                ++_attempts;
+                pthread_cond_broadcast(&_reloaded);
+            }
+        }
+        // previous document is destroyed here unless readers still hold it
+    }
+
+}
@@ -0,0 +1,172 @@
+/*
+ * Hot reload of PJSIP persistent documents watched with inotify
+ * -----------------------------------------------------------------
+ *
+ * Copyright (C) 2014, by Aleksei Kharlov (akharlov@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __PJSETTINGS_WATCHER_H__
+#define __PJSETTINGS_WATCHER_H__
+
+#include <pthread.h>
+#include <string>
+
+#ifndef PJSETTINGS_NOT_USE_PJSUA
+#include <pjsua2/persistent.hpp>
+#endif
+
+namespace pjsettings
+{
+    /**
+     * Reference counted handle of document published by DocumentWatcher.
+     *
+     * Document lives while any handle refers to it, so readers keep
+     * reading the tree they started with while newer one is published.
+     * Handles can be copied and destroyed by any thread.
+     */
+    class SharedDocument
+    {
+    public:
+        SharedDocument();
+        SharedDocument(const SharedDocument &other);
+        SharedDocument &operator=(const SharedDocument &other);
+        ~SharedDocument();
+
+        pj::PersistentDocument *get() const;
+        pj::PersistentDocument *operator->() const { return get(); }
+        pj::PersistentDocument &operator*() const { return *get(); }
+
+        // 1 for the document loaded by start(), incremented by every reload
+        unsigned long version() const;
+
+    private:
+        friend class DocumentWatcher;
+
+        struct Holder
+        {
+            pj::PersistentDocument *document;
+            unsigned long version;
+            long references;
+        };
+
+        explicit SharedDocument(Holder *holder);
+        void release();
+
+        Holder *_holder;
+    };
+
+    // Creates document of watched file and loads it, called on watcher thread for reloads.
+    // Published document is read by many threads at once, so loader returns it
+    // safe for concurrent reads (see setConcurrentReadEnabled of the documents).
+    class DocumentLoader
+    {
+    public:
+        virtual ~DocumentLoader() {}
+        virtual pj::PersistentDocument *load(const std::string &filename) throw(pj::Error) = 0;
+    };
+
+    // Loads JsonCppDocument or PugixmlDocument and enables concurrent reads of it:
+    // all readers of published document share its root node
+    template <class Document>
+    class FileDocumentLoader : public DocumentLoader
+    {
+    public:
+        virtual pj::PersistentDocument *load(const std::string &filename) throw(pj::Error)
+        {
+            Document *document = new Document();
+            try
+            {
+                document->loadFile(filename);
+                document->setConcurrentReadEnabled(true);
+            }
+            catch (...)
+            {
+                delete document;
+                throw;
+            }
+            return document;
+        }
+    };
+
+    /**
+     * Watches file with inotify and reloads it on background thread.
+     *
+     * Every reload parses the file into fresh document, which is then
+     * published instead of the previous one. Published documents are
+     * never changed, so document() never returns half-loaded tree and
+     * never waits for parsing: it only copies handle of current document.
+     * If reload fails, the previous document stays published and the
+     * error is kept in lastError().
+     *
+     * Directory of the file is watched, so files replaced by rename
+     * (as editors and deployment tools save them) are reloaded too.
+     * Bursts of events are merged: reload starts when the file is quiet
+     * for settle time.
+     */
+    class DocumentWatcher
+    {
+    public:
+        static const unsigned settleTimeMs = 50;
+
+        // loader must outlive the watcher
+        DocumentWatcher(const std::string &filename, DocumentLoader &loader);
+        ~DocumentWatcher();
+
+        // Loads the file on calling thread, then starts watching it
+        void start() throw(pj::Error);
+        void stop();
+
+        SharedDocument document() const;
+
+        // Reloads finished by watcher thread, successful or not
+        unsigned long reloadAttempts() const;
+        unsigned long reloadFailures() const;
+        std::string lastError() const;
+
+        // Waits until reloadAttempts() reaches count, false on timeout
+        bool waitReloadAttempts(unsigned long count, unsigned timeoutMs) const;
+
+    private:
+        DocumentWatcher(const DocumentWatcher &);
+        DocumentWatcher &operator=(const DocumentWatcher &);
+
+        static void *threadMain(void *watcher);
+        void run();
+        void reload();
+        void publish(pj::PersistentDocument *document, bool reloaded);
+
+        std::string _filename;
+        std::string _directory;
+        std::string _name;
+        DocumentLoader &_loader;
+
+        int _inotify;
+        int _stopPipe[2];
+        pthread_t _thread;
+        bool _running;
+
+        mutable pthread_mutex_t _lock;   // guards fields below
+        mutable pthread_cond_t _reloaded;
+        SharedDocument::Holder *_current;
+        unsigned long _version;
+        unsigned long _attempts;
+        unsigned long _failures;
+        std::string _lastError;
+    };
+}
+
+#endif
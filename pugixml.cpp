@@ -277,6 +277,7 @@ PUGI__NS_BEGIN
 
 			result->allocator = 0;
 			result->memory = 0;
+			result->size = 0;
 			result->prev = 0;
 			result->next = 0;
 			result->busy_size = 0;
@@ -288,6 +289,7 @@ PUGI__NS_BEGIN
 		xml_allocator* allocator;
 
 		void* memory;
+		size_t size; // size of memory, for page pool
 
 		xml_memory_page* prev;
 		xml_memory_page* next;
@@ -306,7 +308,7 @@ PUGI__NS_BEGIN
 
 	struct xml_allocator
 	{
-		xml_allocator(xml_memory_page* root): _root(root), _busy_size(root->busy_size)
+		xml_allocator(xml_memory_page* root, xml_page_pool* pool, size_t page_size): _root(root), _busy_size(root->busy_size), _pool(pool), _page_size(page_size)
 		{
 		}
 
@@ -315,7 +317,8 @@ PUGI__NS_BEGIN
 			size_t size = offsetof(xml_memory_page, data) + data_size;
 
 			// allocate block with some alignment, leaving memory for worst-case padding
-			void* memory = xml_memory::allocate(size + xml_memory_page_alignment);
+			size_t memory_size = size + xml_memory_page_alignment;
+			void* memory = _pool ? _pool->allocate_page(memory_size, data_size == _page_size) : xml_memory::allocate(memory_size);
 			if (!memory) return 0;
 
 			// align upwards to page boundary
@@ -326,6 +329,7 @@ PUGI__NS_BEGIN
 			assert(page);
 
 			page->memory = memory;
+			page->size = memory_size;
 			page->allocator = _root->allocator;
 
 			return page;
@@ -333,14 +337,17 @@ PUGI__NS_BEGIN
 
 		static void deallocate_page(xml_memory_page* page)
 		{
-			xml_memory::deallocate(page->memory);
+			xml_page_pool* pool = page->allocator->_pool;
+
+			if (pool) pool->deallocate_page(page->memory, page->size);
+			else xml_memory::deallocate(page->memory);
 		}
 
 		void* allocate_memory_oob(size_t size, xml_memory_page*& out_page);
 
 		void* allocate_memory(size_t size, xml_memory_page*& out_page)
 		{
-			if (_busy_size + size > xml_memory_page_size) return allocate_memory_oob(size, out_page);
+			if (_busy_size + size > _page_size) return allocate_memory_oob(size, out_page);
 
 			void* buf = _root->data + _busy_size;
 
@@ -434,13 +441,17 @@ PUGI__NS_BEGIN
 
 		xml_memory_page* _root;
 		size_t _busy_size;
+
+		// pjsettings: page pool of document, if any, and data size of its regular pages
+		xml_page_pool* _pool;
+		size_t _page_size;
 	};
 
 	PUGI__FN_NO_INLINE void* xml_allocator::allocate_memory_oob(size_t size, xml_memory_page*& out_page)
 	{
-		const size_t large_allocation_threshold = xml_memory_page_size / 4;
+		const size_t large_allocation_threshold = _page_size / 4;
 
-		xml_memory_page* page = allocate_page(size <= large_allocation_threshold ? xml_memory_page_size : size);
+		xml_memory_page* page = allocate_page(size <= large_allocation_threshold ? _page_size : size);
 		out_page = page;
 
 		if (!page) return 0;
@@ -529,7 +540,7 @@ PUGI__NS_BEGIN
 
 	struct xml_document_struct: public xml_node_struct, public xml_allocator
 	{
-		xml_document_struct(xml_memory_page* page): xml_node_struct(page, node_document), xml_allocator(page), buffer(0), extra_buffers(0)
+		xml_document_struct(xml_memory_page* page, xml_page_pool* pool, size_t page_size): xml_node_struct(page, node_document), xml_allocator(page, pool, page_size), buffer(0), extra_buffers(0)
 		{
 		}
 
@@ -5566,7 +5577,11 @@ namespace pugi
 		}
 	}
 
-	PUGI__FN xml_document::xml_document(): _buffer(0)
+	PUGI__FN xml_page_pool::~xml_page_pool()
+	{
+	}
+
+	PUGI__FN xml_document::xml_document(): _buffer(0), _page_pool(0)
 	{
 		create();
 	}
@@ -5590,6 +5605,18 @@ namespace pugi
 			append_copy(cur);
 	}
 
+	PUGI__FN void xml_document::set_page_pool(xml_page_pool* pool)
+	{
+		// pages of the current tree go back where they came from, see deallocate_page
+		_page_pool = pool;
+		reset();
+	}
+
+	PUGI__FN xml_page_pool* xml_document::page_pool() const
+	{
+		return _page_pool;
+	}
+
 	PUGI__FN void xml_document::create()
 	{
         assert(!_root);
@@ -5604,10 +5631,11 @@ namespace pugi
 		impl::xml_memory_page* page = impl::xml_memory_page::construct(page_memory);
 		assert(page);
 
-		page->busy_size = impl::xml_memory_page_size;
+		size_t page_size = _page_pool ? _page_pool->page_size() : impl::xml_memory_page_size;
+		page->busy_size = page_size;
 
 		// allocate new root
-		_root = new (page->data) impl::xml_document_struct(page);
+		_root = new (page->data) impl::xml_document_struct(page, _page_pool, page_size);
 		_root->prev_sibling_c = _root;
 
 		// setup sentinel page
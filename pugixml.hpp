@@ -922,13 +922,29 @@ namespace pugi
 		const char* description() const;
 	};
 
+	// pjsettings: source of memory pages of one document, see xml_document::set_page_pool
+	class PUGIXML_CLASS xml_page_pool
+	{
+	public:
+		virtual ~xml_page_pool();
+
+		// Data size of regular pages (1024 to 65536 bytes), allocations larger than a quarter of it get pages of their own
+		virtual size_t page_size() const = 0;
+
+		// Memory of page including page header; regular pages are always requested with the same size.
+		// Returns NULL on failure, memory is released with the size it was allocated with.
+		virtual void* allocate_page(size_t size, bool regular) = 0;
+		virtual void deallocate_page(void* memory, size_t size) = 0;
+	};
+
 	// Document class (DOM tree root)
 	class PUGIXML_CLASS xml_document: public xml_node
 	{
 	private:
 		char_t* _buffer;
+		xml_page_pool* _page_pool;
 
-		char _memory[192];
+		char _memory[224];
 		
 		// Non-copyable semantics
 		xml_document(const xml_document&);
@@ -950,6 +966,11 @@ namespace pugi
 		// Removes all nodes, then copies the entire contents of the specified document
 		void reset(const xml_document& proto);
 
+		// pjsettings: pages of the tree are allocated from pool instead of memory management functions,
+		// pool must outlive the document. Removes all nodes, page size of pool is read on every reset.
+		void set_page_pool(xml_page_pool* pool);
+		xml_page_pool* page_pool() const;
+
 	#ifndef PUGIXML_NO_STL
 		// Load document from stream.
 		xml_parse_result load(std::basic_istream<char, std::char_traits<char> >& stream, unsigned int options = parse_default, xml_encoding encoding = encoding_auto);
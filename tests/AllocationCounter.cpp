@@ -0,0 +1,31 @@
+#include <new>
+#include <stdlib.h>
+#include "AllocationCounter.h"
+
+static size_t allocations = 0;
+
+size_t allocation_count()
+{
+    return allocations;
+}
+
+void *operator new(size_t size)
+{
+    // counted by threads of concurrent read tests too
+#if defined(__GNUC__)
+    __sync_fetch_and_add(&allocations, 1);
+#else
+    ++allocations;
+#endif
+    void *result = malloc(size == 0 ? 1 : size);
+    if (result == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return result;
+}
+
+void operator delete(void *ptr) throw()
+{
+    free(ptr);
+}
@@ -0,0 +1,9 @@
+#ifndef __ALLOCATION_COUNTER_FOR_TESTS_H__
+#define __ALLOCATION_COUNTER_FOR_TESTS_H__
+
+#include <stddef.h>
+
+// Number of global operator new calls since test program start
+size_t allocation_count();
+
+#endif
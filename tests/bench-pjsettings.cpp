@@ -0,0 +1,1149 @@
+/*
+ * Benchmarks for pjsettings document backends
+ *
+ * Every benchmark case runs in a separate child process,
+ * so peak resident set size is reported for that case only.
+ * Time and allocations are reported for measured part of the case only.
+ *
+ * Inputs are synthetic account lists generated with fixed seed,
+ * so every run on every platform measures the same documents.
+ * Results are printed as one JSON object per line.
+ *
+ * Number parsing cases run on 1 thread and on every online processor,
+ * every thread parses the same generated numbers, so throughput grows
+ * with threads count unless the parser serializes threads.
+ *
+ * usage: bench-pjsettings [accounts count...], 10 1000 100000 by default
+ */
+#include <pjsettings-jsoncpp.h>
+#include <pjsettings-json-stream.h>
+#include <pjsettings-number.h>
+#include <pjsettings-pugixml.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "AllocationCounter.h"
+
+using namespace pj;
+using namespace pjsettings;
+
+static const char *fieldsJsonFile = "bench-fields.json";
+static const char *fieldsXmlFile = "bench-fields.xml";
+static const char *parallelJsonFile = "bench-parallel.json";
+static const char *parallelXmlFile = "bench-parallel.xml";
+
+static const unsigned fieldsElementsCount = 2000;
+static const unsigned fieldsPerElement = 60;
+static const unsigned readPasses = 5;
+static const unsigned parallelAccountsCount = 20000;
+static unsigned threadsCount = 1;       // of number parsing and parallel read cases
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Synthetic accounts, the same shape as pj::AccountConfig persistence */
+
+class BenchAuthCred : public PersistentObject
+{
+public:
+    virtual void readObject(const ContainerNode &node) throw(Error)
+    {
+        ContainerNode this_node = node.readContainer("AuthCredInfo");
+        NODE_READ_STRING(this_node, scheme);
+        NODE_READ_STRING(this_node, realm);
+        NODE_READ_STRING(this_node, username);
+        NODE_READ_INT(this_node, dataType);
+        NODE_READ_STRING(this_node, data);
+    }
+
+    virtual void writeObject(ContainerNode &node) const throw(Error)
+    {
+        ContainerNode this_node = node.writeNewContainer("AuthCredInfo");
+        NODE_WRITE_STRING(this_node, scheme);
+        NODE_WRITE_STRING(this_node, realm);
+        NODE_WRITE_STRING(this_node, username);
+        NODE_WRITE_INT(this_node, dataType);
+        NODE_WRITE_STRING(this_node, data);
+    }
+
+    std::string scheme;
+    std::string realm;
+    std::string username;
+    int dataType;
+    std::string data;
+};
+
+class BenchAccount : public PersistentObject
+{
+public:
+    virtual void readObject(const ContainerNode &node) throw(Error)
+    {
+        ContainerNode this_node = node.readContainer("AccountConfig");
+        NODE_READ_INT(this_node, priority);
+        NODE_READ_STRING(this_node, idUri);
+
+        ContainerNode reg_node = this_node.readContainer("regConfig");
+        NODE_READ_STRING(reg_node, registrarUri);
+        NODE_READ_BOOL(reg_node, registerOnAdd);
+        NODE_READ_UNSIGNED(reg_node, timeoutSec);
+        NODE_READ_UNSIGNED(reg_node, retryIntervalSec);
+        NODE_READ_UNSIGNED(reg_node, delayBeforeRefreshSec);
+
+        ContainerNode sip_node = this_node.readContainer("sipConfig");
+        NODE_READ_STRINGV(sip_node, proxies);
+        NODE_READ_STRING(sip_node, contactForced);
+        ContainerNode creds_node = sip_node.readArray("authCreds");
+        authCreds.clear();
+        while (creds_node.hasUnread())
+        {
+            BenchAuthCred cred;
+            cred.readObject(creds_node);
+            authCreds.push_back(cred);
+        }
+    }
+
+    virtual void writeObject(ContainerNode &node) const throw(Error)
+    {
+        ContainerNode this_node = node.writeNewContainer("AccountConfig");
+        NODE_WRITE_INT(this_node, priority);
+        NODE_WRITE_STRING(this_node, idUri);
+
+        ContainerNode reg_node = this_node.writeNewContainer("regConfig");
+        NODE_WRITE_STRING(reg_node, registrarUri);
+        NODE_WRITE_BOOL(reg_node, registerOnAdd);
+        NODE_WRITE_UNSIGNED(reg_node, timeoutSec);
+        NODE_WRITE_UNSIGNED(reg_node, retryIntervalSec);
+        NODE_WRITE_UNSIGNED(reg_node, delayBeforeRefreshSec);
+
+        ContainerNode sip_node = this_node.writeNewContainer("sipConfig");
+        NODE_WRITE_STRINGV(sip_node, proxies);
+        NODE_WRITE_STRING(sip_node, contactForced);
+        ContainerNode creds_node = sip_node.writeNewArray("authCreds");
+        for (size_t i = 0; i < authCreds.size(); ++i)
+        {
+            authCreds[i].writeObject(creds_node);
+        }
+    }
+
+    int priority;
+    std::string idUri;
+    std::string registrarUri;
+    bool registerOnAdd;
+    unsigned timeoutSec;
+    unsigned retryIntervalSec;
+    unsigned delayBeforeRefreshSec;
+    StringVector proxies;
+    std::string contactForced;
+    std::vector<BenchAuthCred> authCreds;
+};
+
+class BenchAccounts : public PersistentObject
+{
+public:
+    virtual void readObject(const ContainerNode &node) throw(Error)
+    {
+        ContainerNode array_node = node.readArray("accounts");
+        accounts.clear();
+        while (array_node.hasUnread())
+        {
+            BenchAccount account;
+            account.readObject(array_node);
+            accounts.push_back(account);
+        }
+    }
+
+    virtual void writeObject(ContainerNode &node) const throw(Error)
+    {
+        ContainerNode array_node = node.writeNewArray("accounts");
+        for (size_t i = 0; i < accounts.size(); ++i)
+        {
+            accounts[i].writeObject(array_node);
+        }
+    }
+
+    std::vector<BenchAccount> accounts;
+};
+
+// Fixed seed LCG, same sequence on every platform
+class BenchRandom
+{
+public:
+    BenchRandom(unsigned seed) : _seed(seed) {}
+
+    unsigned next(unsigned range)
+    {
+        _seed = _seed * 1103515245u + 12345u;
+        return (_seed >> 16) % range;
+    }
+
+private:
+    unsigned _seed;
+};
+
+static std::string numbered(const char *prefix, unsigned number, const char *suffix = "")
+{
+    std::ostringstream result;
+    result << prefix << number << suffix;
+    return result.str();
+}
+
+static BenchAccounts generate_accounts(unsigned count)
+{
+    BenchRandom random(12345);
+    BenchAccounts result;
+    result.accounts.resize(count);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        BenchAccount &account = result.accounts[i];
+        unsigned domain = random.next(100);
+        account.priority = static_cast<int>(random.next(10));
+        account.idUri = numbered("sip:user", i, numbered("@domain", domain, ".example.com").c_str());
+        account.registrarUri = numbered("sip:domain", domain, ".example.com");
+        account.registerOnAdd = random.next(2) == 0;
+        account.timeoutSec = 60 + random.next(3600);
+        account.retryIntervalSec = random.next(600);
+        account.delayBeforeRefreshSec = 5;
+        unsigned proxies = random.next(3);
+        for (unsigned j = 0; j < proxies; ++j)
+        {
+            account.proxies.push_back(numbered("sip:proxy", j, numbered(".domain", domain, ".example.com;lr").c_str()));
+        }
+        account.contactForced = random.next(4) == 0 ? numbered("sip:user", i, "@10.0.0.1:5060") : "";
+        BenchAuthCred cred;
+        cred.scheme = "digest";
+        cred.realm = "*";
+        cred.username = numbered("user", i);
+        cred.dataType = 0;
+        cred.data = numbered("secret", random.next(1000000));
+        account.authCreds.push_back(cred);
+    }
+    return result;
+}
+
+static std::string accounts_file(unsigned count, const char *extension)
+{
+    return numbered("bench-accounts-", count, extension);
+}
+
+static std::string read_file(const std::string &filename)
+{
+    std::ifstream input(filename.c_str(), std::ifstream::binary);
+    std::ostringstream content;
+    content << input.rdbuf();
+    return content.str();
+}
+
+static size_t file_size(const std::string &filename)
+{
+    std::ifstream input(filename.c_str(), std::ifstream::binary | std::ifstream::ate);
+    return static_cast<size_t>(input.tellg());
+}
+
+static std::string field_name(unsigned index)
+{
+    std::ostringstream name;
+    name << "field" << index;
+    return name.str();
+}
+
+// Array of elements with many number fields, written in field index order
+static void generate_fields(const std::string &jsonFilename, const std::string &xmlFilename)
+{
+    std::ofstream json(jsonFilename.c_str(), std::ofstream::binary);
+    std::ofstream xml(xmlFilename.c_str(), std::ofstream::binary);
+    json << "{\n    \"elements\": [\n";
+    xml << "<root>\n    <elements>\n";
+    for (unsigned i = 0; i < fieldsElementsCount; ++i)
+    {
+        json << (i == 0 ? "" : ",\n") << "        {";
+        xml << "        <add";
+        for (unsigned j = 0; j < fieldsPerElement; ++j)
+        {
+            json << (j == 0 ? " " : ", ") << "\"" << field_name(j) << "\": " << (i + j);
+            xml << " " << field_name(j) << "=\"" << (i + j) << "\"";
+        }
+        json << " }";
+        xml << " />\n";
+    }
+    json << "\n    ]\n}\n";
+    xml << "    </elements>\n</root>\n";
+}
+
+/* Benchmark cases, each one runs in its own process */
+
+struct BenchResult
+{
+    double timeMs;
+    size_t allocations;
+    size_t bytes;           // size of document loaded or saved
+};
+
+// Measured part of benchmark case
+class BenchTimer
+{
+public:
+    BenchTimer()
+        : _start(now_ms())
+        , _allocations(allocation_count())
+    {
+    }
+
+    BenchResult stop(size_t bytes) const
+    {
+        BenchResult result;
+        result.timeMs = now_ms() - _start;
+        result.allocations = allocation_count() - _allocations;
+        result.bytes = bytes;
+        return result;
+    }
+
+private:
+    double _start;
+    size_t _allocations;
+};
+
+// Documents constructed from file name, so cases can load them in any way
+template<class Base>
+class LoadedDocument : public Base
+{
+public:
+    LoadedDocument() {}
+    explicit LoadedDocument(const std::string &filename) { this->loadFile(filename); }
+};
+
+template<class Base>
+class SnapshotDocument : public Base
+{
+public:
+    SnapshotDocument() { this->setSnapshotCacheEnabled(true); }
+    explicit SnapshotDocument(const std::string &filename)
+    {
+        this->setSnapshotCacheEnabled(true);
+        this->loadFile(filename);
+    }
+};
+
+// Loaded tree allocated value by value, as jsoncpp does it without arena
+template<class Base>
+class HeapDocument : public Base
+{
+public:
+    HeapDocument() { this->setArenaEnabled(false); }
+    explicit HeapDocument(const std::string &filename)
+    {
+        this->setArenaEnabled(false);
+        this->loadFile(filename);
+    }
+};
+
+// Loaded and converted to read-only layout
+template<class Base>
+class FrozenDocument : public Base
+{
+public:
+    FrozenDocument() {}
+    explicit FrozenDocument(const std::string &filename)
+    {
+        this->loadFile(filename);
+        this->freeze();
+    }
+};
+
+typedef LoadedDocument<JsonCppDocument> BenchJsonCpp;
+typedef LoadedDocument<PugixmlDocument> BenchPugixml;
+typedef LoadedDocument<JsonStreamDocument> BenchJsonStream;
+typedef HeapDocument<JsonCppDocument> BenchJsonCppHeap;
+typedef SnapshotDocument<JsonCppDocument> BenchJsonCppSnapshot;
+typedef SnapshotDocument<PugixmlDocument> BenchPugixmlSnapshot;
+typedef FrozenDocument<JsonCppDocument> BenchJsonCppFrozen;
+typedef FrozenDocument<PugixmlDocument> BenchPugixmlFrozen;
+
+template<class Document>
+static BenchResult bench_load_file(const std::string &filename)
+{
+    Document doc;
+    BenchTimer timer;
+    doc.loadFile(filename);
+    return timer.stop(file_size(filename));
+}
+
+template<class Document>
+static BenchResult bench_load_string(const std::string &filename)
+{
+    std::string content = read_file(filename);
+    Document doc;
+    BenchTimer timer;
+    doc.loadString(content);
+    return timer.stop(content.size());
+}
+
+// Second load of the same text into loaded document
+template<class Document>
+static BenchResult bench_reload_string(const std::string &filename)
+{
+    std::string content = read_file(filename);
+    Document doc;
+    doc.loadString(content);
+    BenchTimer timer;
+    doc.loadString(content);
+    return timer.stop(content.size());
+}
+
+// Conversion of loaded tree to read-only layout
+template<class Document>
+static BenchResult bench_freeze(const std::string &filename)
+{
+    Document doc(filename);
+    BenchTimer timer;
+    doc.freeze();
+    return timer.stop(file_size(filename));
+}
+
+// Destruction of loaded document, the whole tree is freed
+template<class Document>
+static BenchResult bench_free(const std::string &filename)
+{
+    Document *doc = new Document(filename);
+    BenchTimer timer;
+    delete doc;
+    return timer.stop(file_size(filename));
+}
+
+template<class Document>
+static BenchResult bench_read_object(const std::string &filename)
+{
+    Document doc(filename);
+    BenchAccounts accounts;
+    BenchTimer timer;
+    doc.readObject(accounts);
+    BenchResult result = timer.stop(file_size(filename));
+    if (accounts.accounts.empty())
+    {
+        throw Error(1, "read object error", "there is no accounts read", filename, 0);
+    }
+    return result;
+}
+
+struct ElementsTask
+{
+    const std::vector<ContainerNode> *elements;
+    std::vector<BenchAccount> *accounts;
+    size_t begin;
+    size_t end;
+    bool failed;
+};
+
+static void *read_elements_thread(void *argument)
+{
+    ElementsTask &task = *static_cast<ElementsTask *>(argument);
+    try
+    {
+        for (size_t i = task.begin; i < task.end; ++i)
+        {
+            (*task.accounts)[i].readObject((*task.elements)[i]);
+        }
+    }
+    catch (Error &)
+    {
+        task.failed = true;
+    }
+    return NULL;
+}
+
+// Accounts split between threads by ranges of array items read by readArrayElements()
+template<class Document>
+static BenchResult bench_parallel_read_object(const std::string &filename)
+{
+    Document doc(filename);
+    doc.setConcurrentReadEnabled(true);
+    std::vector<ContainerNode> elements;
+    std::vector<BenchAccount> accounts;
+    std::vector<ElementsTask> tasks(threadsCount);
+    std::vector<pthread_t> threads(threadsCount);
+    BenchTimer timer;
+    doc.readArrayElements(doc.getRootContainer(), "accounts", elements);
+    accounts.resize(elements.size());
+    for (unsigned i = 0; i < threadsCount; ++i)
+    {
+        ElementsTask task = { &elements, &accounts, elements.size() * i / threadsCount, elements.size() * (i + 1) / threadsCount, false };
+        tasks[i] = task;
+        if (pthread_create(&threads[i], NULL, &read_elements_thread, &tasks[i]) != 0)
+        {
+            throw Error(1, "read object error", "can't create thread", "", 0);
+        }
+    }
+    for (unsigned i = 0; i < threadsCount; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    BenchResult result = timer.stop(file_size(filename));
+    for (unsigned i = 0; i < threadsCount; ++i)
+    {
+        if (tasks[i].failed)
+        {
+            throw Error(1, "read object error", "account is not read", filename, 0);
+        }
+    }
+    if (accounts.empty())
+    {
+        throw Error(1, "read object error", "there is no accounts read", filename, 0);
+    }
+    return result;
+}
+
+// Items of accounts array parsed by threads, one thread parses the file serially
+static BenchResult jsoncpp_parallel_load_file(const std::string &filename)
+{
+    JsonCppDocument doc;
+    doc.setParallelParsing(threadsCount, "accounts", 0);
+    BenchTimer timer;
+    doc.loadFile(filename);
+    BenchResult result = timer.stop(file_size(filename));
+    if (threadsCount > 1 && !doc.isParsedInParallel())
+    {
+        throw Error(1, "load file error", "file is not parsed by threads", filename, 0);
+    }
+    return result;
+}
+
+template<class Document>
+static BenchResult bench_write_object(const std::string &filename)
+{
+    BenchAccounts accounts;
+    Document(filename).readObject(accounts);
+    Document doc;
+    BenchTimer timer;
+    doc.writeObject(accounts);
+    return timer.stop(file_size(filename));
+}
+
+template<class Document>
+static BenchResult bench_save_string(const std::string &filename)
+{
+    Document doc(filename);
+    BenchTimer timer;
+    std::string result = doc.saveString();
+    return timer.stop(result.size());
+}
+
+template<class Document>
+static BenchResult bench_save_file(const std::string &filename)
+{
+    Document doc(filename);
+    std::string output = filename + ".saved";
+    BenchTimer timer;
+    doc.saveFile(output);
+    BenchResult result = timer.stop(file_size(output));
+    remove(output.c_str());
+    return result;
+}
+
+// Load and read every account: application startup path
+template<class Document>
+static BenchResult bench_load_read_object(const std::string &filename)
+{
+    BenchAccounts accounts;
+    BenchTimer timer;
+    Document doc(filename);
+    doc.readObject(accounts);
+    return timer.stop(file_size(filename));
+}
+
+// Reload of the file that has the same content as loaded document, it is hashed only
+template<class Document>
+static BenchResult bench_reload_unchanged(const std::string &filename)
+{
+    Document doc(filename);
+    BenchTimer timer;
+    bool reloaded = doc.reloadIfChanged(filename);
+    BenchResult result = timer.stop(file_size(filename));
+    if (reloaded)
+    {
+        throw Error(1, "reload error", "unchanged file is loaded again", filename, 0);
+    }
+    return result;
+}
+
+// Diff of reloaded document that has one account changed,
+// subtree hashes of the previous document are cached by its own diff
+template<class Document>
+static BenchResult bench_reload_diff(const std::string &filename)
+{
+    std::string content = read_file(filename);
+    Document previous;
+    previous.loadString(content);
+    previous.diff(previous);
+    content.replace(content.find("secret"), 6, "SECRET");
+    Document current;
+    current.loadString(content);
+    BenchTimer timer;
+    std::vector<std::string> changed = current.diff(previous);
+    BenchResult result = timer.stop(content.size());
+    if (changed.size() != 1)
+    {
+        throw Error(1, "diff error", "one changed container expected", filename, 0);
+    }
+    return result;
+}
+
+static BenchResult jsoncpp_load_istream(const std::string &filename)
+{
+    // the way JsonCppDocument::loadFile worked before: whole stream is copied to std::string
+    BenchTimer timer;
+    std::ifstream input(filename.c_str(), std::ifstream::binary);
+    Json::Value document;
+    Json::Reader reader;
+    if (!reader.parse(input, document))
+    {
+        throw Error(1, "jsoncpp load from stream error", reader.getFormattedErrorMessages(), filename, 0);
+    }
+    return timer.stop(file_size(filename));
+}
+
+enum ReadOrder
+{
+    READ_IN_ORDER,
+    READ_SHUFFLED,
+    READ_REVERSE
+};
+
+static std::vector<std::string> field_names(ReadOrder order)
+{
+    std::vector<std::string> names;
+    for (unsigned i = 0; i < fieldsPerElement; ++i)
+    {
+        names.push_back(field_name(i));
+    }
+    if (order == READ_REVERSE)
+    {
+        std::vector<std::string> reversed(names.rbegin(), names.rend());
+        names.swap(reversed);
+    }
+    else if (order == READ_SHUFFLED)
+    {
+        // Fisher-Yates with fixed seed, same order on every platform
+        BenchRandom random(12345);
+        for (size_t i = names.size() - 1; i > 0; --i)
+        {
+            std::swap(names[i], names[random.next(static_cast<unsigned>(i + 1))]);
+        }
+    }
+    return names;
+}
+
+static BenchResult read_fields(PersistentDocument &doc, const std::string &filename, ReadOrder order)
+{
+    std::vector<std::string> names = field_names(order);
+    double checksum = 0;
+    BenchTimer timer;
+    for (unsigned pass = 0; pass < readPasses; ++pass)
+    {
+        ContainerNode elements = doc.readArray("elements");
+        while (elements.hasUnread())
+        {
+            ContainerNode element = elements.readContainer("add");
+            for (size_t i = 0; i < names.size(); ++i)
+            {
+                checksum += element.readNumber(names[i]);
+            }
+        }
+    }
+    BenchResult result = timer.stop(file_size(filename) * readPasses);
+    if (checksum <= 0)
+    {
+        throw Error(1, "read fields error", "unexpected checksum", "", 0);
+    }
+    return result;
+}
+
+static BenchResult jsoncpp_read(const std::string &filename, ReadOrder order)
+{
+    JsonCppDocument doc;
+    doc.loadFile(filename);
+    return read_fields(doc, filename, order);
+}
+
+static BenchResult pugixml_read(const std::string &filename, ReadOrder order, bool nameIndex)
+{
+    PugixmlDocument doc;
+    doc.setNameIndexEnabled(nameIndex);
+    doc.loadFile(filename);
+    return read_fields(doc, filename, order);
+}
+
+static BenchResult jsoncpp_read_in_order(const std::string &filename) { return jsoncpp_read(filename, READ_IN_ORDER); }
+static BenchResult jsoncpp_read_shuffled(const std::string &filename) { return jsoncpp_read(filename, READ_SHUFFLED); }
+static BenchResult jsoncpp_read_reverse(const std::string &filename) { return jsoncpp_read(filename, READ_REVERSE); }
+static BenchResult pugixml_read_in_order(const std::string &filename) { return pugixml_read(filename, READ_IN_ORDER, false); }
+static BenchResult pugixml_read_shuffled(const std::string &filename) { return pugixml_read(filename, READ_SHUFFLED, false); }
+static BenchResult pugixml_read_reverse(const std::string &filename) { return pugixml_read(filename, READ_REVERSE, false); }
+static BenchResult pugixml_index_read_in_order(const std::string &filename) { return pugixml_read(filename, READ_IN_ORDER, true); }
+static BenchResult pugixml_index_read_shuffled(const std::string &filename) { return pugixml_read(filename, READ_SHUFFLED, true); }
+static BenchResult pugixml_index_read_reverse(const std::string &filename) { return pugixml_read(filename, READ_REVERSE, true); }
+
+/* Number parsing from several threads at once */
+
+static const unsigned numbersCount = 100000;
+
+// Real numbers as they're written in settings, generated with fixed seed
+static std::vector<std::string> generate_numbers()
+{
+    BenchRandom random(12345);
+    std::vector<std::string> numbers(numbersCount);
+    for (unsigned i = 0; i < numbersCount; ++i)
+    {
+        char text[64];
+        double value = (random.next(1000000) + 1) * 1e-3;
+        int exponent = static_cast<int>(random.next(13)) - 6;
+        int precision = static_cast<int>(3 + random.next(15));
+        snprintf(text, sizeof(text), "%.*g", precision, value * pow(10.0, exponent));
+        numbers[i] = text;
+    }
+    return numbers;
+}
+
+static size_t numbers_size(const std::vector<std::string> &numbers)
+{
+    size_t size = 0;
+    for (size_t i = 0; i < numbers.size(); ++i)
+    {
+        size += numbers[i].size();
+    }
+    return size;
+}
+
+struct NumbersTask
+{
+    const std::vector<std::string> *numbers;
+    double (*parse)(const std::string &text);
+    const std::string *text;        // document to load
+    PugixmlDocument *document;      // document loaded already
+    double checksum;
+};
+
+static void *numbers_thread(void *argument)
+{
+    NumbersTask &task = *static_cast<NumbersTask *>(argument);
+    for (size_t i = 0; i < task.numbers->size(); ++i)
+    {
+        task.checksum += task.parse((*task.numbers)[i]);
+    }
+    return NULL;
+}
+
+// Every task runs in its own thread, time of all threads is measured
+static BenchResult run_numbers_threads(std::vector<NumbersTask> &tasks, void *(*body)(void *), size_t bytesPerThread)
+{
+    std::vector<pthread_t> threads(tasks.size());
+    BenchTimer timer;
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        if (pthread_create(&threads[i], NULL, body, &tasks[i]) != 0)
+        {
+            throw Error(1, "numbers bench error", "can't create thread", "", 0);
+        }
+    }
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    BenchResult result = timer.stop(bytesPerThread * tasks.size());
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        if (tasks[i].checksum <= 0)
+        {
+            throw Error(1, "numbers bench error", "unexpected checksum", "", 0);
+        }
+    }
+    return result;
+}
+
+static double parse_sscanf(const std::string &text)
+{
+    // the way Json::Reader::decodeDouble parsed numbers before
+    double value = 0;
+    sscanf(text.c_str(), "%lf", &value);
+    return value;
+}
+
+static double parse_strtod(const std::string &text)
+{
+    // the way pugi::xml_attribute::as_double parses numbers
+    return strtod(text.c_str(), NULL);
+}
+
+static double parse_pjsettings(const std::string &text)
+{
+    double value = 0;
+    parseDouble(text.data(), text.data() + text.size(), value);
+    return value;
+}
+
+static BenchResult bench_parse_numbers(double (*parse)(const std::string &text))
+{
+    std::vector<std::string> numbers = generate_numbers();
+    NumbersTask task = { &numbers, parse, NULL, NULL, 0 };
+    std::vector<NumbersTask> tasks(threadsCount, task);
+    return run_numbers_threads(tasks, &numbers_thread, numbers_size(numbers));
+}
+
+static BenchResult numbers_sscanf(const std::string &) { return bench_parse_numbers(&parse_sscanf); }
+static BenchResult numbers_strtod(const std::string &) { return bench_parse_numbers(&parse_strtod); }
+static BenchResult numbers_pjsettings(const std::string &) { return bench_parse_numbers(&parse_pjsettings); }
+
+static void *jsoncpp_load_numbers_thread(void *argument)
+{
+    NumbersTask &task = *static_cast<NumbersTask *>(argument);
+    JsonCppDocument doc;
+    doc.loadString(*task.text);
+    task.checksum = doc.readArray("numbers").readNumber("");
+    return NULL;
+}
+
+// Every thread loads its own document, real numbers are decoded by Json::Reader
+static BenchResult jsoncpp_load_numbers(const std::string &)
+{
+    std::vector<std::string> numbers = generate_numbers();
+    std::string document = "{ \"numbers\": [ ";
+    for (size_t i = 0; i < numbers.size(); ++i)
+    {
+        document += (i == 0 ? "" : ", ") + numbers[i];
+    }
+    document += " ] }";
+    NumbersTask task = { &numbers, NULL, &document, NULL, 0 };
+    std::vector<NumbersTask> tasks(threadsCount, task);
+    return run_numbers_threads(tasks, &jsoncpp_load_numbers_thread, document.size());
+}
+
+static void *pugixml_read_numbers_thread(void *argument)
+{
+    NumbersTask &task = *static_cast<NumbersTask *>(argument);
+    ContainerNode numbers = task.document->readArray("numbers");
+    while (numbers.hasUnread())
+    {
+        task.checksum += numbers.readNumber("n");
+    }
+    return NULL;
+}
+
+// Every thread reads its own loaded document, numbers are parsed by readNumber
+static BenchResult pugixml_read_numbers(const std::string &)
+{
+    std::vector<std::string> numbers = generate_numbers();
+    std::string document = "<root><numbers>";
+    for (size_t i = 0; i < numbers.size(); ++i)
+    {
+        document += "<n>" + numbers[i] + "</n>";
+    }
+    document += "</numbers></root>";
+    std::vector<PugixmlDocument *> docs(threadsCount);
+    std::vector<NumbersTask> tasks(threadsCount);
+    for (unsigned i = 0; i < threadsCount; ++i)
+    {
+        docs[i] = new PugixmlDocument();
+        docs[i]->loadString(document);
+        NumbersTask task = { &numbers, NULL, NULL, docs[i], 0 };
+        tasks[i] = task;
+    }
+    BenchResult result = run_numbers_threads(tasks, &pugixml_read_numbers_thread, numbers_size(numbers));
+    for (unsigned i = 0; i < threadsCount; ++i)
+    {
+        delete docs[i];
+    }
+    return result;
+}
+
+enum BenchInput
+{
+    ACCOUNTS_JSON,
+    ACCOUNTS_XML,
+    FIELDS_JSON,
+    FIELDS_XML,
+    PARALLEL_JSON,      // parallelAccountsCount accounts, case argument is threads count
+    PARALLEL_XML,
+    NUMBERS             // generated in memory, case argument is threads count
+};
+
+struct BenchCase
+{
+    const char *name;
+    BenchInput input;
+    BenchResult (*run)(const std::string &filename);
+};
+
+static BenchCase benchCases[] = {
+    { "jsoncpp-load-istream", ACCOUNTS_JSON, &jsoncpp_load_istream },
+    { "jsoncpp-load-file", ACCOUNTS_JSON, &bench_load_file<JsonCppDocument> },
+    { "jsoncpp-load-string", ACCOUNTS_JSON, &bench_load_string<JsonCppDocument> },
+    { "jsoncpp-heap-load-string", ACCOUNTS_JSON, &bench_load_string<BenchJsonCppHeap> },
+    { "jsoncpp-free", ACCOUNTS_JSON, &bench_free<BenchJsonCpp> },
+    { "jsoncpp-heap-free", ACCOUNTS_JSON, &bench_free<BenchJsonCppHeap> },
+    { "jsoncpp-read-object", ACCOUNTS_JSON, &bench_read_object<BenchJsonCpp> },
+    { "jsoncpp-freeze", ACCOUNTS_JSON, &bench_freeze<BenchJsonCpp> },
+    { "jsoncpp-frozen-read-object", ACCOUNTS_JSON, &bench_read_object<BenchJsonCppFrozen> },
+    { "jsoncpp-write-object", ACCOUNTS_JSON, &bench_write_object<BenchJsonCpp> },
+    { "jsoncpp-save-string", ACCOUNTS_JSON, &bench_save_string<BenchJsonCpp> },
+    { "jsoncpp-save-file", ACCOUNTS_JSON, &bench_save_file<BenchJsonCpp> },
+    { "jsoncpp-load-read-object", ACCOUNTS_JSON, &bench_load_read_object<BenchJsonCpp> },
+    { "jsoncpp-reload-diff", ACCOUNTS_JSON, &bench_reload_diff<JsonCppDocument> },
+    { "jsoncpp-reload-unchanged", ACCOUNTS_JSON, &bench_reload_unchanged<BenchJsonCpp> },
+    { "jsoncpp-build-snapshot", ACCOUNTS_JSON, &bench_load_file<BenchJsonCppSnapshot> },
+    { "jsoncpp-load-snapshot", ACCOUNTS_JSON, &bench_load_file<BenchJsonCppSnapshot> },
+    { "jsoncpp-snapshot-load-read-object", ACCOUNTS_JSON, &bench_load_read_object<BenchJsonCppSnapshot> },
+    { "json-stream-load-read-object", ACCOUNTS_JSON, &bench_load_read_object<BenchJsonStream> },
+    { "pugixml-load-file", ACCOUNTS_XML, &bench_load_file<PugixmlDocument> },
+    { "pugixml-load-string", ACCOUNTS_XML, &bench_load_string<PugixmlDocument> },
+    { "pugixml-reload-string", ACCOUNTS_XML, &bench_reload_string<PugixmlDocument> },
+    { "pugixml-read-object", ACCOUNTS_XML, &bench_read_object<BenchPugixml> },
+    { "pugixml-freeze", ACCOUNTS_XML, &bench_freeze<BenchPugixml> },
+    { "pugixml-frozen-read-object", ACCOUNTS_XML, &bench_read_object<BenchPugixmlFrozen> },
+    { "pugixml-write-object", ACCOUNTS_XML, &bench_write_object<BenchPugixml> },
+    { "pugixml-save-string", ACCOUNTS_XML, &bench_save_string<BenchPugixml> },
+    { "pugixml-save-file", ACCOUNTS_XML, &bench_save_file<BenchPugixml> },
+    { "pugixml-load-read-object", ACCOUNTS_XML, &bench_load_read_object<BenchPugixml> },
+    { "pugixml-reload-diff", ACCOUNTS_XML, &bench_reload_diff<PugixmlDocument> },
+    { "pugixml-reload-unchanged", ACCOUNTS_XML, &bench_reload_unchanged<BenchPugixml> },
+    { "pugixml-build-snapshot", ACCOUNTS_XML, &bench_load_file<BenchPugixmlSnapshot> },
+    { "pugixml-load-snapshot", ACCOUNTS_XML, &bench_load_file<BenchPugixmlSnapshot> },
+    { "pugixml-snapshot-load-read-object", ACCOUNTS_XML, &bench_load_read_object<BenchPugixmlSnapshot> },
+    { "jsoncpp-parallel-load-file", PARALLEL_JSON, &jsoncpp_parallel_load_file },
+    { "jsoncpp-parallel-read-object", PARALLEL_JSON, &bench_parallel_read_object<BenchJsonCpp> },
+    { "jsoncpp-frozen-parallel-read-object", PARALLEL_JSON, &bench_parallel_read_object<BenchJsonCppFrozen> },
+    { "pugixml-parallel-read-object", PARALLEL_XML, &bench_parallel_read_object<BenchPugixml> },
+    { "pugixml-frozen-parallel-read-object", PARALLEL_XML, &bench_parallel_read_object<BenchPugixmlFrozen> },
+    { "jsoncpp-read-in-order", FIELDS_JSON, &jsoncpp_read_in_order },
+    { "jsoncpp-read-shuffled", FIELDS_JSON, &jsoncpp_read_shuffled },
+    { "jsoncpp-read-reverse", FIELDS_JSON, &jsoncpp_read_reverse },
+    { "pugixml-read-in-order", FIELDS_XML, &pugixml_read_in_order },
+    { "pugixml-read-shuffled", FIELDS_XML, &pugixml_read_shuffled },
+    { "pugixml-read-reverse", FIELDS_XML, &pugixml_read_reverse },
+    { "pugixml-index-read-in-order", FIELDS_XML, &pugixml_index_read_in_order },
+    { "pugixml-index-read-shuffled", FIELDS_XML, &pugixml_index_read_shuffled },
+    { "pugixml-index-read-reverse", FIELDS_XML, &pugixml_index_read_reverse },
+    { "numbers-sscanf", NUMBERS, &numbers_sscanf },
+    { "numbers-strtod", NUMBERS, &numbers_strtod },
+    { "numbers-pjsettings", NUMBERS, &numbers_pjsettings },
+    { "jsoncpp-load-numbers", NUMBERS, &jsoncpp_load_numbers },
+    { "pugixml-read-numbers", NUMBERS, &pugixml_read_numbers },
+};
+
+static const size_t benchCasesCount = sizeof(benchCases) / sizeof(benchCases[0]);
+
+static bool is_accounts_input(BenchInput input)
+{
+    return input == ACCOUNTS_JSON || input == ACCOUNTS_XML;
+}
+
+static std::string input_file(BenchInput input, unsigned accounts)
+{
+    switch (input)
+    {
+    case ACCOUNTS_JSON: return accounts_file(accounts, ".json");
+    case ACCOUNTS_XML: return accounts_file(accounts, ".xml");
+    case FIELDS_JSON: return fieldsJsonFile;
+    case FIELDS_XML: return fieldsXmlFile;
+    case PARALLEL_JSON: return parallelJsonFile;
+    case PARALLEL_XML: return parallelXmlFile;
+    default: return "";
+    }
+}
+
+static int run_case_in_child(const char *self, const BenchCase &benchCase, unsigned argument)
+{
+    bool parallel = benchCase.input == PARALLEL_JSON || benchCase.input == PARALLEL_XML;
+    unsigned accounts = benchCase.input == NUMBERS ? 0 : parallel ? parallelAccountsCount : argument;
+    unsigned threads = benchCase.input == NUMBERS || parallel ? argument : 1;
+    int result[2];
+    if (pipe(result) != 0)
+    {
+        perror("pipe");
+        return 1;
+    }
+
+    std::string caseArgument = numbered("", argument);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0)
+    {
+        close(result[0]);
+        dup2(result[1], STDOUT_FILENO);
+        execl(self, self, "--run", benchCase.name, caseArgument.c_str(), (char *)NULL);
+        perror("execl");
+        _exit(1);
+    }
+
+    close(result[1]);
+    char buffer[128] = {};
+    ssize_t length = read(result[0], buffer, sizeof(buffer) - 1);
+    close(result[0]);
+
+    int status = 0;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    double timeMs = 0;
+    unsigned long allocations = 0;
+    unsigned long bytes = 0;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || length <= 0
+        || sscanf(buffer, "%lf %lu %lu", &timeMs, &allocations, &bytes) != 3)
+    {
+        std::cerr << benchCase.name << " " << argument << ": failed" << std::endl;
+        return 1;
+    }
+
+    // ru_maxrss is in kilobytes on Linux
+    double throughput = timeMs > 0 ? bytes / (1024.0 * 1024.0) / (timeMs / 1000.0) : 0;
+    printf("{\"case\": \"%s\", \"accounts\": %u, \"threads\": %u, \"bytes\": %lu, \"time_ms\": %.3f, \"mb_per_s\": %.2f, \"allocations\": %lu, \"peak_rss_kb\": %ld}\n",
+        benchCase.name,
+        accounts,
+        threads,
+        bytes,
+        timeMs,
+        throughput,
+        allocations,
+        usage.ru_maxrss);
+    fflush(stdout);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 4 && strcmp(argv[1], "--run") == 0)
+    {
+        unsigned argument = static_cast<unsigned>(atoi(argv[3]));
+        threadsCount = argument;
+        for (size_t i = 0; i < benchCasesCount; ++i)
+        {
+            if (strcmp(benchCases[i].name, argv[2]) == 0)
+            {
+                try
+                {
+                    BenchResult result = benchCases[i].run(input_file(benchCases[i].input, argument));
+                    printf("%.3f %lu %lu\n", result.timeMs, (unsigned long)result.allocations, (unsigned long)result.bytes);
+                    return 0;
+                }
+                catch (Error &err)
+                {
+                    std::cerr << err.info(true) << std::endl;
+                    return 1;
+                }
+            }
+        }
+        std::cerr << "unknown benchmark case " << argv[2] << std::endl;
+        return 1;
+    }
+
+    std::vector<unsigned> accountCounts;
+    for (int i = 1; i < argc; ++i)
+    {
+        accountCounts.push_back(static_cast<unsigned>(atoi(argv[i])));
+    }
+    if (accountCounts.empty())
+    {
+        accountCounts.push_back(10);
+        accountCounts.push_back(1000);
+        accountCounts.push_back(100000);
+    }
+
+    int failed = 0;
+    for (size_t count = 0; count < accountCounts.size(); ++count)
+    {
+        unsigned accounts = accountCounts[count];
+        std::string jsonFile = accounts_file(accounts, ".json");
+        std::string xmlFile = accounts_file(accounts, ".xml");
+        {
+            BenchAccounts generated = generate_accounts(accounts);
+            JsonCppDocument json;
+            json.writeObject(generated);
+            json.saveFile(jsonFile);
+            PugixmlDocument xml;
+            xml.writeObject(generated);
+            xml.saveFile(xmlFile);
+        }
+        remove(snapshotFilename(jsonFile).c_str());
+        remove(snapshotFilename(xmlFile).c_str());
+
+        for (size_t i = 0; i < benchCasesCount; ++i)
+        {
+            if (is_accounts_input(benchCases[i].input))
+            {
+                failed += run_case_in_child(argv[0], benchCases[i], accounts);
+            }
+        }
+
+        remove(jsonFile.c_str());
+        remove(xmlFile.c_str());
+        remove(snapshotFilename(jsonFile).c_str());
+        remove(snapshotFilename(xmlFile).c_str());
+    }
+
+    // field read order cases do not depend on accounts count
+    generate_fields(fieldsJsonFile, fieldsXmlFile);
+    for (size_t i = 0; i < benchCasesCount; ++i)
+    {
+        if (benchCases[i].input == FIELDS_JSON || benchCases[i].input == FIELDS_XML)
+        {
+            failed += run_case_in_child(argv[0], benchCases[i], 0);
+        }
+    }
+    remove(fieldsJsonFile);
+    remove(fieldsXmlFile);
+
+    unsigned processors = static_cast<unsigned>(sysconf(_SC_NPROCESSORS_ONLN));
+
+    // parallel reads run on 1, 2, 4... threads up to every online processor
+    {
+        BenchAccounts generated = generate_accounts(parallelAccountsCount);
+        JsonCppDocument json;
+        json.writeObject(generated);
+        json.saveFile(parallelJsonFile);
+        PugixmlDocument xml;
+        xml.writeObject(generated);
+        xml.saveFile(parallelXmlFile);
+    }
+    for (size_t i = 0; i < benchCasesCount; ++i)
+    {
+        if (benchCases[i].input == PARALLEL_JSON || benchCases[i].input == PARALLEL_XML)
+        {
+            for (unsigned threads = 1; threads < processors; threads *= 2)
+            {
+                failed += run_case_in_child(argv[0], benchCases[i], threads);
+            }
+            failed += run_case_in_child(argv[0], benchCases[i], processors);
+        }
+    }
+    remove(parallelJsonFile);
+    remove(parallelXmlFile);
+
+    for (size_t i = 0; i < benchCasesCount; ++i)
+    {
+        if (benchCases[i].input == NUMBERS)
+        {
+            failed += run_case_in_child(argv[0], benchCases[i], 1);
+            if (processors > 1)
+            {
+                failed += run_case_in_child(argv[0], benchCases[i], processors);
+            }
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,403 @@
+#include <catch/catch.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <pjsettings-jsoncpp.h>
+#include <pjsettings-pugixml.h>
+
+using namespace pj;
+using namespace pjsettings;
+
+static const unsigned concurrentAccountsCount = 10000;
+static const unsigned concurrentReadersCount = 16;
+
+class ConcurrentAccount : public PersistentObject
+{
+public:
+    explicit ConcurrentAccount(unsigned index = 0)
+    {
+        std::ostringstream id;
+        id << index;
+        priority = index;
+        idUri = "sip:user" + id.str() + "@example.com";
+        registrarUri = "sip:example.com";
+        timeoutSec = 300 + index % 60;
+        proxies.push_back("sip:proxy" + id.str() + ".example.com");
+        proxies.push_back("sip:backup.example.com");
+        usernames.push_back("user" + id.str());
+        usernames.push_back("fallback" + id.str());
+    }
+
+    virtual void readObject(const ContainerNode &node) throw(Error)
+    {
+        ContainerNode this_node = node.readContainer("AccountConfig");
+        NODE_READ_INT(this_node, priority);
+        NODE_READ_STRING(this_node, idUri);
+
+        ContainerNode reg_node = this_node.readContainer("regConfig");
+        NODE_READ_STRING(reg_node, registrarUri);
+        NODE_READ_UNSIGNED(reg_node, timeoutSec);
+
+        ContainerNode sip_node = this_node.readContainer("sipConfig");
+        NODE_READ_STRINGV(sip_node, proxies);
+        ContainerNode creds_node = sip_node.readArray("authCreds");
+        usernames.clear();
+        while (creds_node.hasUnread())
+        {
+            ContainerNode cred_node = creds_node.readContainer("AuthCredInfo");
+            usernames.push_back(cred_node.readString("username"));
+        }
+    }
+
+    virtual void writeObject(ContainerNode &node) const throw(Error)
+    {
+        ContainerNode this_node = node.writeNewContainer("AccountConfig");
+        NODE_WRITE_INT(this_node, priority);
+        NODE_WRITE_STRING(this_node, idUri);
+
+        ContainerNode reg_node = this_node.writeNewContainer("regConfig");
+        NODE_WRITE_STRING(reg_node, registrarUri);
+        NODE_WRITE_UNSIGNED(reg_node, timeoutSec);
+
+        ContainerNode sip_node = this_node.writeNewContainer("sipConfig");
+        NODE_WRITE_STRINGV(sip_node, proxies);
+        ContainerNode creds_node = sip_node.writeNewArray("authCreds");
+        for (size_t i = 0; i < usernames.size(); ++i)
+        {
+            ContainerNode cred_node = creds_node.writeNewContainer("AuthCredInfo");
+            cred_node.writeString("username", usernames[i]);
+        }
+    }
+
+    bool operator==(const ConcurrentAccount &other) const
+    {
+        return priority == other.priority
+            && idUri == other.idUri
+            && registrarUri == other.registrarUri
+            && timeoutSec == other.timeoutSec
+            && proxies == other.proxies
+            && usernames == other.usernames;
+    }
+
+    int priority;
+    std::string idUri;
+    std::string registrarUri;
+    unsigned timeoutSec;
+    StringVector proxies;
+    StringVector usernames;
+};
+
+// Account changedAccount has other timeout, so documents differ in it only
+template <typename Document>
+static void load_concurrent_accounts(Document &loaded, unsigned changedAccount = concurrentAccountsCount)
+{
+    Document written;
+    written.writeInt("count", concurrentAccountsCount);
+    ContainerNode accounts = written.getRootContainer().writeNewArray("accounts");
+    for (unsigned i = 0; i < concurrentAccountsCount; ++i)
+    {
+        ConcurrentAccount account(i);
+        if (i == changedAccount)
+        {
+            account.timeoutSec = 0;
+        }
+        account.writeObject(accounts);
+    }
+    loaded.loadString(written.saveString());
+}
+
+struct ConcurrentReader
+{
+    const PersistentDocument *document;
+    const NumericExtension *numeric;
+    unsigned long reads;
+    unsigned long mismatches;
+};
+
+// Every reader reads all accounts through nodes of its own, the count
+// is read through root node shared by all readers
+static void *read_concurrent_accounts(void *argument)
+{
+    ConcurrentReader &reader = *static_cast<ConcurrentReader *>(argument);
+    try
+    {
+        const ContainerNode &root = reader.document->getRootContainer();
+        if (reader.numeric->readInt64(root, "count") != concurrentAccountsCount
+            || reader.document->readInt("count") != static_cast<int>(concurrentAccountsCount))
+        {
+            ++reader.mismatches;
+        }
+
+        ContainerNode accounts = reader.document->readArray("accounts");
+        for (unsigned i = 0; i < concurrentAccountsCount; ++i)
+        {
+            ConcurrentAccount account;
+            account.readObject(accounts);
+            if (!(account == ConcurrentAccount(i)))
+            {
+                ++reader.mismatches;
+            }
+            ++reader.reads;
+        }
+        if (accounts.hasUnread())
+        {
+            ++reader.mismatches;
+        }
+    }
+    catch (const Error &)
+    {
+        ++reader.mismatches;
+    }
+    return NULL;
+}
+
+template <typename Document>
+static void read_concurrently(const Document &document, unsigned long &reads, unsigned long &mismatches)
+{
+    ConcurrentReader readers[concurrentReadersCount];
+    pthread_t threads[concurrentReadersCount];
+    for (unsigned i = 0; i < concurrentReadersCount; ++i)
+    {
+        ConcurrentReader reader = { &document, &document, 0, 0 };
+        readers[i] = reader;
+        pthread_create(&threads[i], NULL, &read_concurrent_accounts, &readers[i]);
+    }
+
+    reads = 0;
+    mismatches = 0;
+    for (unsigned i = 0; i < concurrentReadersCount; ++i)
+    {
+        pthread_join(threads[i], NULL);
+        reads += readers[i].reads;
+        mismatches += readers[i].mismatches;
+    }
+}
+
+struct ElementsReader
+{
+    const std::vector<ContainerNode> *elements;
+    unsigned begin;
+    unsigned end;
+    unsigned long mismatches;
+};
+
+// Every reader reads its own range of array items through their nodes
+static void *read_account_elements(void *argument)
+{
+    ElementsReader &reader = *static_cast<ElementsReader *>(argument);
+    try
+    {
+        for (unsigned i = reader.begin; i < reader.end; ++i)
+        {
+            ConcurrentAccount account;
+            account.readObject((*reader.elements)[i]);
+            if (!(account == ConcurrentAccount(i)))
+            {
+                ++reader.mismatches;
+            }
+        }
+    }
+    catch (const Error &)
+    {
+        ++reader.mismatches;
+    }
+    return NULL;
+}
+
+template <typename Document>
+static unsigned long read_elements_concurrently(const Document &document)
+{
+    std::vector<ContainerNode> elements;
+    document.readArrayElements(document.getRootContainer(), "accounts", elements);
+    if (elements.size() != concurrentAccountsCount)
+    {
+        return 1;
+    }
+
+    ElementsReader readers[concurrentReadersCount];
+    pthread_t threads[concurrentReadersCount];
+    for (unsigned i = 0; i < concurrentReadersCount; ++i)
+    {
+        ElementsReader reader = {
+            &elements,
+            concurrentAccountsCount * i / concurrentReadersCount,
+            concurrentAccountsCount * (i + 1) / concurrentReadersCount,
+            0
+        };
+        readers[i] = reader;
+        pthread_create(&threads[i], NULL, &read_account_elements, &readers[i]);
+    }
+
+    unsigned long mismatches = 0;
+    for (unsigned i = 0; i < concurrentReadersCount; ++i)
+    {
+        pthread_join(threads[i], NULL);
+        mismatches += readers[i].mismatches;
+    }
+    return mismatches;
+}
+
+template <typename Document>
+struct DiffReader
+{
+    const Document *document;
+    const Document *other;
+    std::vector<std::string> changed;
+    uint64_t treeHash;
+};
+
+// Every reader hashes both trees and compares them at once,
+// subtree hashes of documents read by threads are not cached
+template <typename Document>
+static void *diff_concurrent_documents(void *argument)
+{
+    DiffReader<Document> &reader = *static_cast<DiffReader<Document> *>(argument);
+    reader.treeHash = reader.document->getTreeHash();
+    reader.changed = reader.document->diff(*reader.other);
+    return NULL;
+}
+
+template <typename Document>
+static unsigned long diff_concurrently(const Document &document, const Document &other)
+{
+    DiffReader<Document> readers[concurrentReadersCount];
+    pthread_t threads[concurrentReadersCount];
+    for (unsigned i = 0; i < concurrentReadersCount; ++i)
+    {
+        readers[i].document = &document;
+        readers[i].other = &other;
+        readers[i].treeHash = 0;
+        pthread_create(&threads[i], NULL, &diff_concurrent_documents<Document>, &readers[i]);
+    }
+    for (unsigned i = 0; i < concurrentReadersCount; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    // the trees are hashed again after readers are done
+    std::vector<std::string> changed = document.diff(other);
+    uint64_t treeHash = document.getTreeHash();
+    unsigned long mismatches = changed.size() == 1 && treeHash != other.getTreeHash() ? 0 : 1;
+    for (unsigned i = 0; i < concurrentReadersCount; ++i)
+    {
+        if (readers[i].treeHash != treeHash || readers[i].changed != changed)
+        {
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+SCENARIO("jsoncpp concurrent readers", "[concurrent]")
+{
+    JsonCppDocument document;
+    load_concurrent_accounts(document);
+    document.profiler().setEnabled(true);
+    document.setConcurrentReadEnabled(true);
+    CHECK(document.isConcurrentReadEnabled());
+    CHECK_FALSE(document.profiler().isEnabled());
+
+    SECTION("loaded tree is read by all threads at once")
+    {
+        unsigned long reads;
+        unsigned long mismatches;
+        read_concurrently(document, reads, mismatches);
+        unsigned long expectedReads = concurrentReadersCount * concurrentAccountsCount;
+        CHECK(expectedReads == reads);
+        CHECK(0 == mismatches);
+    }
+
+    SECTION("frozen document is read by all threads at once")
+    {
+        document.freeze();
+        unsigned long reads;
+        unsigned long mismatches;
+        read_concurrently(document, reads, mismatches);
+        unsigned long expectedReads = concurrentReadersCount * concurrentAccountsCount;
+        CHECK(expectedReads == reads);
+        CHECK(0 == mismatches);
+    }
+
+    SECTION("array items are split between threads")
+    {
+        CHECK(0 == read_elements_concurrently(document));
+        document.freeze();
+        CHECK(0 == read_elements_concurrently(document));
+    }
+
+    SECTION("trees are hashed and compared by all threads at once")
+    {
+        JsonCppDocument other;
+        load_concurrent_accounts(other, concurrentAccountsCount / 2);
+        other.setConcurrentReadEnabled(true);
+        CHECK(0 == diff_concurrently(document, other));
+    }
+
+    SECTION("named reads leave shared root node untouched")
+    {
+        ContainerNode &root = document.getRootContainer();
+        ContainerNode before = root;
+        CHECK(concurrentAccountsCount == document.readInt64(root, "count"));
+        document.readArray("accounts");
+        CHECK(before.data.data2 == root.data.data2);
+    }
+}
+
+SCENARIO("pugixml concurrent readers", "[concurrent]")
+{
+    PugixmlDocument document;
+    load_concurrent_accounts(document);
+    document.setNameIndexEnabled(true);
+    document.setConcurrentReadEnabled(true);
+    CHECK(document.isConcurrentReadEnabled());
+
+    SECTION("loaded tree is read by all threads at once")
+    {
+        unsigned long reads;
+        unsigned long mismatches;
+        read_concurrently(document, reads, mismatches);
+        unsigned long expectedReads = concurrentReadersCount * concurrentAccountsCount;
+        CHECK(expectedReads == reads);
+        CHECK(0 == mismatches);
+    }
+
+    SECTION("frozen document is read by all threads at once")
+    {
+        document.freeze();
+        unsigned long reads;
+        unsigned long mismatches;
+        read_concurrently(document, reads, mismatches);
+        unsigned long expectedReads = concurrentReadersCount * concurrentAccountsCount;
+        CHECK(expectedReads == reads);
+        CHECK(0 == mismatches);
+    }
+
+    SECTION("array items are split between threads")
+    {
+        CHECK(0 == read_elements_concurrently(document));
+        document.freeze();
+        CHECK(0 == read_elements_concurrently(document));
+    }
+
+    SECTION("trees are hashed and compared by all threads at once")
+    {
+        PugixmlDocument other;
+        load_concurrent_accounts(other, concurrentAccountsCount / 2);
+        other.setConcurrentReadEnabled(true);
+        CHECK(0 == diff_concurrently(document, other));
+    }
+
+    SECTION("attribute cursor is not kept by shared root node")
+    {
+        ContainerNode &root = document.getRootContainer();
+        CHECK(concurrentAccountsCount == document.readInt64(root, "count"));
+        CHECK(concurrentAccountsCount == root.readInt("count"));
+        CHECK(NULL == root.data.data2);
+
+        document.setConcurrentReadEnabled(false);
+        document.setNameIndexEnabled(false);
+        CHECK(concurrentAccountsCount == root.readInt("count"));
+        CHECK(NULL != root.data.data2);
+    }
+}
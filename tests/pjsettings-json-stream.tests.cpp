@@ -0,0 +1,361 @@
+#include <boost/filesystem/operations.hpp>
+#include <catch/catch.hpp>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <pjsettings-json-stream.h>
+#include <pjsua2/endpoint.hpp>
+#include "SimpleClass.h"
+
+using namespace pj;
+using namespace pjsettings;
+
+SCENARIO("read json stream from string", "[json-stream]")
+{
+    const char *jsonString = "{\n"
+        "   \"intValue\": 14,\n"
+        "   \"stringValue\": \"string\",\n"
+        "   \"doubleValue\": 2.5,\n"
+        "   \"trueBool\":  true,\n"
+        "   \"falseBool\": false,\n"
+        "   \"simpleClass\": {\n"
+        "       \"intValue\": 15,\n"
+        "       \"stringValue\": \"string\"\n"
+        "   },\n"
+        "   \"stringsArray\": [ \"string\", \"other string\" ],\n"
+        "   \"boolArray\": [ true, false ],\n"
+        "   \"simpleClassArray\": [\n"
+        "       { \"intValue\": 16 },\n"
+        "       { \"intValue\": 17 }\n"
+        "   ],\n"
+        "   \"simpleContainer\": {\n"
+        "       \"simpleClass\": { \"intValue\": 18 }\n"
+        "   },\n"
+        "   \"intArray\": [ 19, 20 ],\n"
+        "   \"arrayOfStringVectors\": [\n"
+        "       [ \"first\", \"second\" ],\n"
+        "       [ \"third\", \"fourth\" ]\n"
+        "   ]\n"
+        "}";
+
+    JsonStreamDocument doc;
+    try
+    {
+        doc.loadString(jsonString);
+    }
+    catch (Error &err)
+    {
+        std::cerr << err.info(true) << std::endl;
+        throw;
+    }
+
+    SECTION("read simple data types")
+    {
+        ContainerNode &node = doc.getRootContainer();
+
+        SECTION("read integer")
+        {
+            int intValue;
+            NODE_READ_INT(node, intValue);
+            CHECK(14 == intValue);
+        }
+
+        SECTION("read double")
+        {
+            double doubleValue;
+            NODE_READ_FLOAT(node, doubleValue);
+            CHECK(2.5 == doubleValue);
+        }
+
+        SECTION("read string")
+        {
+            std::string stringValue;
+            NODE_READ_STRING(node, stringValue);
+            CHECK("string" == stringValue);
+        }
+
+        WHEN("read bool")
+        {
+            THEN("true bool")
+            {
+                bool trueBool = false;
+                NODE_READ_BOOL(node, trueBool);
+                CHECK(true == trueBool);
+            }
+
+            THEN("false bool")
+            {
+                bool falseBool = true;
+                NODE_READ_BOOL(node, falseBool);
+                CHECK(false == falseBool);
+            }
+        }
+
+        SECTION("read string vector")
+        {
+            StringVector stringsArray;
+            NODE_READ_STRINGV(node, stringsArray);
+            REQUIRE(2 == stringsArray.size());
+            CHECK("string" == stringsArray[0]);
+            CHECK("other string" == stringsArray[1]);
+        }
+    }
+
+    SECTION("read from array")
+    {
+        SECTION("read array of objects")
+        {
+            ContainerNode arrayNode = doc.readArray("simpleClassArray");
+            std::vector<SimpleClass> data;
+            while (arrayNode.hasUnread())
+            {
+                SimpleClass obj("simpleClass");
+                arrayNode.readObject(obj);
+                data.push_back(obj);
+            }
+            REQUIRE(2 == data.size());
+            CHECK(data[0].intValue == 16);
+            CHECK(data[1].intValue == 17);
+        }
+
+        SECTION("read int array")
+        {
+            ContainerNode arrayNode = doc.readArray("intArray");
+            std::vector<int> data;
+            while (arrayNode.hasUnread())
+            {
+                data.push_back(arrayNode.readInt());
+            }
+            REQUIRE(2 == data.size());
+            CHECK(data[0] == 19);
+            CHECK(data[1] == 20);
+        }
+
+        SECTION("read string array")
+        {
+            ContainerNode arrayNode = doc.readArray("stringsArray");
+            std::vector<std::string> data;
+            while (arrayNode.hasUnread())
+            {
+                data.push_back(arrayNode.readString());
+            }
+            REQUIRE(2 == data.size());
+            CHECK("string" == data[0]);
+            CHECK("other string" == data[1]);
+        }
+
+        SECTION("read bool array")
+        {
+            ContainerNode arrayNode = doc.readArray("boolArray");
+            std::vector<bool> data;
+            while (arrayNode.hasUnread())
+            {
+                data.push_back(arrayNode.readBool());
+            }
+            REQUIRE(2 == data.size());
+            CHECK(true == data[0]);
+            CHECK(false == data[1]);
+        }
+
+        SECTION("read StringVector array")
+        {
+            ContainerNode arrayNode = doc.readArray("arrayOfStringVectors");
+            std::vector<StringVector> data;
+            while (arrayNode.hasUnread())
+            {
+                data.push_back(arrayNode.readStringVector());
+            }
+            REQUIRE(2 == data.size());
+            CHECK(data[0].size() == 2);
+            CHECK(data[0][0] == "first");
+            CHECK(data[0][1] == "second");
+            CHECK(data[1].size() == 2);
+            CHECK(data[1][0] == "third");
+            CHECK(data[1][1] == "fourth");
+        }
+
+        SECTION("read array in array")
+        {
+            ContainerNode arrayNode = doc.readArray("arrayOfStringVectors");
+            std::vector<std::string> data;
+            while (arrayNode.hasUnread())
+            {
+                ContainerNode subNode = arrayNode.readArray("vector");
+                while (subNode.hasUnread())
+                {
+                    data.push_back(subNode.readString("add"));
+                }
+            }
+            REQUIRE(4 == data.size());
+            CHECK(data[0] == "first");
+            CHECK(data[1] == "second");
+            CHECK(data[2] == "third");
+            CHECK(data[3] == "fourth");
+        }
+    }
+
+    SECTION("read object")
+    {
+        SimpleClass simpleClass("simpleClass");
+        doc.readObject(simpleClass);
+        CHECK(simpleClass.intValue == 15);
+        CHECK(simpleClass.stringValue == "string");
+    }
+
+    SECTION("read container")
+    {
+        ContainerNode node = doc.readContainer("simpleContainer");
+        SimpleClass simpleClass("simpleClass");
+        node.readObject(simpleClass);
+        CHECK(simpleClass.intValue == 18);
+    }
+}
+
+SCENARIO("json stream read order", "[json-stream]")
+{
+    JsonStreamDocument doc;
+    doc.loadString("{\n"
+        "   \"first\": 1,\n"
+        "   \"container\": { \"a\": 2, \"b\": { \"c\": 3 }, \"d\": 4 },\n"
+        "   \"array\": [ { \"e\": 5 }, { \"e\": 6 }, [ 7 ] ],\n"
+        "   \"last\": 8\n"
+        "}");
+
+    SECTION("in file order")
+    {
+        CHECK(1 == doc.readInt("first"));
+        ContainerNode container = doc.readContainer("container");
+        CHECK(2 == container.readInt("a"));
+        CHECK(3 == container.readContainer("b").readInt("c"));
+        CHECK(4 == container.readInt("d"));
+        CHECK(8 == doc.readInt("last"));
+    }
+
+    SECTION("skipped members are read later")
+    {
+        CHECK(8 == doc.readInt("last"));
+        CHECK(1 == doc.readInt("first"));
+        ContainerNode container = doc.readContainer("container");
+        CHECK(4 == container.readInt("d"));
+        CHECK(3 == container.readContainer("b").readInt("c"));
+        CHECK(2 == container.readInt("a"));
+    }
+
+    SECTION("missing members read as defaults")
+    {
+        CHECK(0 == doc.readInt("missing"));
+        CHECK("" == doc.readString("missing"));
+        CHECK(false == doc.readBool("missing"));
+        CHECK(0 == doc.readContainer("missing").readInt("value"));
+        CHECK_THROWS_AS(doc.readArray("missing"), Error);
+        CHECK(1 == doc.readInt("first"));
+    }
+
+    SECTION("parent read finishes child container")
+    {
+        ContainerNode container = doc.readContainer("container");
+        CHECK(2 == container.readInt("a"));
+        CHECK(8 == doc.readInt("last"));
+        CHECK_THROWS_AS(container.readInt("d"), Error);
+    }
+
+    SECTION("array items")
+    {
+        ContainerNode array = doc.readArray("array");
+        REQUIRE(array.hasUnread());
+        CHECK(5 == array.readContainer("").readInt("e"));
+        REQUIRE(array.hasUnread());
+        CHECK(array.hasUnread());
+        CHECK(6 == array.readContainer("").readInt("e"));
+        ContainerNode inner = array.readArray("");
+        CHECK(7 == inner.readInt());
+        CHECK_FALSE(inner.hasUnread());
+        CHECK_FALSE(array.hasUnread());
+        CHECK_THROWS_AS(array.readInt(), Error);
+        CHECK(8 == doc.readInt("last"));
+    }
+
+    SECTION("skipped array is buffered")
+    {
+        CHECK(8 == doc.readInt("last"));
+        ContainerNode array = doc.readArray("array");
+        CHECK(5 == array.readContainer("").readInt("e"));
+        CHECK(6 == array.readContainer("").readInt("e"));
+        CHECK(array.hasUnread());
+    }
+
+    SECTION("document is read-only")
+    {
+        CHECK_THROWS_AS(doc.writeInt("value", 1), Error);
+        CHECK_THROWS_AS(doc.writeNewContainer("container"), Error);
+        CHECK_THROWS_AS(doc.saveString(), Error);
+    }
+}
+
+SCENARIO("json stream errors", "[json-stream]")
+{
+    JsonStreamDocument doc;
+
+    SECTION("root must be object")
+    {
+        CHECK_THROWS_AS(doc.loadString("[ 1 ]"), Error);
+    }
+
+    SECTION("error is reported by the read that reaches it")
+    {
+        doc.loadString("{\n  \"good\": 1,\n  \"bad\": [ 1 2 ]\n}");
+        CHECK(1 == doc.readInt("good"));
+        try
+        {
+            doc.readArray("bad").readInt();
+            doc.readInt("other");
+            FAIL("parse error expected");
+        }
+        catch (Error &err)
+        {
+            CHECK(err.reason.find("Line 3") != std::string::npos);
+        }
+    }
+
+    SECTION("missing file")
+    {
+        CHECK_THROWS_AS(doc.loadFile("there-is-no-such-file.json"), Error);
+    }
+}
+
+SCENARIO("json stream from file", "[json-stream]")
+{
+    const char *filename = "test-json-stream.json";
+    const unsigned count = 5000;
+    {
+        // larger than read chunk of the parser
+        std::ofstream output(filename, std::ofstream::binary);
+        output << "{ \"items\": [\n";
+        for (unsigned i = 0; i < count; ++i)
+        {
+            output << (i == 0 ? "" : ",\n") << "  { \"intValue\": " << i << ", \"stringValue\": \"item \\u0041 " << i << "\" }";
+        }
+        output << "\n], \"last\": true }\n";
+    }
+
+    JsonStreamDocument doc;
+    doc.loadFile(filename);
+
+    ContainerNode items = doc.readArray("items");
+    unsigned read = 0;
+    bool ordered = true;
+    while (items.hasUnread())
+    {
+        SimpleClass item("item");
+        items.readObject(item);
+        std::ostringstream expected;
+        expected << "item A " << read;
+        ordered = ordered && item.intValue == static_cast<int>(read) && item.stringValue == expected.str();
+        ++read;
+    }
+    CHECK(count == read);
+    CHECK(ordered);
+    CHECK(doc.readBool("last"));
+
+    boost::filesystem::remove(filename);
+}
@@ -1,8 +1,15 @@
 #include <boost/filesystem/operations.hpp>
 #include <catch/catch.hpp>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <sstream>
+#include <pjsettings-hash.h>
+#include <pjsettings-json-parallel.h>
 #include <pjsettings-jsoncpp.h>
 #include <pjsua2/endpoint.hpp>
+#include "AllocationCounter.h"
 #include "SimpleClass.h"
 
 using namespace Json;
@@ -258,21 +265,341 @@ SCENARIO("jsoncpp read pjsip LogConfig", "[jsoncpp]")
     }
 }
 
-SCENARIO("jsoncpp from file", "[jsoncpp]")
+SCENARIO("jsoncpp read does not change document", "[jsoncpp]")
 {
-    const char *filename = "test-config-jsoncpp.json";
+    const char *jsonString = "{\n"
+        "    \"LogConfig\": { \"level\": 5 },\n"
+        "    \"simpleClassArray\": [ { \"intValue\": 16 } ]\n"
+        "}";
+    JsonCppDocument doc;
+    doc.loadString(jsonString);
+    std::string savedBefore = doc.saveString();
 
+    SECTION("missing fields of object")
+    {
+        LogConfig config;
+        size_t before = allocation_count();
+        doc.readObject(config);
+        size_t firstRead = allocation_count() - before;
+
+        before = allocation_count();
+        doc.readObject(config);
+        size_t secondRead = allocation_count() - before;
+
+        CHECK(5 == config.level);
+        CHECK(firstRead == secondRead);
+        CHECK(savedBefore == doc.saveString());
+    }
+
+    SECTION("missing container")
+    {
+        SimpleClass simpleClass("missingContainer");
+        doc.readObject(simpleClass);
+        CHECK(0 == simpleClass.intValue);
+        CHECK(savedBefore == doc.saveString());
+    }
+
+    SECTION("missing fields of array element")
+    {
+        ContainerNode arrayNode = doc.readArray("simpleClassArray");
+        ContainerNode element = arrayNode.readContainer("simpleClass");
+        CHECK(16 == element.readInt("intValue"));
+        CHECK("" == element.readString("stringValue"));
+        CHECK(savedBefore == doc.saveString());
+    }
+
+    SECTION("missing array")
+    {
+        CHECK_THROWS_AS(doc.readArray("missingArray"), Error);
+        CHECK(savedBefore == doc.saveString());
+    }
+
+    SECTION("write to missing container")
+    {
+        ContainerNode node = doc.readContainer("missingContainer");
+        CHECK_THROWS_AS(node.writeInt("intValue", 1), Error);
+        CHECK(savedBefore == doc.saveString());
+    }
+}
+
+SCENARIO("jsoncpp from buffer", "[jsoncpp]")
+{
+    const char *jsonString = "{ \"LogConfig\": { \"level\": 5, \"filename\": \"pjsip.log\" } }";
     JsonCppDocument doc;
-    doc.loadFile(filename);
+
+    SECTION("pointer and length")
+    {
+        std::string buffer = std::string(jsonString) + "garbage after buffer end";
+        doc.loadBuffer(buffer.data(), strlen(jsonString));
+    }
+
+#if PJSETTINGS_HAS_RVALUE_REFERENCES
+    SECTION("moved string")
+    {
+        std::string input(jsonString);
+        doc.loadString(std::move(input));
+    }
+#endif
 
     LogConfig config;
     doc.readObject(config);
-
     CHECK(5 == config.level);
-    CHECK(4 == config.consoleLevel);
     CHECK("pjsip.log" == config.filename);
 }
 
+SCENARIO("jsoncpp from broken buffer", "[jsoncpp]")
+{
+    JsonCppDocument doc;
+#if PJSETTINGS_HAS_RVALUE_REFERENCES
+    std::string input("{ \"LogConfig\": { ");
+    CHECK_THROWS_AS(doc.loadString(std::move(input)), Error);
+#endif
+    CHECK_THROWS_AS(doc.loadBuffer("{ \"a\"", 5), Error);
+}
+
+SCENARIO("jsoncpp from file", "[jsoncpp]")
+{
+    const char *filename = "test-config-jsoncpp.json";
+
+    JsonCppDocument doc;
+    doc.loadFile(filename);
+
+    SECTION("read config")
+    {
+        LogConfig config;
+        doc.readObject(config);
+
+        CHECK(5 == config.level);
+        CHECK(4 == config.consoleLevel);
+        CHECK("pjsip.log" == config.filename);
+    }
+
+    SECTION("missing file")
+    {
+        CHECK_THROWS_AS(doc.loadFile("there-is-no-such-file.json"), Error);
+    }
+}
+
+
+SCENARIO("jsoncpp snapshot cache", "[jsoncpp]")
+{
+    const char *filename = "test-snapshot-jsoncpp.json";
+    const std::string snapshot = snapshotFilename(filename);
+    const char *jsonString = "{\n"
+        "   \"LogConfig\": { \"filename\": \"pjsip.log\", \"level\": 5, \"consoleLevel\": 4 },\n"
+        "   \"bigValue\": 5000000000,\n"
+        "   \"realValue\": 2.5,\n"
+        "   \"stringsArray\": [ \"string\", \"other string\" ],\n"
+        "   \"simpleClassArray\": [ { \"intValue\": 16 }, { \"intValue\": 17 } ]\n"
+        "}";
+    {
+        std::ofstream output(filename, std::ofstream::binary);
+        output << jsonString;
+    }
+    boost::filesystem::remove(snapshot);
+
+    JsonCppDocument parsed;
+    parsed.setSnapshotCacheEnabled(true);
+    parsed.loadFile(filename);
+    CHECK_FALSE(parsed.isLoadedFromSnapshot());
+    CHECK(boost::filesystem::exists(snapshot));
+
+    JsonCppDocument doc;
+    doc.setSnapshotCacheEnabled(true);
+    doc.loadFile(filename);
+
+    SECTION("second load reads snapshot")
+    {
+        CHECK(doc.isLoadedFromSnapshot());
+
+        LogConfig config;
+        doc.readObject(config);
+        CHECK(5 == config.level);
+        CHECK(4 == config.consoleLevel);
+        CHECK("pjsip.log" == config.filename);
+    }
+
+    SECTION("failed load of broken file leaves empty document")
+    {
+        REQUIRE(doc.isLoadedFromSnapshot());
+        {
+            std::ofstream output(filename, std::ofstream::binary | std::ofstream::trunc);
+            output << "{ \"LogConfig\": ";
+        }
+        CHECK_THROWS_AS(doc.loadFile(filename), Error);
+        CHECK_FALSE(doc.isLoadedFromSnapshot());
+        CHECK_FALSE(doc.getRootContainer().hasUnread());
+        CHECK_FALSE(doc.readContainer("LogConfig").hasUnread());
+    }
+
+    SECTION("failed load of frozen document leaves empty document")
+    {
+        parsed.freeze();
+        {
+            std::ofstream output(filename, std::ofstream::binary | std::ofstream::trunc);
+            output << "{ \"LogConfig\": ";
+        }
+        CHECK_THROWS_AS(parsed.loadFile(filename), Error);
+        CHECK_FALSE(parsed.isFrozen());
+        CHECK_FALSE(parsed.readContainer("LogConfig").hasUnread());
+    }
+
+    SECTION("failed load of missing file keeps loaded tree")
+    {
+        boost::filesystem::remove(filename);
+        CHECK_THROWS_AS(doc.loadFile(filename), Error);
+        CHECK(doc.isLoadedFromSnapshot());
+        CHECK(5 == doc.readContainer("LogConfig").readInt("level"));
+    }
+
+    SECTION("read values and arrays")
+    {
+        CHECK(2.5 == doc.readNumber("realValue"));
+        CHECK(0 == doc.readInt("missingValue"));
+        CHECK("" == doc.readString("missingValue"));
+        StringVector strings = doc.readStringVector("stringsArray");
+        REQUIRE(2 == strings.size());
+        CHECK("other string" == strings[1]);
+
+        ContainerNode array = doc.readArray("simpleClassArray");
+        CHECK(16 == array.readContainer("").readInt("intValue"));
+        CHECK(array.hasUnread());
+        CHECK(17 == array.readContainer("").readInt("intValue"));
+        CHECK_FALSE(array.hasUnread());
+        CHECK_THROWS_AS(array.readContainer(""), Error);
+        CHECK_THROWS_AS(doc.readArray("realValue"), Error);
+    }
+
+    SECTION("document is read-only")
+    {
+        CHECK_THROWS_AS(doc.writeString("newValue", "string"), Error);
+        CHECK_THROWS_AS(doc.writeNewContainer("newContainer"), Error);
+    }
+
+    SECTION("saved document is the same")
+    {
+        CHECK(parsed.saveString() == doc.saveString());
+    }
+
+    SECTION("other load drops snapshot")
+    {
+        doc.loadString("{ \"value\": 1 }");
+        CHECK_FALSE(doc.isLoadedFromSnapshot());
+        CHECK(1 == doc.readInt("value"));
+    }
+
+    SECTION("changed file of the same size is parsed")
+    {
+        // modified within the second the snapshot was built, so only content hash tells
+        std::string changed = jsonString;
+        changed.replace(changed.find("\"level\": 5"), 10, "\"level\": 3");
+        {
+            std::ofstream output(filename, std::ofstream::binary);
+            output << changed;
+        }
+        JsonCppDocument reloaded;
+        reloaded.setSnapshotCacheEnabled(true);
+        reloaded.loadFile(filename);
+        CHECK_FALSE(reloaded.isLoadedFromSnapshot());
+        CHECK(3 == reloaded.readContainer("LogConfig").readInt("level"));
+    }
+
+    SECTION("changed file with preserved modification time is parsed")
+    {
+        // as copied by cp -p or rsync -t long after the snapshot was built
+        boost::filesystem::remove(snapshot);
+        std::time_t modified = boost::filesystem::last_write_time(filename) - 100;
+        boost::filesystem::last_write_time(filename, modified);
+        JsonCppDocument built;
+        built.setSnapshotCacheEnabled(true);
+        built.loadFile(filename);
+        REQUIRE(boost::filesystem::exists(snapshot));
+
+        std::string changed = jsonString;
+        changed.replace(changed.find("\"level\": 5"), 10, "\"level\": 2");
+        {
+            std::ofstream output(filename, std::ofstream::binary);
+            output << changed;
+        }
+        boost::filesystem::last_write_time(filename, modified);
+        JsonCppDocument reloaded;
+        reloaded.setSnapshotCacheEnabled(true);
+        reloaded.loadFile(filename);
+        CHECK_FALSE(reloaded.isLoadedFromSnapshot());
+        CHECK(2 == reloaded.readContainer("LogConfig").readInt("level"));
+    }
+
+    SECTION("broken snapshot is rebuilt")
+    {
+        {
+            std::ofstream output(snapshot.c_str(), std::ofstream::binary);
+            output << "broken snapshot";
+        }
+        JsonCppDocument reloaded;
+        reloaded.setSnapshotCacheEnabled(true);
+        reloaded.loadFile(filename);
+        CHECK_FALSE(reloaded.isLoadedFromSnapshot());
+        CHECK(5 == reloaded.readContainer("LogConfig").readInt("level"));
+
+        reloaded.loadFile(filename);
+        CHECK(reloaded.isLoadedFromSnapshot());
+    }
+
+    SECTION("snapshot with broken node is rebuilt")
+    {
+        std::vector<char> image;
+        {
+            std::ifstream input(snapshot.c_str(), std::ifstream::binary);
+            image.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+        }
+        REQUIRE(image.size() > sizeof(SnapshotHeader));
+        SnapshotHeader header;
+        memcpy(&header, &image[0], sizeof(header));
+
+        // valid header, but children of root, name of root member and
+        // the sorted index of root point out of the image
+        for (int broken = 0; broken < 3; ++broken)
+        {
+            std::vector<char> corrupted = image;
+            SnapshotNode node;
+            size_t offset = header.nodesOffset + (broken == 1 ? sizeof(SnapshotNode) : 0);
+            memcpy(&node, &corrupted[offset], sizeof(node));
+            if (broken == 0)
+            {
+                node.firstChild = header.nodeCount;
+            }
+            else if (broken == 1)
+            {
+                node.name = header.stringsSize - 1;
+            }
+            else
+            {
+                node.sortedChildren = header.sortedCount;
+            }
+            memcpy(&corrupted[offset], &node, sizeof(node));
+            {
+                std::ofstream output(snapshot.c_str(), std::ofstream::binary);
+                output.write(&corrupted[0], corrupted.size());
+            }
+
+            JsonCppDocument reloaded;
+            reloaded.setSnapshotCacheEnabled(true);
+            reloaded.loadFile(filename);
+            CHECK_FALSE(reloaded.isLoadedFromSnapshot());
+            CHECK(5 == reloaded.readContainer("LogConfig").readInt("level"));
+        }
+    }
+
+    SECTION("cache is not used when disabled")
+    {
+        JsonCppDocument reloaded;
+        reloaded.loadFile(filename);
+        CHECK_FALSE(reloaded.isLoadedFromSnapshot());
+    }
+
+    boost::filesystem::remove(filename);
+    boost::filesystem::remove(snapshot);
+}
 
 bool contains_string(JsonCppDocument &doc, const std::string &search)
 {
@@ -285,6 +612,812 @@ bool contains_string(JsonCppDocument &doc, const std::string &search)
     return expression;
 }
 
+SCENARIO("jsoncpp operation profiler", "[jsoncpp]")
+{
+    const char *jsonString = "{\n"
+        "    \"LogConfig\": {\n"
+        "        \"filename\": \"pjsip.log\",\n"
+        "        \"level\": 5,\n"
+        "        \"consoleLevel\": 4\n"
+        "    }\n"
+        "}";
+    JsonCppDocument doc;
+    doc.loadString(jsonString);
+    LogConfig config;
+
+    SECTION("disabled profiler records nothing")
+    {
+        doc.readObject(config);
+        ProfilingStats stats = doc.profiler().stats();
+        CHECK(0 == stats.operations[PROFILE_READ_CONTAINER].calls);
+        CHECK(0 == stats.operations[PROFILE_READ_NUMBER].calls);
+        CHECK(stats.names.empty());
+    }
+
+    SECTION("read operations are counted")
+    {
+        doc.profiler().setEnabled(true);
+        doc.readObject(config);
+        CHECK(5 == config.level);
+        CHECK("pjsip.log" == config.filename);
+
+        ProfilingStats stats = doc.profiler().stats();
+        CHECK(1 == stats.operations[PROFILE_READ_CONTAINER].calls);
+        CHECK(0 == stats.operations[PROFILE_READ_CONTAINER].misses);
+        CHECK(5 == stats.operations[PROFILE_READ_NUMBER].calls);
+        CHECK(3 == stats.operations[PROFILE_READ_NUMBER].misses);
+        CHECK(1 == stats.operations[PROFILE_READ_STRING].calls);
+        CHECK(9 == stats.operations[PROFILE_READ_STRING].bytesCopied);
+        CHECK(0 == stats.operations[PROFILE_WRITE_NUMBER].calls);
+        CHECK(stats.names.empty());
+        CHECK(std::string("readNumber") == profiledOperationName(PROFILE_READ_NUMBER));
+
+        doc.profiler().reset();
+        CHECK(0 == doc.profiler().stats().operations[PROFILE_READ_NUMBER].calls);
+    }
+
+    SECTION("per name stats")
+    {
+        doc.profiler().setEnabled(true);
+        doc.profiler().setPerNameStatsEnabled(true);
+        doc.readObject(config);
+
+        ProfilingStats stats = doc.profiler().stats();
+        REQUIRE(stats.names.count("level"));
+        CHECK(1 == stats.names["level"].calls);
+        CHECK(0 == stats.names["level"].misses);
+        REQUIRE(stats.names.count("decor"));
+        CHECK(1 == stats.names["decor"].misses);
+        CHECK(9 == stats.names["filename"].bytesCopied);
+        CHECK(1 == stats.names["LogConfig"].calls);
+    }
+
+    SECTION("write operations are counted")
+    {
+        JsonCppDocument written;
+        written.profiler().setEnabled(true);
+        config.filename = "pjsip.log";
+        written.writeObject(config);
+
+        ProfilingStats stats = written.profiler().stats();
+        CHECK(1 == stats.operations[PROFILE_WRITE_NEW_CONTAINER].calls);
+        CHECK(5 == stats.operations[PROFILE_WRITE_NUMBER].calls);
+        CHECK(1 == stats.operations[PROFILE_WRITE_STRING].calls);
+        CHECK(9 == stats.operations[PROFILE_WRITE_STRING].bytesCopied);
+    }
+}
+
+SCENARIO("jsoncpp typed numbers", "[jsoncpp]")
+{
+    const int64_t bigInteger = 9007199254740993LL;
+    const int64_t minInteger = -9223372036854775807LL - 1;
+    const double third = 1.0 / 3;
+
+    JsonCppDocument written;
+    ContainerNode numbers = written.writeNewContainer("numbers");
+    written.writeInt64(numbers, "big", bigInteger);
+    written.writeInt64(numbers, "min", minInteger);
+    written.writeDouble(numbers, "third", third);
+    written.writeDouble(numbers, "huge", 1e300);
+    ContainerNode items = numbers.writeNewArray("items");
+    written.writeInt64(items, "", 4000000001LL);
+    written.writeDouble(items, "", 0.1);
+    std::string saved = written.saveString();
+    CHECK(saved.find("\"big\" : 9007199254740993") != std::string::npos);
+    CHECK(saved.find("\"third\" : 0.3333333333333333") != std::string::npos);
+
+    JsonCppDocument doc;
+    doc.loadString(saved);
+
+    SECTION("numbers are read with no float conversion")
+    {
+        ContainerNode node = doc.readContainer("numbers");
+        CHECK(bigInteger == doc.readInt64(node, "big"));
+        CHECK(minInteger == doc.readInt64(node, "min"));
+        CHECK(third == doc.readDouble(node, "third"));
+        CHECK(1e300 == doc.readDouble(node, "huge"));
+        CHECK(0 == doc.readInt64(node, "missing"));
+        CHECK(0 == doc.readDouble(node, "missing"));
+
+        ContainerNode array = node.readArray("items");
+        CHECK(4000000001LL == doc.readInt64(array, ""));
+        CHECK(0.1 == doc.readDouble(array, ""));
+        CHECK_FALSE(array.hasUnread());
+    }
+
+    SECTION("document is used through extension interface")
+    {
+        PersistentDocument &persistent = doc;
+        NumericExtension *extension = dynamic_cast<NumericExtension *>(&persistent);
+        REQUIRE(extension != NULL);
+        ContainerNode node = persistent.readContainer("numbers");
+        CHECK(bigInteger == extension->readInt64(node, "big"));
+    }
+
+    SECTION("reals are truncated, values out of range and not numbers throw")
+    {
+        JsonCppDocument values;
+        values.loadString("{ \"positive\": 1.9, \"negative\": -1.9, \"large\": 1e19, \"unsigned\": 18446744073709551615, \"text\": \"5\", \"flag\": true }");
+        ContainerNode &root = values.getRootContainer();
+        CHECK(1 == values.readInt64(root, "positive"));
+        CHECK(-1 == values.readInt64(root, "negative"));
+        CHECK(1 == values.readInt64(root, "flag"));
+        CHECK(18446744073709551615.0 == values.readDouble(root, "unsigned"));
+        CHECK_THROWS_AS(values.readInt64(root, "large"), Error);
+        CHECK_THROWS_AS(values.readInt64(root, "unsigned"), Error);
+        CHECK_THROWS_AS(values.readInt64(root, "text"), Error);
+        CHECK_THROWS_AS(values.readDouble(root, "text"), Error);
+    }
+
+    SECTION("profiling nodes are nodes of document")
+    {
+        doc.profiler().setEnabled(true);
+        ContainerNode node = doc.readContainer("numbers");
+        CHECK(bigInteger == doc.readInt64(node, "big"));
+        ContainerNode array = node.readArray("items");
+        CHECK(4000000001LL == doc.readInt64(array, ""));
+        CHECK(0.1 == doc.readDouble(array, ""));
+        CHECK_FALSE(array.hasUnread());
+    }
+
+    SECTION("nodes of other documents throw")
+    {
+        ContainerNode node = doc.readContainer("numbers");
+        JsonCppDocument other;
+        CHECK_THROWS_AS(other.readInt64(node, "big"), Error);
+        CHECK_THROWS_AS(other.writeDouble(node, "big", 1), Error);
+    }
+
+    SECTION("snapshot is read with the same precision and is read-only")
+    {
+        const char *filename = "test-typed-numbers-jsoncpp.json";
+        {
+            std::ofstream output(filename, std::ofstream::binary);
+            output << saved;
+        }
+        boost::filesystem::remove(snapshotFilename(filename));
+        {
+            JsonCppDocument parsed;
+            parsed.setSnapshotCacheEnabled(true);
+            parsed.loadFile(filename);
+        }
+        JsonCppDocument snapshot;
+        snapshot.setSnapshotCacheEnabled(true);
+        snapshot.loadFile(filename);
+        REQUIRE(snapshot.isLoadedFromSnapshot());
+
+        ContainerNode node = snapshot.readContainer("numbers");
+        CHECK(bigInteger == snapshot.readInt64(node, "big"));
+        CHECK(minInteger == snapshot.readInt64(node, "min"));
+        CHECK(third == snapshot.readDouble(node, "third"));
+        ContainerNode array = node.readArray("items");
+        CHECK(4000000001LL == snapshot.readInt64(array, ""));
+        CHECK(0.1 == snapshot.readDouble(array, ""));
+        CHECK_THROWS_AS(snapshot.writeInt64(node, "big", 1), Error);
+
+        boost::filesystem::remove(filename);
+        boost::filesystem::remove(snapshotFilename(filename));
+    }
+}
+
+SCENARIO("jsoncpp string views", "[jsoncpp]")
+{
+    JsonCppDocument doc;
+    doc.loadString("{ \"account\": { \"id\": \"sip:alice@example.com\", \"empty\": \"\", \"port\": 5060,"
+                   " \"proxies\": [ \"sip:one.example.com\", \"sip:two.example.com\" ], \"mixed\": [ \"a\", 1 ],"
+                   " \"items\": [ \"first\", [ \"x\", \"y\" ] ] } }");
+    const std::string id = "id";
+    const std::string proxies = "proxies";
+    std::vector<StringView> views;
+
+    SECTION("strings are read as views")
+    {
+        ContainerNode node = doc.readContainer("account");
+        CHECK(doc.readStringView(node, id) == "sip:alice@example.com");
+        CHECK(doc.readStringView(node, "empty").empty());
+        CHECK(doc.readStringView(node, "missing").empty());
+
+        doc.readStringVectorViews(node, proxies, views);
+        REQUIRE(2 == views.size());
+        CHECK(views[0] == "sip:one.example.com");
+        CHECK(views[1] == "sip:two.example.com");
+        doc.readStringVectorViews(node, "missing", views);
+        CHECK(views.empty());
+
+        ContainerNode array = node.readArray("items");
+        CHECK(doc.readStringView(array, "") == "first");
+        doc.readStringVectorViews(array, "", views);
+        REQUIRE(2 == views.size());
+        CHECK(views[1] == "y");
+        CHECK_FALSE(array.hasUnread());
+    }
+
+    SECTION("views are read with no allocations")
+    {
+        ContainerNode node = doc.readContainer("account");
+        doc.readStringVectorViews(node, proxies, views);
+
+        size_t before = allocation_count();
+        StringView view = doc.readStringView(node, id);
+        doc.readStringVectorViews(node, proxies, views);
+        size_t allocations = allocation_count() - before;
+
+        CHECK(0 == allocations);
+        CHECK(view == "sip:alice@example.com");
+        CHECK(2 == views.size());
+    }
+
+    SECTION("not strings and nodes of other documents throw")
+    {
+        ContainerNode node = doc.readContainer("account");
+        CHECK_THROWS_AS(doc.readStringView(node, "port"), Error);
+        CHECK_THROWS_AS(doc.readStringVectorViews(node, "id", views), Error);
+        CHECK_THROWS_AS(doc.readStringVectorViews(node, "mixed", views), Error);
+        JsonCppDocument other;
+        CHECK_THROWS_AS(other.readStringView(node, id), Error);
+    }
+
+    SECTION("profiling nodes are nodes of document")
+    {
+        doc.profiler().setEnabled(true);
+        ContainerNode node = doc.readContainer("account");
+        CHECK(doc.readStringView(node, id) == "sip:alice@example.com");
+        ContainerNode array = node.readArray("items");
+        CHECK(doc.readStringView(array, "") == "first");
+        CHECK(array.hasUnread());
+    }
+
+    SECTION("snapshot strings are read as views")
+    {
+        const char *filename = "test-string-views-jsoncpp.json";
+        doc.saveFile(filename);
+        boost::filesystem::remove(snapshotFilename(filename));
+        {
+            JsonCppDocument parsed;
+            parsed.setSnapshotCacheEnabled(true);
+            parsed.loadFile(filename);
+        }
+        JsonCppDocument snapshot;
+        snapshot.setSnapshotCacheEnabled(true);
+        snapshot.loadFile(filename);
+        REQUIRE(snapshot.isLoadedFromSnapshot());
+
+        ContainerNode node = snapshot.readContainer("account");
+        CHECK(snapshot.readStringView(node, id) == "sip:alice@example.com");
+        CHECK(snapshot.readStringView(node, "missing").empty());
+        CHECK_THROWS_AS(snapshot.readStringView(node, "port"), Error);
+        snapshot.readStringVectorViews(node, proxies, views);
+        REQUIRE(2 == views.size());
+        CHECK(views[1] == "sip:two.example.com");
+        ContainerNode array = node.readArray("items");
+        CHECK(snapshot.readStringView(array, "") == "first");
+        snapshot.readStringVectorViews(array, "", views);
+        REQUIRE(2 == views.size());
+        CHECK(views[0] == "x");
+
+        boost::filesystem::remove(filename);
+        boost::filesystem::remove(snapshotFilename(filename));
+    }
+}
+
+SCENARIO("jsoncpp arena", "[jsoncpp]")
+{
+    std::ostringstream input;
+    input << "{ \"accounts\": [";
+    for (int i = 0; i < 200; ++i)
+    {
+        input << (i == 0 ? "" : ", ") << "{ \"id\": \"sip:account" << i << "@example.com\", \"port\": " << i
+              << ", \"proxies\": [ \"sip:proxy" << i << ".example.com\" ] }";
+    }
+    input << "] }";
+    const std::string text = input.str();
+
+    JsonCppDocument arena;
+    JsonCppDocument heap;
+    heap.setArenaEnabled(false);
+    CHECK(arena.isArenaEnabled());
+    CHECK_FALSE(heap.isArenaEnabled());
+
+    size_t before = allocation_count();
+    heap.loadString(text);
+    size_t heapAllocations = allocation_count() - before;
+    before = allocation_count();
+    arena.loadString(text);
+    size_t arenaAllocations = allocation_count() - before;
+
+    SECTION("tree is allocated from arena")
+    {
+        size_t reduced = heapAllocations / 4;
+        CHECK(arenaAllocations < reduced);
+        CHECK(arena.getArenaSize() > text.size() / 2);
+        CHECK(0 == heap.getArenaSize());
+        CHECK(arena.saveString() == heap.saveString());
+    }
+
+    SECTION("arena is released on reload")
+    {
+        size_t loaded = arena.getArenaSize();
+        arena.loadString(text);
+        CHECK(loaded == arena.getArenaSize());
+        arena.loadString("{ \"small\": \"value\" }");
+        CHECK(arena.getArenaSize() < loaded);
+        CHECK("value" == arena.readString("small"));
+    }
+
+    SECTION("values written over loaded tree are kept")
+    {
+        ContainerNode &root = arena.getRootContainer();
+        ContainerNode accounts = root.readArray("accounts");
+        ContainerNode first = accounts.readContainer("");
+        CHECK("sip:account0@example.com" == first.readString("id"));
+
+        ContainerNode written = arena.writeNewContainer("written");
+        written.writeString("id", "sip:written@example.com");
+        std::string saved = arena.saveString();
+
+        arena.loadString(saved);
+        CHECK("sip:written@example.com" == arena.readContainer("written").readString("id"));
+        ContainerNode reloaded = arena.readArray("accounts").readContainer("");
+        CHECK("sip:account0@example.com" == reloaded.readString("id"));
+    }
+
+    SECTION("document loads again after failed load")
+    {
+        CHECK_THROWS_AS(arena.loadString("{ \"broken\": [ 1, 2"), Error);
+        arena.loadString(text);
+        CHECK("sip:account0@example.com" == arena.readArray("accounts").readContainer("").readString("id"));
+    }
+}
+
+SCENARIO("jsoncpp structural diff", "[jsoncpp]")
+{
+    const std::string text =
+        "{ \"LogConfig\": { \"level\": 5 }, \"accounts\": ["
+        " { \"id\": \"sip:alice@example.com\", \"proxies\": [ \"sip:one.example.com\" ], \"auth\": { \"user\": \"alice\" } },"
+        " { \"id\": \"sip:bob@example.com\", \"proxies\": [], \"auth\": { \"user\": \"bob\" } } ] }";
+    JsonCppDocument previous;
+    previous.loadString(text);
+    JsonCppDocument current;
+    std::vector<std::string> changed;
+
+    SECTION("equal documents have no changes")
+    {
+        current.loadString(text);
+        CHECK(current.diff(previous).empty());
+        CHECK(current.diff(current).empty());
+    }
+
+    SECTION("changed containers are reported by path")
+    {
+        std::string modified = text;
+        modified.replace(modified.find("\"bob\""), 5, "\"robert\"");
+        modified.replace(modified.find("\"level\": 5"), 10, "\"level\": 4");
+        current.loadString(modified);
+        changed = current.diff(previous);
+        REQUIRE(2 == changed.size());
+        CHECK("LogConfig" == changed[0]);
+        CHECK("accounts/1/auth" == changed[1]);
+    }
+
+    SECTION("scalar items change their array")
+    {
+        std::string modified = text;
+        modified.replace(modified.find("\"proxies\": []"), 13, "\"proxies\": [ \"sip:two.example.com\" ]");
+        current.loadString(modified);
+        changed = current.diff(previous);
+        REQUIRE(1 == changed.size());
+        CHECK("accounts/1/proxies" == changed[0]);
+    }
+
+    SECTION("added and removed containers are reported, added scalars change their container")
+    {
+        current.loadString("{ \"LogConfig\": { \"level\": 5 }, \"accounts\": ["
+            " { \"id\": \"sip:alice@example.com\", \"proxies\": [ \"sip:one.example.com\" ], \"auth\": { \"user\": \"alice\" } } ],"
+            " \"UaConfig\": { \"threads\": 1 }, \"version\": 2 }");
+        changed = current.diff(previous);
+        REQUIRE(3 == changed.size());
+        CHECK("" == changed[0]);
+        CHECK("UaConfig" == changed[1]);
+        CHECK("accounts/1" == changed[2]);
+    }
+
+    SECTION("values of other type are changes")
+    {
+        std::string modified = text;
+        modified.replace(modified.find("\"level\": 5"), 10, "\"level\": 5.0");
+        current.loadString(modified);
+        changed = current.diff(previous);
+        REQUIRE(1 == changed.size());
+        CHECK("LogConfig" == changed[0]);
+    }
+
+    SECTION("written values drop cached hashes")
+    {
+        current.loadString(text);
+        CHECK(current.diff(previous).empty());
+        ContainerNode logConfig = current.writeNewContainer("LogConfig");
+        logConfig.writeNumber("level", 3);
+        changed = current.diff(previous);
+        REQUIRE(1 == changed.size());
+        CHECK("LogConfig" == changed[0]);
+    }
+
+    SECTION("unchanged subtrees are skipped by cached hashes")
+    {
+        current.loadString(text);
+        current.diff(previous);
+        size_t before = allocation_count();
+        changed = current.diff(previous);
+        size_t allocations = allocation_count() - before;
+        CHECK(changed.empty());
+        CHECK(0 == allocations);
+    }
+}
+
+SCENARIO("jsoncpp content hash", "[jsoncpp]")
+{
+    const char *filename = "test-content-hash-jsoncpp.json";
+    const std::string text = "{ \"LogConfig\": { \"level\": 5, \"filename\": \"pjsip.log\" } }";
+    {
+        std::ofstream output(filename, std::ofstream::binary);
+        output << text;
+    }
+    JsonCppDocument doc;
+    CHECK_FALSE(doc.hasContentHash());
+    doc.loadFile(filename);
+    REQUIRE(doc.hasContentHash());
+
+    SECTION("content hash is hash of loaded bytes")
+    {
+        CHECK(Hash64::calculate(text.data(), text.size()) == doc.getContentHash());
+        JsonCppDocument fromString;
+        fromString.loadString(text);
+        CHECK(doc.getContentHash() == fromString.getContentHash());
+    }
+
+    SECTION("tree hash does not depend on formatting")
+    {
+        JsonCppDocument formatted;
+        formatted.loadString("{\n    \"LogConfig\": {\n        \"filename\": \"pjsip.log\",\n        \"level\": 5\n    }\n}\n");
+        CHECK(doc.getContentHash() != formatted.getContentHash());
+        CHECK(doc.getTreeHash() == formatted.getTreeHash());
+        formatted.loadString("{ \"LogConfig\": { \"level\": 4, \"filename\": \"pjsip.log\" } }");
+        CHECK(doc.getTreeHash() != formatted.getTreeHash());
+    }
+
+    SECTION("file with the same bytes is not loaded again")
+    {
+        {
+            std::ofstream output(filename, std::ofstream::binary | std::ofstream::trunc);
+            output << text;
+        }
+        pj::ContainerNode logConfig = doc.readContainer("LogConfig");
+        CHECK_FALSE(doc.reloadIfChanged(filename));
+        // nodes of the tree are still valid
+        CHECK(5 == logConfig.readInt("level"));
+    }
+
+    SECTION("changed file is loaded")
+    {
+        {
+            std::ofstream output(filename, std::ofstream::binary | std::ofstream::trunc);
+            output << "{ \"LogConfig\": { \"level\": 4, \"filename\": \"pjsip.log\" } }";
+        }
+        CHECK(doc.reloadIfChanged(filename));
+        CHECK(4 == doc.readContainer("LogConfig").readInt("level"));
+        CHECK_FALSE(doc.reloadIfChanged(filename));
+    }
+
+    SECTION("written document is loaded again")
+    {
+        doc.writeNewContainer("UaConfig");
+        CHECK_FALSE(doc.hasContentHash());
+        CHECK(doc.reloadIfChanged(filename));
+        CHECK(doc.hasContentHash());
+    }
+
+    SECTION("failed load drops content hash")
+    {
+        CHECK_THROWS_AS(doc.loadString("{ \"broken\": "), Error);
+        CHECK_FALSE(doc.hasContentHash());
+        CHECK_THROWS_AS(doc.reloadIfChanged("test-content-hash-missing.json"), Error);
+    }
+
+    SECTION("document loaded from snapshot keeps content hash of its source")
+    {
+        JsonCppDocument cached;
+        cached.setSnapshotCacheEnabled(true);
+        cached.loadFile(filename);
+        cached.loadFile(filename);
+        REQUIRE(cached.isLoadedFromSnapshot());
+        CHECK(doc.getContentHash() == cached.getContentHash());
+        CHECK(doc.getTreeHash() == cached.getTreeHash());
+        CHECK_FALSE(cached.reloadIfChanged(filename));
+        boost::filesystem::remove(snapshotFilename(filename));
+    }
+
+    boost::filesystem::remove(filename);
+}
+
+SCENARIO("jsoncpp freeze", "[jsoncpp]")
+{
+    const std::string text = "{\n"
+        "   \"LogConfig\": { \"filename\": \"pjsip.log\", \"level\": 5, \"consoleLevel\": 4 },\n"
+        "   \"bigValue\": 5000000000,\n"
+        "   \"stringsArray\": [ \"string\", \"other string\" ],\n"
+        "   \"simpleClassArray\": [ { \"intValue\": 16 }, { \"intValue\": 17 } ]\n"
+        "}";
+    JsonCppDocument doc;
+    doc.loadString(text);
+    const std::string saved = doc.saveString();
+    const uint64_t treeHash = doc.getTreeHash();
+    CHECK_FALSE(doc.isFrozen());
+    doc.freeze();
+    CHECK(doc.isFrozen());
+    CHECK_FALSE(doc.isLoadedFromSnapshot());
+
+    SECTION("frozen document is read")
+    {
+        LogConfig config;
+        doc.readObject(config);
+        CHECK(5 == config.level);
+        CHECK("pjsip.log" == config.filename);
+        CHECK(5000000000LL == doc.readInt64(doc.getRootContainer(), "bigValue"));
+        StringVector strings = doc.readStringVector("stringsArray");
+        REQUIRE(2 == strings.size());
+        CHECK("other string" == strings[1]);
+        ContainerNode array = doc.readArray("simpleClassArray");
+        array.readContainer("");
+        CHECK(17 == array.readContainer("").readInt("intValue"));
+        CHECK(doc.readStringView(doc.readContainer("LogConfig"), "filename") == "pjsip.log");
+    }
+
+    SECTION("frozen document is read-only")
+    {
+        CHECK_THROWS_AS(doc.writeString("newValue", "string"), Error);
+        CHECK_THROWS_AS(doc.writeNewArray("newArray"), Error);
+        ContainerNode &root = doc.getRootContainer();
+        CHECK_THROWS_AS(doc.writeInt64(root, "newValue", 1), Error);
+    }
+
+    SECTION("frozen document is saved, hashed and compared as before")
+    {
+        CHECK(saved == doc.saveString());
+        CHECK(treeHash == doc.getTreeHash());
+        CHECK(doc.hasContentHash());
+        JsonCppDocument parsed;
+        parsed.loadString(text);
+        CHECK(parsed.diff(doc).empty());
+    }
+
+    SECTION("thawed document is written")
+    {
+        doc.freeze();
+        doc.thaw();
+        CHECK_FALSE(doc.isFrozen());
+        CHECK(saved == doc.saveString());
+        doc.writeString("newValue", "string");
+        CHECK("string" == doc.readString("newValue"));
+        doc.thaw();
+        CHECK("string" == doc.readString("newValue"));
+    }
+
+    SECTION("load drops frozen layout")
+    {
+        doc.loadString("{ \"value\": 1 }");
+        CHECK_FALSE(doc.isFrozen());
+        doc.writeInt("value", 2);
+        CHECK(2 == doc.readInt("value"));
+    }
+}
+
+SCENARIO("jsoncpp array elements", "[jsoncpp]")
+{
+    JsonCppDocument doc;
+    doc.loadString("{ \"name\": \"items\",\n"
+        "  \"simpleClassArray\": [ { \"intValue\": 16, \"stringValue\": \"a\" }, { \"intValue\": 17, \"stringValue\": \"b\" },"
+        " { \"intValue\": 18, \"stringValue\": \"c\" } ],\n"
+        "  \"arrays\": [ [ 1, 2 ], [ 3 ] ] }");
+    std::vector<ContainerNode> elements;
+
+    SECTION("every item is read by its own node in any order")
+    {
+        doc.readArrayElements(doc.getRootContainer(), "simpleClassArray", elements);
+        REQUIRE(3 == elements.size());
+        for (int i = 2; i >= 0; --i)
+        {
+            SimpleClass item("item");
+            item.readObject(elements[i]);
+            int expected = 16 + i;
+            CHECK(expected == item.intValue);
+        }
+    }
+
+    SECTION("frozen document gives nodes of its layout")
+    {
+        doc.freeze();
+        doc.readArrayElements(doc.getRootContainer(), "simpleClassArray", elements);
+        REQUIRE(3 == elements.size());
+        SimpleClass item("item");
+        item.readObject(elements[1]);
+        CHECK(17 == item.intValue);
+        CHECK("b" == item.stringValue);
+    }
+
+    SECTION("items of array node are arrays too")
+    {
+        ContainerNode arrays = doc.readArray("arrays");
+        doc.readArrayElements(arrays, "", elements);
+        REQUIRE(2 == elements.size());
+        CHECK(2 == elements[1].readNumber(""));
+        CHECK(1 == elements[0].readNumber(""));
+        doc.readArrayElements(arrays, "", elements);
+        REQUIRE(1 == elements.size());
+        CHECK(3 == elements[0].readNumber(""));
+        CHECK_FALSE(arrays.hasUnread());
+    }
+
+    SECTION("not arrays and nodes of other documents throw")
+    {
+        ContainerNode &root = doc.getRootContainer();
+        CHECK_THROWS_AS(doc.readArrayElements(root, "name", elements), Error);
+        CHECK_THROWS_AS(doc.readArrayElements(root, "missing", elements), Error);
+        JsonCppDocument other;
+        CHECK_THROWS_AS(other.readArrayElements(root, "simpleClassArray", elements), Error);
+    }
+}
+
+// Values are equal with their offsets and comments
+static bool same_parsed_values(const Value &left, const Value &right)
+{
+    if (!(left == right)
+        || left.getOffsetStart() != right.getOffsetStart()
+        || left.getOffsetLimit() != right.getOffsetLimit())
+    {
+        return false;
+    }
+    for (int placement = commentBefore; placement < numberOfCommentPlacement; ++placement)
+    {
+        CommentPlacement comment = static_cast<CommentPlacement>(placement);
+        if (left.hasComment(comment) != right.hasComment(comment)
+            || (left.hasComment(comment) && left.getComment(comment) != right.getComment(comment)))
+        {
+            return false;
+        }
+    }
+    if (left.isArray() || left.isObject())
+    {
+        for (Value::const_iterator l = left.begin(), r = right.begin(); l != left.end(); ++l, ++r)
+        {
+            if (!same_parsed_values(*l, *r))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static std::string parallel_load_error(JsonCppDocument &doc, const std::string &input)
+{
+    try
+    {
+        doc.loadString(input);
+    }
+    catch (Error &err)
+    {
+        return err.reason;
+    }
+    return "";
+}
+
+SCENARIO("jsoncpp parallel parsing", "[jsoncpp]")
+{
+    const std::string accounts = "// accounts\n"
+        "{ \"name\": \"[items]\",\n"
+        "  \"accounts\" : [ { \"id\": \"sip:a@b, \\\"c\\\" ]}\", \"ports\": [ 1, 2 ] },\n"
+        "    \"\\\\\", -1.5e3 , true,null,\n"
+        "    [ [], {}, { \"nested\": [ \"]\" ] } ],\n"
+        "    { \"id\": \"tail\\\\\" } ], // after array\n"
+        "  \"count\": 6 }\n";
+
+    Value serial;
+    REQUIRE(Reader().parse(accounts.data(), accounts.data() + accounts.size(), serial));
+
+    SECTION("structural scan finds items of the array")
+    {
+        JsonArrayItems items;
+        REQUIRE(scanJsonArrayItems(accounts.data(), accounts.data() + accounts.size(), "accounts", items));
+        REQUIRE(7 == items.begins.size());
+        CHECK('[' == accounts[items.open]);
+        CHECK(']' == accounts[items.close]);
+        CHECK("\"\\\\\"" == accounts.substr(items.begins[1], items.ends[1] - items.begins[1]));
+        CHECK("-1.5e3" == accounts.substr(items.begins[2], items.ends[2] - items.begins[2]));
+        CHECK("null" == accounts.substr(items.begins[4], items.ends[4] - items.begins[4]));
+
+        CHECK_FALSE(scanJsonArrayItems(accounts.data(), accounts.data() + accounts.size(), "missing", items));
+        CHECK_FALSE(scanJsonArrayItems(accounts.data(), accounts.data() + accounts.size(), "", items));
+        const std::string twice = "{ \"a\": [1, 2], \"a\": [3, 4] }";
+        CHECK_FALSE(scanJsonArrayItems(twice.data(), twice.data() + twice.size(), "a", items));
+        const std::string comments = "[ 1, // one\n 2 ]";
+        CHECK_FALSE(scanJsonArrayItems(comments.data(), comments.data() + comments.size(), "", items));
+        const std::string empty = "[ 1, , 2 ]";
+        CHECK_FALSE(scanJsonArrayItems(empty.data(), empty.data() + empty.size(), "", items));
+    }
+
+    SECTION("tree is the same as serial parser builds, offsets and comments included")
+    {
+        for (unsigned threads = 2; threads <= 8; threads *= 2)
+        {
+            // arenas outlive values allocated from them
+            std::vector<Arena> arenas(threads - 1);
+            Value parallel;
+            REQUIRE(parseJsonArrayInParallel(accounts.data(), accounts.data() + accounts.size(), "accounts", threads, parallel, &arenas));
+            CHECK(same_parsed_values(serial, parallel));
+        }
+
+        const std::string root = " [ 1, \"two\", [ 3 ], { \"four\": 4 } ] ";
+        Value serialRoot;
+        Value parallelRoot;
+        REQUIRE(Reader().parse(root.data(), root.data() + root.size(), serialRoot));
+        REQUIRE(parseJsonArrayInParallel(root.data(), root.data() + root.size(), "", 3, parallelRoot, NULL));
+        CHECK(same_parsed_values(serialRoot, parallelRoot));
+    }
+
+    SECTION("document is loaded by threads")
+    {
+        JsonCppDocument doc;
+        doc.setParallelParsing(4, "accounts", 0);
+        CHECK(4 == doc.getParallelParsingThreads());
+        doc.loadString(accounts);
+        CHECK(doc.isParsedInParallel());
+        CHECK(6 == doc.readInt("count"));
+        ContainerNode array = doc.readArray("accounts");
+        ContainerNode first = array.readContainer("");
+        CHECK("sip:a@b, \"c\" ]}" == first.readString("id"));
+        CHECK("\\" == array.readString(""));
+        CHECK(-1500 == array.readNumber(""));
+
+        doc.setParallelParsing(4, "accounts", accounts.size() + 1);
+        doc.loadString(accounts);
+        CHECK_FALSE(doc.isParsedInParallel());
+    }
+
+    SECTION("input that can't be split is parsed serially")
+    {
+        JsonCppDocument doc;
+        doc.setParallelParsing(4, "accounts", 0);
+        doc.loadString("{ \"accounts\": [ 1, /* two */ 2 ] }");
+        CHECK_FALSE(doc.isParsedInParallel());
+        ContainerNode array = doc.readArray("accounts");
+        CHECK(1 == array.readNumber(""));
+        CHECK(2 == array.readNumber(""));
+        doc.loadString("{ \"accounts\": [ 1 ] }");
+        CHECK_FALSE(doc.isParsedInParallel());
+    }
+
+    SECTION("errors are reported the same way as by serial parser")
+    {
+        const char *inputs[] = {
+            "{ \"accounts\": [ { \"a\": 1 },\n  { \"a\": tru }, 3 ] }",
+            "{ \"accounts\": [ 1,\n  2 3, 4 ] }",
+            "{ \"accounts\": [ 1, 2 ],\n  \"count\": } ",
+            "{ \"accounts\": [ 1, \"\\q\", 3 ] }",
+            "{ \"accounts\": [ 1, 2 ] ",
+        };
+        for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+        {
+            JsonCppDocument serialDoc;
+            JsonCppDocument parallelDoc;
+            parallelDoc.setParallelParsing(4, "accounts", 0);
+            std::string expected = parallel_load_error(serialDoc, inputs[i]);
+            CHECK_FALSE(expected.empty());
+            CHECK(expected == parallel_load_error(parallelDoc, inputs[i]));
+            CHECK_FALSE(parallelDoc.isParsedInParallel());
+        }
+    }
+}
+
 SCENARIO("jsoncpp to string", "[jsoncpp]")
 {
     JsonCppDocument doc(true);
@@ -485,3 +1618,137 @@ SCENARIO("jsoncpp write pjsip LogConfig", "[jsoncpp]")
         REQUIRE(exists(filename));
     }
 }
+
+std::string read_saved_file(const char *filename)
+{
+    std::ifstream input(filename, std::ifstream::binary);
+    std::ostringstream content;
+    content << input.rdbuf();
+    return content.str();
+}
+
+SCENARIO("jsoncpp save to file", "[jsoncpp]")
+{
+    const char *jsonString = "// leading comment\n"
+        "{\n"
+        "    \"empty\": { \"array\": [], \"object\": {} },\n"
+        "    \"numbers\": [ 1, -2, 3.5, 1e300, -9223372036854775808, 18446744073709551615 ],\n"
+        "    \"longLine\": [ \"aaaaaaaaaaaaaaaaaaaa\", \"bbbbbbbbbbbbbbbbbbbb\", \"cccccccccccccccccccc\", \"dddd\" ],\n"
+        "    \"manyItems\": [ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25 ],\n"
+        "    \"nested\": [ [ 1, 2 ], { \"a\": true, \"b\": null }, [] ],\n"
+        "    \"escaped\": \"quote \\\" backslash \\\\ tab \\t line \\n control \\u0001 slash /\",\n"
+        "    \"commented\": 1, // same line comment\n"
+        "    /* before comment */\n"
+        "    \"last\": false\n"
+        "}\n";
+    JsonCppDocument source;
+    source.loadString(jsonString);
+    Json::Value parsed;
+    Json::Reader().parse(jsonString, parsed);
+    char const *filename = "test-save-to-file.json";
+    remove(filename);
+
+    SECTION("styled output is the same as of StyledStreamWriter")
+    {
+        source.saveFile(filename);
+
+        std::ostringstream expected;
+        Json::StyledStreamWriter("    ").write(expected, parsed);
+        CHECK(expected.str() == read_saved_file(filename));
+    }
+
+    SECTION("not styled output is the same as of FastWriter")
+    {
+        JsonCppDocument doc(true);
+        doc.loadString(jsonString);
+        doc.saveFile(filename);
+
+        CHECK(Json::FastWriter().write(parsed) == read_saved_file(filename));
+    }
+
+    SECTION("document larger than writer buffer")
+    {
+        JsonCppDocument doc;
+        ContainerNode array = doc.writeNewArray("items");
+        for (int i = 0; i < 5000; ++i)
+        {
+            ContainerNode item = array.writeNewContainer("item");
+            item.writeInt("index", i);
+            item.writeString("name", "item name");
+        }
+        doc.saveFile(filename);
+
+        CHECK(doc.saveString() == read_saved_file(filename));
+        JsonCppDocument loaded;
+        loaded.loadFile(filename);
+        ContainerNode items = loaded.readArray("items");
+        int count = 0;
+        while (items.hasUnread())
+        {
+            CHECK(count == items.readContainer("item").readInt("index"));
+            ++count;
+        }
+        CHECK(5000 == count);
+    }
+
+    SECTION("file can not be opened")
+    {
+        CHECK_THROWS_AS(source.saveFile("not-existing-directory/test.json"), pj::Error);
+    }
+}
+
+SCENARIO("jsoncpp save to string", "[jsoncpp]")
+{
+    LogConfig config;
+    config.filename = "pjsip.log";
+    ContainerNode array;
+
+    GIVEN("styled document")
+    {
+        JsonCppDocument doc;
+        doc.writeObject(config);
+        array = doc.writeNewArray("items");
+        array.writeString("", "first");
+        array.writeNumber("", 2);
+
+        THEN("output is the same as of StyledStreamWriter")
+        {
+            Json::Value parsed;
+            REQUIRE(Json::Reader().parse(doc.saveString(), parsed));
+            std::ostringstream expected;
+            Json::StyledStreamWriter("    ").write(expected, parsed);
+            CHECK(expected.str() == doc.saveString());
+        }
+
+        THEN("result is allocated once")
+        {
+            doc.saveString();
+            size_t before = allocation_count();
+            std::string saved = doc.saveString();
+            size_t allocations = allocation_count() - before;
+            CHECK(1 == allocations);
+        }
+    }
+
+    GIVEN("not styled document")
+    {
+        JsonCppDocument doc(true);
+        doc.writeObject(config);
+
+        THEN("output is the same as of FastWriter")
+        {
+            Json::Value parsed;
+            REQUIRE(Json::Reader().parse(doc.saveString(), parsed));
+            CHECK(Json::FastWriter().write(parsed) == doc.saveString());
+        }
+
+        THEN("result is allocated once")
+        {
+            doc.saveString();
+            size_t before = allocation_count();
+            std::string saved = doc.saveString();
+            size_t allocations = allocation_count() - before;
+            CHECK(1 == allocations);
+        }
+    }
+}
@@ -0,0 +1,404 @@
+#include <catch/catch.hpp>
+#include <float.h>
+#include <locale.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <pjsettings-jsoncpp.h>
+#include <pjsettings-number.h>
+#include <pjsettings-pugixml.h>
+
+using namespace pj;
+using namespace pjsettings;
+
+static std::string format_double(double value)
+{
+    char buffer[NumberBufferSize];
+    size_t length = formatDouble(value, buffer);
+    return std::string(buffer, length);
+}
+
+static std::string format_float(float value)
+{
+    char buffer[NumberBufferSize];
+    size_t length = formatFloat(value, buffer);
+    return std::string(buffer, length);
+}
+
+static bool same_bits(double a, double b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static bool same_bits(float a, float b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+// Count of significant digits in text of formatDouble or formatFloat
+static int significant_digits(const std::string &text)
+{
+    std::string digits;
+    for (size_t i = 0; i < text.size() && text[i] != 'e'; ++i)
+    {
+        if (text[i] >= '0' && text[i] <= '9')
+        {
+            digits += text[i];
+        }
+    }
+    size_t first = digits.find_first_not_of('0');
+    if (first == std::string::npos)
+    {
+        return 1;
+    }
+    size_t last = digits.find_last_not_of('0');
+    return static_cast<int>(last - first + 1);
+}
+
+// Fewest digits printf needs to round trip the value, read as double and converted to float for floats
+template<class T>
+static int printf_shortest_digits(T value)
+{
+    char buffer[64];
+    for (int precision = 0; precision < 17; ++precision)
+    {
+        snprintf(buffer, sizeof(buffer), "%.*e", precision, static_cast<double>(value));
+        if (same_bits(static_cast<T>(strtod(buffer, NULL)), value))
+        {
+            return precision + 1;
+        }
+    }
+    return 17;
+}
+
+// Fixed seed, same sequence on every platform
+class BitsRandom
+{
+public:
+    BitsRandom() : _state(0x9E3779B97F4A7C15ull) {}
+
+    uint64_t next()
+    {
+        _state ^= _state << 13;
+        _state ^= _state >> 7;
+        _state ^= _state << 17;
+        return _state;
+    }
+
+private:
+    uint64_t _state;
+};
+
+SCENARIO("format double", "[number]")
+{
+    SECTION("known values")
+    {
+        CHECK("0" == format_double(0.0));
+        CHECK("-0" == format_double(-0.0));
+        CHECK("100" == format_double(100.0));
+        CHECK("-42" == format_double(-42.0));
+        CHECK("0.1" == format_double(0.1));
+        CHECK("2.5" == format_double(2.5));
+        CHECK("0.3333333333333333" == format_double(1.0 / 3));
+        CHECK("0.000001" == format_double(0.000001));
+        CHECK("1e-7" == format_double(1e-7));
+        CHECK("1.5e-9" == format_double(1.5e-9));
+        CHECK("100000000000000000000" == format_double(1e20));
+        CHECK("1e+21" == format_double(1e21));
+        CHECK("9007199254740992" == format_double(9007199254740992.0));
+        CHECK("5e-324" == format_double(4.9406564584124654e-324));
+        CHECK("1.7976931348623157e+308" == format_double(DBL_MAX));
+        CHECK("2.2250738585072014e-308" == format_double(DBL_MIN));
+    }
+
+    SECTION("not finite values")
+    {
+        double zero = 0;
+        CHECK("null" == format_double(zero / zero));
+        CHECK("1e+9999" == format_double(1 / zero));
+        CHECK("-1e+9999" == format_double(-1 / zero));
+    }
+
+    SECTION("random values are read back exactly with fewest digits")
+    {
+        BitsRandom random;
+        for (int i = 0; i < 20000; ++i)
+        {
+            uint64_t bits = random.next();
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            if (value != value || value - value != 0)
+            {
+                continue;
+            }
+            std::string text = format_double(value);
+            INFO(text);
+            REQUIRE(same_bits(value, strtod(text.c_str(), NULL)));
+            REQUIRE(printf_shortest_digits(value) == significant_digits(text));
+        }
+    }
+}
+
+SCENARIO("format float", "[number]")
+{
+    SECTION("known values")
+    {
+        CHECK("0.1" == format_float(0.1f));
+        CHECK("20" == format_float(20.0f));
+        CHECK("0.33333334" == format_float(1.0f / 3));
+        CHECK("1e+30" == format_float(1e30f));
+        CHECK("1e-45" == format_float(1.4e-45f));
+        CHECK("3.4028235e+38" == format_float(FLT_MAX));
+        CHECK("0.1" == format_double(floatToShortestDouble(0.1f)));
+        CHECK(0.1 == floatToShortestDouble(0.1f));
+    }
+
+    SECTION("random values are read back exactly with fewest digits")
+    {
+        BitsRandom random;
+        for (int i = 0; i < 20000; ++i)
+        {
+            uint32_t bits = static_cast<uint32_t>(random.next() >> 32);
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            if (value != value || value - value != 0)
+            {
+                continue;
+            }
+            std::string text = format_float(value);
+            INFO(text);
+            REQUIRE(same_bits(value, static_cast<float>(strtod(text.c_str(), NULL))));
+            REQUIRE(printf_shortest_digits(value) == significant_digits(text));
+            REQUIRE(same_bits(value, static_cast<float>(floatToShortestDouble(value))));
+        }
+    }
+}
+
+// Value and length of number at the start of text
+static double parse_double(const std::string &text, size_t &length)
+{
+    double value = -1;
+    const char *begin = text.data();
+    length = static_cast<size_t>(parseDouble(begin, begin + text.size(), value) - begin);
+    return value;
+}
+
+static bool parsed_as_strtod(const std::string &text)
+{
+    size_t length = 0;
+    double value = parse_double(text, length);
+    char *end = NULL;
+    double expected = strtod(text.c_str(), &end);
+    return same_bits(expected, value) && length == static_cast<size_t>(end - text.c_str());
+}
+
+SCENARIO("parse double", "[number]")
+{
+    size_t length = 0;
+
+    SECTION("decimal numbers")
+    {
+        CHECK(0.1 == parse_double("0.1", length));
+        CHECK(3 == length);
+        CHECK(-2500 == parse_double("-2.5e3", length));
+        CHECK(0.5 == parse_double(".5", length));
+        CHECK(5 == parse_double("+5.", length));
+        CHECK(3 == length);
+        CHECK(same_bits(-0.0, parse_double("-0", length)));
+        CHECK(1e22 == parse_double("1e22", length));
+        CHECK(1.5e25 == parse_double("1.5e25", length));
+        CHECK(DBL_MAX == parse_double("1.7976931348623157e+308", length));
+        CHECK(4.9406564584124654e-324 == parse_double("5e-324", length));
+        CHECK(0 == parse_double("1e-400", length));
+        CHECK(parsed_as_strtod("123456789012345678901234567890"));
+        CHECK(parsed_as_strtod("0.000000000000000000000000000000000000001234"));
+        CHECK(parsed_as_strtod("9007199254740993"));
+        CHECK(parsed_as_strtod("2.2250738585072011e-308"));
+    }
+
+    SECTION("number is parsed up to the end of range")
+    {
+        CHECK(12 == parse_double("12abc", length));
+        CHECK(2 == length);
+        CHECK(1 == parse_double("1e", length));
+        CHECK(1 == length);
+        CHECK(1 == parse_double("1e+", length));
+        CHECK(1 == length);
+        CHECK(1.5 == parse_double("1.5,2", length));
+        CHECK(3 == length);
+
+        double value = 0;
+        const char *text = "1234";
+        const char *end = parseDouble(text, text + 2, value);
+        CHECK(2 == end - text);
+        CHECK(12 == value);
+    }
+
+    SECTION("not numbers")
+    {
+        CHECK(0 == parse_double("", length));
+        CHECK(0 == length);
+        CHECK(0 == parse_double("abc", length));
+        CHECK(0 == length);
+        CHECK(0 == parse_double("-", length));
+        CHECK(0 == length);
+        CHECK(0 == parse_double(".e5", length));
+        CHECK(0 == length);
+        CHECK(0 == parse_double(" 5", length));
+        CHECK(0 == length);
+    }
+
+    SECTION("special and hexadecimal numbers")
+    {
+        CHECK(parsed_as_strtod("inf"));
+        CHECK(parsed_as_strtod("-Infinity"));
+        CHECK(parsed_as_strtod("1e400"));
+        CHECK(parsed_as_strtod("0x1A"));
+        CHECK(parsed_as_strtod("0x1.8p1"));
+        double nan = parse_double("NaN", length);
+        CHECK(nan != nan);
+        CHECK(3 == length);
+    }
+
+    SECTION("random numbers are parsed as strtod parses them")
+    {
+        BitsRandom random;
+        char text[64];
+        for (int i = 0; i < 20000; ++i)
+        {
+            uint64_t bits = random.next();
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            if (value != value)
+            {
+                continue;
+            }
+            snprintf(text, sizeof(text), "%.*g", static_cast<int>(bits % 18) + 1, value);
+            INFO(text);
+            REQUIRE(parsed_as_strtod(text));
+            std::string shortest = format_double(value);
+            REQUIRE(parsed_as_strtod(shortest));
+
+            snprintf(text, sizeof(text), "%u.%03ue%d", static_cast<unsigned>(bits % 100000),
+                static_cast<unsigned>((bits >> 20) % 1000), static_cast<int>((bits >> 40) % 60) - 30);
+            REQUIRE(parsed_as_strtod(text));
+        }
+    }
+
+    SECTION("decimal point does not depend on locale")
+    {
+        const char *locales[] = { "de_DE.UTF-8", "ru_RU.UTF-8", "fr_FR.UTF-8", "C.UTF-8" };
+        std::string previous = setlocale(LC_NUMERIC, NULL);
+        for (size_t i = 0; i < sizeof(locales) / sizeof(locales[0]); ++i)
+        {
+            if (setlocale(LC_NUMERIC, locales[i]) != NULL)
+            {
+                break;
+            }
+        }
+        double parsed = parse_double("1.5", length);
+        double slowParsed = parse_double("1.50000000000000000000001", length);
+        setlocale(LC_NUMERIC, previous.c_str());
+        CHECK(1.5 == parsed);
+        CHECK(1.5 == slowParsed);
+    }
+}
+
+SCENARIO("numbers are read from documents without strtod", "[number]")
+{
+    GIVEN("pugixml document with numbers in different forms")
+    {
+        PugixmlDocument doc;
+        doc.loadString("<root><numbers a=\" 5\" b=\"1.5e3\" c=\"12abc\" d=\"abc\" e=\"0x10\"/>"
+            "<list><item>0.25</item><item>-1</item></list></root>");
+        ContainerNode numbers = doc.readContainer("numbers");
+        CHECK(5 == numbers.readNumber("a"));
+        CHECK(1500 == numbers.readNumber("b"));
+        CHECK(12 == numbers.readNumber("c"));
+        CHECK(0 == numbers.readNumber("d"));
+        CHECK(16 == numbers.readNumber("e"));
+        CHECK(0 == numbers.readNumber("missing"));
+        ContainerNode list = doc.readArray("list");
+        CHECK(0.25 == list.readNumber("item"));
+        CHECK(-1 == list.readNumber("item"));
+    }
+
+    GIVEN("json documents with real numbers")
+    {
+        const char *text = "{ \"numbers\" : { \"a\" : 1.5e3, \"b\" : -0.125, \"c\" : 1e400 } }";
+        JsonCppDocument doc;
+        doc.loadString(text);
+        ContainerNode numbers = doc.readContainer("numbers");
+        CHECK(1500 == numbers.readNumber("a"));
+        CHECK(-0.125 == numbers.readNumber("b"));
+        CHECK(numbers.readNumber("c") > FLT_MAX);
+
+        JsonCppDocument wrong;
+        CHECK_THROWS_AS(wrong.loadString("{ \"a\" : .e5 }"), Error);
+    }
+}
+
+template<class Document>
+static void check_number_round_trip(const char *expectedText)
+{
+    BitsRandom random;
+    std::vector<float> values;
+    values.push_back(0.1f);
+    values.push_back(-2.5f);
+    values.push_back(1e-30f);
+    values.push_back(3.4028235e38f);
+    values.push_back(1.4e-45f);
+    for (int i = 0; i < 1000; ++i)
+    {
+        uint32_t bits = static_cast<uint32_t>(random.next() >> 32);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        if (value == value && value - value == 0)
+        {
+            values.push_back(value);
+        }
+    }
+
+    Document written;
+    ContainerNode numbers = written.writeNewContainer("numbers");
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "n%u", static_cast<unsigned>(i));
+        numbers.writeNumber(name, values[i]);
+    }
+    std::string saved = written.saveString();
+    CHECK(saved.find(expectedText) != std::string::npos);
+
+    Document read;
+    read.loadString(saved);
+    ContainerNode readNumbers = read.readContainer("numbers");
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "n%u", static_cast<unsigned>(i));
+        float value = readNumbers.readNumber(name);
+        INFO(name);
+        REQUIRE(same_bits(values[i], value));
+    }
+
+    Document resaved;
+    resaved.loadString(saved);
+    CHECK(saved == resaved.saveString());
+}
+
+SCENARIO("numbers round trip through documents", "[number]")
+{
+    SECTION("jsoncpp")
+    {
+        check_number_round_trip<JsonCppDocument>("\"n0\" : 0.1,");
+    }
+
+    SECTION("pugixml")
+    {
+        check_number_round_trip<PugixmlDocument>("n0=\"0.1\"");
+    }
+}
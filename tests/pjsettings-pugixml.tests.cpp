@@ -1,8 +1,14 @@
 #include <boost/filesystem/operations.hpp>
 #include <catch/catch.hpp>
+#include <cstring>
+#include <fstream>
+#include <pjsettings-hash.h>
+#include <pjsettings-jsoncpp.h>
 #include <pjsettings-pugixml.h>
 #include <pjsua2/endpoint.hpp>
 #include <iostream>
+#include <sstream>
+#include "AllocationCounter.h"
 #include "SimpleClass.h"
 
 using namespace pj;
@@ -273,6 +279,154 @@ SCENARIO("pugixml read pjsip LogConfig", "[pugixml]")
     }
 }
 
+SCENARIO("pugixml name index", "[pugixml]")
+{
+    const char *xmlString = ""
+        "<root>\n"
+        "    <wide a0=\"0\" a1=\"1\" a2=\"2\" a3=\"3\" a4=\"4\" a5=\"5\" a6=\"6\" a7=\"7\" a8=\"8\" a9=\"9\" a5=\"duplicate\">\n"
+        "        <c0 intValue=\"10\" /><c1 /><c2 /><c3 /><c4 /><c5 /><c6 /><c7 />\n"
+        "        <c8 intValue=\"18\" /><c9 /><c8 intValue=\"duplicate\" />\n"
+        "        <strings><add>first</add><add>second</add></strings>\n"
+        "    </wide>\n"
+        "    <narrow a0=\"0\" a1=\"1\" />\n"
+        "</root>";
+    PugixmlDocument doc;
+    doc.setNameIndexEnabled(true);
+    doc.loadString(xmlString);
+
+    SECTION("read attributes of wide node")
+    {
+        ContainerNode node = doc.readContainer("wide");
+        for (int i = 9; i >= 0; --i)
+        {
+            std::ostringstream name;
+            name << "a" << i;
+            CHECK(i == node.readInt(name.str()));
+        }
+        CHECK("" == node.readString("missing"));
+    }
+
+    SECTION("first of duplicate names is found")
+    {
+        ContainerNode node = doc.readContainer("wide");
+        CHECK(5 == node.readInt("a5"));
+        CHECK(18 == node.readContainer("c8").readInt("intValue"));
+    }
+
+    SECTION("read children of wide node")
+    {
+        ContainerNode node = doc.readContainer("wide");
+        CHECK(10 == node.readContainer("c0").readInt("intValue"));
+        StringVector strings = node.readStringVector("strings");
+        REQUIRE(2 == strings.size());
+        CHECK("second" == strings[1]);
+        CHECK(0 == node.readContainer("missing").readInt("intValue"));
+    }
+
+    SECTION("read attributes of narrow node")
+    {
+        ContainerNode node = doc.readContainer("narrow");
+        CHECK(1 == node.readInt("a1"));
+        CHECK(0 == node.readInt("a0"));
+    }
+
+    SECTION("index is invalidated on write")
+    {
+        ContainerNode node = doc.readContainer("wide");
+        CHECK(0 == node.readInt("a10"));
+        node.writeInt("a10", 10);
+        CHECK(10 == node.readInt("a10"));
+
+        CHECK(0 == node.readContainer("c10").readInt("intValue"));
+        ContainerNode child = node.writeNewContainer("c10");
+        child.writeInt("intValue", 20);
+        CHECK(20 == node.readContainer("c10").readInt("intValue"));
+    }
+
+    SECTION("index is cleared on load")
+    {
+        CHECK(1 == doc.readContainer("wide").readInt("a1"));
+        doc.loadString("<root><wide a1=\"11\" /></root>");
+        CHECK(11 == doc.readContainer("wide").readInt("a1"));
+    }
+}
+
+SCENARIO("pugixml attribute read order", "[pugixml]")
+{
+    const char *xmlString = ""
+        "<root a0=\"0\" a1=\"1\" a2=\"2\" a3=\"3\" a4=\"4\">\n"
+        "    <array>\n"
+        "        <add intValue=\"1\" stringValue=\"one\" />\n"
+        "        <add intValue=\"2\" stringValue=\"two\" />\n"
+        "    </array>\n"
+        "</root>";
+    PugixmlDocument doc;
+    doc.loadString(xmlString);
+    ContainerNode &node = doc.getRootContainer();
+
+    SECTION("in order")
+    {
+        for (int i = 0; i < 5; ++i)
+        {
+            std::ostringstream name;
+            name << "a" << i;
+            CHECK(i == node.readInt(name.str()));
+        }
+    }
+
+    SECTION("reverse order")
+    {
+        for (int i = 4; i >= 0; --i)
+        {
+            std::ostringstream name;
+            name << "a" << i;
+            CHECK(i == node.readInt(name.str()));
+        }
+    }
+
+    SECTION("shuffled order with missing names")
+    {
+        CHECK(3 == node.readInt("a3"));
+        CHECK(0 == node.readInt("missing"));
+        CHECK(1 == node.readInt("a1"));
+        CHECK(4 == node.readInt("a4"));
+        CHECK(0 == node.readInt("a0"));
+        CHECK(2 == node.readInt("a2"));
+        CHECK(2 == node.readInt("a2"));
+    }
+
+    SECTION("object node has no unread items")
+    {
+        CHECK(2 == node.readInt("a2"));
+        CHECK(!node.hasUnread());
+        CHECK("root" == node.unreadName());
+    }
+
+    SECTION("write after read")
+    {
+        CHECK(4 == node.readInt("a4"));
+        node.writeInt("a5", 5);
+        CHECK(5 == node.readInt("a5"));
+        CHECK(0 == node.readInt("a0"));
+    }
+
+    SECTION("array of objects")
+    {
+        CHECK(1 == node.readInt("a1"));
+        ContainerNode arrayNode = node.readArray("array");
+        std::vector<SimpleClass> data;
+        while (arrayNode.hasUnread())
+        {
+            ContainerNode item = arrayNode.readContainer("add");
+            CHECK("" != item.readString("stringValue"));
+            data.push_back(SimpleClass("add", item.readInt("intValue")));
+        }
+        REQUIRE(2 == data.size());
+        CHECK(1 == data[0].intValue);
+        CHECK(2 == data[1].intValue);
+    }
+}
+
 SCENARIO("pugixml from file", "[pugixml]")
 {
     const char *filename = "test-config-pugixml.xml";
@@ -288,6 +442,288 @@ SCENARIO("pugixml from file", "[pugixml]")
     CHECK("pjsip.log" == config.filename);
 }
 
+SCENARIO("pugixml from buffer", "[pugixml]")
+{
+    const char *xmlString = "<root><LogConfig level=\"5\" filename=\"pjsip.log\" /></root>";
+    PugixmlDocument doc;
+
+    SECTION("pointer and length")
+    {
+        std::string buffer = std::string(xmlString) + "garbage after buffer end";
+        doc.loadBuffer(buffer.data(), strlen(xmlString));
+    }
+
+    SECTION("text ends at the first NUL")
+    {
+        std::string input = std::string(xmlString) + '\0' + "<garbage";
+        doc.loadString(input);
+        CHECK(doc.getContentHash() == Hash64::calculate(xmlString, strlen(xmlString)));
+    }
+
+#if PJSETTINGS_HAS_RVALUE_REFERENCES
+    SECTION("moved string")
+    {
+        std::string input(xmlString);
+        doc.loadString(std::move(input));
+    }
+
+    SECTION("moved string ends at the first NUL")
+    {
+        std::string input = std::string(xmlString) + '\0' + "<garbage";
+        doc.loadString(std::move(input));
+    }
+
+    SECTION("reload from other string releases moved one")
+    {
+        doc.loadString(std::string("<root />"));
+        doc.loadString(std::string(xmlString));
+    }
+#endif
+
+    LogConfig config;
+    doc.readObject(config);
+    CHECK(5 == config.level);
+    CHECK("pjsip.log" == config.filename);
+}
+
+SCENARIO("pugixml from broken buffer", "[pugixml]")
+{
+    PugixmlDocument doc;
+#if PJSETTINGS_HAS_RVALUE_REFERENCES
+    std::string input("<root><LogConfig></root>");
+    CHECK_THROWS_AS(doc.loadString(std::move(input)), Error);
+#endif
+    CHECK_THROWS_AS(doc.loadBuffer("<root", 5), Error);
+    // strings are UTF-8, UTF-16 text ends at NUL after '<'
+    const char utf16[] = { '<', 0, 'r', 0, '/', 0, '>', 0 };
+    CHECK_THROWS_AS(doc.loadBuffer(utf16, sizeof(utf16)), Error);
+#if PJSETTINGS_HAS_RVALUE_REFERENCES
+    CHECK_THROWS_AS(doc.loadString(std::string(utf16, sizeof(utf16))), Error);
+#endif
+}
+
+SCENARIO("pugixml from mapped file", "[pugixml]")
+{
+    const char *filename = "test-config-pugixml.xml";
+
+    PugixmlDocument doc(pugi::format_default, true);
+    doc.loadFile(filename);
+
+    SECTION("read config")
+    {
+        LogConfig config;
+        doc.readObject(config);
+
+        CHECK(5 == config.level);
+        CHECK(4 == config.consoleLevel);
+        CHECK("pjsip.log" == config.filename);
+    }
+
+    SECTION("write to loaded document")
+    {
+        ContainerNode node = doc.readContainer("LogConfig");
+        node.writeString("newValue", "some string");
+        CHECK(doc.readContainer("LogConfig").readString("newValue") == "some string");
+        CHECK(doc.readContainer("LogConfig").readString("filename") == "pjsip.log");
+    }
+
+    SECTION("memory saving is not more than file size")
+    {
+        CHECK(doc.getMappedMemorySaving() <= boost::filesystem::file_size(filename));
+    }
+
+    SECTION("reload from string releases mapping")
+    {
+        doc.loadString("<root><LogConfig level=\"3\" /></root>");
+        CHECK(0 == doc.getMappedMemorySaving());
+        CHECK(3 == doc.readContainer("LogConfig").readInt("level"));
+    }
+
+    SECTION("missing file")
+    {
+        CHECK_THROWS_AS(doc.loadFile("there-is-no-such-file.xml"), Error);
+    }
+}
+
+SCENARIO("pugixml mapped file changed on disk", "[pugixml]")
+{
+    const std::string filename = "test-mapped-file-changed.xml";
+    const std::string text = "<root><LogConfig filename=\"pjsip.log\" level=\"5\" /></root>";
+    {
+        std::ofstream output(filename.c_str(), std::ofstream::binary | std::ofstream::trunc);
+        output << text;
+    }
+    PugixmlDocument doc(pugi::format_default, true);
+    doc.loadFile(filename);
+    CHECK_FALSE(doc.reloadIfChanged(filename));
+
+    SECTION("file written in place with the same bytes is loaded again")
+    {
+        {
+            std::ofstream output(filename.c_str(), std::ofstream::binary | std::ofstream::trunc);
+            output << text;
+        }
+        // modification time may not change within a single clock tick
+        std::time_t modified = boost::filesystem::last_write_time(filename) - 100;
+        boost::filesystem::last_write_time(filename, modified);
+        CHECK(doc.reloadIfChanged(filename));
+        CHECK(5 == doc.readContainer("LogConfig").readInt("level"));
+        CHECK_FALSE(doc.reloadIfChanged(filename));
+    }
+
+    SECTION("file replaced by rename with the same bytes is not loaded again")
+    {
+        const std::string temporary = filename + ".tmp";
+        {
+            std::ofstream output(temporary.c_str(), std::ofstream::binary | std::ofstream::trunc);
+            output << text;
+        }
+        boost::filesystem::rename(temporary, filename);
+        CHECK_FALSE(doc.reloadIfChanged(filename));
+        CHECK(5 == doc.readContainer("LogConfig").readInt("level"));
+    }
+
+    boost::filesystem::remove(filename);
+}
+
+
+SCENARIO("pugixml snapshot cache", "[pugixml]")
+{
+    const char *filename = "test-snapshot-pugixml.xml";
+    const std::string snapshot = snapshotFilename(filename);
+    const char *xmlString = "<root>\n"
+        "    <LogConfig filename=\"pjsip.log\" level=\"5\" consoleLevel=\"4\" />\n"
+        "    <values doubleValue=\"2.5\" trueBool=\"true\" />\n"
+        "    <stringsArray><item>string</item><item>other string</item></stringsArray>\n"
+        "    <simpleClassArray><SimpleClass intValue=\"16\" /><SimpleClass intValue=\"17\" /></simpleClassArray>\n"
+        "    <intArray><item>19</item><item>20</item></intArray>\n"
+        "</root>\n";
+    {
+        std::ofstream output(filename, std::ofstream::binary);
+        output << xmlString;
+    }
+    boost::filesystem::remove(snapshot);
+
+    PugixmlDocument parsed;
+    parsed.setSnapshotCacheEnabled(true);
+    parsed.loadFile(filename);
+    CHECK_FALSE(parsed.isLoadedFromSnapshot());
+    CHECK(boost::filesystem::exists(snapshot));
+
+    PugixmlDocument doc;
+    doc.setSnapshotCacheEnabled(true);
+    doc.loadFile(filename);
+
+    SECTION("second load reads snapshot")
+    {
+        CHECK(doc.isLoadedFromSnapshot());
+
+        LogConfig config;
+        doc.readObject(config);
+        CHECK(5 == config.level);
+        CHECK(4 == config.consoleLevel);
+        CHECK("pjsip.log" == config.filename);
+    }
+
+    SECTION("failed load of broken file leaves empty document")
+    {
+        REQUIRE(doc.isLoadedFromSnapshot());
+        {
+            std::ofstream output(filename, std::ofstream::binary | std::ofstream::trunc);
+            output << "<root><LogConfig level=\"5\">";
+        }
+        CHECK_THROWS_AS(doc.loadFile(filename), Error);
+        CHECK_FALSE(doc.isLoadedFromSnapshot());
+        CHECK_FALSE(doc.getRootContainer().hasUnread());
+        CHECK_FALSE(doc.readContainer("LogConfig").hasUnread());
+    }
+
+    SECTION("failed load of frozen document leaves empty document")
+    {
+        parsed.freeze();
+        {
+            std::ofstream output(filename, std::ofstream::binary | std::ofstream::trunc);
+            output << "<root><LogConfig level=\"5\">";
+        }
+        CHECK_THROWS_AS(parsed.loadFile(filename), Error);
+        CHECK_FALSE(parsed.isFrozen());
+        CHECK_FALSE(parsed.readContainer("LogConfig").hasUnread());
+    }
+
+    SECTION("failed load of missing file keeps loaded tree")
+    {
+        boost::filesystem::remove(filename);
+        CHECK_THROWS_AS(doc.loadFile(filename), Error);
+        CHECK(doc.isLoadedFromSnapshot());
+        CHECK(5 == doc.readContainer("LogConfig").readInt("level"));
+    }
+
+    SECTION("read values and arrays")
+    {
+        ContainerNode values = doc.readContainer("values");
+        CHECK(2.5 == values.readNumber("doubleValue"));
+        CHECK(values.readBool("trueBool"));
+        CHECK(0 == values.readInt("missingValue"));
+        CHECK("" == values.readString("missingValue"));
+
+        StringVector strings = doc.readStringVector("stringsArray");
+        REQUIRE(2 == strings.size());
+        CHECK("other string" == strings[1]);
+
+        ContainerNode objects = doc.readArray("simpleClassArray");
+        CHECK("SimpleClass" == objects.unreadName());
+        CHECK(16 == objects.readContainer("").readInt("intValue"));
+        CHECK(17 == objects.readContainer("").readInt("intValue"));
+        CHECK_FALSE(objects.hasUnread());
+
+        ContainerNode ints = doc.readArray("intArray");
+        CHECK(19 == ints.readInt(""));
+        CHECK(20 == ints.readInt(""));
+        CHECK_FALSE(ints.hasUnread());
+    }
+
+    SECTION("document is read-only")
+    {
+        CHECK_THROWS_AS(doc.writeString("newValue", "string"), Error);
+        CHECK_THROWS_AS(doc.writeNewArray("newArray"), Error);
+    }
+
+    SECTION("saved document is the same")
+    {
+        CHECK(parsed.saveString() == doc.saveString());
+    }
+
+    SECTION("changed file of the same size is parsed")
+    {
+        // modified within the second the snapshot was built, so only content hash tells
+        std::string changed = xmlString;
+        changed.replace(changed.find("level=\"5\""), 9, "level=\"3\"");
+        {
+            std::ofstream output(filename, std::ofstream::binary);
+            output << changed;
+        }
+        PugixmlDocument reloaded;
+        reloaded.setSnapshotCacheEnabled(true);
+        reloaded.loadFile(filename);
+        CHECK_FALSE(reloaded.isLoadedFromSnapshot());
+        CHECK(3 == reloaded.readContainer("LogConfig").readInt("level"));
+    }
+
+    SECTION("snapshot of other backend is not used")
+    {
+        boost::filesystem::copy_file(filename, "test-snapshot-pugixml.json", boost::filesystem::copy_option::overwrite_if_exists);
+        boost::filesystem::copy_file(snapshot, snapshotFilename("test-snapshot-pugixml.json"), boost::filesystem::copy_option::overwrite_if_exists);
+        JsonCppDocument json;
+        json.setSnapshotCacheEnabled(true);
+        CHECK_THROWS_AS(json.loadFile("test-snapshot-pugixml.json"), Error);
+        CHECK_FALSE(json.isLoadedFromSnapshot());
+        boost::filesystem::remove("test-snapshot-pugixml.json");
+        boost::filesystem::remove(snapshotFilename("test-snapshot-pugixml.json"));
+    }
+
+    boost::filesystem::remove(filename);
+    boost::filesystem::remove(snapshot);
+}
 
 bool contains_string(PugixmlDocument &doc, const std::string &search)
 {
@@ -300,6 +736,693 @@ bool contains_string(PugixmlDocument &doc, const std::string &search)
     return expression;
 }
 
+SCENARIO("pugixml operation profiler", "[pugixml]")
+{
+    const char *xmlString = "<?xml version=\"1.0\"?>\n"
+        "<root>\n"
+        "    <LogConfig filename=\"pjsip.log\" level=\"5\" consoleLevel=\"4\" />\n"
+        "</root>\n";
+    PugixmlDocument doc;
+    doc.loadString(xmlString);
+    LogConfig config;
+
+    SECTION("disabled profiler records nothing")
+    {
+        doc.readObject(config);
+        ProfilingStats stats = doc.profiler().stats();
+        CHECK(0 == stats.operations[PROFILE_READ_CONTAINER].calls);
+        CHECK(0 == stats.operations[PROFILE_READ_NUMBER].calls);
+        CHECK(stats.names.empty());
+    }
+
+    SECTION("read operations are counted")
+    {
+        doc.profiler().setEnabled(true);
+        doc.readObject(config);
+        CHECK(5 == config.level);
+        CHECK("pjsip.log" == config.filename);
+
+        ProfilingStats stats = doc.profiler().stats();
+        CHECK(1 == stats.operations[PROFILE_READ_CONTAINER].calls);
+        CHECK(0 == stats.operations[PROFILE_READ_CONTAINER].misses);
+        CHECK(5 == stats.operations[PROFILE_READ_NUMBER].calls);
+        CHECK(3 == stats.operations[PROFILE_READ_NUMBER].misses);
+        CHECK(1 == stats.operations[PROFILE_READ_STRING].calls);
+        CHECK(9 == stats.operations[PROFILE_READ_STRING].bytesCopied);
+        CHECK(0 == stats.operations[PROFILE_WRITE_NUMBER].calls);
+        CHECK(stats.names.empty());
+        CHECK(std::string("readNumber") == profiledOperationName(PROFILE_READ_NUMBER));
+
+        doc.profiler().reset();
+        CHECK(0 == doc.profiler().stats().operations[PROFILE_READ_NUMBER].calls);
+    }
+
+    SECTION("per name stats")
+    {
+        doc.profiler().setEnabled(true);
+        doc.profiler().setPerNameStatsEnabled(true);
+        doc.readObject(config);
+
+        ProfilingStats stats = doc.profiler().stats();
+        REQUIRE(stats.names.count("level"));
+        CHECK(1 == stats.names["level"].calls);
+        CHECK(0 == stats.names["level"].misses);
+        REQUIRE(stats.names.count("decor"));
+        CHECK(1 == stats.names["decor"].misses);
+        CHECK(9 == stats.names["filename"].bytesCopied);
+        CHECK(1 == stats.names["LogConfig"].calls);
+    }
+
+    SECTION("write operations are counted")
+    {
+        PugixmlDocument written;
+        written.profiler().setEnabled(true);
+        config.filename = "pjsip.log";
+        written.writeObject(config);
+
+        ProfilingStats stats = written.profiler().stats();
+        CHECK(1 == stats.operations[PROFILE_WRITE_NEW_CONTAINER].calls);
+        CHECK(5 == stats.operations[PROFILE_WRITE_NUMBER].calls);
+        CHECK(1 == stats.operations[PROFILE_WRITE_STRING].calls);
+        CHECK(9 == stats.operations[PROFILE_WRITE_STRING].bytesCopied);
+    }
+}
+
+SCENARIO("pugixml typed numbers", "[pugixml]")
+{
+    const int64_t bigInteger = 9007199254740993LL;
+    const int64_t minInteger = -9223372036854775807LL - 1;
+    const double third = 1.0 / 3;
+
+    PugixmlDocument written;
+    ContainerNode numbers = written.writeNewContainer("numbers");
+    written.writeInt64(numbers, "big", bigInteger);
+    written.writeInt64(numbers, "min", minInteger);
+    written.writeDouble(numbers, "third", third);
+    written.writeDouble(numbers, "huge", 1e300);
+    ContainerNode items = numbers.writeNewArray("items");
+    written.writeInt64(items, "", 4000000001LL);
+    written.writeDouble(items, "", 0.1);
+    std::string saved = written.saveString();
+    CHECK(saved.find("big=\"9007199254740993\"") != std::string::npos);
+    CHECK(saved.find("min=\"-9223372036854775808\"") != std::string::npos);
+    CHECK(saved.find("third=\"0.3333333333333333\"") != std::string::npos);
+
+    PugixmlDocument doc;
+    doc.loadString(saved);
+
+    SECTION("numbers are read with no float conversion")
+    {
+        ContainerNode node = doc.readContainer("numbers");
+        CHECK(bigInteger == doc.readInt64(node, "big"));
+        CHECK(minInteger == doc.readInt64(node, "min"));
+        CHECK(third == doc.readDouble(node, "third"));
+        CHECK(1e300 == doc.readDouble(node, "huge"));
+        CHECK(0 == doc.readInt64(node, "missing"));
+        CHECK(0 == doc.readDouble(node, "missing"));
+
+        ContainerNode array = node.readArray("items");
+        CHECK(4000000001LL == doc.readInt64(array, ""));
+        CHECK(0.1 == doc.readDouble(array, ""));
+        CHECK_FALSE(array.hasUnread());
+    }
+
+    SECTION("document is used through extension interface")
+    {
+        PersistentDocument &persistent = doc;
+        NumericExtension *extension = dynamic_cast<NumericExtension *>(&persistent);
+        REQUIRE(extension != NULL);
+        ContainerNode node = persistent.readContainer("numbers");
+        CHECK(bigInteger == extension->readInt64(node, "big"));
+    }
+
+    SECTION("text is read as readNumber reads it, values out of range throw")
+    {
+        PugixmlDocument values;
+        values.loadString("<root positive=\"1.9\" negative=\"-1.9\" spaced=\" 42\" hex=\"0x10\" exponent=\"2e3\" "
+            "text=\"abc\" max=\"9223372036854775807\" large=\"9223372036854775808\" huge=\"1e19\"/>");
+        ContainerNode &root = values.getRootContainer();
+        CHECK(1 == values.readInt64(root, "positive"));
+        CHECK(-1 == values.readInt64(root, "negative"));
+        CHECK(42 == values.readInt64(root, "spaced"));
+        CHECK(16 == values.readInt64(root, "hex"));
+        CHECK(2000 == values.readInt64(root, "exponent"));
+        CHECK(0 == values.readInt64(root, "text"));
+        CHECK(9223372036854775807LL == values.readInt64(root, "max"));
+        CHECK_THROWS_AS(values.readInt64(root, "large"), Error);
+        CHECK_THROWS_AS(values.readInt64(root, "huge"), Error);
+    }
+
+    SECTION("profiling nodes are nodes of document")
+    {
+        doc.profiler().setEnabled(true);
+        ContainerNode node = doc.readContainer("numbers");
+        CHECK(bigInteger == doc.readInt64(node, "big"));
+        CHECK(third == doc.readDouble(node, "third"));
+        ContainerNode array = node.readArray("items");
+        CHECK(4000000001LL == doc.readInt64(array, ""));
+        CHECK(0.1 == doc.readDouble(array, ""));
+        CHECK_FALSE(array.hasUnread());
+    }
+
+    SECTION("nodes of other documents throw")
+    {
+        ContainerNode node = doc.readContainer("numbers");
+        PugixmlDocument other;
+        CHECK_THROWS_AS(other.readInt64(node, "big"), Error);
+        CHECK_THROWS_AS(other.writeDouble(node, "big", 1), Error);
+    }
+
+    SECTION("snapshot is read with the same precision and is read-only")
+    {
+        const char *filename = "test-typed-numbers-pugixml.xml";
+        {
+            std::ofstream output(filename, std::ofstream::binary);
+            output << saved;
+        }
+        boost::filesystem::remove(snapshotFilename(filename));
+        {
+            PugixmlDocument parsed;
+            parsed.setSnapshotCacheEnabled(true);
+            parsed.loadFile(filename);
+        }
+        PugixmlDocument snapshot;
+        snapshot.setSnapshotCacheEnabled(true);
+        snapshot.loadFile(filename);
+        REQUIRE(snapshot.isLoadedFromSnapshot());
+
+        ContainerNode node = snapshot.readContainer("numbers");
+        CHECK(bigInteger == snapshot.readInt64(node, "big"));
+        CHECK(minInteger == snapshot.readInt64(node, "min"));
+        CHECK(third == snapshot.readDouble(node, "third"));
+        ContainerNode array = node.readArray("items");
+        CHECK(4000000001LL == snapshot.readInt64(array, ""));
+        CHECK(0.1 == snapshot.readDouble(array, ""));
+        CHECK_THROWS_AS(snapshot.writeInt64(node, "big", 1), Error);
+
+        boost::filesystem::remove(filename);
+        boost::filesystem::remove(snapshotFilename(filename));
+    }
+}
+
+SCENARIO("pugixml string views", "[pugixml]")
+{
+    StringVector proxyValues;
+    proxyValues.push_back("sip:one.example.com");
+    proxyValues.push_back("sip:two.example.com");
+    StringVector itemValues;
+    itemValues.push_back("x");
+    itemValues.push_back("y");
+
+    PugixmlDocument written;
+    ContainerNode account = written.writeNewContainer("account");
+    account.writeString("id", "sip:alice@example.com");
+    account.writeString("empty", "");
+    account.writeStringVector("proxies", proxyValues);
+    ContainerNode items = account.writeNewArray("items");
+    items.writeString("", "first");
+    items.writeStringVector("", itemValues);
+    std::string saved = written.saveString();
+
+    PugixmlDocument doc;
+    doc.loadString(saved);
+    const std::string id = "id";
+    const std::string proxies = "proxies";
+    std::vector<StringView> views;
+
+    SECTION("text is read as views")
+    {
+        ContainerNode node = doc.readContainer("account");
+        CHECK(doc.readStringView(node, id) == "sip:alice@example.com");
+        CHECK(doc.readStringView(node, "empty").empty());
+        CHECK(doc.readStringView(node, "missing").empty());
+
+        doc.readStringVectorViews(node, proxies, views);
+        REQUIRE(2 == views.size());
+        CHECK(views[0] == "sip:one.example.com");
+        CHECK(views[1] == "sip:two.example.com");
+        doc.readStringVectorViews(node, "missing", views);
+        CHECK(views.empty());
+
+        ContainerNode array = node.readArray("items");
+        CHECK(doc.readStringView(array, "") == "first");
+        doc.readStringVectorViews(array, "", views);
+        REQUIRE(2 == views.size());
+        CHECK(views[1] == "y");
+        CHECK_FALSE(array.hasUnread());
+    }
+
+    SECTION("views are read with no allocations")
+    {
+        ContainerNode node = doc.readContainer("account");
+        doc.readStringVectorViews(node, proxies, views);
+
+        size_t before = allocation_count();
+        StringView view = doc.readStringView(node, id);
+        doc.readStringVectorViews(node, proxies, views);
+        size_t allocations = allocation_count() - before;
+
+        CHECK(0 == allocations);
+        CHECK(view == "sip:alice@example.com");
+        CHECK(2 == views.size());
+    }
+
+    SECTION("profiling nodes are nodes of document")
+    {
+        doc.profiler().setEnabled(true);
+        ContainerNode node = doc.readContainer("account");
+        CHECK(doc.readStringView(node, id) == "sip:alice@example.com");
+        ContainerNode array = node.readArray("items");
+        CHECK(doc.readStringView(array, "") == "first");
+        CHECK(array.hasUnread());
+    }
+
+    SECTION("nodes of other documents throw")
+    {
+        ContainerNode node = doc.readContainer("account");
+        PugixmlDocument other;
+        CHECK_THROWS_AS(other.readStringView(node, id), Error);
+        CHECK_THROWS_AS(other.readStringVectorViews(node, proxies, views), Error);
+    }
+
+    SECTION("snapshot text is read as views")
+    {
+        const char *filename = "test-string-views-pugixml.xml";
+        {
+            std::ofstream output(filename, std::ofstream::binary);
+            output << saved;
+        }
+        boost::filesystem::remove(snapshotFilename(filename));
+        {
+            PugixmlDocument parsed;
+            parsed.setSnapshotCacheEnabled(true);
+            parsed.loadFile(filename);
+        }
+        PugixmlDocument snapshot;
+        snapshot.setSnapshotCacheEnabled(true);
+        snapshot.loadFile(filename);
+        REQUIRE(snapshot.isLoadedFromSnapshot());
+
+        ContainerNode node = snapshot.readContainer("account");
+        CHECK(snapshot.readStringView(node, id) == "sip:alice@example.com");
+        CHECK(snapshot.readStringView(node, "missing").empty());
+        snapshot.readStringVectorViews(node, proxies, views);
+        REQUIRE(2 == views.size());
+        CHECK(views[1] == "sip:two.example.com");
+        ContainerNode array = node.readArray("items");
+        CHECK(snapshot.readStringView(array, "") == "first");
+        snapshot.readStringVectorViews(array, "", views);
+        REQUIRE(2 == views.size());
+        CHECK(views[0] == "x");
+
+        boost::filesystem::remove(filename);
+        boost::filesystem::remove(snapshotFilename(filename));
+    }
+}
+
+#if PJSETTINGS_HAS_PUGIXML_PAGE_POOL
+SCENARIO("pugixml page pool", "[pugixml]")
+{
+    std::ostringstream input;
+    input << "<root><accounts>";
+    for (int i = 0; i < 2000; ++i)
+    {
+        input << "<account id=\"sip:account" << i << "@example.com\" port=\"" << i << "\" />";
+    }
+    input << "</accounts></root>";
+    const std::string large = input.str();
+    const std::string small = "<root><account id=\"sip:small@example.com\" /></root>";
+
+    PugixmlDocument doc;
+    CHECK(32768 == doc.getPageSize());
+    doc.loadString(large);
+    size_t largeInUse = doc.getPagesInUse();
+    CHECK(largeInUse > 2);
+
+    SECTION("pages of previous tree are reused by next load")
+    {
+        doc.loadString(small);
+        CHECK(doc.getPagesInUse() < largeInUse);
+        size_t released = largeInUse - doc.getPagesInUse();
+        CHECK(released == doc.getPooledPages());
+
+        doc.loadString(large);
+        CHECK(largeInUse == doc.getPagesInUse());
+        CHECK(0 == doc.getPooledPages());
+        CHECK("sip:account0@example.com" == doc.readArray("accounts").readContainer("").readString("id"));
+    }
+
+    SECTION("pooled pages are freed by trim")
+    {
+        doc.loadString(small);
+        CHECK(doc.getPooledPages() > 0);
+        doc.trimPagePool();
+        CHECK(0 == doc.getPooledPages());
+        CHECK("sip:small@example.com" == doc.readContainer("account").readString("id"));
+    }
+
+    SECTION("page size is applied on next load")
+    {
+        doc.setPageSize(4096);
+        CHECK(4096 == doc.getPageSize());
+        CHECK(largeInUse == doc.getPagesInUse());
+
+        doc.loadString(large);
+        CHECK(doc.getPagesInUse() > largeInUse * 4);
+        CHECK(0 == doc.getPooledPages());
+        CHECK("sip:account0@example.com" == doc.readArray("accounts").readContainer("").readString("id"));
+
+        ContainerNode written = doc.writeNewContainer("written");
+        written.writeString("id", std::string(10000, 'x'));
+        CHECK(10000 == doc.readContainer("written").readString("id").size());
+    }
+
+    SECTION("page size out of range throws")
+    {
+        CHECK_THROWS_AS(doc.setPageSize(512), Error);
+        CHECK_THROWS_AS(doc.setPageSize(65537), Error);
+        CHECK(32768 == doc.getPageSize());
+    }
+}
+#endif
+
+SCENARIO("pugixml structural diff", "[pugixml]")
+{
+    const std::string text = "<root>"
+        "<LogConfig level=\"5\" consoleLevel=\"4\" />"
+        "<accounts>"
+        "<AccountConfig id=\"sip:alice@example.com\"><proxies><item>sip:one.example.com</item></proxies><auth user=\"alice\" /></AccountConfig>"
+        "<AccountConfig id=\"sip:bob@example.com\"><proxies /><auth user=\"bob\" /></AccountConfig>"
+        "</accounts>"
+        "</root>";
+    PugixmlDocument previous;
+    previous.loadString(text);
+    PugixmlDocument current;
+    std::vector<std::string> changed;
+
+    SECTION("equal documents have no changes")
+    {
+        current.loadString(text);
+        CHECK(current.diff(previous).empty());
+        CHECK(current.diff(current).empty());
+    }
+
+    SECTION("attribute order is not a change")
+    {
+        std::string modified = text;
+        modified.replace(modified.find("level=\"5\" consoleLevel=\"4\""), 26, "consoleLevel=\"4\" level=\"5\"");
+        current.loadString(modified);
+        CHECK(current.diff(previous).empty());
+    }
+
+    SECTION("changed elements are reported by path")
+    {
+        std::string modified = text;
+        modified.replace(modified.find("\"bob\""), 5, "\"robert\"");
+        modified.replace(modified.find("level=\"5\""), 9, "level=\"4\"");
+        current.loadString(modified);
+        changed = current.diff(previous);
+        REQUIRE(2 == changed.size());
+        CHECK("LogConfig" == changed[0]);
+        CHECK("accounts/AccountConfig[1]/auth" == changed[1]);
+    }
+
+    SECTION("text items change their parent")
+    {
+        std::string modified = text;
+        modified.replace(modified.find("<proxies />"), 11, "<proxies><item>sip:two.example.com</item></proxies>");
+        current.loadString(modified);
+        changed = current.diff(previous);
+        REQUIRE(1 == changed.size());
+        CHECK("accounts/AccountConfig[1]/proxies" == changed[0]);
+    }
+
+    SECTION("added and removed elements are reported")
+    {
+        current.loadString("<root version=\"2\">"
+            "<LogConfig level=\"5\" consoleLevel=\"4\" />"
+            "<accounts>"
+            "<AccountConfig id=\"sip:alice@example.com\"><proxies><item>sip:one.example.com</item></proxies><auth user=\"alice\" /></AccountConfig>"
+            "</accounts>"
+            "<UaConfig threads=\"1\" />"
+            "</root>");
+        changed = current.diff(previous);
+        REQUIRE(3 == changed.size());
+        CHECK("" == changed[0]);
+        CHECK("accounts/AccountConfig[1]" == changed[1]);
+        CHECK("UaConfig" == changed[2]);
+    }
+
+    SECTION("written values drop cached hashes")
+    {
+        current.loadString(text);
+        CHECK(current.diff(previous).empty());
+        current.getRootContainer().readContainer("LogConfig").writeNumber("msgLogging", 1);
+        changed = current.diff(previous);
+        REQUIRE(1 == changed.size());
+        CHECK("LogConfig" == changed[0]);
+    }
+
+    SECTION("document loaded from snapshot is compared")
+    {
+        const char *filename = "test-diff-pugixml.xml";
+        {
+            std::ofstream output(filename, std::ofstream::binary);
+            output << text;
+        }
+        current.setSnapshotCacheEnabled(true);
+        current.loadFile(filename);
+        current.loadFile(filename);
+        REQUIRE(current.isLoadedFromSnapshot());
+        CHECK(current.diff(previous).empty());
+        CHECK(previous.diff(current).empty());
+        boost::filesystem::remove(filename);
+        boost::filesystem::remove(snapshotFilename(filename));
+    }
+
+    SECTION("unchanged subtrees are skipped by cached hashes")
+    {
+        current.loadString(text);
+        current.diff(previous);
+        size_t before = allocation_count();
+        changed = current.diff(previous);
+        size_t allocations = allocation_count() - before;
+        CHECK(changed.empty());
+        CHECK(0 == allocations);
+    }
+}
+
+SCENARIO("pugixml content hash", "[pugixml]")
+{
+    const char *filename = "test-content-hash-pugixml.xml";
+    const std::string text = "<root><LogConfig level=\"5\" filename=\"pjsip.log\" /></root>";
+    {
+        std::ofstream output(filename, std::ofstream::binary);
+        output << text;
+    }
+    PugixmlDocument doc;
+    CHECK_FALSE(doc.hasContentHash());
+    doc.loadFile(filename);
+    REQUIRE(doc.hasContentHash());
+
+    SECTION("content hash is hash of loaded bytes")
+    {
+        CHECK(Hash64::calculate(text.data(), text.size()) == doc.getContentHash());
+        PugixmlDocument fromString;
+        fromString.loadString(text);
+        CHECK(doc.getContentHash() == fromString.getContentHash());
+    }
+
+    SECTION("tree hash does not depend on formatting")
+    {
+        PugixmlDocument formatted;
+        formatted.loadString("<root>\n    <LogConfig filename=\"pjsip.log\" level=\"5\" />\n</root>\n");
+        CHECK(doc.getContentHash() != formatted.getContentHash());
+        CHECK(doc.getTreeHash() == formatted.getTreeHash());
+        formatted.loadString("<root><LogConfig level=\"4\" filename=\"pjsip.log\" /></root>");
+        CHECK(doc.getTreeHash() != formatted.getTreeHash());
+    }
+
+    SECTION("file with the same bytes is not loaded again")
+    {
+        {
+            std::ofstream output(filename, std::ofstream::binary | std::ofstream::trunc);
+            output << text;
+        }
+        pj::ContainerNode logConfig = doc.readContainer("LogConfig");
+        CHECK_FALSE(doc.reloadIfChanged(filename));
+        // nodes of the tree are still valid
+        CHECK(5 == logConfig.readInt("level"));
+    }
+
+    SECTION("changed file is loaded")
+    {
+        {
+            std::ofstream output(filename, std::ofstream::binary | std::ofstream::trunc);
+            output << "<root><LogConfig level=\"4\" filename=\"pjsip.log\" /></root>";
+        }
+        CHECK(doc.reloadIfChanged(filename));
+        CHECK(4 == doc.readContainer("LogConfig").readInt("level"));
+        CHECK_FALSE(doc.reloadIfChanged(filename));
+    }
+
+    SECTION("written document is loaded again")
+    {
+        doc.writeNewContainer("UaConfig");
+        CHECK_FALSE(doc.hasContentHash());
+        CHECK(doc.reloadIfChanged(filename));
+        CHECK(doc.hasContentHash());
+    }
+
+    SECTION("failed load drops content hash")
+    {
+        CHECK_THROWS_AS(doc.loadString("<root><broken"), Error);
+        CHECK_FALSE(doc.hasContentHash());
+        CHECK_THROWS_AS(doc.reloadIfChanged("test-content-hash-missing.xml"), Error);
+    }
+
+    SECTION("document loaded from snapshot keeps content hash of its source")
+    {
+        PugixmlDocument cached;
+        cached.setSnapshotCacheEnabled(true);
+        cached.loadFile(filename);
+        cached.loadFile(filename);
+        REQUIRE(cached.isLoadedFromSnapshot());
+        CHECK(doc.getContentHash() == cached.getContentHash());
+        CHECK(doc.getTreeHash() == cached.getTreeHash());
+        CHECK_FALSE(cached.reloadIfChanged(filename));
+        boost::filesystem::remove(snapshotFilename(filename));
+    }
+
+    boost::filesystem::remove(filename);
+}
+
+SCENARIO("pugixml freeze", "[pugixml]")
+{
+    const std::string text = "<root>"
+        "<LogConfig filename=\"pjsip.log\" level=\"5\" consoleLevel=\"4\">text</LogConfig>"
+        "<values bigValue=\"5000000000\" />"
+        "<stringsArray><item>string</item><item>other string</item></stringsArray>"
+        "<simpleClassArray><SimpleClass intValue=\"16\" /><SimpleClass intValue=\"17\" /></simpleClassArray>"
+        "</root>";
+    PugixmlDocument doc;
+    doc.loadString(text);
+    const std::string saved = doc.saveString();
+    const uint64_t treeHash = doc.getTreeHash();
+    CHECK_FALSE(doc.isFrozen());
+    doc.freeze();
+    CHECK(doc.isFrozen());
+    CHECK_FALSE(doc.isLoadedFromSnapshot());
+
+    SECTION("frozen document is read")
+    {
+        LogConfig config;
+        doc.readObject(config);
+        CHECK(5 == config.level);
+        CHECK("pjsip.log" == config.filename);
+        CHECK(5000000000LL == doc.readInt64(doc.readContainer("values"), "bigValue"));
+        StringVector strings = doc.readStringVector("stringsArray");
+        REQUIRE(2 == strings.size());
+        CHECK("other string" == strings[1]);
+        ContainerNode array = doc.readArray("simpleClassArray");
+        array.readContainer("SimpleClass");
+        CHECK(17 == array.readContainer("SimpleClass").readInt("intValue"));
+        CHECK(doc.readStringView(doc.readContainer("LogConfig"), "filename") == "pjsip.log");
+    }
+
+    SECTION("frozen document is read-only")
+    {
+        CHECK_THROWS_AS(doc.writeString("newValue", "string"), Error);
+        CHECK_THROWS_AS(doc.writeNewContainer("newContainer"), Error);
+        ContainerNode values = doc.readContainer("values");
+        CHECK_THROWS_AS(doc.writeDouble(values, "newValue", 1.5), Error);
+    }
+
+    SECTION("frozen document is saved, hashed and compared as before")
+    {
+        CHECK(saved == doc.saveString());
+        CHECK(treeHash == doc.getTreeHash());
+        CHECK(doc.hasContentHash());
+        PugixmlDocument parsed;
+        parsed.loadString(text);
+        CHECK(parsed.diff(doc).empty());
+    }
+
+    SECTION("thawed document is written")
+    {
+        doc.thaw();
+        CHECK_FALSE(doc.isFrozen());
+        CHECK(saved == doc.saveString());
+        doc.writeString("newValue", "string");
+        CHECK("string" == doc.readString("newValue"));
+    }
+
+    SECTION("load drops frozen layout")
+    {
+        doc.loadString("<root value=\"1\" />");
+        CHECK_FALSE(doc.isFrozen());
+        doc.writeInt("other", 2);
+        CHECK(2 == doc.readInt("other"));
+    }
+}
+
+SCENARIO("pugixml array elements", "[pugixml]")
+{
+    PugixmlDocument doc;
+    doc.loadString("<root name=\"items\">"
+        "<simpleClassArray><item intValue=\"16\" stringValue=\"a\" /><item intValue=\"17\" stringValue=\"b\" />"
+        "<item intValue=\"18\" stringValue=\"c\" /></simpleClassArray>"
+        "<arrays><item><v>1</v><v>2</v></item><item><v>3</v></item></arrays>"
+        "</root>");
+    std::vector<ContainerNode> elements;
+
+    SECTION("every item is read by its own node in any order")
+    {
+        doc.readArrayElements(doc.getRootContainer(), "simpleClassArray", elements);
+        REQUIRE(3 == elements.size());
+        for (int i = 2; i >= 0; --i)
+        {
+            SimpleClass item("item");
+            item.readObject(elements[i]);
+            int expected = 16 + i;
+            CHECK(expected == item.intValue);
+        }
+    }
+
+    SECTION("frozen document gives nodes of its layout")
+    {
+        doc.freeze();
+        doc.readArrayElements(doc.getRootContainer(), "simpleClassArray", elements);
+        REQUIRE(3 == elements.size());
+        SimpleClass item("item");
+        item.readObject(elements[1]);
+        CHECK(17 == item.intValue);
+        CHECK("b" == item.stringValue);
+    }
+
+    SECTION("items of array node are arrays too")
+    {
+        ContainerNode arrays = doc.readArray("arrays");
+        doc.readArrayElements(arrays, "", elements);
+        REQUIRE(2 == elements.size());
+        CHECK(2 == elements[1].readNumber("v"));
+        CHECK(1 == elements[0].readNumber("v"));
+        doc.readArrayElements(arrays, "", elements);
+        REQUIRE(1 == elements.size());
+        CHECK(3 == elements[0].readNumber("v"));
+        CHECK_FALSE(arrays.hasUnread());
+    }
+
+    SECTION("missing array gives no nodes, nodes of other documents throw")
+    {
+        ContainerNode &root = doc.getRootContainer();
+        doc.readArrayElements(root, "missing", elements);
+        CHECK(elements.empty());
+        PugixmlDocument other;
+        CHECK_THROWS_AS(other.readArrayElements(root, "simpleClassArray", elements), Error);
+    }
+}
+
 SCENARIO("pugixml to string", "[pugixml]")
 {
     PugixmlDocument doc;
@@ -541,3 +1664,33 @@ SCENARIO("pugixml write pjsip LogConfig", "[pugixml]")
         REQUIRE(exists(filename));
     }
 }
+
+SCENARIO("pugixml save to string", "[pugixml]")
+{
+    LogConfig config;
+    config.filename = "pjsip.log";
+    PugixmlDocument doc;
+    doc.writeObject(config);
+    ContainerNode array = doc.writeNewArray("items");
+    array.writeString("", "first");
+    array.writeNumber("", 2);
+
+    THEN("output is the same as of xml_document::save")
+    {
+        pugi::xml_document parsed;
+        std::string saved = doc.saveString();
+        REQUIRE(parsed.load_buffer(saved.data(), saved.size()));
+        std::ostringstream expected;
+        parsed.save(expected, "    ", pugi::format_default, pugi::encoding_utf8);
+        CHECK(expected.str() == saved);
+    }
+
+    THEN("result is allocated once")
+    {
+        doc.saveString();
+        size_t before = allocation_count();
+        std::string saved = doc.saveString();
+        size_t allocations = allocation_count() - before;
+        CHECK(1 == allocations);
+    }
+}
@@ -0,0 +1,225 @@
+#include <boost/filesystem/operations.hpp>
+#include <catch/catch.hpp>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <pthread.h>
+#include <pjsettings-jsoncpp.h>
+#include <pjsettings-pugixml.h>
+#include <pjsettings-watcher.h>
+
+using namespace pj;
+using namespace pjsettings;
+
+static void write_file(const std::string &filename, const std::string &content)
+{
+    std::ofstream output(filename.c_str(), std::ofstream::binary | std::ofstream::trunc);
+    output << content;
+}
+
+// Replaced as editors save files: written next to it and renamed over it
+static void replace_file(const std::string &filename, const std::string &content)
+{
+    std::string temporary = filename + ".tmp";
+    write_file(temporary, content);
+    rename(temporary.c_str(), filename.c_str());
+}
+
+static std::string read_value(const SharedDocument &document)
+{
+    ContainerNode root = document->getRootContainer();
+    return root.readString("value");
+}
+
+SCENARIO("watcher reloads changed file", "[watcher]")
+{
+    const std::string filename = "test-watcher.json";
+    write_file(filename, "{ \"value\": \"first\" }");
+    FileDocumentLoader<JsonCppDocument> loader;
+    DocumentWatcher watcher(filename, loader);
+    watcher.start();
+
+    SharedDocument first = watcher.document();
+    REQUIRE(first.get() != NULL);
+    CHECK(1 == first.version());
+    CHECK("first" == read_value(first));
+    CHECK(0 == watcher.reloadAttempts());
+
+    SECTION("file written in place is reloaded")
+    {
+        write_file(filename, "{ \"value\": \"second\" }");
+        REQUIRE(watcher.waitReloadAttempts(1, 5000));
+        SharedDocument second = watcher.document();
+        CHECK(2 == second.version());
+        CHECK("second" == read_value(second));
+        CHECK(0 == watcher.reloadFailures());
+
+        // document of previous version stays with its readers
+        CHECK("first" == read_value(first));
+    }
+
+    SECTION("file replaced by rename is reloaded")
+    {
+        replace_file(filename, "{ \"value\": \"renamed\" }");
+        REQUIRE(watcher.waitReloadAttempts(1, 5000));
+        CHECK("renamed" == read_value(watcher.document()));
+    }
+
+    SECTION("broken file keeps previous document published")
+    {
+        write_file(filename, "{ \"value\": ");
+        REQUIRE(watcher.waitReloadAttempts(1, 5000));
+        CHECK(1 == watcher.reloadFailures());
+        CHECK_FALSE(watcher.lastError().empty());
+        SharedDocument current = watcher.document();
+        CHECK(1 == current.version());
+        CHECK("first" == read_value(current));
+
+        write_file(filename, "{ \"value\": \"fixed\" }");
+        REQUIRE(watcher.waitReloadAttempts(2, 5000));
+        CHECK("fixed" == read_value(watcher.document()));
+    }
+
+    SECTION("other files of directory are ignored")
+    {
+        write_file("test-watcher-other.json", "{}");
+        CHECK_FALSE(watcher.waitReloadAttempts(1, 300));
+        boost::filesystem::remove("test-watcher-other.json");
+    }
+
+    SECTION("document stays published after stop")
+    {
+        watcher.stop();
+        write_file(filename, "{ \"value\": \"stopped\" }");
+        CHECK_FALSE(watcher.waitReloadAttempts(1, 300));
+        CHECK("first" == read_value(watcher.document()));
+    }
+
+    watcher.stop();
+    boost::filesystem::remove(filename);
+}
+
+SCENARIO("watcher start fails on missing file", "[watcher]")
+{
+    FileDocumentLoader<JsonCppDocument> loader;
+    DocumentWatcher watcher("test-watcher-missing.json", loader);
+    CHECK_THROWS_AS(watcher.start(), Error);
+    CHECK(NULL == watcher.document().get());
+}
+
+struct WatcherReader
+{
+    DocumentWatcher *watcher;
+    volatile int *stop;         // set atomically by the test thread
+    unsigned long reads;
+    unsigned long inconsistent;
+};
+
+// Both attributes of every published document hold the same version.
+// Readers read through the shared root node of the document and through
+// their own copies of it at once.
+static void *read_published_documents(void *argument)
+{
+    WatcherReader &reader = *static_cast<WatcherReader *>(argument);
+    while (__sync_fetch_and_add(reader.stop, 0) == 0)
+    {
+        SharedDocument document = reader.watcher->document();
+        ContainerNode root = document->getRootContainer();
+        std::string first = root.readString("first");
+        std::string last = document->readString("last");
+        std::string item = document->readContainer("item").readString("index");
+        if (first.empty() || first != last || item != "0")
+        {
+            ++reader.inconsistent;
+        }
+        ++reader.reads;
+    }
+    return NULL;
+}
+
+// Name index of pugixml document is built on reads unless concurrent reads are enabled
+class IndexedPugixmlLoader : public DocumentLoader
+{
+public:
+    virtual PersistentDocument *load(const std::string &filename) throw(Error)
+    {
+        PugixmlDocument *document = new PugixmlDocument();
+        document->setNameIndexEnabled(true);
+        document->loadFile(filename);
+        document->setConcurrentReadEnabled(true);
+        return document;
+    }
+};
+
+static std::string versioned_document(unsigned version)
+{
+    std::ostringstream content;
+    content << "<root first=\"" << version << "\" last=\"" << version << "\">";
+    for (unsigned i = 0; i < 1000; ++i)
+    {
+        content << "<item index=\"" << i << "\" />";
+    }
+    content << "</root>";
+    return content.str();
+}
+
+static void read_while_reloading(DocumentLoader &loader)
+{
+    const std::string filename = "test-watcher.xml";
+    write_file(filename, versioned_document(0));
+    DocumentWatcher watcher(filename, loader);
+    watcher.start();
+    PugixmlDocument *published = dynamic_cast<PugixmlDocument *>(watcher.document().get());
+    REQUIRE(published != NULL);
+    CHECK(published->isConcurrentReadEnabled());
+
+    const unsigned readersCount = 4;
+    volatile int stop = 0;
+    WatcherReader readers[readersCount];
+    pthread_t threads[readersCount];
+    for (unsigned i = 0; i < readersCount; ++i)
+    {
+        WatcherReader reader = { &watcher, &stop, 0, 0 };
+        readers[i] = reader;
+        pthread_create(&threads[i], NULL, &read_published_documents, &readers[i]);
+    }
+
+    const unsigned reloads = 10;
+    for (unsigned version = 1; version <= reloads; ++version)
+    {
+        replace_file(filename, versioned_document(version));
+        watcher.waitReloadAttempts(version, 5000);
+    }
+    __sync_lock_test_and_set(&stop, 1);
+
+    unsigned long reads = 0;
+    unsigned long inconsistent = 0;
+    for (unsigned i = 0; i < readersCount; ++i)
+    {
+        pthread_join(threads[i], NULL);
+        reads += readers[i].reads;
+        inconsistent += readers[i].inconsistent;
+    }
+    watcher.stop();
+    boost::filesystem::remove(filename);
+
+    CHECK(reloads == watcher.reloadAttempts());
+    CHECK(0 == watcher.reloadFailures());
+    CHECK(reads > 0);
+    CHECK(0 == inconsistent);
+}
+
+SCENARIO("watcher readers never see half-loaded document", "[watcher]")
+{
+    SECTION("pugixml documents are read by threads at once")
+    {
+        FileDocumentLoader<PugixmlDocument> loader;
+        read_while_reloading(loader);
+    }
+
+    SECTION("name index is not built by concurrent readers")
+    {
+        IndexedPugixmlLoader loader;
+        read_while_reloading(loader);
+    }
+}